@@ -8,18 +8,28 @@ CONFIG += c++17
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+include(collector.pri)
+
 SOURCES += \
+    analysisreport.cpp \
+    eventlogmodel.cpp \
+    framepresenter.cpp \
+    historychartview.cpp \
     main.cpp \
     mainwindow.cpp \
-    proc_database.cpp \
-    proc_stats.cpp
+    proc_search_index.cpp \
+    processfilterproxymodel.cpp \
+    processtablemodel.cpp
 
 HEADERS += \
+    analysisreport.h \
+    eventlogmodel.h \
+    framepresenter.h \
+    historychartview.h \
     mainwindow.h \
-    proc_database.h \
-    proc_stats.h
-
-LIBS += -lpsapi
+    proc_search_index.h \
+    processfilterproxymodel.h \
+    processtablemodel.h
 
 FORMS += \
     mainwindow.ui_
@@ -0,0 +1,375 @@
+#include "fleet.h"
+#include "proc_push.h"
+#include "proc_stream.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QJsonArray>
+#include <QSqlError>
+#include <QStringList>
+#include <QTcpSocket>
+
+#include <algorithm>
+
+// Largest frame a client may send: a full batch compresses far below this
+static const qsizetype kMaxFrameBytes = 16 << 20;
+
+// The ingest rate is averaged over this many seconds
+static const int kRateSeconds = 5;
+
+// Window of a query that does not give "minutes"
+static const int kDefaultQueryMinutes = 5;
+
+static int metricIndex(const QString &name) {
+    for (size_t i = 0; i < kStatsFieldCount; ++i) {
+        if (name == kStatsFields[i].name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+static QJsonObject queryError(const QString &message) {
+    QJsonObject reply;
+    reply["error"] = message;
+    return reply;
+}
+
+FleetStore::FleetStore(const QString &path, int window_minutes)
+    : window_minutes_(std::max(window_minutes, 1))
+    , connection_(QString("fleet-%1").arg(reinterpret_cast<quintptr>(this)))
+{
+    db_ = QSqlDatabase::addDatabase("QSQLITE", connection_);
+    db_.setDatabaseName(path);
+    if (!db_.open()) {
+        error_ = db_.lastError().text();
+        return;
+    }
+
+    // The collector's columns, preceded by where the sample came from
+    QStringList columns{"HOST", "PID", "PROCESS", "TIME_STAMP"};
+    QStringList definitions{"ID INTEGER PRIMARY KEY", "HOST TEXT", "PID INTEGER", "PROCESS TEXT", "TIME_STAMP INTEGER"};
+    for (const StatsField &field : kStatsFields) {
+        columns.append(field.name);
+        definitions.append(QString("%1 INTEGER").arg(field.name));
+    }
+    QSqlQuery query(db_);
+    if (!query.exec("PRAGMA journal_mode=WAL")
+        || !query.exec(QString("CREATE TABLE IF NOT EXISTS stats (%1)").arg(definitions.join(", ")))
+        || !query.exec("CREATE INDEX IF NOT EXISTS stats_host_time ON stats (HOST, TIME_STAMP)")) {
+        error_ = query.lastError().text();
+        return;
+    }
+
+    insert_ = std::make_unique<QSqlQuery>(db_);
+    QStringList placeholders;
+    for (int i = 0; i < columns.size(); ++i) {
+        placeholders.append("?");
+    }
+    if (!insert_->prepare(QString("INSERT INTO stats (%1) VALUES (%2)").arg(columns.join(", "), placeholders.join(", ")))) {
+        error_ = insert_->lastError().text();
+    }
+}
+
+FleetStore::~FleetStore() {
+    insert_.reset();
+    db_.close();
+    db_ = QSqlDatabase();
+    QSqlDatabase::removeDatabase(connection_);
+}
+
+void FleetStore::Add(const QString &host, const std::vector<StatsSample> &samples) {
+    if (samples.empty()) {
+        return;
+    }
+
+    if (insert_) {
+        db_.transaction();
+        for (const StatsSample &sample : samples) {
+            insert_->bindValue(0, host);
+            insert_->bindValue(1, sample.pid);
+            insert_->bindValue(2, sample.process);
+            insert_->bindValue(3, sample.time_stamp);
+            for (size_t i = 0; i < kStatsFieldCount; ++i) {
+                insert_->bindValue(4 + static_cast<int>(i), sample.stats.*kStatsFields[i].member);
+            }
+            if (!insert_->exec()) {
+                qDebug() << "Error storing a sample of" << host << ":" << insert_->lastError().text();
+            }
+        }
+        db_.commit();
+    }
+
+    Host &info = hosts_[host];
+    for (const StatsSample &sample : samples) {
+        Minute &minute = minutes_[sample.time_stamp / 60000];
+        KeyMinute &key = minute.keys[Key(host, sample.pid)];
+        key.process = sample.process;
+        for (size_t i = 0; i < kStatsFieldCount; ++i) {
+            const double value = static_cast<double>(sample.stats.*kStatsFields[i].member);
+            minute.sketches[i].Add(value);
+            Moments &moments = key.metrics[i];
+            moments.max = moments.count == 0 ? value : std::max(moments.max, value);
+            moments.sum += value;
+            ++moments.count;
+        }
+        if (sample.time_stamp >= info.last_time) {
+            info.last_time = sample.time_stamp;
+            info.pid = sample.pid;
+            info.process = sample.process;
+        }
+    }
+    info.samples += samples.size();
+    ingested_ += samples.size();
+
+    // Summaries older than the window are only in the table
+    const qint64 oldest = QDateTime::currentMSecsSinceEpoch() / 60000 - window_minutes_;
+    minutes_.erase(minutes_.begin(), minutes_.lower_bound(oldest));
+}
+
+QJsonObject FleetStore::Query(const QJsonObject &request) const {
+    const QString kind = request["query"].toString();
+    if (kind == "hosts") {
+        return Hosts();
+    }
+
+    const int metric = metricIndex(request["metric"].toString());
+    if (metric < 0) {
+        return queryError("unknown metric " + request["metric"].toString());
+    }
+    const int minutes = std::clamp(request["minutes"].toInt(kDefaultQueryMinutes), 1, window_minutes_);
+    if (kind == "top") {
+        return Top(metric, std::max(request["k"].toInt(10), 1), minutes, request["by"].toString() == "max");
+    }
+    if (kind == "percentiles") {
+        std::vector<double> quantiles;
+        for (const QJsonValue &value : request["quantiles"].toArray()) {
+            quantiles.push_back(std::clamp(value.toDouble(), 0.0, 1.0));
+        }
+        if (quantiles.empty()) {
+            quantiles = {0.5, 0.95, 0.99};
+        }
+        return Percentiles(metric, quantiles, minutes);
+    }
+    return queryError("unknown query " + kind);
+}
+
+QJsonObject FleetStore::Top(int metric, int k, int minutes, bool by_max) const {
+    struct Total {
+        QString process;
+        Moments moments;
+    };
+    QHash<Key, Total> totals;
+    const qint64 first = QDateTime::currentMSecsSinceEpoch() / 60000 - minutes + 1;
+    for (auto it = minutes_.lower_bound(first); it != minutes_.end(); ++it) {
+        for (auto key = it->second.keys.constBegin(); key != it->second.keys.constEnd(); ++key) {
+            const Moments &moments = key->metrics[metric];
+            Total &total = totals[key.key()];
+            total.process = key->process;
+            total.moments.max = total.moments.count == 0 ? moments.max : std::max(total.moments.max, moments.max);
+            total.moments.sum += moments.sum;
+            total.moments.count += moments.count;
+        }
+    }
+
+    struct Ranked {
+        Key key;
+        QString process;
+        double mean;
+        double max;
+        quint64 count;
+    };
+    std::vector<Ranked> ranked;
+    ranked.reserve(static_cast<size_t>(totals.size()));
+    for (auto it = totals.constBegin(); it != totals.constEnd(); ++it) {
+        const Moments &moments = it->moments;
+        ranked.push_back({it.key(), it->process, moments.sum / static_cast<double>(std::max<quint64>(moments.count, 1)),
+                          moments.max, moments.count});
+    }
+    const size_t shown = std::min(ranked.size(), static_cast<size_t>(k));
+    std::partial_sort(ranked.begin(), ranked.begin() + static_cast<std::ptrdiff_t>(shown), ranked.end(),
+                      [by_max](const Ranked &a, const Ranked &b) { return by_max ? a.max > b.max : a.mean > b.mean; });
+
+    QJsonArray rows;
+    for (size_t i = 0; i < shown; ++i) {
+        QJsonObject row;
+        row["host"] = ranked[i].key.first;
+        row["pid"] = static_cast<qint64>(ranked[i].key.second);
+        row["process"] = ranked[i].process;
+        row["mean"] = ranked[i].mean;
+        row["max"] = ranked[i].max;
+        row["samples"] = static_cast<qint64>(ranked[i].count);
+        rows.append(row);
+    }
+    QJsonObject reply;
+    reply["metric"] = kStatsFields[metric].name;
+    reply["minutes"] = minutes;
+    reply["top"] = rows;
+    return reply;
+}
+
+QJsonObject FleetStore::Percentiles(int metric, const std::vector<double> &quantiles, int minutes) const {
+    QuantileSketch merged;
+    const qint64 first = QDateTime::currentMSecsSinceEpoch() / 60000 - minutes + 1;
+    for (auto it = minutes_.lower_bound(first); it != minutes_.end(); ++it) {
+        merged.Merge(it->second.sketches[metric]);
+    }
+
+    QJsonArray values;
+    for (double q : quantiles) {
+        QJsonObject value;
+        value["quantile"] = q;
+        value["value"] = merged.Quantile(q);
+        values.append(value);
+    }
+    QJsonObject reply;
+    reply["metric"] = kStatsFields[metric].name;
+    reply["minutes"] = minutes;
+    reply["samples"] = static_cast<qint64>(merged.Count());
+    reply["relative_accuracy"] = QuantileSketch::kRelativeAccuracy;
+    reply["percentiles"] = values;
+    return reply;
+}
+
+QJsonObject FleetStore::Hosts() const {
+    QJsonArray rows;
+    for (auto it = hosts_.constBegin(); it != hosts_.constEnd(); ++it) {
+        QJsonObject row;
+        row["host"] = it.key();
+        row["last_time"] = it->last_time;
+        row["pid"] = static_cast<qint64>(it->pid);
+        row["process"] = it->process;
+        row["samples"] = static_cast<qint64>(it->samples);
+        rows.append(row);
+    }
+    QJsonObject reply;
+    reply["hosts"] = rows;
+    return reply;
+}
+
+struct FleetServer::Connection {
+    QTcpSocket *socket = nullptr;
+    QByteArray input;
+    QString host;           // set by the Hello of a collector
+    bool closed = false;
+};
+
+FleetServer::FleetServer(FleetStore *store) : store_(store) {
+    QObject::connect(&server_, &QTcpServer::newConnection, &server_, [this]() { Accept(); });
+    QObject::connect(&rate_timer_, &QTimer::timeout, &server_, [this]() { Tick(); });
+    clock_.start();
+    rate_timer_.start(1000);
+}
+
+FleetServer::~FleetServer() {
+    for (const std::unique_ptr<Connection> &connection : connections_) {
+        if (!connection->closed) {
+            QObject::disconnect(connection->socket, nullptr, &server_, nullptr);
+        }
+    }
+    connections_.clear();
+    server_.close();
+}
+
+bool FleetServer::Listen(const QHostAddress &address, quint16 port) {
+    return server_.listen(address, port);
+}
+
+double FleetServer::IngestRate() const {
+    if (rate_points_.size() < 2) {
+        return 0.0;
+    }
+    const auto &first = rate_points_.front();
+    const auto &last = rate_points_.back();
+    return static_cast<double>(last.second - first.second) * 1000.0 / static_cast<double>(std::max<qint64>(last.first - first.first, 1));
+}
+
+void FleetServer::Tick() {
+    rate_points_.emplace_back(clock_.elapsed(), store_->IngestedCount());
+    while (rate_points_.size() > static_cast<size_t>(kRateSeconds) + 1) {
+        rate_points_.pop_front();
+    }
+}
+
+QJsonObject FleetServer::Status() const {
+    QJsonObject reply;
+    reply["ingested"] = static_cast<qint64>(store_->IngestedCount());
+    reply["samples_per_second"] = IngestRate();
+    reply["hosts"] = store_->HostCount();
+    reply["connections"] = ConnectionCount();
+    return reply;
+}
+
+void FleetServer::Accept() {
+    while (QTcpSocket *socket = server_.nextPendingConnection()) {
+        auto connection = std::make_unique<Connection>();
+        connection->socket = socket;
+        Connection *raw = connection.get();
+        QObject::connect(socket, &QTcpSocket::readyRead, &server_, [this, raw]() { Receive(raw); });
+        QObject::connect(socket, &QTcpSocket::disconnected, &server_, [this, raw]() { Remove(raw); });
+        connections_.push_back(std::move(connection));
+    }
+}
+
+void FleetServer::Receive(Connection *connection) {
+    if (connection->closed) {
+        return;
+    }
+    connection->input.append(connection->socket->readAll());
+
+    qsizetype offset = 0;
+    quint8 type;
+    QByteArrayView payload;
+    bool valid = true;
+    while (valid && NextStreamFrame(connection->input, offset, type, payload)) {
+        switch (type) {
+        case PushHello:
+            valid = DecodeHello(payload, connection->host);
+            break;
+        case PushBatch:
+            decoded_.clear();
+            valid = !connection->host.isEmpty() && DecodeBatch(payload, decoded_);
+            if (valid) {
+                store_->Add(connection->host, decoded_);
+            }
+            break;
+        case FleetQuery: {
+            QJsonObject request;
+            valid = DecodeJsonFrame(payload, request);
+            if (valid) {
+                QByteArray reply;
+                EncodeJsonFrame(FleetResult, request["query"].toString() == "status" ? Status() : store_->Query(request), reply);
+                connection->socket->write(reply);
+            }
+            break;
+        }
+        default:
+            valid = false;
+        }
+    }
+    if (!valid) {
+        qDebug() << "Dropping" << connection->socket->peerAddress().toString() << ": malformed frame";
+        connection->socket->abort();
+        return;
+    }
+    connection->input.remove(0, offset);
+    if (connection->input.size() > kMaxFrameBytes) {
+        connection->socket->abort();
+    }
+}
+
+void FleetServer::Remove(Connection *connection) {
+    if (connection->closed) {
+        return;
+    }
+    // Called from inside the socket; erased once back in the event loop
+    connection->closed = true;
+    connection->socket->deleteLater();
+    QMetaObject::invokeMethod(&server_, [this]() { Prune(); }, Qt::QueuedConnection);
+}
+
+void FleetServer::Prune() {
+    connections_.erase(std::remove_if(connections_.begin(), connections_.end(),
+                                      [](const std::unique_ptr<Connection> &connection) { return connection->closed; }),
+                       connections_.end());
+}
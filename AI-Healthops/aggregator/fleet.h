@@ -0,0 +1,125 @@
+#ifndef FLEET_H
+#define FLEET_H
+
+#include "proc_sketch.h"
+#include "proc_stats.h"
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostAddress>
+#include <QJsonObject>
+#include <QPair>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+#include <QTcpServer>
+#include <QTimer>
+
+#include <array>
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+
+class QTcpSocket;
+
+// Samples of every host pushing to the aggregator. Each one is stored in
+// the stats table, whose columns are those of a collector's plus HOST, PID
+// and PROCESS, and counted into per-minute summaries that answer fleet-wide
+// queries over the last window_minutes without touching the table:
+//   {"query": "top", "metric": "CPU_USERPERCENT", "k": 10, "minutes": 5, "by": "mean"}
+//       the k host/process pairs with the highest mean (or "max") value
+//   {"query": "percentiles", "metric": "PROC_WORKINGSETSIZE", "minutes": 15,
+//    "quantiles": [0.5, 0.95, 0.99]}
+//       quantiles of the metric over every sample of every host
+//   {"query": "hosts"}
+//       every host with its last sample
+// Windows cover whole minutes, the current one included.
+struct FleetStore
+{
+    explicit FleetStore(const QString &path, int window_minutes = 60);
+    ~FleetStore();
+
+    bool Ok() const { return error_.isEmpty(); }
+    QString ErrorString() const { return error_; }
+
+    // Stores the samples in one transaction
+    void Add(const QString &host, const std::vector<StatsSample> &samples);
+    QJsonObject Query(const QJsonObject &request) const;
+
+    quint64 IngestedCount() const { return ingested_; }
+    int HostCount() const { return static_cast<int>(hosts_.size()); }
+
+private:
+    using Key = QPair<QString, quint32>;   // host and pid
+
+    struct Moments {
+        quint64 count = 0;
+        double sum = 0.0;
+        double max = 0.0;
+    };
+    struct KeyMinute {
+        QString process;
+        std::array<Moments, kStatsFieldCount> metrics;
+    };
+    struct Minute {
+        std::array<QuantileSketch, kStatsFieldCount> sketches;
+        QHash<Key, KeyMinute> keys;
+    };
+    struct Host {
+        qint64 last_time = 0;
+        quint32 pid = 0;
+        QString process;
+        quint64 samples = 0;
+    };
+
+    QJsonObject Top(int metric, int k, int minutes, bool by_max) const;
+    QJsonObject Percentiles(int metric, const std::vector<double> &quantiles, int minutes) const;
+    QJsonObject Hosts() const;
+
+    int window_minutes_;
+    QString connection_;
+    QSqlDatabase db_;
+    std::unique_ptr<QSqlQuery> insert_;
+    QString error_;
+
+    std::map<qint64, Minute> minutes_;   // by minute since the epoch
+    QHash<QString, Host> hosts_;
+    quint64 ingested_ = 0;
+};
+
+// TCP endpoint collectors push to and clients query, on the calling
+// thread's event loop
+struct FleetServer
+{
+    explicit FleetServer(FleetStore *store);
+    ~FleetServer();
+
+    bool Listen(const QHostAddress &address, quint16 port);
+    QString ErrorString() const { return server_.errorString(); }
+    quint16 Port() const { return server_.serverPort(); }
+
+    int ConnectionCount() const { return static_cast<int>(connections_.size()); }
+    // Samples ingested per second over the last few seconds
+    double IngestRate() const;
+
+private:
+    struct Connection;
+
+    void Accept();
+    void Receive(Connection *connection);
+    void Remove(Connection *connection);
+    void Prune();
+    void Tick();
+    QJsonObject Status() const;
+
+    FleetStore *store_;
+    QTcpServer server_;
+    QTimer rate_timer_;
+    std::vector<std::unique_ptr<Connection>> connections_;
+    std::vector<StatsSample> decoded_;
+    std::deque<std::pair<qint64, quint64>> rate_points_;   // (ms, ingested)
+    QElapsedTimer clock_;
+};
+
+#endif // FLEET_H
@@ -0,0 +1,30 @@
+QT = core network sql
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = healthops-aggregator
+
+# Fleet aggregator: collectors started with --push stream their samples
+# here over TCP, where they are stored per host and queried fleet-wide
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    fleet.cpp \
+    main.cpp \
+    ../proc_push.cpp \
+    ../proc_sketch.cpp \
+    ../proc_stream.cpp
+
+HEADERS += \
+    fleet.h \
+    ../proc_push.h \
+    ../proc_sketch.h \
+    ../proc_stats.h \
+    ../proc_stream.h
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
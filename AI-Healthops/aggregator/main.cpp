@@ -0,0 +1,128 @@
+#include "fleet.h"
+#include "proc_push.h"
+#include "proc_stream.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QJsonDocument>
+#include <QStandardPaths>
+#include <QTcpSocket>
+#include <QTimer>
+
+#include <cstdio>
+
+// How often the ingest rate is logged
+static const int kLogIntervalMs = 10000;
+
+// Longest a --query client waits for the aggregator
+static const int kQueryTimeoutMs = 10000;
+
+// Sends one query to a running aggregator and prints its reply
+static int runQuery(const QString &server, const QString &text)
+{
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(text.toUtf8(), &parseError);
+    if (!document.isObject()) {
+        std::fprintf(stderr, "query: %s\n", qPrintable(parseError.errorString()));
+        return 1;
+    }
+
+    const QStringList parts = server.split(':');
+    const quint16 port = parts.size() > 1 ? parts[1].toUShort() : 0;
+    QTcpSocket socket;
+    socket.connectToHost(parts[0], port ? port : kDefaultAggregatorPort);
+    if (!socket.waitForConnected(kQueryTimeoutMs)) {
+        std::fprintf(stderr, "connect: %s\n", qPrintable(socket.errorString()));
+        return 1;
+    }
+    QByteArray request;
+    EncodeJsonFrame(FleetQuery, document.object(), request);
+    socket.write(request);
+
+    QByteArray input;
+    qsizetype offset = 0;
+    quint8 type;
+    QByteArrayView payload;
+    while (!NextStreamFrame(input, offset, type, payload)) {
+        if (!socket.waitForReadyRead(kQueryTimeoutMs)) {
+            std::fprintf(stderr, "reply: %s\n", qPrintable(socket.errorString()));
+            return 1;
+        }
+        input.append(socket.readAll());
+    }
+    QJsonObject reply;
+    if (type != FleetResult || !DecodeJsonFrame(payload, reply)) {
+        std::fprintf(stderr, "reply: malformed\n");
+        return 1;
+    }
+    std::printf("%s", QJsonDocument(reply).toJson(QJsonDocument::Indented).constData());
+    return reply.contains("error") ? 1 : 0;
+}
+
+// To try a fleet on one machine, start the aggregator and then several
+// daemons pushing to it, each with its own store and without the local
+// endpoints the first one already holds:
+//   healthops-aggregator --db fleet.db
+//   healthops-daemon --db a/healthops.db --stream "" --shared "" --push localhost --host-name a
+//   healthops-daemon --db b/healthops.db --stream "" --shared "" --push localhost --host-name b
+//   healthops-aggregator --query '{"query": "top", "metric": "CPU_USERPERCENT", "k": 5}'
+// Collectors are not authenticated, so the aggregator only listens on the
+// loopback unless --bind names an interface of a trusted network.
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("healthops-aggregator");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("AI HealthOps fleet aggregator");
+    parser.addHelpOption();
+    const QCommandLineOption portOption("port", "Port collectors push to and clients query.", "port",
+                                        QString::number(kDefaultAggregatorPort));
+    const QCommandLineOption bindOption("bind", "Address to listen on; 0.0.0.0 for other hosts.", "address", "127.0.0.1");
+    const QCommandLineOption dbOption("db", "Database file, default <data dir>/fleet.db.", "file");
+    const QCommandLineOption windowOption("window-minutes", "Minutes of summaries kept for queries.", "minutes", "60");
+    const QCommandLineOption queryOption("query", "Send a JSON query to a running aggregator and print the reply.", "json");
+    const QCommandLineOption serverOption("server", "Aggregator --query is sent to.", "host[:port]", "localhost");
+    parser.addOptions({portOption, bindOption, dbOption, windowOption, queryOption, serverOption});
+    parser.process(app);
+
+    if (parser.isSet(queryOption)) {
+        return runQuery(parser.value(serverOption), parser.value(queryOption));
+    }
+
+    // Next to the collectors' stores, as Collector::DataDir() has it
+    QString dbPath = parser.value(dbOption);
+    if (dbPath.isEmpty()) {
+        const QString dir = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + "/AI-Healthops_2";
+        QDir().mkpath(dir);
+        dbPath = dir + "/fleet.db";
+    }
+
+    FleetStore store(dbPath, parser.value(windowOption).toInt());
+    if (!store.Ok()) {
+        qWarning().noquote() << "Could not open" << dbPath << ":" << store.ErrorString();
+        return 1;
+    }
+    FleetServer server(&store);
+    const QHostAddress address(parser.value(bindOption));
+    const quint16 port = parser.value(portOption).toUShort();
+    if (!server.Listen(address, port)) {
+        qWarning().noquote() << "Could not listen on" << address.toString() << port << ":" << server.ErrorString();
+        return 1;
+    }
+    qInfo().noquote() << QString("Aggregating into %1 on %2:%3").arg(dbPath, address.toString()).arg(port);
+
+    QTimer logTimer;
+    QObject::connect(&logTimer, &QTimer::timeout, [&server, &store]() {
+        qInfo().noquote() << QString("Ingested %1 samples/s from %2 hosts over %3 connections, %4 in total")
+                                 .arg(server.IngestRate(), 0, 'f', 0)
+                                 .arg(store.HostCount())
+                                 .arg(server.ConnectionCount())
+                                 .arg(store.IngestedCount());
+    });
+    logTimer.start(kLogIntervalMs);
+
+    return app.exec();
+}
@@ -0,0 +1,59 @@
+#include "analysisreport.h"
+#include "proc_trace.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonValue>
+
+bool parseAnalysisFile(const QByteArray &content, QJsonObject &json, QString &error)
+{
+    TRACE_SPAN("analysis.parse");
+    // The file has a text header; the JSON starts at the first '{'
+    const qsizetype jsonStartPos = content.indexOf('{');
+    if (jsonStartPos == -1) {
+        error = "Could not find the start of JSON content in the file.";
+        return false;
+    }
+
+    const QJsonDocument jsonDoc = QJsonDocument::fromJson(content.mid(jsonStartPos));
+    if (jsonDoc.isNull() || !jsonDoc.isObject()) {
+        error = "The file does not contain valid JSON data.";
+        return false;
+    }
+    json = jsonDoc.object();
+    return true;
+}
+
+QString analysisHtml(const QJsonObject &json)
+{
+    TRACE_SPAN("analysis.html");
+    QString html;
+    html.append("<h1>AI Process Usage Analysis</h1>");
+
+    // Summary
+    if (json.contains("summary") && json["summary"].isString()) {
+        html.append("<h2>Summary</h2>");
+        html.append("<p>" + json["summary"].toString() + "</p>");
+    }
+
+    // Sections that are arrays of label/details objects
+    auto formatSection = [&](const QString &key, const QString &title) {
+        if (json.contains(key) && json[key].isArray()) {
+            html.append("<h2>" + title + "</h2>");
+            html.append("<ul>");
+            for (const QJsonValue &value : json[key].toArray()) {
+                QJsonObject obj = value.toObject();
+                if (obj.contains("label") && obj.contains("details")) {
+                    html.append("<li><b>" + obj["label"].toString() + ":</b> " + obj["details"].toString() + "</li>");
+                }
+            }
+            html.append("</ul>");
+        }
+    };
+
+    formatSection("keyPoints", "Key Points");
+    formatSection("recommendations", "Recommendations");
+    formatSection("performanceProfile", "Performance Profile");
+    formatSection("resourceHotspots", "Resource Hotspots");
+    return html;
+}
@@ -0,0 +1,19 @@
+#ifndef ANALYSISREPORT_H
+#define ANALYSISREPORT_H
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QString>
+
+// Analysis files returned by the analysis service: a free-form text header
+// followed by one JSON object with summary, keyPoints, recommendations,
+// performanceProfile and resourceHotspots.
+
+// Extracts the JSON object from the file's content. Returns false and sets
+// error if there is none.
+bool parseAnalysisFile(const QByteArray &content, QJsonObject &json, QString &error);
+
+// HTML shown in the AI Analysis tab
+QString analysisHtml(const QJsonObject &json);
+
+#endif // ANALYSISREPORT_H
@@ -0,0 +1,77 @@
+#include "proc_kernels.h"
+
+#include <QElapsedTimer>
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Samples per window and windows per measurement
+static const size_t kWindow = 1 << 20;
+static const int kRepeats = 50;
+
+// Keeps the compiler from dropping the work of a kernel
+static volatile quint64 sink;
+
+template <typename Body>
+static double samplesPerSecond(Body body) {
+    body();  // warm-up
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < kRepeats; ++i) {
+        body();
+    }
+    const double seconds = static_cast<double>(timer.nsecsElapsed()) / 1e9;
+    return static_cast<double>(kWindow) * kRepeats / seconds;
+}
+
+static void run(const ColumnKernels &kernels, const std::vector<quint64> &values, double *results) {
+    std::vector<qint64> deltas(values.size());
+    std::vector<quint64> bins(64);
+
+    results[0] = samplesPerSecond([&]() { sink = kernels.sum(values.data(), values.size()); });
+    results[1] = samplesPerSecond([&]() {
+        quint64 min = 0, max = 0;
+        kernels.min_max(values.data(), values.size(), min, max);
+        sink = min + max;
+    });
+    results[2] = samplesPerSecond([&]() { sink = kernels.count_above(values.data(), values.size(), 1ULL << 29); });
+    results[3] = samplesPerSecond([&]() {
+        kernels.deltas(values.data(), values.size(), deltas.data());
+        sink = static_cast<quint64>(deltas[values.size() / 2]);
+    });
+    results[4] = samplesPerSecond([&]() {
+        kernels.histogram(values.data(), values.size(), 0, 24, bins.data(), bins.size());
+        sink = bins[0];
+    });
+}
+
+int main() {
+    // Working-set sized values: a slow climb with noise
+    std::mt19937_64 random(42);
+    std::vector<quint64> values(kWindow);
+    for (size_t i = 0; i < kWindow; ++i) {
+        values[i] = (400ULL << 20) + i * 64 + (random() % (64ULL << 20));
+    }
+
+    const char *names[] = {"sum", "min/max", "count above", "deltas", "histogram"};
+    double scalar[5];
+    run(ScalarKernels(), values, scalar);
+
+    const ColumnKernels *avx2 = Avx2Kernels();
+    double vector[5];
+    if (avx2) {
+        run(*avx2, values, vector);
+    }
+
+    std::printf("%zu samples per window, %d windows\n", kWindow, kRepeats);
+    std::printf("%-12s %14s %14s %8s\n", "kernel", "scalar Ms/s", "avx2 Ms/s", "speedup");
+    for (int i = 0; i < 5; ++i) {
+        if (avx2) {
+            std::printf("%-12s %14.0f %14.0f %7.2fx\n", names[i], scalar[i] / 1e6, vector[i] / 1e6, vector[i] / scalar[i]);
+        } else {
+            std::printf("%-12s %14.0f %14s %8s\n", names[i], scalar[i] / 1e6, "n/a", "-");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,16 @@
+QT       -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+# Micro-benchmark of the column aggregation kernels: scalar against AVX2
+# over million-sample windows
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    kernels_bench.cpp \
+    ../proc_kernels.cpp
+
+HEADERS += \
+    ../proc_kernels.h
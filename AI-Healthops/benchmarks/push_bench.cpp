@@ -0,0 +1,107 @@
+#include "fleet.h"
+#include "proc_push.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QTimer>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Samples published per burst; bursts are spread evenly over each second
+static const int kBurst = 1000;
+
+// Usage: push_bench [hosts] [samples per second per host] [seconds]
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    const int hosts = std::max(argc > 1 ? std::atoi(argv[1]) : 8, 1);
+    const long long rate = argc > 2 ? std::atoll(argv[2]) : 20000;
+    const int seconds = std::max(argc > 3 ? std::atoi(argv[3]) : 10, 1);
+
+    const QString path = QDir::temp().filePath(QString("push_bench_%1.db").arg(QCoreApplication::applicationPid()));
+    QFile::remove(path);
+    auto store = std::make_unique<FleetStore>(path, 5);
+    if (!store->Ok()) {
+        std::fprintf(stderr, "store: %s\n", qPrintable(store->ErrorString()));
+        return 1;
+    }
+    auto server = std::make_unique<FleetServer>(store.get());
+    if (!server->Listen(QHostAddress::LocalHost, 0)) {
+        std::fprintf(stderr, "listen: %s\n", qPrintable(server->ErrorString()));
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<StatsPushClient>> clients;
+    for (int i = 0; i < hosts; ++i) {
+        clients.push_back(std::make_unique<StatsPushClient>());
+        clients.back()->Start("127.0.0.1", server->Port(), QString("bench-%1").arg(i));
+    }
+
+    // One publisher per host, as its collector thread would be
+    std::atomic<bool> stop{false};
+    std::atomic<quint64> published{0};
+    std::vector<std::thread> publishers;
+    for (int i = 0; i < hosts; ++i) {
+        publishers.emplace_back([&, i]() {
+            StatsSample sample;
+            sample.process = QString("bench-%1.exe").arg(i);
+            const auto period = std::chrono::nanoseconds(1000000000LL * kBurst / std::max(rate, 1LL));
+            auto next = std::chrono::steady_clock::now();
+            quint64 count = 0;
+            while (!stop) {
+                for (int j = 0; j < kBurst; ++j) {
+                    sample.time_stamp = QDateTime::currentMSecsSinceEpoch();
+                    sample.pid = 1000 + static_cast<quint32>(count % 64);
+                    sample.stats.CPU_USERPERCENT = count % 100;
+                    sample.stats.PROC_WORKINGSETSIZE = count;
+                    clients[i]->Publish(sample);
+                    ++count;
+                }
+                next += period;
+                std::this_thread::sleep_until(next);
+            }
+            published += count;
+        });
+    }
+
+    double peak = 0.0;
+    QTimer rateTimer;
+    QObject::connect(&rateTimer, &QTimer::timeout, [&]() { peak = std::max(peak, server->IngestRate()); });
+    rateTimer.start(1000);
+
+    QTimer::singleShot(seconds * 1000, [&]() {
+        stop = true;
+        for (std::thread &publisher : publishers) {
+            publisher.join();
+        }
+        // Whatever the clients still hold goes out on Stop
+        for (const std::unique_ptr<StatsPushClient> &client : clients) {
+            client->Stop();
+        }
+        QTimer::singleShot(500, &app, &QCoreApplication::quit);
+    });
+    app.exec();
+
+    quint64 dropped = 0;
+    for (const std::unique_ptr<StatsPushClient> &client : clients) {
+        dropped += client->DroppedCount();
+    }
+    const quint64 ingested = store->IngestedCount();
+    std::printf("%d hosts published %llu samples in %d s, ingested %llu (%.0f/s, peak %.0f/s), dropped %llu\n",
+                hosts, static_cast<unsigned long long>(published.load()), seconds,
+                static_cast<unsigned long long>(ingested), static_cast<double>(ingested) / seconds, peak,
+                static_cast<unsigned long long>(dropped));
+
+    server.reset();
+    store.reset();
+    QFile::remove(path);
+    return 0;
+}
@@ -0,0 +1,23 @@
+QT = core network sql
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+# Ingest throughput of the fleet aggregator: several push clients, each
+# standing in for one host, publish into a FleetServer over loopback TCP
+
+INCLUDEPATH += .. ../aggregator
+
+SOURCES += \
+    push_bench.cpp \
+    ../aggregator/fleet.cpp \
+    ../proc_push.cpp \
+    ../proc_sketch.cpp \
+    ../proc_stream.cpp
+
+HEADERS += \
+    ../aggregator/fleet.h \
+    ../proc_push.h \
+    ../proc_sketch.h \
+    ../proc_stats.h \
+    ../proc_stream.h
@@ -0,0 +1,119 @@
+#include "proc_stream.h"
+
+#include <QCoreApplication>
+#include <QLocalSocket>
+#include <QTimer>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// Samples published per burst; bursts are spread evenly over each second
+static const int kBurst = 1000;
+
+static double percentile(std::vector<qint64> &values, double p) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    const size_t rank = std::min(values.size() - 1, static_cast<size_t>(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(rank), values.end());
+    return static_cast<double>(values[rank]);
+}
+
+// Usage: stream_bench [samples per second] [seconds] [metric mask]
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    const long long rate = argc > 1 ? std::atoll(argv[1]) : 1000000;
+    const int seconds = argc > 2 ? std::atoi(argv[2]) : 5;
+    const quint64 metrics = argc > 3 ? std::strtoull(argv[3], nullptr, 0) : kStreamAllMetrics;
+
+    const QString name = QString("healthops-stream-bench-%1").arg(QCoreApplication::applicationPid());
+    StatsStreamServer server(1 << 16);
+    if (!server.Listen(name)) {
+        std::fprintf(stderr, "listen: %s\n", qPrintable(server.ErrorString()));
+        return 1;
+    }
+
+    QLocalSocket socket;
+    socket.connectToServer(name);
+    if (!socket.waitForConnected(1000)) {
+        std::fprintf(stderr, "connect: %s\n", qPrintable(socket.errorString()));
+        return 1;
+    }
+    StreamFilter filter;
+    filter.metrics = metrics;
+    QByteArray request;
+    EncodeSubscribe(filter, request);
+    socket.write(request);
+    socket.flush();
+    // Let the server take the subscription before anything is published
+    while (server.SubscriberCount() == 0) {
+        QCoreApplication::processEvents();
+    }
+
+    quint64 received = 0;
+    quint64 dropped = 0;
+    quint64 frames = 0;
+    std::vector<qint64> latencies;
+    latencies.reserve(1 << 20);
+    std::vector<StreamRecord> records;
+    QByteArray buffer;
+    QObject::connect(&socket, &QLocalSocket::readyRead, [&]() {
+        buffer.append(socket.readAll());
+        qsizetype offset = 0;
+        quint8 type;
+        QByteArrayView payload;
+        while (NextStreamFrame(buffer, offset, type, payload)) {
+            quint32 lost = 0;
+            qint64 published_us = 0;
+            records.clear();
+            received += DecodeSamples(payload, metrics, records, &lost, &published_us);
+            dropped += lost;
+            ++frames;
+            // Age of the oldest record of the frame, i.e. its worst case
+            latencies.push_back(StreamClockUs() - published_us);
+        }
+        buffer.remove(0, offset);
+    });
+
+    std::atomic<bool> stop{false};
+    quint64 published = 0;
+    std::thread publisher([&]() {
+        StatsSample sample;
+        sample.pid = 4242;
+        const auto period = std::chrono::nanoseconds(1000000000LL * kBurst / std::max(rate, 1LL));
+        auto next = std::chrono::steady_clock::now();
+        while (!stop) {
+            for (int i = 0; i < kBurst; ++i) {
+                sample.time_stamp = static_cast<qint64>(published);
+                sample.stats.PROC_WORKINGSETSIZE = published;
+                server.Publish(sample);
+                ++published;
+            }
+            next += period;
+            std::this_thread::sleep_until(next);
+        }
+    });
+
+    QTimer::singleShot(seconds * 1000, [&]() {
+        stop = true;
+        publisher.join();
+        // Whatever is still in flight
+        QTimer::singleShot(200, &app, &QCoreApplication::quit);
+    });
+    app.exec();
+    server.Close();
+
+    std::printf("published %llu samples in %d s (%.0f/s), received %llu in %llu frames, dropped %llu\n",
+                static_cast<unsigned long long>(published), seconds, static_cast<double>(published) / seconds,
+                static_cast<unsigned long long>(received), static_cast<unsigned long long>(frames),
+                static_cast<unsigned long long>(dropped));
+    std::printf("latency us: p50 %.0f  p99 %.0f  p99.9 %.0f  max %.0f\n",
+                percentile(latencies, 0.5), percentile(latencies, 0.99), percentile(latencies, 0.999),
+                percentile(latencies, 1.0));
+    return 0;
+}
@@ -0,0 +1,18 @@
+QT = core network
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+# Test client of the live stats stream: a publisher thread feeds a
+# StatsStreamServer at a fixed rate and a subscriber on the other end of
+# the local socket measures throughput, losses and end-to-end latency
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    stream_bench.cpp \
+    ../proc_stream.cpp
+
+HEADERS += \
+    ../proc_stats.h \
+    ../proc_stream.h
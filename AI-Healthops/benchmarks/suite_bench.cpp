@@ -0,0 +1,512 @@
+#include "analysisreport.h"
+#include "eventlogmodel.h"
+#include "historychartview.h"
+#include "proc_database.h"
+#include "proc_history.h"
+#include "proc_snapshot.h"
+#include "proc_stats.h"
+#include "proc_summary.h"
+#include "proc_trace.h"
+#include "processtablemodel.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSysInfo>
+#include <QTemporaryDir>
+#include <QTextDocument>
+#include <QtCharts/QChart>
+#include <QtCharts/QDateTimeAxis>
+#include <QtCharts/QLineSeries>
+#include <QtCharts/QValueAxis>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Benchmark suite over the hot paths of collection, storage and the UI.
+// Micro-benchmarks time one call of a hot path, macro-benchmarks a whole
+// workload. Every result is the median of kRuns runs in nanoseconds per
+// operation, lower is better. --json writes the results for a later
+// --baseline run, which flags every benchmark whose median got slower by
+// more than the threshold and exits with 1 if there was any.
+
+// Runs per benchmark; the median is reported
+static const int kRuns = 5;
+
+// Micro-benchmarks repeat the operation until one run takes this long
+static const qint64 kMicroRunNs = 100 * 1000 * 1000;
+
+// Samples handed to the events table per presented frame
+static const int kFrameSamples = 16;
+
+// Default workload sizes of the macro-benchmarks
+static const int kDefaultProcesses = 300;
+static const int kDefaultSeconds = 600;
+static const int kDefaultPoints = 7 * 24 * 3600;
+static const int kDefaultFileMb = 8;
+
+// Size of the rendered chart
+static const int kChartWidth = 1600;
+static const int kChartHeight = 600;
+
+// Keeps the compiler from dropping the work of a benchmark
+static volatile quint64 sink;
+
+struct BenchResult {
+    QString name;
+    qint64 ops = 0;          // operations per run
+    double median = 0.0;     // ns per operation
+    double min = 0.0;
+    double max = 0.0;
+};
+
+// Body runs the operation count times
+using BenchBody = std::function<void(qint64 count)>;
+
+static BenchResult measure(const QString &name, qint64 ops, const BenchBody &body) {
+    std::vector<double> runs;
+    runs.reserve(kRuns);
+    for (int run = 0; run < kRuns; ++run) {
+        QElapsedTimer timer;
+        timer.start();
+        body(ops);
+        runs.push_back(static_cast<double>(timer.nsecsElapsed()) / static_cast<double>(ops));
+    }
+    std::sort(runs.begin(), runs.end());
+
+    BenchResult result;
+    result.name = name;
+    result.ops = ops;
+    result.median = runs[runs.size() / 2];
+    result.min = runs.front();
+    result.max = runs.back();
+    return result;
+}
+
+// One operation per call of body, repeated until a run lasts kMicroRunNs
+static BenchResult measureMicro(const QString &name, const BenchBody &body) {
+    QElapsedTimer timer;
+    timer.start();
+    body(1);  // warm-up and first estimate
+    qint64 ops = 1;
+    qint64 elapsed = std::max<qint64>(timer.nsecsElapsed(), 1);
+    while (elapsed < kMicroRunNs / 10 && ops < (1LL << 30)) {
+        ops *= 10;
+        timer.restart();
+        body(ops);
+        elapsed = std::max<qint64>(timer.nsecsElapsed(), 1);
+    }
+    ops = std::max<qint64>(1, static_cast<qint64>(static_cast<double>(ops) * kMicroRunNs / elapsed));
+    return measure(name, ops, body);
+}
+
+// Whole workloads run once per run after one warm-up
+static BenchResult measureMacro(const QString &name, const BenchBody &body) {
+    body(1);
+    return measure(name, 1, body);
+}
+
+static QString formatNs(double ns) {
+    if (ns >= 1e9) {
+        return QString::number(ns / 1e9, 'f', 2) + " s";
+    }
+    if (ns >= 1e6) {
+        return QString::number(ns / 1e6, 'f', 2) + " ms";
+    }
+    if (ns >= 1e3) {
+        return QString::number(ns / 1e3, 'f', 2) + " us";
+    }
+    return QString::number(ns, 'f', 1) + " ns";
+}
+
+// Synthetic sweep of count processes at time_stamp; values drift with it
+static void fillSnapshot(ProcessSnapshot &snapshot, int count, qint64 time_stamp, std::mt19937 &random) {
+    snapshot.Clear();
+    snapshot.Reserve(count);
+    snapshot.time_stamp = time_stamp;
+    std::uniform_real_distribution<double> cpu(0.0, 25.0);
+    for (int i = 0; i < count; ++i) {
+        snapshot.pids.push_back(static_cast<quint32>(4 * (i + 1)));
+        snapshot.names.push_back(QString("process%1.exe").arg(i));
+        snapshot.users.push_back("bench");
+        snapshot.kernel_times.push_back(0);
+        snapshot.user_times.push_back(0);
+        snapshot.cpu_user_percent.push_back(cpu(random));
+        snapshot.cpu_kernel_percent.push_back(cpu(random) / 4);
+        snapshot.working_set.push_back((64ULL << 20) + static_cast<quint64>(i) * 4096 + random() % (16 << 20));
+        snapshot.io_operations.push_back(static_cast<quint64>(time_stamp / 1000) * i);
+        snapshot.io_ops_per_sec.push_back(random() % 500);
+        snapshot.io_write_bytes.push_back(static_cast<quint64>(time_stamp / 1000) * i * 1024);
+        snapshot.io_write_bytes_per_sec.push_back(random() % (1 << 20));
+        snapshot.groups.push_back(kAllMetricGroups);
+    }
+}
+
+// Analysis file of about megabytes: a text header, then the JSON object
+static QByteArray analysisFile(int megabytes) {
+    const char *sections[] = {"keyPoints", "recommendations", "performanceProfile", "resourceHotspots"};
+    const QString details = "Working set of the process grew steadily over the sampled range while CPU stayed "
+                            "below ten percent; the growth matches the allocation rate of the render thread.";
+
+    QJsonObject json;
+    json["summary"] = "Synthetic analysis generated by suite_bench.";
+    const qint64 target = static_cast<qint64>(megabytes) << 20;
+    const qint64 perEntry = 40 + details.size();
+    const qint64 entries = std::max<qint64>(1, target / perEntry / 4);
+    for (const char *section : sections) {
+        QJsonArray array;
+        for (qint64 i = 0; i < entries; ++i) {
+            QJsonObject entry;
+            entry["label"] = QString("Finding %1").arg(i);
+            entry["details"] = details;
+            array.append(entry);
+        }
+        json[section] = array;
+    }
+    return "Analysis of SampleData_ResourceUsage.json\n\n" + QJsonDocument(json).toJson(QJsonDocument::Compact);
+}
+
+static QJsonObject toJson(const std::vector<BenchResult> &results, const QJsonObject &parameters) {
+    QJsonArray array;
+    for (const BenchResult &result : results) {
+        QJsonObject entry;
+        entry["name"] = result.name;
+        entry["unit"] = "ns/op";
+        entry["ops"] = result.ops;
+        entry["runs"] = kRuns;
+        entry["median"] = result.median;
+        entry["min"] = result.min;
+        entry["max"] = result.max;
+        array.append(entry);
+    }
+
+    QJsonObject host;
+    host["os"] = QSysInfo::prettyProductName();
+    host["cpu"] = QSysInfo::currentCpuArchitecture();
+    host["threads"] = static_cast<int>(std::thread::hardware_concurrency());
+
+    QJsonObject json;
+    json["suite"] = "suite_bench";
+    json["version"] = 1;
+    json["created"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    json["host"] = host;
+    json["parameters"] = parameters;
+    json["results"] = array;
+    return json;
+}
+
+// Prints results next to baseline and returns how many regressed by more
+// than threshold (a fraction)
+static int compare(const std::vector<BenchResult> &results, const QJsonObject &baseline, double threshold) {
+    QHash<QString, double> before;
+    for (const QJsonValue &value : baseline["results"].toArray()) {
+        const QJsonObject entry = value.toObject();
+        before.insert(entry["name"].toString(), entry["median"].toDouble());
+    }
+
+    int regressions = 0;
+    std::printf("\n%-32s %12s %12s %9s\n", "benchmark", "baseline", "current", "change");
+    for (const BenchResult &result : results) {
+        const auto found = before.constFind(result.name);
+        if (found == before.constEnd() || *found <= 0.0) {
+            std::printf("%-32s %12s %12s %9s  new\n", qPrintable(result.name), "-", qPrintable(formatNs(result.median)), "-");
+            continue;
+        }
+        const double change = result.median / *found - 1.0;
+        const char *verdict = "";
+        if (change > threshold) {
+            verdict = "  REGRESSION";
+            ++regressions;
+        } else if (change < -threshold) {
+            verdict = "  improved";
+        }
+        std::printf("%-32s %12s %12s %+8.1f%%%s\n", qPrintable(result.name), qPrintable(formatNs(*found)),
+                    qPrintable(formatNs(result.median)), change * 100.0, verdict);
+    }
+    return regressions;
+}
+
+int main(int argc, char *argv[]) {
+    // The chart is rendered into an image; no display is needed
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmarks of the collector, storage and UI hot paths");
+    parser.addHelpOption();
+    const QCommandLineOption jsonOption("json", "Write the results as JSON to <file>.", "file");
+    const QCommandLineOption baselineOption("baseline", "Compare with the results in <file>; exit with 1 on regressions.", "file");
+    const QCommandLineOption thresholdOption("threshold", "Slowdown in <percent> counted as a regression (default 10).", "percent", "10");
+    const QCommandLineOption filterOption("filter", "Run only benchmarks whose name contains <text>.", "text");
+    const QCommandLineOption processesOption("processes", "Processes of the ingest workload.", "count", QString::number(kDefaultProcesses));
+    const QCommandLineOption secondsOption("seconds", "Seconds of the ingest workload.", "count", QString::number(kDefaultSeconds));
+    const QCommandLineOption pointsOption("points", "Points in the rendered chart's history.", "count", QString::number(kDefaultPoints));
+    const QCommandLineOption fileOption("file-mb", "Size of the loaded analysis file.", "megabytes", QString::number(kDefaultFileMb));
+    parser.addOptions({jsonOption, baselineOption, thresholdOption, filterOption,
+                       processesOption, secondsOption, pointsOption, fileOption});
+    parser.process(app);
+
+    const int processes = std::max(1, parser.value(processesOption).toInt());
+    const int seconds = std::max(1, parser.value(secondsOption).toInt());
+    const int points = std::max(2, parser.value(pointsOption).toInt());
+    const int fileMb = std::max(1, parser.value(fileOption).toInt());
+    const double threshold = parser.value(thresholdOption).toDouble() / 100.0;
+    const QString filter = parser.value(filterOption);
+
+    QJsonObject baseline;
+    if (parser.isSet(baselineOption)) {
+        QFile file(parser.value(baselineOption));
+        if (!file.open(QIODevice::ReadOnly)) {
+            std::fprintf(stderr, "Could not open baseline %s: %s\n", qPrintable(file.fileName()), qPrintable(file.errorString()));
+            return 2;
+        }
+        baseline = QJsonDocument::fromJson(file.readAll()).object();
+    }
+
+    QTemporaryDir scratch;
+    if (!scratch.isValid()) {
+        std::fprintf(stderr, "Could not create a temporary directory\n");
+        return 2;
+    }
+
+    std::vector<BenchResult> results;
+    auto run = [&](const QString &name, bool macro, const std::function<BenchBody()> &setup) {
+        if (!filter.isEmpty() && !name.contains(filter)) {
+            return;
+        }
+        const BenchBody body = setup();
+        results.push_back(macro ? measureMacro(name, body) : measureMicro(name, body));
+        const BenchResult &result = results.back();
+        std::printf("%-32s %12s  (min %s, max %s, %lld ops/run)\n", qPrintable(result.name), qPrintable(formatNs(result.median)),
+                    qPrintable(formatNs(result.min)), qPrintable(formatNs(result.max)), static_cast<long long>(result.ops));
+        std::fflush(stdout);
+    };
+
+    // --- Micro-benchmarks ---
+
+    // One timing span, when they are compiled in (CONFIG+=tracing)
+    if (kTracingEnabled) {
+        run("micro/trace.span", false, [&]() {
+            return [](qint64 count) {
+                for (qint64 i = 0; i < count; ++i) {
+                    TRACE_SPAN("bench.span");
+                }
+            };
+        });
+    }
+
+    // One sample of the attached process, as taken every interval
+    PerformanceStats stats;
+    run("micro/stats.get_stats", false, [&]() {
+        return [&](qint64 count) {
+            for (qint64 i = 0; i < count; ++i) {
+                sink = stats.GetStats().CPU_USERTOTAL;
+            }
+        };
+    });
+
+    // The same with a CPU-only plan, which makes one call instead of three
+    MetricSelection cpuOnly;
+    cpuOnly.groups = CpuMetrics;
+    PerformanceStats cpuStats("", 0, 0, cpuOnly);
+    run("micro/stats.get_stats_cpu", false, [&]() {
+        return [&](qint64 count) {
+            for (qint64 i = 0; i < count; ++i) {
+                sink = cpuStats.GetStats().CPU_USERTOTAL;
+            }
+        };
+    });
+
+    // One row of the stats table; every Save commits on its own
+    run("micro/storage.save", false, [&]() {
+        auto database = std::make_shared<Database>(scratch.filePath("save.db"));
+        const Stats sample = stats.GetStats();
+        return [&, database, sample](qint64 count) {
+            const qint64 now = QDateTime::currentMSecsSinceEpoch();
+            for (qint64 i = 0; i < count; ++i) {
+                database->Save(now + i, sample);
+            }
+        };
+    });
+
+    // One frame of samples into the events table, as presentSamples does it
+    EventLogModel eventModel;
+    run("micro/ui.events_append", false, [&]() {
+        std::vector<StatsSample> batch(kFrameSamples);
+        for (StatsSample &sample : batch) {
+            sample.pid = stats.process_id_;
+            sample.process = stats.process_name_;
+            sample.stats = stats.GetStats();
+        }
+        return [&, batch](qint64 count) {
+            std::vector<LiveEvent> events;
+            for (qint64 i = 0; i < count; ++i) {
+                events.clear();
+                for (const StatsSample &sample : batch) {
+                    LiveEvent event;
+                    event.time_stamp = sample.time_stamp + i;
+                    event.pid = sample.pid;
+                    event.process = sample.process;
+                    event.cpu_user = sample.stats.CPU_USERPERCENT;
+                    event.cpu_kernel = sample.stats.CPU_KERNPERCENT;
+                    events.push_back(event);
+                }
+                eventModel.append(events);
+            }
+        };
+    });
+
+    // The process list refresh: one sweep, then the table model update
+    ProcessSnapshot previous;
+    ProcessSnapshot next;
+    run("micro/collector.process_sweep", false, [&]() {
+        TakeProcessSnapshot(previous, next);
+        return [&](qint64 count) {
+            for (qint64 i = 0; i < count; ++i) {
+                std::swap(previous, next);
+                TakeProcessSnapshot(previous, next);
+            }
+        };
+    });
+
+    ProcessTableModel processModel;
+    run("micro/ui.process_model", false, [&]() {
+        // Alternating between two sweeps changes the CPU columns every time
+        TakeProcessSnapshot(next, previous);
+        TakeProcessSnapshot(previous, next);
+        return [&](qint64 count) {
+            for (qint64 i = 0; i < count; ++i) {
+                processModel.setSnapshot((i & 1) ? previous : next);
+            }
+        };
+    });
+
+    // --- Macro-benchmarks ---
+
+    // What the collector stores over seconds while the enumerator sweeps
+    // processes every second: a stats row per second and a sketch per
+    // process, series and minute
+    run("macro/storage.ingest", true, [&]() {
+        return [&](qint64 count) {
+            for (qint64 i = 0; i < count; ++i) {
+                QFile::remove(scratch.filePath("ingest.db"));
+                Database database(scratch.filePath("ingest.db"));
+                ProcessSketches sketches;
+                ProcessSnapshot snapshot;
+                std::vector<SketchRecord> closed;
+                std::mt19937 random(42);
+                const Stats sample = stats.GetStats();
+                const qint64 start = QDateTime::currentMSecsSinceEpoch() / 60000 * 60000;
+                for (int second = 0; second < seconds; ++second) {
+                    const qint64 time_stamp = start + second * 1000LL;
+                    fillSnapshot(snapshot, processes, time_stamp, random);
+                    sketches.Add(snapshot, closed);
+                    database.Save(time_stamp, sample);
+                    if (!closed.empty()) {
+                        database.SaveSketches(closed);
+                        closed.clear();
+                    }
+                }
+                sketches.Flush(closed);
+                database.SaveSketches(closed);
+            }
+        };
+    });
+
+    // Rendering the CPU chart zoomed out over the whole history
+    SeriesHistory history(points);
+    QLineSeries *series = new QLineSeries();
+    QChart *chart = new QChart();
+    chart->addSeries(series);
+    chart->legend()->hide();
+    QDateTimeAxis *axisX = new QDateTimeAxis();
+    chart->addAxis(axisX, Qt::AlignBottom);
+    series->attachAxis(axisX);
+    QValueAxis *axisY = new QValueAxis();
+    axisY->setRange(0, 100);
+    chart->addAxis(axisY, Qt::AlignLeft);
+    series->attachAxis(axisY);
+    HistoryChartView chartView(&history, series, axisX);
+    chartView.resize(kChartWidth, kChartHeight);
+    run("macro/ui.chart_render", true, [&]() {
+        if (history.Empty()) {
+            std::mt19937 random(42);
+            std::normal_distribution<double> noise(0.0, 4.0);
+            const qint64 start = QDateTime::currentMSecsSinceEpoch() - points * 1000LL;
+            for (int i = 0; i < points; ++i) {
+                history.Append(start + i * 1000LL, std::clamp(20.0 + 10.0 * std::sin(i / 600.0) + noise(random), 0.0, 100.0));
+            }
+        }
+        return [&](qint64 count) {
+            for (qint64 i = 0; i < count; ++i) {
+                chartView.showRange(history.FirstTime(), history.LastTime());
+                sink = chartView.grab().cacheKey();
+            }
+        };
+    });
+
+    // Opening an analysis file: read, parse, format and lay out the HTML
+    run("macro/ui.analysis_load", true, [&]() {
+        QFile file(scratch.filePath("analysis.txt"));
+        if (file.open(QIODevice::WriteOnly)) {
+            file.write(analysisFile(fileMb));
+        }
+        return [&](qint64 count) {
+            for (qint64 i = 0; i < count; ++i) {
+                QFile file(scratch.filePath("analysis.txt"));
+                if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+                    return;
+                }
+                QJsonObject json;
+                QString error;
+                if (!parseAnalysisFile(file.readAll(), json, error)) {
+                    return;
+                }
+                QTextDocument document;
+                document.setHtml(analysisHtml(json));
+                sink = document.characterCount();
+            }
+        };
+    });
+
+    QJsonObject parameters;
+    parameters["processes"] = processes;
+    parameters["seconds"] = seconds;
+    parameters["points"] = points;
+    parameters["file_mb"] = fileMb;
+    const QJsonObject json = toJson(results, parameters);
+
+    if (parser.isSet(jsonOption)) {
+        QFile file(parser.value(jsonOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(QJsonDocument(json).toJson()) < 0) {
+            std::fprintf(stderr, "Could not write %s: %s\n", qPrintable(file.fileName()), qPrintable(file.errorString()));
+            return 2;
+        }
+    }
+
+    if (parser.isSet(baselineOption)) {
+        if (baseline["parameters"].toObject() != parameters) {
+            std::printf("\nWarning: the baseline was taken with different workload sizes\n");
+        }
+        const int regressions = compare(results, baseline, threshold);
+        if (regressions > 0) {
+            std::printf("\n%d regression(s) above %.0f%%\n", regressions, threshold * 100.0);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,28 @@
+QT += core gui widgets charts sql network
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+# Benchmark suite over the collector, storage and UI hot paths with JSON
+# output and regression checks against a saved baseline:
+#   suite_bench --json baseline.json
+#   suite_bench --baseline baseline.json --threshold 10
+
+include(../collector.pri)
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    suite_bench.cpp \
+    ../analysisreport.cpp \
+    ../eventlogmodel.cpp \
+    ../historychartview.cpp \
+    ../proc_search_index.cpp \
+    ../processtablemodel.cpp
+
+HEADERS += \
+    ../analysisreport.h \
+    ../eventlogmodel.h \
+    ../historychartview.h \
+    ../proc_search_index.h \
+    ../processtablemodel.h
@@ -0,0 +1,54 @@
+#include "proc_pool.h"
+#include "proc_snapshot.h"
+
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+
+// Sweeps per measurement
+static const int kRepeats = 20;
+
+// Usage: sweep_bench [max threads] [affinity mask]
+int main(int argc, char *argv[]) {
+    const int hardware = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    const int maxThreads = argc > 1 ? std::max(1, std::atoi(argv[1])) : hardware;
+    const quint64 affinity = argc > 2 ? std::strtoull(argv[2], nullptr, 0) : 0;
+
+    std::printf("%d hardware threads, %d sweeps per point\n", hardware, kRepeats);
+    std::printf("%8s %10s %14s %9s %10s\n", "threads", "sweeps/s", "processes/s", "speedup", "stolen");
+
+    double single = 0.0;
+    for (int threads = 1; threads <= maxThreads; threads = threads < 4 ? threads + 1 : threads * 2) {
+        // The calling thread is one of them, as in ProcessEnumerator
+        std::unique_ptr<WorkStealingPool> pool;
+        if (threads > 1) {
+            pool = std::make_unique<WorkStealingPool>(threads - 1, affinity);
+        }
+
+        ProcessSnapshot previous;
+        ProcessSnapshot next;
+        TakeProcessSnapshot(previous, next, nullptr, pool.get());  // warm-up
+        std::swap(previous, next);
+
+        size_t processes = 0;
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < kRepeats; ++i) {
+            TakeProcessSnapshot(previous, next, nullptr, pool.get());
+            processes += next.Size();
+            std::swap(previous, next);
+        }
+        const double seconds = static_cast<double>(timer.nsecsElapsed()) / 1e9;
+        const double sweeps = kRepeats / seconds;
+        if (threads == 1) {
+            single = sweeps;
+        }
+        std::printf("%8d %10.1f %14.0f %8.2fx %10llu\n", threads, sweeps, static_cast<double>(processes) / seconds,
+                    sweeps / single, static_cast<unsigned long long>(pool ? pool->StolenCount() : 0));
+    }
+    return 0;
+}
@@ -0,0 +1,20 @@
+QT -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+# Scaling of the process sweep over the work-stealing pool, from one
+# thread up to every hardware thread
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    sweep_bench.cpp \
+    ../proc_pool.cpp \
+    ../proc_snapshot.cpp
+
+HEADERS += \
+    ../proc_pool.h \
+    ../proc_snapshot.h
+
+LIBS += -lpsapi
@@ -0,0 +1,59 @@
+# Sampling, detection and storage, shared by the GUI and the headless
+# daemon. Nothing here may depend on Qt GUI or Widgets.
+
+QT += network sql
+
+INCLUDEPATH += $$PWD
+
+# Timing spans (proc_trace.h), off unless configured with CONFIG+=tracing
+CONFIG(tracing): DEFINES += HEALTHOPS_TRACING
+
+SOURCES += \
+    $$PWD/proc_alerts.cpp \
+    $$PWD/proc_anomaly.cpp \
+    $$PWD/proc_collector.cpp \
+    $$PWD/proc_columns.cpp \
+    $$PWD/proc_correlation.cpp \
+    $$PWD/proc_database.cpp \
+    $$PWD/proc_downsample.cpp \
+    $$PWD/proc_enumerator.cpp \
+    $$PWD/proc_history.cpp \
+    $$PWD/proc_kernels.cpp \
+    $$PWD/proc_pool.cpp \
+    $$PWD/proc_push.cpp \
+    $$PWD/proc_rules.cpp \
+    $$PWD/proc_shared.cpp \
+    $$PWD/proc_sketch.cpp \
+    $$PWD/proc_snapshot.cpp \
+    $$PWD/proc_stats.cpp \
+    $$PWD/proc_stream.cpp \
+    $$PWD/proc_summary.cpp \
+    $$PWD/proc_topk.cpp \
+    $$PWD/proc_trace.cpp \
+    $$PWD/proc_trend.cpp
+
+HEADERS += \
+    $$PWD/proc_alerts.h \
+    $$PWD/proc_anomaly.h \
+    $$PWD/proc_collector.h \
+    $$PWD/proc_columns.h \
+    $$PWD/proc_correlation.h \
+    $$PWD/proc_database.h \
+    $$PWD/proc_downsample.h \
+    $$PWD/proc_enumerator.h \
+    $$PWD/proc_history.h \
+    $$PWD/proc_kernels.h \
+    $$PWD/proc_pool.h \
+    $$PWD/proc_push.h \
+    $$PWD/proc_rules.h \
+    $$PWD/proc_shared.h \
+    $$PWD/proc_sketch.h \
+    $$PWD/proc_snapshot.h \
+    $$PWD/proc_stats.h \
+    $$PWD/proc_stream.h \
+    $$PWD/proc_summary.h \
+    $$PWD/proc_topk.h \
+    $$PWD/proc_trace.h \
+    $$PWD/proc_trend.h
+
+LIBS += -lpsapi
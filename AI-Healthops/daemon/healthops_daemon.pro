@@ -0,0 +1,19 @@
+QT = core sql
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = healthops-daemon
+
+# Headless collector: samples, detects and stores exactly like the GUI,
+# which can then be started as a viewer over the same database
+
+include(../collector.pri)
+
+SOURCES += \
+    main.cpp
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
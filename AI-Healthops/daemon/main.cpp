@@ -0,0 +1,318 @@
+#include "proc_collector.h"
+#include "proc_database.h"
+#include "proc_enumerator.h"
+#include "proc_push.h"
+#include "proc_shared.h"
+#include "proc_stream.h"
+#include "proc_trace.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLockFile>
+#include <QSettings>
+#include <QSysInfo>
+#include <QTimer>
+
+#include <algorithm>
+#include <cstdio>
+
+// Enumerator sweeps feeding sketches, correlation and heavy hitters; same
+// period as the GUI's process list
+static const int kSnapshotIntervalMs = 10000;
+
+// Samples viewers can catch up on in shared memory
+static const int kSharedSeconds = 600;
+
+// Longest Windows waits for a close, logoff or shutdown handler
+static const DWORD kShutdownWaitMs = 5000;
+
+// Set once the collector has stopped and flushed everything
+static HANDLE stopped_event = nullptr;
+
+// Where Ctrl+Break and the exit write the timing trace, empty for nowhere
+static QString trace_path;
+
+static void writeTrace()
+{
+    QString error;
+    if (WriteChromeTrace(trace_path, &error)) {
+        qInfo().noquote() << "Timing trace written to" << trace_path;
+    } else {
+        qWarning().noquote() << "Could not write the timing trace:" << error;
+    }
+}
+
+static BOOL WINAPI onConsoleEvent(DWORD type)
+{
+    switch (type) {
+    case CTRL_BREAK_EVENT:
+        // With a trace file Ctrl+Break dumps the spans and keeps collecting
+        if (!trace_path.isEmpty()) {
+            QMetaObject::invokeMethod(QCoreApplication::instance(), []() { writeTrace(); }, Qt::QueuedConnection);
+            return TRUE;
+        }
+        QMetaObject::invokeMethod(QCoreApplication::instance(), "quit", Qt::QueuedConnection);
+        return TRUE;
+    case CTRL_C_EVENT:
+        QMetaObject::invokeMethod(QCoreApplication::instance(), "quit", Qt::QueuedConnection);
+        return TRUE;
+    case CTRL_CLOSE_EVENT:
+    case CTRL_LOGOFF_EVENT:
+    case CTRL_SHUTDOWN_EVENT:
+        // The process is killed as soon as this returns, so wait for the
+        // last minute of sketches and open regions to be stored
+        QMetaObject::invokeMethod(QCoreApplication::instance(), "quit", Qt::QueuedConnection);
+        WaitForSingleObject(stopped_event, kShutdownWaitMs);
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+static QString memoryUsage()
+{
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return "unknown";
+    }
+    return QString("working set %1 KB, peak %2 KB")
+        .arg(counters.WorkingSetSize / 1024)
+        .arg(counters.PeakWorkingSetSize / 1024);
+}
+
+// Prints the percentiles of metric over [from, to] merged from the stored
+// per-minute sketches, for pids or every process if it is empty. Runs next
+// to a collecting daemon, on a connection of its own.
+static int runPercentiles(const QString &dbPath, const QString &metric, const std::vector<quint32> &pids, qint64 from,
+                          qint64 to)
+{
+    SketchRecord merged;
+    int count;
+    {
+        Database database(dbPath, "percentiles");
+        count = database.MergeSketches(metric, pids, from - from % 60000, to, merged);
+    }
+    if (count < 0) {
+        qWarning().noquote() << "Could not read the sketches in" << dbPath;
+        return 1;
+    }
+
+    QJsonObject reply;
+    reply["metric"] = metric;
+    reply["from"] = from;
+    reply["to"] = to;
+    QJsonArray pidValues;
+    for (quint32 pid : pids) {
+        pidValues.append(static_cast<qint64>(pid));
+    }
+    reply["pids"] = pidValues;
+    reply["sketches"] = count;
+    reply["count"] = static_cast<qint64>(merged.sketch.Count());
+    if (!merged.sketch.Empty()) {
+        reply["min"] = merged.min;
+        reply["max"] = merged.max;
+        reply["mean"] = merged.sum / static_cast<double>(merged.sketch.Count());
+        QJsonObject quantiles;
+        for (double q : {0.5, 0.9, 0.95, 0.99}) {
+            quantiles[QString("p%1").arg(q * 100.0)] = merged.sketch.Quantile(q);
+        }
+        reply["percentiles"] = quantiles;
+    }
+    std::printf("%s", QJsonDocument(reply).toJson(QJsonDocument::Indented).constData());
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    QElapsedTimer startup;
+    startup.start();
+
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("healthops-daemon");
+
+    const QString dataDir = Collector::DataDir();
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless AI HealthOps collector");
+    parser.addHelpOption();
+    const QCommandLineOption configOption("config", "Settings file (ini), default <data dir>/daemon.ini.", "file",
+                                          dataDir + "/daemon.ini");
+    const QCommandLineOption dbOption("db", "Database file.", "file");
+    const QCommandLineOption pidOption("pid", "Process to sample, 0 for the daemon itself.", "pid");
+    const QCommandLineOption intervalOption("interval", "Sampling interval in milliseconds.", "ms");
+    const QCommandLineOption snapshotOption("snapshot-interval", "Process enumeration interval in milliseconds.", "ms");
+    const QCommandLineOption rulesOption("rules", "Rules file.", "file");
+    const QCommandLineOption alertsOption("alerts", "Alerts file.", "file");
+    const QCommandLineOption alertHookOption("alert-hook", "Program run with every alert as JSON on stdin, empty for none.",
+                                             "command");
+    const QCommandLineOption streamOption("stream", "Local endpoint streaming live samples, empty for none.", "name");
+    const QCommandLineOption sharedOption("shared", "Shared-memory segment of the latest samples, empty for none.", "name");
+    const QCommandLineOption sharedSecondsOption("shared-seconds", "Seconds of samples kept in shared memory.", "s");
+    const QCommandLineOption workersOption("workers", "Threads querying processes during a sweep, 0 for automatic.", "n");
+    const QCommandLineOption affinityOption("affinity", "CPU mask the sweep threads are pinned to, e.g. 0xF0.", "mask");
+    const QCommandLineOption metricsOption("metrics", "Metric groups sampled: cpu, memory, io or all.", "groups");
+    const QCommandLineOption pushOption("push", "Fleet aggregator samples are pushed to, empty for none.", "host[:port]");
+    const QCommandLineOption hostNameOption("host-name", "Name samples are tagged with at the aggregator.", "name");
+    const QCommandLineOption percentilesOption("percentiles", "Print percentiles of a stored metric and exit: a Stats field of the "
+                                               "sampled process or a per-process series such as SNAP_CPU_PERCENT.",
+                                               "metric");
+    const QCommandLineOption pidsOption("pids", "Processes --percentiles covers, comma separated; all if not set.", "pids");
+    const QCommandLineOption minutesOption("minutes", "Minutes before now --percentiles covers.", "minutes", "60");
+    const QCommandLineOption traceOption("trace", "Timing trace written on Ctrl+Break and at exit (needs CONFIG+=tracing).", "file");
+    parser.addOptions({configOption, dbOption, pidOption, intervalOption, snapshotOption, rulesOption, alertsOption,
+                       alertHookOption, streamOption, sharedOption, sharedSecondsOption, workersOption, affinityOption, metricsOption, pushOption, hostNameOption,
+                       percentilesOption, pidsOption, minutesOption, traceOption});
+    parser.process(app);
+
+    // Flags override the settings file, which overrides the defaults
+    const QSettings settings(parser.value(configOption), QSettings::IniFormat);
+    auto value = [&](const QCommandLineOption &option, const QString &key, const QVariant &fallback) {
+        return parser.isSet(option) ? QVariant(parser.value(option)) : settings.value(key, fallback);
+    };
+    const QString dbPath = value(dbOption, "db", dataDir + "/healthops.db").toString();
+    const QString rulesPath = value(rulesOption, "rules", dataDir + "/rules.json").toString();
+    const QString alertsPath = value(alertsOption, "alerts", dataDir + "/alerts.json").toString();
+    const QString alertHookCommand = value(alertHookOption, "alert_hook", QString()).toString();
+    const int pid = value(pidOption, "pid", 0).toInt();
+    const int intervalMs = value(intervalOption, "interval", 1000).toInt();
+    const int snapshotMs = value(snapshotOption, "snapshot_interval", kSnapshotIntervalMs).toInt();
+    const QString streamName = value(streamOption, "stream", kDefaultStreamName).toString();
+    const QString sharedName = value(sharedOption, "shared", kDefaultSharedName).toString();
+    const int sharedSeconds = value(sharedSecondsOption, "shared_seconds", kSharedSeconds).toInt();
+    const int workers = value(workersOption, "workers", 0).toInt();
+    const quint64 affinity = value(affinityOption, "affinity", "0").toString().toULongLong(nullptr, 0);
+    const QString metricGroups = value(metricsOption, "metrics", "all").toStringList().join(',');
+    const QString pushTarget = value(pushOption, "push", QString()).toString();
+    const QString hostName = value(hostNameOption, "host_name", QSysInfo::machineHostName()).toString();
+    trace_path = value(traceOption, "trace", QString()).toString();
+
+    if (parser.isSet(percentilesOption)) {
+        std::vector<quint32> pids;
+        for (const QString &pid : parser.value(pidsOption).split(',', Qt::SkipEmptyParts)) {
+            pids.push_back(pid.trimmed().toUInt());
+        }
+        const qint64 to = QDateTime::currentMSecsSinceEpoch();
+        const qint64 from = to - parser.value(minutesOption).toLongLong() * 60000;
+        return runPercentiles(dbPath, parser.value(percentilesOption), pids, from, to);
+    }
+
+    // The groups apply to every process unless [process_metrics] names it,
+    // e.g. sqlservr.exe=cpu,io
+    MetricSelection metrics;
+    if (!ParseMetricGroups(metricGroups, metrics.groups)) {
+        qWarning() << "Unknown metric group in" << metricGroups;
+        return 1;
+    }
+    for (const QString &key : settings.allKeys()) {
+        if (!key.startsWith("process_metrics/")) {
+            continue;
+        }
+        // The ini format reads "cpu,io" as a list
+        const QString process = key.mid(key.indexOf('/') + 1);
+        const QString list = settings.value(key).toStringList().join(',');
+        quint32 groups;
+        if (!ParseMetricGroups(list, groups)) {
+            qWarning() << "Unknown metric group in" << list << "for" << process;
+            return 1;
+        }
+        metrics.by_process.insert(process.toLower(), groups);
+    }
+
+    // One collector per host, wherever --db points: the GUI looks for the
+    // lock in the data directory and turns into a viewer while we hold it,
+    // and both would publish to the same shared segment
+    const QString lockPath = dataDir + "/collector.lock";
+    QLockFile lock(lockPath);
+    if (!lock.tryLock(0)) {
+        qWarning() << "Another collector is already running; its lock is" << lockPath;
+        return 1;
+    }
+
+    TRACE_THREAD("main");
+    stopped_event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    SetConsoleCtrlHandler(onConsoleEvent, TRUE);
+
+    StatsStreamServer stream;
+    if (!streamName.isEmpty() && !stream.Listen(streamName)) {
+        qWarning() << "Not streaming on" << streamName << ":" << stream.ErrorString();
+    }
+
+    // Viewers read the latest samples from here instead of sampling
+    SharedStatsWriter shared;
+    const size_t sharedSamples = static_cast<size_t>(std::max(sharedSeconds, 1)) * 1000 / std::max(intervalMs, 1);
+    if (!sharedName.isEmpty() && !shared.Create(sharedName, sharedSamples, intervalMs)) {
+        qWarning() << "Not sharing on" << sharedName << ":" << shared.ErrorString();
+    }
+
+    // host[:port]; the port defaults to the aggregator's
+    StatsPushClient push;
+    if (!pushTarget.isEmpty()) {
+        const QStringList parts = pushTarget.split(':');
+        const quint16 port = parts.size() > 1 ? parts[1].toUShort() : 0;
+        push.Start(parts[0], port ? port : kDefaultAggregatorPort, hostName);
+    }
+
+    AlertHook alertHook;
+    alertHook.Start(alertHookCommand);
+
+    Collector collector(dbPath, pid, intervalMs);
+    collector.SetRulesPath(rulesPath);
+    collector.SetAlertsPath(alertsPath);
+    if (!alertHookCommand.isEmpty()) {
+        collector.SetAlertHook(&alertHook);
+    }
+    collector.SetMetrics(metrics);
+    collector.SetStream(&stream);
+    collector.SetShared(&shared);
+    if (!pushTarget.isEmpty()) {
+        collector.SetPush(&push);
+    }
+    // Nobody drains samples here; they are only stored
+    collector.SetHandOffEnabled(false);
+
+    ProcessEnumerator enumerator([&collector](std::shared_ptr<const ProcessSnapshot> snapshot) {
+        collector.AddSnapshot(std::move(snapshot));
+    }, workers, affinity);
+    enumerator.SetMetrics(metrics);
+    QTimer snapshotTimer;
+    QObject::connect(&snapshotTimer, &QTimer::timeout, [&enumerator]() { enumerator.Request(); });
+
+    collector.Start();
+    enumerator.Request();
+    snapshotTimer.start(snapshotMs > 0 ? snapshotMs : kSnapshotIntervalMs);
+
+    qInfo().noquote() << QString("Collecting %1 into %2 every %3 ms; started in %4 ms, %5")
+                             .arg(MetricGroupNames(metrics.groups), dbPath).arg(intervalMs).arg(startup.elapsed())
+                             .arg(memoryUsage());
+
+    const int code = app.exec();
+
+    snapshotTimer.stop();
+    collector.Stop();
+    stream.Close();
+    shared.Close();
+    push.Stop();
+    alertHook.Stop();
+    qInfo().noquote() << QString("Stopped after %1 samples, %2 dropped by stream subscribers, %3")
+                             .arg(collector.SampleCount()).arg(stream.DroppedCount()).arg(memoryUsage());
+    if (!pushTarget.isEmpty()) {
+        qInfo().noquote() << QString("Pushed %1 samples to %2 as %3, %4 dropped")
+                                 .arg(push.SentCount()).arg(pushTarget, hostName).arg(push.DroppedCount());
+    }
+    if (!alertHookCommand.isEmpty()) {
+        qInfo().noquote() << QString("Alert hook ran %1 times, %2 alerts dropped")
+                                 .arg(alertHook.RunCount()).arg(alertHook.DroppedCount());
+    }
+    if (!trace_path.isEmpty()) {
+        writeTrace();
+    }
+
+    SetEvent(stopped_event);
+    return code;
+}
@@ -0,0 +1,170 @@
+#include "eventlogmodel.h"
+
+#include <QBrush>
+#include <QColor>
+#include <QDateTime>
+
+#include <algorithm>
+
+EventLogModel::EventLogModel(size_t capacity, QObject *parent)
+    : QAbstractTableModel(parent)
+    , ring(std::max<size_t>(capacity, 1))
+    , sequences(ring.size(), 0)
+{
+}
+
+int EventLogModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : static_cast<int>(count);
+}
+
+int EventLogModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+const LiveEvent &EventLogModel::eventAt(int row) const
+{
+    const size_t size = ring.size();
+    return ring[(head + size - 1 - static_cast<size_t>(row)) % size];
+}
+
+QVariant EventLogModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= static_cast<int>(count)) {
+        return QVariant();
+    }
+
+    const LiveEvent &event = eventAt(index.row());
+    const double totalCpu = event.cpu_user + event.cpu_kernel;
+
+    switch (role) {
+    case Qt::DisplayRole:
+        switch (index.column()) {
+        case SequenceColumn: {
+            const size_t size = ring.size();
+            return sequences[(head + size - 1 - static_cast<size_t>(index.row())) % size];
+        }
+        case ProcessColumn:   return event.process;
+        case PidColumn:       return event.pid;
+        case CpuUserColumn:   return QString::number(event.cpu_user, 'f', 1) + "%";
+        case CpuKernelColumn: return QString::number(event.cpu_kernel, 'f', 1) + "%";
+        case CpuTotalColumn:  return QString::number(totalCpu, 'f', 1) + "%";
+        case TimeStampColumn: return QDateTime::fromMSecsSinceEpoch(event.time_stamp).toString("yyyy-MM-dd hh:mm:ss.zzz");
+        }
+        break;
+
+    case Qt::TextAlignmentRole:
+        if (index.column() == CpuUserColumn || index.column() == CpuKernelColumn || index.column() == CpuTotalColumn) {
+            return int(Qt::AlignRight | Qt::AlignVCenter);
+        }
+        break;
+
+    case Qt::BackgroundRole:
+        // Color code the total CPU
+        if (index.column() == CpuTotalColumn) {
+            if (totalCpu > 20.0) {
+                return QBrush(QColor(255, 200, 200));
+            } else if (totalCpu > 10.0) {
+                return QBrush(QColor(255, 255, 200));
+            }
+            return QBrush(QColor(200, 255, 200));
+        }
+        break;
+    }
+
+    return QVariant();
+}
+
+QVariant EventLogModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole || orientation != Qt::Horizontal) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+
+    switch (section) {
+    case SequenceColumn:  return QStringLiteral("Line #");
+    case ProcessColumn:   return QStringLiteral("Process");
+    case PidColumn:       return QStringLiteral("PID");
+    case CpuUserColumn:   return QStringLiteral("CPU-User%");
+    case CpuKernelColumn: return QStringLiteral("CPU-Kernel");
+    case CpuTotalColumn:  return QStringLiteral("Total CPU");
+    case TimeStampColumn: return QStringLiteral("TimeStamp");
+    }
+    return QVariant();
+}
+
+void EventLogModel::append(const LiveEvent &event)
+{
+    append(&event, 1);
+}
+
+void EventLogModel::append(const std::vector<LiveEvent> &events)
+{
+    append(events.data(), events.size());
+}
+
+void EventLogModel::append(const LiveEvent *events, size_t eventCount)
+{
+    if (eventCount == 0) {
+        return;
+    }
+
+    const size_t size = ring.size();
+    // Only the newest size events of a batch can ever be visible
+    const size_t skip = eventCount > size ? eventCount - size : 0;
+    const size_t added = eventCount - skip;
+    nextSequence += skip;
+
+    // Drop the oldest rows from the bottom to make room
+    const size_t overflow = count + added > size ? count + added - size : 0;
+    if (overflow > 0) {
+        beginRemoveRows(QModelIndex(), static_cast<int>(count - overflow), static_cast<int>(count - 1));
+        count -= overflow;
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), 0, static_cast<int>(added - 1));
+    for (size_t i = skip; i < eventCount; ++i) {
+        ring[head] = events[i];
+        sequences[head] = nextSequence++;
+        head = (head + 1) % size;
+    }
+    count += added;
+    endInsertRows();
+}
+
+void EventLogModel::setCapacity(size_t capacity)
+{
+    capacity = std::max<size_t>(capacity, 1);
+    if (capacity == ring.size()) {
+        return;
+    }
+
+    beginResetModel();
+
+    // Keep the newest events that still fit, oldest first
+    const size_t keep = std::min(count, capacity);
+    std::vector<LiveEvent> newRing(capacity);
+    std::vector<quint64> newSequences(capacity, 0);
+    for (size_t i = 0; i < keep; ++i) {
+        const size_t from = (head + ring.size() - keep + i) % ring.size();
+        newRing[i] = std::move(ring[from]);
+        newSequences[i] = sequences[from];
+    }
+
+    ring.swap(newRing);
+    sequences.swap(newSequences);
+    head = keep % capacity;
+    count = keep;
+    endResetModel();
+}
+
+void EventLogModel::clear()
+{
+    beginResetModel();
+    std::fill(ring.begin(), ring.end(), LiveEvent());
+    head = 0;
+    count = 0;
+    endResetModel();
+}
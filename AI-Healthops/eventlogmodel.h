@@ -0,0 +1,64 @@
+#ifndef EVENTLOGMODEL_H
+#define EVENTLOGMODEL_H
+
+#include <QAbstractTableModel>
+#include <QString>
+
+#include <vector>
+
+// One row of the live events table
+struct LiveEvent
+{
+    qint64 time_stamp = 0;  // ms since epoch
+    quint32 pid = 0;
+    QString process;        // shared between events of the same process
+    double cpu_user = 0.0;
+    double cpu_kernel = 0.0;
+};
+
+// Live event log backed by a fixed-capacity ring buffer. The newest event is
+// row 0. Appending writes into the ring in O(1) per event; once the ring is
+// full the oldest rows drop off the bottom. Cells are only formatted when the
+// view asks for them, so the depth can be far larger than the visible rows.
+class EventLogModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column {
+        SequenceColumn,
+        ProcessColumn,
+        PidColumn,
+        CpuUserColumn,
+        CpuKernelColumn,
+        CpuTotalColumn,
+        TimeStampColumn,
+        ColumnCount
+    };
+
+    explicit EventLogModel(size_t capacity = 100000, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    void append(const LiveEvent &event);
+    void append(const std::vector<LiveEvent> &events);
+
+    size_t capacity() const { return ring.size(); }
+    void setCapacity(size_t capacity);
+    void clear();
+
+private:
+    void append(const LiveEvent *events, size_t eventCount);
+    const LiveEvent &eventAt(int row) const;
+
+    std::vector<LiveEvent> ring;
+    std::vector<quint64> sequences;
+    size_t head = 0;   // next write position
+    size_t count = 0;
+    quint64 nextSequence = 1;
+};
+
+#endif // EVENTLOGMODEL_H
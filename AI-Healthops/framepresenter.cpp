@@ -0,0 +1,78 @@
+#include "framepresenter.h"
+#include "proc_collector.h"
+#include "proc_trace.h"
+
+#include <QEvent>
+#include <QWidget>
+
+// Refresh interval while the window is visible (~30 Hz) and while it is
+// minimized or hidden
+static const int kVisibleFrameMs = 33;
+static const int kHiddenFrameMs = 1000;
+
+FramePresenter::FramePresenter(Collector *collector, QWidget *window, QObject *parent)
+    : QObject(parent)
+    , collector(collector)
+    , window(window)
+{
+    frameTimer.setTimerType(Qt::PreciseTimer);
+    connect(&frameTimer, &QTimer::timeout, this, &FramePresenter::presentFrame);
+    window->installEventFilter(this);
+}
+
+void FramePresenter::start()
+{
+    statisticsClock.start();
+    updateRate();
+    frameTimer.start();
+}
+
+void FramePresenter::stop()
+{
+    frameTimer.stop();
+}
+
+bool FramePresenter::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == window) {
+        switch (event->type()) {
+        case QEvent::WindowStateChange:
+        case QEvent::Show:
+        case QEvent::Hide:
+            updateRate();
+            break;
+        default:
+            break;
+        }
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+void FramePresenter::updateRate()
+{
+    const bool hidden = !window->isVisible() || window->isMinimized();
+    frameTimer.setInterval(hidden ? kHiddenFrameMs : kVisibleFrameMs);
+}
+
+void FramePresenter::presentFrame()
+{
+    TRACE_SPAN("ui.present_frame");
+    // Nothing new means nothing to repaint
+    if (collector->Drain(batch) != 0) {
+        ++frames;
+        ++framesSinceReport;
+        samples += batch.size();
+        coalesced += batch.size() - 1;
+        emit frameReady(batch);
+    }
+
+    if (statisticsClock.elapsed() >= 1000) {
+        const double seconds = statisticsClock.restart() / 1000.0;
+        emit statisticsChanged(QString("UI %1 fps | %2 samples, %3 coalesced, %4 dropped")
+                               .arg(framesSinceReport / seconds, 0, 'f', 1)
+                               .arg(samples)
+                               .arg(coalesced)
+                               .arg(collector->DroppedCount()));
+        framesSinceReport = 0;
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef FRAMEPRESENTER_H
+#define FRAMEPRESENTER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+
+#include "proc_stats.h"
+
+struct Collector;
+class QWidget;
+
+// Presentation layer between the collector and the widgets. A timer on the
+// GUI thread drains everything the collector produced since the last frame
+// and hands it over as one batch, so the GUI does one update per frame no
+// matter how fast samples arrive. The frame rate drops while the window is
+// minimized or hidden.
+class FramePresenter : public QObject
+{
+    Q_OBJECT
+
+public:
+    FramePresenter(Collector *collector, QWidget *window, QObject *parent = nullptr);
+
+    void start();
+    void stop();
+
+    quint64 framesPresented() const { return frames; }
+    quint64 samplesPresented() const { return samples; }
+    // Samples that shared a frame with another sample
+    quint64 samplesCoalesced() const { return coalesced; }
+
+signals:
+    void frameReady(const std::vector<StatsSample> &batch);
+    // Emitted about once a second with a short human readable summary
+    void statisticsChanged(const QString &summary);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    void presentFrame();
+    void updateRate();
+
+    Collector *collector;
+    QWidget *window;
+    QTimer frameTimer;
+    QElapsedTimer statisticsClock;
+    std::vector<StatsSample> batch;
+
+    quint64 frames = 0;
+    quint64 samples = 0;
+    quint64 coalesced = 0;
+    quint64 framesSinceReport = 0;
+};
+
+#endif // FRAMEPRESENTER_H
@@ -0,0 +1,177 @@
+#include "historychartview.h"
+#include "proc_history.h"
+#include "proc_trace.h"
+
+#include <QDateTime>
+#include <QWheelEvent>
+#include <QMouseEvent>
+#include <QKeyEvent>
+#include <QResizeEvent>
+
+#include <algorithm>
+
+// Live view shows the last 100 seconds, matching the old fixed 100-sample axis
+static const qint64 kDefaultSpanMs = 100 * 1000;
+static const qint64 kMinSpanMs = 10 * 1000;
+static const double kZoomStep = 0.8;
+
+HistoryChartView::HistoryChartView(const SeriesHistory *history, QLineSeries *series, QDateTimeAxis *axisX, QWidget *parent)
+    : QChartView(series->chart(), parent)
+    , history(history)
+    , series(series)
+    , axisX(axisX)
+    , viewSpan(kDefaultSpanMs)
+{
+    setRubberBand(QChartView::NoRubberBand);
+    setFocusPolicy(Qt::StrongFocus);
+}
+
+void HistoryChartView::followLive()
+{
+    following = true;
+    viewSpan = kDefaultSpanMs;
+    refresh();
+}
+
+void HistoryChartView::showRange(qint64 from, qint64 to)
+{
+    following = false;
+    viewSpan = to - from;
+    viewEnd = to;
+    refresh();
+}
+
+void HistoryChartView::refresh()
+{
+    TRACE_SPAN("ui.chart_refresh");
+    if (history->Empty()) {
+        return;
+    }
+
+    if (following) {
+        viewEnd = history->LastTime();
+    }
+    clampView();
+
+    const qint64 viewStart = viewEnd - viewSpan;
+    const int columns = std::max(static_cast<int>(chart()->plotArea().width()), 100);
+
+    series->replace(history->Points(viewStart, viewEnd, columns));
+
+    axisX->setFormat(viewSpan > 24LL * 3600 * 1000 ? "MM-dd hh:mm" : "hh:mm:ss");
+    axisX->setRange(QDateTime::fromMSecsSinceEpoch(viewStart), QDateTime::fromMSecsSinceEpoch(viewEnd));
+}
+
+void HistoryChartView::clampView()
+{
+    const qint64 first = history->FirstTime();
+    const qint64 last = history->LastTime();
+
+    viewSpan = std::max(viewSpan, kMinSpanMs);
+    viewSpan = std::min(viewSpan, std::max(last - first, kDefaultSpanMs));
+
+    if (viewEnd >= last) {
+        viewEnd = last;
+        following = true;
+    }
+    if (viewEnd - viewSpan < first) {
+        viewEnd = std::min(first + viewSpan, last);
+    }
+}
+
+void HistoryChartView::wheelEvent(QWheelEvent *event)
+{
+    const QRectF plot = chart()->plotArea();
+    if (plot.width() <= 0 || event->angleDelta().y() == 0) {
+        return;
+    }
+
+    // Keep the time under the cursor fixed while zooming
+    double fraction = (event->position().x() - plot.left()) / plot.width();
+    fraction = std::clamp(fraction, 0.0, 1.0);
+    const qint64 viewStart = viewEnd - viewSpan;
+    const qint64 anchor = viewStart + static_cast<qint64>(fraction * viewSpan);
+
+    const double factor = event->angleDelta().y() > 0 ? kZoomStep : 1.0 / kZoomStep;
+    viewSpan = static_cast<qint64>(viewSpan * factor);
+    viewEnd = anchor + static_cast<qint64>((1.0 - fraction) * viewSpan);
+    following = false;
+
+    refresh();
+    event->accept();
+}
+
+void HistoryChartView::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton) {
+        panning = true;
+        lastMousePos = event->pos();
+        setCursor(Qt::ClosedHandCursor);
+        event->accept();
+        return;
+    }
+    QChartView::mousePressEvent(event);
+}
+
+void HistoryChartView::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!panning) {
+        QChartView::mouseMoveEvent(event);
+        return;
+    }
+
+    const QRectF plot = chart()->plotArea();
+    if (plot.width() > 0) {
+        const int dx = event->pos().x() - lastMousePos.x();
+        viewEnd -= static_cast<qint64>(dx * viewSpan / plot.width());
+        following = false;
+        refresh();
+    }
+    lastMousePos = event->pos();
+    event->accept();
+}
+
+void HistoryChartView::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (panning && event->button() == Qt::LeftButton) {
+        panning = false;
+        unsetCursor();
+        event->accept();
+        return;
+    }
+    QChartView::mouseReleaseEvent(event);
+}
+
+void HistoryChartView::mouseDoubleClickEvent(QMouseEvent *event)
+{
+    followLive();
+    event->accept();
+}
+
+void HistoryChartView::keyPressEvent(QKeyEvent *event)
+{
+    switch (event->key()) {
+    case Qt::Key_Home:
+        followLive();
+        break;
+    case Qt::Key_Plus:
+        viewSpan = static_cast<qint64>(viewSpan * kZoomStep);
+        refresh();
+        break;
+    case Qt::Key_Minus:
+        viewSpan = static_cast<qint64>(viewSpan / kZoomStep);
+        refresh();
+        break;
+    default:
+        QChartView::keyPressEvent(event);
+        return;
+    }
+    event->accept();
+}
+
+void HistoryChartView::resizeEvent(QResizeEvent *event)
+{
+    QChartView::resizeEvent(event);
+    // The number of points depends on the plot width
+    refresh();
+}
@@ -0,0 +1,52 @@
+#ifndef HISTORYCHARTVIEW_H
+#define HISTORYCHARTVIEW_H
+
+#include <QtCharts/QChartView>
+#include <QtCharts/QLineSeries>
+#include <QtCharts/QDateTimeAxis>
+#include <QPoint>
+
+struct SeriesHistory;
+
+// Chart view over a SeriesHistory. The wheel zooms around the cursor, a
+// left-drag pans, and a double-click (or Home) returns to the live tail.
+// Only about one point per horizontal pixel is handed to the series.
+class HistoryChartView : public QChartView
+{
+    Q_OBJECT
+
+public:
+    HistoryChartView(const SeriesHistory *history, QLineSeries *series, QDateTimeAxis *axisX, QWidget *parent = nullptr);
+
+    void refresh();
+    void followLive();
+    // Stops following and shows [from, to] (ms since epoch)
+    void showRange(qint64 from, qint64 to);
+    // Range currently shown (ms since epoch)
+    qint64 viewStartTime() const { return viewEnd - viewSpan; }
+    qint64 viewEndTime() const { return viewEnd; }
+
+protected:
+    void wheelEvent(QWheelEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    void clampView();
+
+    const SeriesHistory *history;
+    QLineSeries *series;
+    QDateTimeAxis *axisX;
+
+    bool following = true;
+    qint64 viewEnd = 0;
+    qint64 viewSpan;
+    bool panning = false;
+    QPoint lastMousePos;
+};
+
+#endif // HISTORYCHARTVIEW_H
@@ -1,4 +1,5 @@
 #include "mainwindow.h"
+#include "analysisreport.h"
 #include "proc_stats.h"
 
 // Add these Windows API includes
@@ -15,106 +16,311 @@
 #include <QtCharts/QChart>
 #include <QtCharts/QLineSeries>
 #include <QtCharts/QValueAxis>
+#include <QtCharts/QDateTimeAxis>
 #include <QtCharts/QChartView>
-#include <QtCharts/QChartView>
+
+#include "historychartview.h"
+#include "processtablemodel.h"
+#include "processfilterproxymodel.h"
+#include "eventlogmodel.h"
+#include "framepresenter.h"
+#include "proc_collector.h"
+#include "proc_database.h"
+#include "proc_enumerator.h"
+#include "proc_shared.h"
+#include "proc_stream.h"
+#include "proc_trace.h"
+
+#include <QElapsedTimer>
+#include <QLockFile>
 
 //using namespace QtCharts;
 
 std::vector<Stats> stats;
 
-QLineSeries* cpu_series;
-//QLineSeries* line_mark;
-QChartView* cpu_chartView;
+// Number of live samples kept in the events table
+static const size_t kEventLogDepth = 100000;
+
+// Anomaly regions listed under "Regions of Interest", newest first
+static const int kRegionsListed = 1000;
 
+// Alert events listed under "Alerts", newest first
+static const int kAlertsListed = 1000;
 
+// Processes whose 15-minute totals are shown in the process table
+static const size_t kHeavyHittersShown = 20;
 
-struct ProcessInfo {
-    QString processName;
-    DWORD processID;
-    double cpuUsage;
-    SIZE_T workingSetSize;
-    QString userName;
-    QString timestamp;
-};
+// Latest samples kept for viewers in shared memory, ten minutes at 1 s
+static const size_t kSharedSamples = 600;
+
+static const int kRegionStartRole = Qt::UserRole;
+static const int kRegionEndRole = Qt::UserRole + 1;
+static const int kRegionMetricRole = Qt::UserRole + 2;
+static const int kRegionBaselineRole = Qt::UserRole + 3;
+static const int kAlertIdRole = Qt::UserRole + 4;
 
 
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
 {
+    TRACE_THREAD("ui");
+    const QString dataDir = Collector::DataDir();
+    collectorLock = std::make_unique<QLockFile>(dataDir + "/collector.lock");
+    const bool viewer = !collectorLock->tryLock(0);
+    collector = std::make_unique<Collector>(dataDir + "/healthops.db");
+    collector->SetRulesPath(dataDir + "/rules.json");
+    collector->SetAlertsPath(dataDir + "/alerts.json");
+    collector->SetStorageEnabled(!viewer);
+    // Live subscribers follow whichever collector owns the store; a viewer
+    // shows that collector's samples instead of taking its own
+    if (viewer) {
+        sharedSource = std::make_unique<SharedStatsReader>(kDefaultSharedName);
+        collector->SetSource(sharedSource.get());
+    } else {
+        statsStream = std::make_unique<StatsStreamServer>();
+        if (statsStream->Listen(kDefaultStreamName)) {
+            collector->SetStream(statsStream.get());
+        } else {
+            qDebug() << "Not streaming live samples:" << statsStream->ErrorString();
+        }
+        sharedStats = std::make_unique<SharedStatsWriter>();
+        if (sharedStats->Create(kDefaultSharedName, kSharedSamples, 1000)) {
+            collector->SetShared(sharedStats.get());
+        } else {
+            qDebug() << "Not sharing live samples:" << sharedStats->ErrorString();
+        }
+    }
+
+    processEnumerator = std::make_unique<ProcessEnumerator>([this](std::shared_ptr<const ProcessSnapshot> snapshot) {
+        collector->AddSnapshot(snapshot);
+        QMetaObject::invokeMethod(this, [this, snapshot]() {
+            applyProcessSnapshot(snapshot);
+        }, Qt::QueuedConnection);
+    });
+
     // Initialize process update timer
     processUpdateTimer = new QTimer(this);
     connect(processUpdateTimer, &QTimer::timeout, this, &MainWindow::updateProcessTable);
 
-    stats_thread = std::thread([this](){
-        PerformanceStats perf_stats;
-        int index = 0;
-        bool filled = false;
-        int size = 100;
-        QRandomGenerator generator(123435);
-        while(!this->stop){
-            std::this_thread::sleep_for(std::chrono::seconds(1));
-            auto stat = perf_stats.GetStats();
-
-            if(index >= size){
-                filled = true;
-                index = 0;
-            }
-
-            if(cpu_series != nullptr){
-                //cpu_series->remove(index);
-                //cpu_series->insert(index, QPointF(index, stat.CPU_KERNPERCENT + stat.CPU_USERPERCENT));
-                //auto random_value = generator.generate()%100;
-                int random_value = 0;
-
-                if(filled){
-                    cpu_series->remove(index);
-                    cpu_series->insert(index, QPointF(index, stat.CPU_KERNPERCENT + stat.CPU_USERPERCENT + random_value));
-                } else{
-                    cpu_series->append(QPointF(index, stat.CPU_KERNPERCENT + stat.CPU_USERPERCENT + random_value));
-                }
-                //line_mark->clear();
-                //line_mark->append(QPointF(index, 50));
-                //line_mark->append(QPointF(index, 100));
-
-                 // --- UPDATE TABLE WITH REAL DATA ---
-                QMetaObject::invokeMethod(this, [this, stat]() {
-                    updateEventsTableWithRealData(stat);
-                }, Qt::QueuedConnection);
-                // -----------------------------------
-
-                qInfo() << "Index: " << index << "Random value: " << random_value;
-                cpu_chartView->update();
-
-                index++;
-            }
-
-        }
-    });
-
     setupUI();
     createMenuBar();
     createToolBar();
     createStatusBar();
+    if (viewer) {
+        statusBar->showMessage("Viewer: showing the live samples of the collector daemon, which owns the store");
+    }
+
+    // Sampling and storage run on the collector's thread; the presenter
+    // hands the samples to the widgets at the display rate.
+    framePresenter = new FramePresenter(collector.get(), this, this);
+    connect(framePresenter, &FramePresenter::frameReady, this, &MainWindow::presentSamples);
+    connect(framePresenter, &FramePresenter::statisticsChanged, frameStatsLabel, &QLabel::setText);
+    collector->Start();
+    framePresenter->start();
 
     // Start the process update timer (update every 10 seconds)
     processUpdateTimer->start(10000);
 
     // Set window properties
-    setWindowTitle("Performance Analyzer - AI HealthOps");
+    setWindowTitle(viewer ? "Performance Analyzer - AI HealthOps (viewer)" : "Performance Analyzer - AI HealthOps");
     setMinimumSize(1200, 800);
     resize(1400, 900);
 }
 
 MainWindow::~MainWindow()
 {
-    stop = true;
     if (processUpdateTimer) {
         processUpdateTimer->stop();
     }
-    if (stats_thread.joinable()) {
-        stats_thread.join();
+    framePresenter->stop();
+    collector->Stop();
+    processEnumerator.reset();
+    if (statsStream) {
+        statsStream->Close();
+    }
+    if (sharedStats) {
+        sharedStats->Close();
+    }
+}
+
+void MainWindow::presentSamples(const std::vector<StatsSample> &batch)
+{
+    std::vector<LiveEvent> events;
+    events.reserve(batch.size());
+    for (const StatsSample &sample : batch) {
+        LiveEvent event;
+        event.time_stamp = sample.time_stamp;
+        event.pid = sample.pid;
+        event.process = sample.process;
+        event.cpu_user = sample.stats.CPU_USERPERCENT;
+        event.cpu_kernel = sample.stats.CPU_KERNPERCENT;
+        events.push_back(event);
+    }
+
+    // One model update and one chart refresh per frame
+    eventModel->append(events);
+    cpuChartView->refresh();
+
+    std::vector<AnomalyRegion> regions;
+    if (collector->DrainRegions(regions) != 0) {
+        addRegions(regions);
+    }
+    std::vector<AlertEvent> alerts;
+    if (collector->DrainAlerts(alerts) != 0) {
+        addAlerts(alerts);
     }
+    updateMemoryTrends(collector->Trends());
+    updateLiveRecommendations();
+}
+
+void MainWindow::updateMemoryTrends(const std::vector<TrendEstimate> &trends)
+{
+    // One child per metric and window, updated in place
+    while (memoryItem->childCount() < static_cast<int>(trends.size())) {
+        memoryItem->addChild(new QTreeWidgetItem());
+    }
+
+    bool leaking = false;
+    for (size_t i = 0; i < trends.size(); ++i) {
+        const TrendEstimate &trend = trends[i];
+        const QString metric = kStatsFields[trend.metric].member == &Stats::PROC_WORKINGSETSIZE ? "Working set" : "Pagefile";
+        const qint64 minutes = trend.window_ms / 60000;
+        const QString window = minutes >= 60 ? QString("%1 h").arg(minutes / 60) : QString("%1 min").arg(minutes);
+
+        QString text;
+        if (!trend.covered) {
+            text = QString("%1, %2: collecting (now %3 MB)").arg(metric, window).arg(trend.current / (1024.0 * 1024.0), 0, 'f', 1);
+        } else {
+            text = QString("%1, %2: %3 MB/h (least squares %4, r2 %5)")
+                       .arg(metric, window)
+                       .arg(trend.theil_sen / (1024.0 * 1024.0), 0, 'f', 2)
+                       .arg(trend.least_squares / (1024.0 * 1024.0), 0, 'f', 2)
+                       .arg(trend.r2, 0, 'f', 2);
+            if (trend.growing && trend.hours_to_limit >= 0.0) {
+                text += QString(", limit in %1 h").arg(trend.hours_to_limit, 0, 'f', 1);
+            }
+        }
+
+        QTreeWidgetItem *item = memoryItem->child(static_cast<int>(i));
+        item->setText(0, text);
+        item->setForeground(0, trend.growing ? QBrush(QColor(200, 0, 0)) : QBrush());
+        leaking = leaking || trend.growing;
+    }
+    memoryItem->setText(0, leaking ? "Memory usage (sustained growth)" : "Memory usage");
+}
+
+void MainWindow::addRegions(const std::vector<AnomalyRegion> &regions)
+{
+    for (const AnomalyRegion &region : regions) {
+        const QString text = QString("%1  %2 (%3)  %4 %5: %6 vs %7, z %8")
+                                 .arg(QDateTime::fromMSecsSinceEpoch(region.start).toString("MM-dd hh:mm:ss"))
+                                 .arg(region.process)
+                                 .arg(region.pid)
+                                 .arg(kStatsFields[region.metric].name)
+                                 .arg(region.kind == AnomalyRegion::Shift ? "shift" : "spike")
+                                 .arg(region.peak, 0, 'f', 1)
+                                 .arg(region.baseline, 0, 'f', 1)
+                                 .arg(region.score, 0, 'f', 1);
+
+        QTreeWidgetItem *item = new QTreeWidgetItem();
+        item->setText(0, text);
+        item->setToolTip(0, QString("%1 to %2")
+                                .arg(QDateTime::fromMSecsSinceEpoch(region.start).toString("yyyy-MM-dd hh:mm:ss"))
+                                .arg(QDateTime::fromMSecsSinceEpoch(region.end).toString("yyyy-MM-dd hh:mm:ss")));
+        item->setData(0, kRegionStartRole, region.start);
+        item->setData(0, kRegionEndRole, region.end);
+        item->setData(0, kRegionMetricRole, region.metric);
+        item->setData(0, kRegionBaselineRole, region.baseline);
+        regionsItem->insertChild(0, item);
+    }
+
+    while (regionsItem->childCount() > kRegionsListed) {
+        delete regionsItem->takeChild(regionsItem->childCount() - 1);
+    }
+    regionsItem->setText(0, QString("Regions of Interest (%1)").arg(regionsItem->childCount()));
+}
+
+void MainWindow::addAlerts(const std::vector<AlertEvent> &alerts)
+{
+    for (const AlertEvent &alert : alerts) {
+        if (alert.kind == AlertEvent::Cleared) {
+            // The event that fired it is no longer current
+            for (int i = 0; i < alertsItem->childCount(); ++i) {
+                QTreeWidgetItem *fired = alertsItem->child(i);
+                if (fired->data(0, kAlertIdRole).toULongLong() == alert.id) {
+                    fired->setForeground(0, QBrush());
+                    break;
+                }
+            }
+        }
+
+        const QString text = QString("%1  %2 %3  %4 (%5): %6 vs %7")
+                                 .arg(QDateTime::fromMSecsSinceEpoch(alert.time_stamp).toString("MM-dd hh:mm:ss"))
+                                 .arg(alert.kind == AlertEvent::Fired ? "fired" : "cleared")
+                                 .arg(alert.label)
+                                 .arg(alert.process)
+                                 .arg(alert.pid)
+                                 .arg(alert.value, 0, 'f', 1)
+                                 .arg(alert.threshold, 0, 'f', 1);
+
+        QTreeWidgetItem *item = new QTreeWidgetItem();
+        item->setText(0, text);
+        item->setToolTip(0, QString("%1, past the threshold since %2")
+                                .arg(MetricName(alert.metric))
+                                .arg(QDateTime::fromMSecsSinceEpoch(alert.since).toString("yyyy-MM-dd hh:mm:ss")));
+        item->setData(0, kAlertIdRole, alert.id);
+        if (alert.kind == AlertEvent::Fired) {
+            item->setForeground(0, QBrush(QColor(200, 0, 0)));
+        }
+        alertsItem->insertChild(0, item);
+    }
+
+    while (alertsItem->childCount() > kAlertsListed) {
+        delete alertsItem->takeChild(alertsItem->childCount() - 1);
+    }
+    int firing = 0;
+    for (int i = 0; i < alertsItem->childCount(); ++i) {
+        firing += alertsItem->child(i)->foreground(0).style() != Qt::NoBrush ? 1 : 0;
+    }
+    alertsItem->setText(0, firing ? QString("Alerts (%1 firing)").arg(firing) : QString("Alerts"));
+}
+
+void MainWindow::showCulprits(int metric, qint64 from, qint64 to)
+{
+    // Compare against the host total of the same kind of resource
+    const QLatin1String name(kStatsFields[metric].name);
+    int series = ProcessSnapshot::CpuPercent;
+    if (name == QLatin1String("IO_BYTESWRITEPERSEC") || name == QLatin1String("IO_TOTALBYTESWRITE")) {
+        series = ProcessSnapshot::WriteBytesPerSec;
+    } else if (name.startsWith(QLatin1String("IO_"))) {
+        series = ProcessSnapshot::IoOpsPerSec;
+    } else if (name.startsWith(QLatin1String("PROC_"))) {
+        series = ProcessSnapshot::WorkingSet;
+    }
+
+    qDeleteAll(culpritsItem->takeChildren());
+    const std::vector<CorrelatedProcess> culprits = collector->Culprits(series, from, to);
+    for (const CorrelatedProcess &culprit : culprits) {
+        QTreeWidgetItem *item = new QTreeWidgetItem(culpritsItem);
+        item->setText(0, QString("%1 (%2): %3% of host %4, r %5")
+                             .arg(culprit.process)
+                             .arg(culprit.pid)
+                             .arg(culprit.share * 100.0, 0, 'f', 1)
+                             .arg(ProcessSnapshot::SeriesName(series))
+                             .arg(culprit.correlation, 0, 'f', 2));
+        if (culprit.lag > 0) {
+            item->setToolTip(0, QString("Leads the host total by %1 snapshot(s)").arg(culprit.lag));
+        }
+    }
+    if (culprits.empty() && to < collector->CulpritsSince()) {
+        // Only the last few minutes of snapshots are kept for this
+        culpritsItem->setText(0, "Likely Culprits (outside the correlation window)");
+    } else {
+        culpritsItem->setText(0, culprits.empty() ? "Likely Culprits (none found)"
+                                                  : QString("Likely Culprits (%1)").arg(culprits.size()));
+    }
+    culpritsItem->setExpanded(true);
 }
 
 void MainWindow::setupUI()
@@ -167,8 +373,8 @@ void MainWindow::createLeftPanel()
     QTreeWidgetItem *deviceIO = new QTreeWidgetItem(systemActivity);
     deviceIO->setText(0, "Device I/O");
 
-    QTreeWidgetItem *images = new QTreeWidgetItem(systemActivity);
-    images->setText(0, "Memory usage");
+    memoryItem = new QTreeWidgetItem(systemActivity);
+    memoryItem->setText(0, "Memory usage");
 
     QTreeWidgetItem *marks = new QTreeWidgetItem(systemActivity);
     marks->setText(0, "Remark");
@@ -176,8 +382,16 @@ void MainWindow::createLeftPanel()
     QTreeWidgetItem *processes = new QTreeWidgetItem(systemActivity);
     processes->setText(0, "Processes");
 
-    QTreeWidgetItem *regions = new QTreeWidgetItem(systemActivity);
-    regions->setText(0, "Regions of Interest");
+    regionsItem = new QTreeWidgetItem(systemActivity);
+    regionsItem->setText(0, "Regions of Interest");
+
+    alertsItem = new QTreeWidgetItem(systemActivity);
+    alertsItem->setText(0, "Alerts");
+    alertsItem->setToolTip(0, "Alerts from alerts.json in the data directory");
+
+    culpritsItem = new QTreeWidgetItem(systemActivity);
+    culpritsItem->setText(0, "Likely Culprits");
+    culpritsItem->setToolTip(0, "Select a region of interest to rank the processes behind it");
 
     QTreeWidgetItem *stacks = new QTreeWidgetItem(systemActivity);
     stacks->setText(0, "Stacks");
@@ -206,57 +420,90 @@ void MainWindow::createCenterPanel()
     //timelineLabel = new QLabel("Timeline View (Activity by Provider, Task, Opcode)", timelineWidget);
     //timelineLabel->setAlignment(Qt::AlignCenter);
 
-    cpu_series = new QLineSeries();
-    //line_mark = new QLineSeries();
+    cpuSeries = new QLineSeries();
 
     QChart* chart = new QChart();
-    chart->addSeries(cpu_series);
-    //chart->addSeries(line_mark);
+    chart->addSeries(cpuSeries);
     chart->setTitle("CPU usage");
+    chart->legend()->hide();
 
-    QValueAxis* axisX = new QValueAxis();
-    axisX->setRange(0, 100);
+    QDateTimeAxis* axisX = new QDateTimeAxis();
+    axisX->setFormat("hh:mm:ss");
     QFont axisX_title_font;
     axisX_title_font.setPointSize(12); // Sets the font size to 12 points
     // Apply the font to the axis title
     axisX->setTitleFont(axisX_title_font);
-    axisX->setTitleText("Samples");
+    axisX->setTitleText("Time (wheel to zoom, drag to pan, double-click for live)");
     chart->addAxis(axisX, Qt::AlignBottom);
-    cpu_series->attachAxis(axisX);
+    cpuSeries->attachAxis(axisX);
 
     QValueAxis* axisY = new QValueAxis();
     axisY->setRange(0, 100);
     axisY->setTitleText("CPU");
     chart->addAxis(axisY, Qt::AlignLeft);
-    cpu_series->attachAxis(axisY);
+    cpuSeries->attachAxis(axisY);
 
     // Set chart margins to give more space for Y-axis labels
 chart->setMargins(QMargins(60, 20, 20, 40));  // left, top, right, bottom
 
-    cpu_chartView = new QChartView(chart);
-    cpu_chartView->setMinimumHeight(300);
+    cpuChartView = new HistoryChartView(&collector->CpuHistory(), cpuSeries, axisX);
+    cpuChartView->setMinimumHeight(300);
 
     QVBoxLayout *timelineLayout = new QVBoxLayout(timelineWidget);
     //timelineLayout->addWidget(timelineLabel);
-    timelineLayout->addWidget(cpu_chartView);
-
-    // Events table (similar to Reference-1)
-    eventsTableWidget = new QTableWidget(this);
-    eventsTableWidget->setColumnCount(7);
-    QStringList headers = {"Line #", "Process", "PID", "CPU-User%", "CPU-Kernel", "Total CPU", "TimeStamp"};
-    eventsTableWidget->setHorizontalHeaderLabels(headers);
-    // ... (rest of eventsTableWidget setup is unchanged) ...
-    eventsTableWidget->horizontalHeader()->setStretchLastSection(true);
-    eventsTableWidget->setAlternatingRowColors(true);
-    eventsTableWidget->setSelectionBehavior(QAbstractItemView::SelectRows);
-
-    populateEventsTable();
-    
+    timelineLayout->addWidget(cpuChartView);
+
+    // Process table: model/view over the latest process snapshot
+    processModel = new ProcessTableModel(this);
+    processProxy = new ProcessFilterProxyModel(processModel, this);
+
+    processFilterEdit = new QLineEdit(this);
+    processFilterEdit->setPlaceholderText("Filter by name, user or PID, e.g. \"chrome ws > 500 MB cpu > 5\"");
+    processFilterEdit->setClearButtonEnabled(true);
+    connect(processFilterEdit, &QLineEdit::textChanged, processProxy, &ProcessFilterProxyModel::setQuery);
+
+    processTableView = new QTableView(this);
+    processTableView->setModel(processProxy);
+    processTableView->setSortingEnabled(true);
+    processTableView->setAlternatingRowColors(true);
+    processTableView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    // Fixed row heights let the view skip measuring rows while scrolling
+    processTableView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    processTableView->verticalHeader()->setDefaultSectionSize(22);
+    processTableView->verticalHeader()->hide();
+    processTableView->horizontalHeader()->setStretchLastSection(true);
+    processTableView->horizontalHeader()->resizeSection(ProcessTableModel::NameColumn, 220);
+    // Sort by Total CPU (descending) initially
+    processTableView->sortByColumn(ProcessTableModel::CpuTotalColumn, Qt::DescendingOrder);
+
+    QWidget *processPanel = new QWidget(this);
+    QVBoxLayout *processLayout = new QVBoxLayout(processPanel);
+    processLayout->setContentsMargins(0, 0, 0, 0);
+    processLayout->addWidget(processFilterEdit);
+    processLayout->addWidget(processTableView);
+
+    // Events table (similar to Reference-1), a ring buffer of live samples
+    eventModel = new EventLogModel(kEventLogDepth, this);
+    eventsTableView = new QTableView(this);
+    eventsTableView->setModel(eventModel);
+    eventsTableView->setAlternatingRowColors(true);
+    eventsTableView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    eventsTableView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    eventsTableView->verticalHeader()->setDefaultSectionSize(22);
+    eventsTableView->verticalHeader()->hide();
+    eventsTableView->horizontalHeader()->setStretchLastSection(true);
+
      // Load real current user processes instead of sample data
     getCurrentUserProcesses();
 
+    QSplitter *tablesSplitter = new QSplitter(Qt::Vertical, this);
+    tablesSplitter->addWidget(processPanel);
+    tablesSplitter->addWidget(eventsTableView);
+    tablesSplitter->setStretchFactor(0, 2);
+    tablesSplitter->setStretchFactor(1, 1);
+
     analysisLayout->addWidget(timelineWidget);
-    analysisLayout->addWidget(eventsTableWidget, 1);
+    analysisLayout->addWidget(tablesSplitter, 1);
 
      // AI Analysis tab
     aiAnalysisBrowser = new QTextBrowser(this);
@@ -313,7 +560,22 @@ void MainWindow::createMenuBar()
     // Trace menu
     QMenu *traceMenu = menuBar()->addMenu("&Trace");
     analyzeAction = new QAction("&Analyze", this);
+    analyzeAction->setToolTip("Save a feature summary of the visible range for the analysis service");
     traceMenu->addAction(analyzeAction);
+    connect(analyzeAction, &QAction::triggered, this, &MainWindow::exportFeatureSummary);
+    QAction *exportSamplesAction = new QAction("Export &Samples...", this);
+    exportSamplesAction->setToolTip("Save the samples of the visible range as CSV or JSON");
+    traceMenu->addAction(exportSamplesAction);
+    connect(exportSamplesAction, &QAction::triggered, this, &MainWindow::exportSamples);
+    QAction *percentilesAction = new QAction("&Percentiles...", this);
+    percentilesAction->setToolTip("Percentiles of the visible range from the stored sketches, for the selected processes or all of them");
+    traceMenu->addAction(percentilesAction);
+    connect(percentilesAction, &QAction::triggered, this, &MainWindow::showPercentiles);
+    QAction *timingTraceAction = new QAction("Save &Timing Trace...", this);
+    timingTraceAction->setToolTip("Save the collector's and the UI's recent timing spans for Perfetto");
+    timingTraceAction->setEnabled(kTracingEnabled);
+    traceMenu->addAction(timingTraceAction);
+    connect(timingTraceAction, &QAction::triggered, this, &MainWindow::saveTimingTrace);
 
     // Profiles menu
     menuBar()->addMenu("&Profiles");
@@ -340,11 +602,38 @@ void MainWindow::createStatusBar()
 {
     statusBar = QMainWindow::statusBar();
     statusBar->showMessage("Ready");
+
+    frameStatsLabel = new QLabel(this);
+    statusBar->addPermanentWidget(frameStatsLabel);
 }
 
 void MainWindow::onAnalysisItemClicked()
 {
     QTreeWidgetItem *item = analysisTreeWidget->currentItem();
+    if (item && item->parent() == regionsItem) {
+        // Show the region with some context on either side in the chart
+        const qint64 start = item->data(0, kRegionStartRole).toLongLong();
+        const qint64 end = item->data(0, kRegionEndRole).toLongLong();
+        const qint64 margin = std::max<qint64>((end - start) / 2, 10000);
+        centerTabWidget->setCurrentIndex(0);
+        cpuChartView->showRange(start - margin, end + margin);
+        const int metric = item->data(0, kRegionMetricRole).toInt();
+        showCulprits(metric, start, end);
+
+        // How the metric behaved over the whole shown range, and how much of
+        // it was above the region's baseline
+        const ColumnStats range = collector->MetricStats(metric, start - margin, end + margin,
+                                                         static_cast<quint64>(item->data(0, kRegionBaselineRole).toDouble()));
+        statusBar->showMessage(QString("Region: %1  |  %2 samples, mean %3, min %4, max %5, %6 above baseline")
+                                   .arg(item->text(0))
+                                   .arg(range.count)
+                                   .arg(range.Mean(), 0, 'f', 1)
+                                   .arg(range.min)
+                                   .arg(range.max)
+                                   .arg(range.above));
+        return;
+    }
+
     if (item) {
         QString itemText = item->text(0);
         statusBar->showMessage("Selected: " + itemText);
@@ -360,6 +649,130 @@ void MainWindow::onAnalysisItemClicked()
     }
 }
 
+void MainWindow::exportFeatureSummary()
+{
+    TRACE_SPAN("ui.feature_summary");
+    // The summary covers what the CPU chart currently shows
+    const qint64 from = cpuChartView->viewStartTime();
+    const qint64 to = cpuChartView->viewEndTime();
+
+    QElapsedTimer timer;
+    timer.start();
+    const QByteArray json = QJsonDocument(collector->FeatureSummary(from, to)).toJson(QJsonDocument::Compact);
+    const qint64 buildUs = timer.nsecsElapsed() / 1000;
+
+    QString filePath = QFileDialog::getSaveFileName(this, "Save Feature Summary", "summary.json", "JSON Files (*.json);;All Files (*)");
+    if (filePath.isEmpty()) {
+        return;
+    }
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+        QMessageBox::warning(this, "Error", "Could not save file: " + file.errorString());
+        return;
+    }
+
+    statusBar->showMessage(QString("Feature summary: %1 bytes, built in %2 us").arg(json.size()).arg(buildUs));
+}
+
+void MainWindow::exportSamples()
+{
+    // Like the summary, the samples the CPU chart currently shows
+    const std::vector<StatsSample> samples = collector->Samples(cpuChartView->viewStartTime(), cpuChartView->viewEndTime());
+
+    QString filePath = QFileDialog::getSaveFileName(this, "Export Samples", "samples.csv", "CSV Files (*.csv);;JSON Files (*.json);;All Files (*)");
+    if (filePath.isEmpty()) {
+        return;
+    }
+
+    QByteArray data;
+    if (filePath.endsWith(".json", Qt::CaseInsensitive)) {
+        QJsonArray rows;
+        for (const StatsSample &sample : samples) {
+            rows.append(StatsToJson(sample));
+        }
+        data = QJsonDocument(rows).toJson(QJsonDocument::Compact);
+    } else {
+        data = StatsCsvHeader();
+        for (const StatsSample &sample : samples) {
+            AppendStatsCsv(sample, data);
+        }
+    }
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+        QMessageBox::warning(this, "Error", "Could not save file: " + file.errorString());
+        return;
+    }
+    statusBar->showMessage(QString("Exported %1 samples to %2").arg(samples.size()).arg(filePath));
+}
+
+void MainWindow::showPercentiles()
+{
+    TRACE_SPAN("ui.percentiles");
+    // The range the CPU chart shows, over the processes selected in the
+    // process table or every process if none is
+    const qint64 from = cpuChartView->viewStartTime();
+    const qint64 to = cpuChartView->viewEndTime();
+    std::vector<quint32> pids;
+    QStringList names;
+    const ProcessSnapshot &rows = processModel->snapshot();
+    for (const QModelIndex &index : processTableView->selectionModel()->selectedRows()) {
+        const size_t row = static_cast<size_t>(processProxy->mapToSource(index).row());
+        pids.push_back(rows.pids[row]);
+        names << QString("%1 (%2)").arg(rows.names[row]).arg(rows.pids[row]);
+    }
+
+    // Per-minute sketches merge into one per series; their own connection,
+    // since the collector's belongs to its thread
+    QStringList lines;
+    {
+        Database database(Collector::DataDir() + "/healthops.db", "percentiles");
+        for (int series = 0; series < ProcessSnapshot::SeriesCount; ++series) {
+            SketchRecord merged;
+            const int count = database.MergeSketches(ProcessSnapshot::SketchMetric(series), pids, from - from % 60000, to, merged);
+            if (count <= 0 || merged.sketch.Empty()) {
+                continue;
+            }
+            const bool bytes = series == ProcessSnapshot::WorkingSet || series == ProcessSnapshot::WriteBytesPerSec;
+            const double scale = bytes ? 1.0 / (1024.0 * 1024.0) : 1.0;
+            lines << QString("%1: p50 %2, p90 %3, p99 %4, max %5%6 (%7 samples in %8 sketches)")
+                         .arg(ProcessSnapshot::SeriesName(series))
+                         .arg(merged.sketch.Quantile(0.50) * scale, 0, 'f', 1)
+                         .arg(merged.sketch.Quantile(0.90) * scale, 0, 'f', 1)
+                         .arg(merged.sketch.Quantile(0.99) * scale, 0, 'f', 1)
+                         .arg(merged.max * scale, 0, 'f', 1)
+                         .arg(bytes ? " MB" : "")
+                         .arg(merged.sketch.Count())
+                         .arg(count);
+        }
+    }
+
+    const QString range = QString("%1 to %2")
+                              .arg(QDateTime::fromMSecsSinceEpoch(from).toString("yyyy-MM-dd hh:mm"))
+                              .arg(QDateTime::fromMSecsSinceEpoch(to).toString("yyyy-MM-dd hh:mm"));
+    QMessageBox::information(this, "Percentiles",
+                             QString("%1\n%2\n\n%3")
+                                 .arg(range)
+                                 .arg(pids.empty() ? QString("All processes") : names.join(", "))
+                                 .arg(lines.isEmpty() ? QString("No sketches stored for this range") : lines.join('\n')));
+}
+
+void MainWindow::saveTimingTrace()
+{
+    QString filePath = QFileDialog::getSaveFileName(this, "Save Timing Trace", "trace.json", "Trace Files (*.json);;All Files (*)");
+    if (filePath.isEmpty()) {
+        return;
+    }
+
+    QString error;
+    if (!WriteChromeTrace(filePath, &error)) {
+        QMessageBox::warning(this, "Error", "Could not save the trace: " + error);
+        return;
+    }
+    statusBar->showMessage("Timing trace saved to " + filePath + "; open it in Perfetto");
+}
+
 void MainWindow::onProcessSelectionChanged()
 {
     // Handle process selection changes
@@ -393,31 +806,22 @@ void MainWindow::openFile()
     QByteArray fileContent = file.readAll();
     file.close();
 
-    // The provided file has a text header. We need to find the start of the JSON object '{'.
-    int jsonStartPos = fileContent.indexOf('{');
-    if (jsonStartPos == -1) {
-        QMessageBox::warning(this, "Parsing Error", "Could not find the start of JSON content in the file.");
+    QJsonObject json;
+    QString error;
+    if (!parseAnalysisFile(fileContent, json, error)) {
+        QMessageBox::warning(this, "Parsing Error", error);
         return;
     }
 
-    // Extract only the JSON part of the file
-    QByteArray jsonData = fileContent.mid(jsonStartPos);
-    QJsonDocument jsonDoc = QJsonDocument::fromJson(jsonData);
-
-    if (jsonDoc.isNull() || !jsonDoc.isObject()) {
-        QMessageBox::warning(this, "Parsing Error", "The file does not contain valid JSON data.");
-        return;
-    }
-
-    displayAnalysisData(jsonDoc.object());
+    displayAnalysisData(json);
     statusBar->showMessage("Successfully loaded and parsed: " + filePath);
 }
 
 void MainWindow::updateRecommendations(const QJsonObject &json)
 {
-    // Clear existing recommendations except the title
+    // Clear existing recommendations except the title and the live ones
     QLayoutItem *item;
-    while ((item = recommendationsLayout->takeAt(2)) != nullptr) {
+    while ((item = recommendationsLayout->takeAt(3)) != nullptr) {
         delete item->widget();
         delete item;
     }
@@ -463,8 +867,6 @@ void MainWindow::updateRecommendations(const QJsonObject &json)
         recommendationsLayout->addWidget(aiRecommendationsGroup);
     }
     
-    // Add additional static recommendations
-    addSampleRecommendations();
     recommendationsLayout->addStretch();
 }
 
@@ -475,37 +877,8 @@ void MainWindow::updateRecommendations(const QJsonObject &json)
  */
 void MainWindow::displayAnalysisData(const QJsonObject &json)
 {
-    QString html;
-    html.append("<h1>AI Process Usage Analysis</h1>");
-
-    // Summary
-    if (json.contains("summary") && json["summary"].isString()) {
-        html.append("<h2>Summary</h2>");
-        html.append("<p>" + json["summary"].toString() + "</p>");
-    }
-
-    // Helper lambda to format sections that are arrays of objects
-    auto formatSection = [&](const QString& key, const QString& title) {
-        if (json.contains(key) && json[key].isArray()) {
-            html.append("<h2>" + title + "</h2>");
-            html.append("<ul>");
-            for (const QJsonValue &value : json[key].toArray()) {
-                QJsonObject obj = value.toObject();
-                if (obj.contains("label") && obj.contains("details")) {
-                    html.append("<li><b>" + obj["label"].toString() + ":</b> " + obj["details"].toString() + "</li>");
-                }
-            }
-            html.append("</ul>");
-        }
-    };
-
-    // Use the helper to process each section
-    formatSection("keyPoints", "Key Points");
-    formatSection("recommendations", "Recommendations");
-    formatSection("performanceProfile", "Performance Profile");
-    formatSection("resourceHotspots", "Resource Hotspots");
-
-    aiAnalysisBrowser->setHtml(html);
+    TRACE_SPAN("ui.show_analysis");
+    aiAnalysisBrowser->setHtml(analysisHtml(json));
     centerTabWidget->setCurrentWidget(aiAnalysisBrowser); // Automatically switch to the tab
     updateRecommendations(json);
 }
@@ -517,6 +890,14 @@ void MainWindow::displayAnalysisData(const QJsonObject &json)
  */
 void MainWindow::attachToProcess()
 {
+    if (!collectorLock->isLocked()) {
+        statusBar->showMessage("Viewer: the collector daemon decides which process is sampled (see its --pid)");
+        return;
+    }
+
+    // Refresh the list while the dialog opens
+    getCurrentUserProcesses();
+
     // Create a simple dialog to select a process
     QDialog dialog(this);
     dialog.setWindowTitle("Attach to Process");
@@ -528,24 +909,32 @@ void MainWindow::attachToProcess()
     QLabel *label = new QLabel("Select a process to attach to:");
     layout->addWidget(label);
 
-    QTableWidget *processTable = new QTableWidget();
-    processTable->setColumnCount(3);
-    processTable->setHorizontalHeaderLabels({"Process Name", "PID", "Memory Usage"});
-    processTable->horizontalHeader()->setStretchLastSection(true);
-    processTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    // Same model and search index as the Overview, with its own query
+    QLineEdit *filterEdit = new QLineEdit();
+    filterEdit->setPlaceholderText("Filter by name, user or PID");
+    filterEdit->setClearButtonEnabled(true);
+    layout->addWidget(filterEdit);
 
-    // Populate with running processes (placeholder data for now)
-    // You can integrate with actual process enumeration later
-    processTable->setRowCount(5);
-    QStringList processes = {"chrome.exe", "notepad.exe", "explorer.exe", "system", "winlogon.exe"};
-    QStringList pids = {"1234", "5678", "9012", "4", "568"};
-    QStringList memory = {"245 MB", "12 MB", "156 MB", "8 MB", "45 MB"};
+    ProcessFilterProxyModel *proxy = new ProcessFilterProxyModel(processModel, &dialog);
+    connect(filterEdit, &QLineEdit::textChanged, proxy, &ProcessFilterProxyModel::setQuery);
 
-    for (int i = 0; i < 5; ++i) {
-        processTable->setItem(i, 0, new QTableWidgetItem(processes[i]));
-        processTable->setItem(i, 1, new QTableWidgetItem(pids[i]));
-        processTable->setItem(i, 2, new QTableWidgetItem(memory[i]));
+    QTableView *processTable = new QTableView();
+    processTable->setModel(proxy);
+    processTable->setSortingEnabled(true);
+    processTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    processTable->setSelectionMode(QAbstractItemView::SingleSelection);
+    processTable->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    processTable->verticalHeader()->setDefaultSectionSize(22);
+    processTable->verticalHeader()->hide();
+    processTable->horizontalHeader()->setStretchLastSection(true);
+    processTable->horizontalHeader()->resizeSection(ProcessTableModel::NameColumn, 180);
+    for (int column = 0; column < ProcessTableModel::ColumnCount; ++column) {
+        if (column != ProcessTableModel::NameColumn && column != ProcessTableModel::PidColumn
+            && column != ProcessTableModel::WorkingSetColumn && column != ProcessTableModel::UserColumn) {
+            processTable->hideColumn(column);
+        }
     }
+    processTable->sortByColumn(ProcessTableModel::NameColumn, Qt::AscendingOrder);
 
     layout->addWidget(processTable);
 
@@ -561,11 +950,13 @@ void MainWindow::attachToProcess()
     connect(attachButton, &QPushButton::clicked, [&]() {
         QModelIndexList selection = processTable->selectionModel()->selectedRows();
         if (!selection.isEmpty()) {
-            int row = selection.first().row();
-            QString processName = processTable->item(row, 0)->text();
-            QString pid = processTable->item(row, 1)->text();
+            const size_t row = static_cast<size_t>(proxy->mapToSource(selection.first()).row());
+            const ProcessSnapshot &rows = processModel->snapshot();
+            QString processName = rows.names[row];
+            quint32 pid = rows.pids[row];
 
-            statusBar->showMessage("Attached to process: " + processName + " (PID: " + pid + ")");
+            collector->Attach(static_cast<int>(pid));
+            statusBar->showMessage("Attached to process: " + processName + " (PID: " + QString::number(pid) + ")");
             dialog.accept();
         }
     });
@@ -599,32 +990,17 @@ void MainWindow::createRecommendationsTab()
     
     QLabel *placeholderLabel = new QLabel(
         "<p style='color: #666; font-style: italic;'>"
-        "Load a process analysis file to view personalized recommendations for optimizing system performance."
+        "Live recommendations come from local rules evaluated on every sample. "
+        "Load a process analysis file to add the AI generated recommendations."
         "</p>"
     );
     placeholderLabel->setTextFormat(Qt::RichText);
     placeholderLabel->setWordWrap(true);
     recommendationsLayout->addWidget(placeholderLabel);
     
-    // Add sample recommendations (these will be replaced when file is loaded)
-    addSampleRecommendations();
-    
-    recommendationsLayout->addStretch();
-    
-    // Set the content widget to scroll area
-    recommendationsScrollArea->setWidget(scrollContent);
-    
-    // Main layout for recommendations widget
-    QVBoxLayout *mainRecommendationLayout = new QVBoxLayout(recommendationsWidget);
-    mainRecommendationLayout->addWidget(recommendationsScrollArea);
-    mainRecommendationLayout->setContentsMargins(0, 0, 0, 0);
-}
-
-void MainWindow::addSampleRecommendations()
-{
-    // CPU Optimization Recommendations
-    QGroupBox *cpuGroup = new QGroupBox("CPU Optimization");
-    cpuGroup->setStyleSheet(
+    // Recommendations from the local rules, refreshed with every frame
+    liveRecommendationsGroup = new QGroupBox("Live Recommendations");
+    liveRecommendationsGroup->setStyleSheet(
         "QGroupBox {"
         "    font-weight: bold;"
         "    border: 2px solid #cccccc;"
@@ -638,355 +1014,95 @@ void MainWindow::addSampleRecommendations()
         "    padding: 0 5px 0 5px;"
         "}"
     );
+    QVBoxLayout *liveLayout = new QVBoxLayout(liveRecommendationsGroup);
+    liveRecommendationsStatus = new QLabel("Waiting for samples...");
+    liveRecommendationsStatus->setWordWrap(true);
+    liveRecommendationsStatus->setStyleSheet("font-weight: normal; color: #666;");
+    liveLayout->addWidget(liveRecommendationsStatus);
+    recommendationsLayout->addWidget(liveRecommendationsGroup);
     
-    QVBoxLayout *cpuLayout = new QVBoxLayout(cpuGroup);
-    
-    QLabel *cpuRec1 = new QLabel("• <b>Reduce Background Processes:</b> Disable unnecessary startup programs to free up CPU resources.");
-    cpuRec1->setWordWrap(true);
-    cpuRec1->setTextFormat(Qt::RichText);
-    
-    QLabel *cpuRec2 = new QLabel("• <b>Update System Drivers:</b> Ensure all hardware drivers are up to date for optimal performance.");
-    cpuRec2->setWordWrap(true);
-    cpuRec2->setTextFormat(Qt::RichText);
-    
-    QLabel *cpuRec3 = new QLabel("• <b>Check for Malware:</b> Run a full system scan to ensure no malicious processes are consuming CPU.");
-    cpuRec3->setWordWrap(true);
-    cpuRec3->setTextFormat(Qt::RichText);
-    
-    cpuLayout->addWidget(cpuRec1);
-    cpuLayout->addWidget(cpuRec2);
-    cpuLayout->addWidget(cpuRec3);
-    
-    // Memory Optimization Recommendations
-    QGroupBox *memoryGroup = new QGroupBox("Memory Optimization");
-    memoryGroup->setStyleSheet(cpuGroup->styleSheet());
-    
-    QVBoxLayout *memoryLayout = new QVBoxLayout(memoryGroup);
-    
-    QLabel *memRec1 = new QLabel("• <b>Increase Virtual Memory:</b> Consider increasing page file size if physical RAM is frequently maxed out.");
-    memRec1->setWordWrap(true);
-    memRec1->setTextFormat(Qt::RichText);
-    
-    QLabel *memRec2 = new QLabel("• <b>Close Unused Applications:</b> Regularly close applications that are not actively being used.");
-    memRec2->setWordWrap(true);
-    memRec2->setTextFormat(Qt::RichText);
-    
-    QLabel *memRec3 = new QLabel("• <b>Clear System Cache:</b> Periodically clear temporary files and system cache to free up memory.");
-    memRec3->setWordWrap(true);
-    memRec3->setTextFormat(Qt::RichText);
-    
-    memoryLayout->addWidget(memRec1);
-    memoryLayout->addWidget(memRec2);
-    memoryLayout->addWidget(memRec3);
-    
-    // System Performance Recommendations
-    QGroupBox *systemGroup = new QGroupBox("System Performance");
-    systemGroup->setStyleSheet(cpuGroup->styleSheet());
-    
-    QVBoxLayout *systemLayout = new QVBoxLayout(systemGroup);
-    
-    QLabel *sysRec1 = new QLabel("• <b>Regular System Maintenance:</b> Schedule regular disk cleanup and defragmentation.");
-    sysRec1->setWordWrap(true);
-    sysRec1->setTextFormat(Qt::RichText);
-    
-    QLabel *sysRec2 = new QLabel("• <b>Monitor Startup Programs:</b> Use Task Manager to control which programs start with Windows.");
-    sysRec2->setWordWrap(true);
-    sysRec2->setTextFormat(Qt::RichText);
-    
-    QLabel *sysRec3 = new QLabel("• <b>Update Operating System:</b> Keep Windows updated with the latest patches and security updates.");
-    sysRec3->setWordWrap(true);
-    sysRec3->setTextFormat(Qt::RichText);
-    
-    systemLayout->addWidget(sysRec1);
-    systemLayout->addWidget(sysRec2);
-    systemLayout->addWidget(sysRec3);
-    
-    recommendationsLayout->addWidget(cpuGroup);
-    recommendationsLayout->addWidget(memoryGroup);
-    recommendationsLayout->addWidget(systemGroup);
-}
-
-
-
-void MainWindow::populateEventsTable()
-{
-    // Clear existing data
-    eventsTableWidget->setRowCount(0);
-    
-    // Sample process data
-    struct ProcessData {
-        QString processName;
-        QString pid;
-        double cpuUser;
-        double cpuKernel;
-        QString timestamp;
-    };
-    
-    // Create sample data for multiple processes
-    QVector<ProcessData> sampleData = {
-        {"chrome.exe", "1234", 15.2, 3.8, "2024-12-20 10:15:23.456"},
-        {"notepad.exe", "5678", 0.5, 0.2, "2024-12-20 10:15:24.123"},
-        {"explorer.exe", "9012", 8.7, 2.1, "2024-12-20 10:15:24.789"},
-        {"system", "4", 2.3, 12.5, "2024-12-20 10:15:25.345"},
-        {"winlogon.exe", "568", 0.1, 0.8, "2024-12-20 10:15:25.901"},
-        {"firefox.exe", "3456", 22.1, 5.3, "2024-12-20 10:15:26.567"},
-        {"code.exe", "7890", 18.9, 4.2, "2024-12-20 10:15:27.234"},
-        {"outlook.exe", "2345", 12.4, 2.9, "2024-12-20 10:15:27.890"},
-        {"teams.exe", "6789", 16.7, 3.6, "2024-12-20 10:15:28.456"},
-        {"svchost.exe", "1111", 1.2, 3.4, "2024-12-20 10:15:29.123"},
-        {"dwm.exe", "2222", 5.6, 1.8, "2024-12-20 10:15:29.789"},
-        {"audiodg.exe", "3333", 2.1, 0.9, "2024-12-20 10:15:30.345"},
-        {"powershell.exe", "4444", 7.8, 2.3, "2024-12-20 10:15:30.901"},
-        {"cmd.exe", "5555", 0.8, 0.4, "2024-12-20 10:15:31.567"},
-        {"taskeng.exe", "6666", 1.5, 1.1, "2024-12-20 10:15:32.234"},
-        {"spoolsv.exe", "7777", 0.3, 0.7, "2024-12-20 10:15:32.890"},
-        {"lsass.exe", "8888", 0.9, 2.1, "2024-12-20 10:15:33.456"},
-        {"csrss.exe", "9999", 1.3, 1.7, "2024-12-20 10:15:34.123"},
-        {"winrar.exe", "1010", 25.4, 6.8, "2024-12-20 10:15:34.789"},
-        {"steam.exe", "1212", 14.2, 3.5, "2024-12-20 10:15:35.345"}
-    };
-    
-    // Set the number of rows
-    eventsTableWidget->setRowCount(sampleData.size());
-    
-    // Populate the table with sample data
-    for (int i = 0; i < sampleData.size(); ++i) {
-        const ProcessData &data = sampleData[i];
-        double totalCpu = data.cpuUser + data.cpuKernel;
-        
-        // Line #
-        eventsTableWidget->setItem(i, 0, new QTableWidgetItem(QString::number(i + 1)));
-        
-        // Process Name
-        eventsTableWidget->setItem(i, 1, new QTableWidgetItem(data.processName));
-        
-        // PID
-        eventsTableWidget->setItem(i, 2, new QTableWidgetItem(data.pid));
-        
-        // CPU-User%
-        QTableWidgetItem *userCpuItem = new QTableWidgetItem(QString::number(data.cpuUser, 'f', 1) + "%");
-        userCpuItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
-        eventsTableWidget->setItem(i, 3, userCpuItem);
-        
-        // CPU-Kernel%
-        QTableWidgetItem *kernelCpuItem = new QTableWidgetItem(QString::number(data.cpuKernel, 'f', 1) + "%");
-        kernelCpuItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
-        eventsTableWidget->setItem(i, 4, kernelCpuItem);
-        
-        // Total CPU%
-        QTableWidgetItem *totalCpuItem = new QTableWidgetItem(QString::number(totalCpu, 'f', 1) + "%");
-        totalCpuItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
-        
-        // Color code based on CPU usage
-        if (totalCpu > 20.0) {
-            totalCpuItem->setBackground(QBrush(QColor(255, 200, 200))); // Light red for high usage
-        } else if (totalCpu > 10.0) {
-            totalCpuItem->setBackground(QBrush(QColor(255, 255, 200))); // Light yellow for medium usage
-        } else {
-            totalCpuItem->setBackground(QBrush(QColor(200, 255, 200))); // Light green for low usage
-        }
-        
-        eventsTableWidget->setItem(i, 5, totalCpuItem);
-        
-        // TimeStamp
-        eventsTableWidget->setItem(i, 6, new QTableWidgetItem(data.timestamp));
-    }
-    
-    // Auto-resize columns to content
-    eventsTableWidget->resizeColumnsToContents();
-    
-    // Make sure the last column stretches
-    eventsTableWidget->horizontalHeader()->setStretchLastSection(true);
-    
-    // Sort by Total CPU (descending) initially
-    eventsTableWidget->sortItems(5, Qt::DescendingOrder);
-}
-
-void MainWindow::updateEventsTableWithRealData(const Stats& stat)
-{
-    // Add new row at the top
-    eventsTableWidget->insertRow(0);
-    
-    // Get current time
-    QString currentTime = QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz");
-    
-    // Populate the new row with real data
-    eventsTableWidget->setItem(0, 0, new QTableWidgetItem(QString::number(eventsTableWidget->rowCount())));
-    eventsTableWidget->setItem(0, 1, new QTableWidgetItem("AI-Healthops")); // You can get actual process name
-    eventsTableWidget->setItem(0, 2, new QTableWidgetItem(QString::number(GetCurrentProcessId())));
-    
-    QTableWidgetItem *userCpuItem = new QTableWidgetItem(QString::number(stat.CPU_USERPERCENT, 'f', 1) + "%");
-    userCpuItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
-    eventsTableWidget->setItem(0, 3, userCpuItem);
-    
-    QTableWidgetItem *kernelCpuItem = new QTableWidgetItem(QString::number(stat.CPU_KERNPERCENT, 'f', 1) + "%");
-    kernelCpuItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
-    eventsTableWidget->setItem(0, 4, kernelCpuItem);
-    
-    double totalCpu = stat.CPU_USERPERCENT + stat.CPU_KERNPERCENT;
-    QTableWidgetItem *totalCpuItem = new QTableWidgetItem(QString::number(totalCpu, 'f', 1) + "%");
-    totalCpuItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
-    
-    // Color code the total CPU
-    if (totalCpu > 20.0) {
-        totalCpuItem->setBackground(QBrush(QColor(255, 200, 200)));
-    } else if (totalCpu > 10.0) {
-        totalCpuItem->setBackground(QBrush(QColor(255, 255, 200)));
-    } else {
-        totalCpuItem->setBackground(QBrush(QColor(200, 255, 200)));
-    }
+    recommendationsLayout->addStretch();
     
-    eventsTableWidget->setItem(0, 5, totalCpuItem);
-    eventsTableWidget->setItem(0, 6, new QTableWidgetItem(currentTime));
+    // Set the content widget to scroll area
+    recommendationsScrollArea->setWidget(scrollContent);
     
-    // Keep only last 50 entries for performance
-    if (eventsTableWidget->rowCount() > 50) {
-        eventsTableWidget->removeRow(50);
-    }
-}
-
-
-
-// Simplified CPU usage function (remove the complex one)
-double GetProcessCPUUsage(HANDLE hProcess) {
-    // For simplicity, return a random value
-    // In a real implementation, you'd calculate actual CPU usage over time
-    Q_UNUSED(hProcess);  // Suppress unused parameter warning
-    return (double)(rand() % 100) / 10.0; // 0-10% CPU usage
-}
-
-// Helper function to get current user name
-QString getCurrentUserName() {
-    char username[256];
-    DWORD size = sizeof(username);
-    if (GetUserNameA(username, &size)) {
-        return QString::fromLocal8Bit(username);
-    }
-    return "Unknown";
+    // Main layout for recommendations widget
+    QVBoxLayout *mainRecommendationLayout = new QVBoxLayout(recommendationsWidget);
+    mainRecommendationLayout->addWidget(recommendationsScrollArea);
+    mainRecommendationLayout->setContentsMargins(0, 0, 0, 0);
 }
 
-void MainWindow::getCurrentUserProcesses()
+void MainWindow::updateLiveRecommendations()
 {
-    // Clear existing data
-    eventsTableWidget->setRowCount(0);
-    
-    HANDLE hProcessSnap;
-    PROCESSENTRY32 pe32;
-    QVector<ProcessInfo> processInfoList;
-    QString currentUser = getCurrentUserName();
-
-    // Take a snapshot of all processes in the system
-    hProcessSnap = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
-    if (hProcessSnap == INVALID_HANDLE_VALUE) {
+    std::shared_ptr<const RuleSet> rules = collector->Rules();
+    if (!rules) {
         return;
     }
+    const std::vector<RuleMatch> matches = collector->RuleMatches();
 
-    // Set the size of the structure before using it
-    pe32.dwSize = sizeof(PROCESSENTRY32);
-
-    // Retrieve information about the first process
-    if (!Process32First(hProcessSnap, &pe32)) {
-        CloseHandle(hProcessSnap);
-        return;
+    std::vector<int> matched;
+    matched.reserve(matches.size());
+    for (const RuleMatch &match : matches) {
+        matched.push_back(match.rule);
     }
 
-    // Walk through the process list
-    do {
-        ProcessInfo procInfo;
-        procInfo.processName = QString::fromWCharArray(pe32.szExeFile);
-        procInfo.processID = pe32.th32ProcessID;
-        procInfo.userName = currentUser; // For simplicity, assuming current user
-        procInfo.timestamp = QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz");
-
-        // Open process to get CPU and memory info
-        HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, pe32.th32ProcessID);
-        if (hProcess != NULL) {
-            // Get memory info
-            PROCESS_MEMORY_COUNTERS pmc;
-            if (GetProcessMemoryInfo(hProcess, &pmc, sizeof(pmc))) {
-                procInfo.workingSetSize = pmc.WorkingSetSize;
-            } else {
-                procInfo.workingSetSize = 0;
-            }
-
-            // Get CPU usage (simplified - using random values for demo)
-            // In a real implementation, you'd need to calculate actual CPU usage
-            procInfo.cpuUsage = (double)(rand() % 100) / 10.0; // 0-10% CPU usage
+    // Rebuild the labels only when the set of matching rules changes;
+    // otherwise just refresh the evidence
+    if (matched != shownRules) {
+        for (QLabel *label : shownRuleLabels) {
+            delete label;
+        }
+        shownRuleLabels.clear();
+        for (size_t i = 0; i < matches.size(); ++i) {
+            QLabel *label = new QLabel();
+            label->setWordWrap(true);
+            label->setTextFormat(Qt::RichText);
+            label->setStyleSheet("margin: 5px 0px;");
+            liveRecommendationsGroup->layout()->addWidget(label);
+            shownRuleLabels.push_back(label);
+        }
+        shownRules = matched;
+    }
 
-            CloseHandle(hProcess);
-        } else {
-            procInfo.workingSetSize = 0;
-            procInfo.cpuUsage = 0.0;
+    for (size_t i = 0; i < matches.size(); ++i) {
+        const Rule &rule = rules->rules[matches[i].rule];
+        QStringList evidence;
+        for (size_t c = 0; c < rule.conditions.size(); ++c) {
+            evidence << rule.conditions[c].Describe(matches[i].evidence[c]).toHtmlEscaped();
         }
+        shownRuleLabels[i]->setText(QString("• <b>%1 - %2:</b> %3<br><span style='color: #666;'>%4</span>")
+                                    .arg(rule.group.toHtmlEscaped(), rule.label.toHtmlEscaped(),
+                                         rule.details.toHtmlEscaped(), evidence.join("; ")));
+    }
 
-        processInfoList.append(procInfo);
+    liveRecommendationsStatus->setText(matches.empty()
+        ? QString("No rule matches the latest sample (%1 rules from %2).").arg(rules->rules.size()).arg(rules->source)
+        : QString("%1 of %2 rules match the latest sample (rules from %3).").arg(matches.size()).arg(rules->rules.size()).arg(rules->source));
+}
 
-    } while (Process32Next(hProcessSnap, &pe32));
 
-    CloseHandle(hProcessSnap);
 
-    // Sort by CPU usage (descending)
-    std::sort(processInfoList.begin(), processInfoList.end(), 
-              [](const ProcessInfo &a, const ProcessInfo &b) {
-                  return a.cpuUsage > b.cpuUsage;
-              });
+void MainWindow::getCurrentUserProcesses()
+{
+    // Enumeration runs on the enumerator's thread; the result comes back
+    // through applyProcessSnapshot
+    processEnumerator->Request();
+}
 
-    // Populate the table with process data
-    eventsTableWidget->setRowCount(processInfoList.size());
-    
-    for (int i = 0; i < processInfoList.size() && i < 100; ++i) { // Limit to 100 processes
-        const ProcessInfo &procInfo = processInfoList[i];
-        
-        // Line #
-        eventsTableWidget->setItem(i, 0, new QTableWidgetItem(QString::number(i + 1)));
-        
-        // Process Name
-        eventsTableWidget->setItem(i, 1, new QTableWidgetItem(procInfo.processName));
-        
-        // PID
-        eventsTableWidget->setItem(i, 2, new QTableWidgetItem(QString::number(procInfo.processID)));
-        
-        // CPU-User% (simplified - showing total CPU usage)
-        double userCpu = procInfo.cpuUsage * 0.7; // Assume 70% is user CPU
-        QTableWidgetItem *userCpuItem = new QTableWidgetItem(QString::number(userCpu, 'f', 1) + "%");
-        userCpuItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
-        eventsTableWidget->setItem(i, 3, userCpuItem);
-        
-        // CPU-Kernel% (simplified - showing remaining CPU usage)
-        double kernelCpu = procInfo.cpuUsage * 0.3; // Assume 30% is kernel CPU
-        QTableWidgetItem *kernelCpuItem = new QTableWidgetItem(QString::number(kernelCpu, 'f', 1) + "%");
-        kernelCpuItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
-        eventsTableWidget->setItem(i, 4, kernelCpuItem);
-        
-        // Total CPU%
-        QTableWidgetItem *totalCpuItem = new QTableWidgetItem(QString::number(procInfo.cpuUsage, 'f', 1) + "%");
-        totalCpuItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
-        
-        // Color code based on CPU usage
-        if (procInfo.cpuUsage > 5.0) {
-            totalCpuItem->setBackground(QBrush(QColor(255, 200, 200))); // Light red for high usage
-        } else if (procInfo.cpuUsage > 2.0) {
-            totalCpuItem->setBackground(QBrush(QColor(255, 255, 200))); // Light yellow for medium usage
-        } else {
-            totalCpuItem->setBackground(QBrush(QColor(200, 255, 200))); // Light green for low usage
-        }
-        
-        eventsTableWidget->setItem(i, 5, totalCpuItem);
-        
-        // TimeStamp
-        eventsTableWidget->setItem(i, 6, new QTableWidgetItem(procInfo.timestamp));
-    }
-    
-    // Auto-resize columns to content
-    eventsTableWidget->resizeColumnsToContents();
-    
-    // Make sure the last column stretches
-    eventsTableWidget->horizontalHeader()->setStretchLastSection(true);
+void MainWindow::applyProcessSnapshot(std::shared_ptr<const ProcessSnapshot> snapshot)
+{
+    TRACE_SPAN("ui.apply_processes");
+    // The model keeps its rows and only diffs against the new snapshot, so a
+    // refresh allocates nothing per process beyond new names.
+    processSnapshot = std::move(snapshot);
+    processModel->setSnapshot(*processSnapshot);
+    processModel->setHeavyHitters(collector->TopProcesses(ProcessSnapshot::CpuPercent, kHeavyHittersShown),
+                                  collector->TopProcesses(ProcessSnapshot::WriteBytesPerSec, kHeavyHittersShown));
+    statusBar->showMessage("Process list updated at " + QDateTime::fromMSecsSinceEpoch(processSnapshot->time_stamp).toString("hh:mm:ss"));
 }
 
 void MainWindow::updateProcessTable()
 {
     // This method updates the process table periodically
     getCurrentUserProcesses();
-    statusBar->showMessage("Process list updated at " + QDateTime::currentDateTime().toString("hh:mm:ss"));
 }
@@ -90,9 +90,14 @@
 #include <QDialog>
 #include <QPushButton>
 #include <QItemSelectionModel>
+#include <QTableView>
+#include <QSortFilterProxyModel>
+#include <QLineEdit>
 
 #include <QRandomGenerator>
 
+#include <memory>
+
 
 class QSplitter;
 class QTreeWidget;
@@ -109,9 +114,27 @@ class QAction;
 class QWidget;
 class QTextBrowser;
 class QSelectionModel;
+class QLockFile;
 
 // Forward declaration for Stats struct - ADD THIS LINE
 struct Stats;
+class HistoryChartView;
+class QLineSeries;
+class ProcessTableModel;
+class ProcessFilterProxyModel;
+class EventLogModel;
+class FramePresenter;
+struct Collector;
+struct StatsStreamServer;
+struct SharedStatsWriter;
+struct SharedStatsReader;
+struct ProcessEnumerator;
+struct StatsSample;
+struct AnomalyRegion;
+struct AlertEvent;
+struct TrendEstimate;
+
+#include "proc_snapshot.h"
 
 
 
@@ -129,6 +152,10 @@ private slots:
     void updateSystemActivity();
     void openFile(); // Add this slot to handle the file open action
     void attachToProcess();  // Add this line
+    void exportFeatureSummary();
+    void exportSamples();
+    void showPercentiles();
+    void saveTimingTrace();
 private:
     void setupUI();
     void createLeftPanel();
@@ -138,13 +165,17 @@ private:
     void createToolBar();
     void createStatusBar();
     void updateRecommendations(const QJsonObject &json);
-    void addSampleRecommendations();
+    void updateLiveRecommendations();
     // Add this helper function to format and display the JSON data
     void displayAnalysisData(const QJsonObject &json);
-    void populateEventsTable(); 
-    void updateEventsTableWithRealData(const Stats& stat);  // Add this line to private methods
     void getCurrentUserProcesses();  // Add this line
     void updateProcessTable();       // Add this line
+    void presentSamples(const std::vector<StatsSample> &batch);
+    void addRegions(const std::vector<AnomalyRegion> &regions);
+    void addAlerts(const std::vector<AlertEvent> &alerts);
+    void showCulprits(int metric, qint64 from, qint64 to);
+    void updateMemoryTrends(const std::vector<TrendEstimate> &trends);
+    void applyProcessSnapshot(std::shared_ptr<const ProcessSnapshot> snapshot);
 
     // Main UI Elements
     QWidget *centralWidget;
@@ -155,18 +186,37 @@ private:
     // Left Panel
     QGroupBox *leftPanelGroup;
     QTreeWidget *analysisTreeWidget;
+    QTreeWidgetItem *regionsItem;
+    QTreeWidgetItem *alertsItem;
+    QTreeWidgetItem *culpritsItem;
+    QTreeWidgetItem *memoryItem;
 
     // Center Panel
     QTabWidget *centerTabWidget;
     QWidget *timelineWidget;
     QLabel *timelineLabel;
-    QTableWidget *eventsTableWidget;
+    QTableView *eventsTableView;
+    EventLogModel *eventModel;
+    QLineSeries *cpuSeries;
+    HistoryChartView *cpuChartView;
     QTextBrowser *aiAnalysisBrowser; // Add this to display the analysis text
 
+    // Process list (Overview)
+    QLineEdit *processFilterEdit;
+    QTableView *processTableView;
+    ProcessTableModel *processModel;
+    ProcessFilterProxyModel *processProxy;
+    std::unique_ptr<ProcessEnumerator> processEnumerator;
+    std::shared_ptr<const ProcessSnapshot> processSnapshot;
+
     // Recommendations Tab
     QWidget *recommendationsWidget;          // Add this line
     QScrollArea *recommendationsScrollArea;  // Add this line
     QVBoxLayout *recommendationsLayout;      // Add this line
+    QGroupBox *liveRecommendationsGroup;
+    QLabel *liveRecommendationsStatus;
+    std::vector<int> shownRules;
+    std::vector<QLabel *> shownRuleLabels;
 
 
     // Actions, Menu, Toolbar, Statusbar
@@ -177,8 +227,15 @@ private:
     QStatusBar *statusBar;
     QAction *attachProcessAction;  // Add this line
 
-    std::thread stats_thread;
-    bool stop = false;
+    std::unique_ptr<Collector> collector;
+    // Held while this window is the store's collector; without it the
+    // window is a viewer and the daemon does the storing
+    std::unique_ptr<QLockFile> collectorLock;
+    std::unique_ptr<StatsStreamServer> statsStream;
+    std::unique_ptr<SharedStatsWriter> sharedStats;
+    std::unique_ptr<SharedStatsReader> sharedSource;
+    FramePresenter *framePresenter;
+    QLabel *frameStatsLabel;
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,329 @@
+#include "proc_alerts.h"
+#include "proc_rules.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QProcess>
+#include <QStringList>
+
+#include <algorithm>
+#include <chrono>
+
+// Longest a hook program may run before it is killed
+static const int kHookTimeoutMs = 5000;
+
+// A wake-up the hook thread misses is picked up after at most this long
+static const int kHookPollMs = 250;
+
+static double metricValue(const Stats &stats, int metric) {
+    return metric == kCpuPercentMetric ? static_cast<double>(stats.CPU_USERPERCENT + stats.CPU_KERNPERCENT)
+                                       : static_cast<double>(stats.*kStatsFields[metric].member);
+}
+
+QJsonObject AlertEventToJson(const AlertEvent &event) {
+    QJsonObject object;
+    object["id"] = static_cast<qint64>(event.id);
+    object["kind"] = event.kind == AlertEvent::Fired ? "fired" : "cleared";
+    object["rule"] = event.rule;
+    object["label"] = event.label;
+    object["metric"] = MetricName(event.metric);
+    object["value"] = event.value;
+    object["threshold"] = event.threshold;
+    object["since"] = event.since;
+    object["time_stamp"] = event.time_stamp;
+    object["pid"] = static_cast<qint64>(event.pid);
+    object["process"] = event.process;
+    if (event.capture_ms > 0) {
+        object["capture_ms"] = event.capture_ms;
+    }
+    return object;
+}
+
+QByteArray AlertEngine::DefaultAlerts() {
+    return R"({
+  "alerts": [
+    {
+      "id": "cpu-high",
+      "label": "CPU above 90%",
+      "metric": "CPU_PERCENT", "op": ">", "fire": 90, "clear": 70,
+      "for": 10, "cooldown": 300, "capture": 30
+    },
+    {
+      "id": "working-set-high",
+      "label": "Working set above 2 GB",
+      "metric": "PROC_WORKINGSETSIZE", "op": ">", "fire": 2147483648, "clear": 1932735283,
+      "for": 60, "cooldown": 600, "capture": 0
+    }
+  ]
+}
+)";
+}
+
+bool AlertEngine::Load(const QString &path, QString *error) {
+    QFile file(path);
+    if (!file.exists()) {
+        if (file.open(QIODevice::WriteOnly)) {
+            file.write(DefaultAlerts());
+            file.close();
+        }
+        return Compile(DefaultAlerts(), "built-in", error);
+    }
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error) {
+            *error = "Cannot read " + path + ": " + file.errorString();
+        }
+        return false;
+    }
+    return Compile(file.readAll(), path, error);
+}
+
+bool AlertEngine::Compile(const QByteArray &json, const QString &source, QString *error) {
+    auto fail = [error](const QString &message) {
+        if (error) {
+            *error = message;
+        }
+        return false;
+    };
+
+    QJsonParseError parse_error;
+    const QJsonDocument document = QJsonDocument::fromJson(json, &parse_error);
+    if (document.isNull()) {
+        return fail("Alerts are not valid JSON: " + parse_error.errorString());
+    }
+    const QJsonValue alert_values = document.object().value("alerts");
+    if (!alert_values.isArray()) {
+        return fail("Alerts file has no \"alerts\" array");
+    }
+
+    std::vector<AlertRule> rules;
+    for (const QJsonValue &alert_value : alert_values.toArray()) {
+        const QJsonObject object = alert_value.toObject();
+        AlertRule rule;
+        rule.id = object.value("id").toString();
+        if (rule.id.isEmpty()) {
+            return fail(QString("Alert %1 has no id").arg(rules.size() + 1));
+        }
+        rule.label = object.value("label").toString(rule.id);
+
+        rule.metric = MetricIndex(object.value("metric").toString());
+        if (rule.metric < 0) {
+            return fail("Alert '" + rule.id + "': unknown metric '" + object.value("metric").toString() + "'");
+        }
+
+        const QString op = object.value("op").toString(">");
+        if (op != ">" && op != "<") {
+            return fail("Alert '" + rule.id + "': operator must be > or <, not '" + op + "'");
+        }
+        rule.above = op == ">";
+
+        if (!object.value("fire").isDouble()) {
+            return fail("Alert '" + rule.id + "' has no numeric fire threshold");
+        }
+        rule.fire = object.value("fire").toDouble();
+        rule.clear = object.value("clear").toDouble(rule.fire);
+        if (rule.above ? rule.clear > rule.fire : rule.clear < rule.fire) {
+            return fail("Alert '" + rule.id + "': clear must lie on the near side of fire");
+        }
+
+        const double seconds[] = {object.value("for").toDouble(0.0), object.value("cooldown").toDouble(0.0),
+                                  object.value("capture").toDouble(0.0)};
+        if (*std::min_element(std::begin(seconds), std::end(seconds)) < 0.0) {
+            return fail("Alert '" + rule.id + "': durations cannot be negative");
+        }
+        rule.min_duration_ms = static_cast<qint64>(seconds[0] * 1000.0);
+        rule.cooldown_ms = static_cast<qint64>(seconds[1] * 1000.0);
+        rule.capture_ms = static_cast<qint64>(seconds[2] * 1000.0);
+        rules.push_back(std::move(rule));
+    }
+
+    rules_ = std::move(rules);
+    states_.assign(rules_.size(), State());
+    source_ = source;
+    return true;
+}
+
+AlertEvent AlertEngine::Event(const AlertRule &rule, const State &state, AlertEvent::Kind kind, double value,
+                              qint64 time_stamp, quint32 pid, const QString &process) const {
+    AlertEvent event;
+    event.id = state.id;
+    event.kind = kind;
+    event.rule = rule.id;
+    event.label = rule.label;
+    event.metric = rule.metric;
+    event.value = value;
+    event.threshold = kind == AlertEvent::Fired ? rule.fire : rule.clear;
+    event.since = state.since;
+    event.time_stamp = time_stamp;
+    event.pid = pid;
+    event.process = process;
+    event.capture_ms = kind == AlertEvent::Fired ? rule.capture_ms : 0;
+    return event;
+}
+
+void AlertEngine::Update(const StatsSample &sample, std::vector<AlertEvent> &events) {
+    pid_ = sample.pid;
+    process_ = sample.process;
+    const qint64 t = sample.time_stamp;
+
+    for (size_t i = 0; i < rules_.size(); ++i) {
+        const AlertRule &rule = rules_[i];
+        State &state = states_[i];
+        if (!(MetricGroupOf(rule.metric) & groups_)) {
+            continue;
+        }
+        const double value = metricValue(sample.stats, rule.metric);
+        const bool past_fire = rule.above ? value > rule.fire : value < rule.fire;
+        const bool past_clear = rule.above ? value <= rule.clear : value >= rule.clear;
+
+        if (state.phase == State::Cooling) {
+            if (t < state.until) {
+                continue;
+            }
+            state.phase = State::Idle;
+        }
+
+        switch (state.phase) {
+        case State::Idle:
+            if (!past_fire) {
+                break;
+            }
+            state.phase = State::Pending;
+            state.since = t;
+            [[fallthrough]];
+        case State::Pending:
+            // The metric has to stay past fire for the whole duration
+            if (!past_fire) {
+                state.phase = State::Idle;
+            } else if (t - state.since >= rule.min_duration_ms) {
+                state.phase = State::Firing;
+                state.id = next_id_++;
+                events.push_back(Event(rule, state, AlertEvent::Fired, value, t, sample.pid, sample.process));
+            }
+            break;
+        case State::Firing:
+            if (past_clear) {
+                events.push_back(Event(rule, state, AlertEvent::Cleared, value, t, sample.pid, sample.process));
+                state.phase = rule.cooldown_ms > 0 ? State::Cooling : State::Idle;
+                state.until = t + rule.cooldown_ms;
+            }
+            break;
+        case State::Cooling:
+            break;
+        }
+    }
+}
+
+void AlertEngine::Reset(qint64 time_stamp, std::vector<AlertEvent> &events) {
+    for (size_t i = 0; i < rules_.size(); ++i) {
+        if (states_[i].phase == State::Firing) {
+            events.push_back(Event(rules_[i], states_[i], AlertEvent::Cleared, 0.0, time_stamp, pid_, process_));
+        }
+        states_[i] = State();
+    }
+}
+
+AlertQueue::AlertQueue(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    slots_.resize(size);
+    mask_ = size - 1;
+}
+
+bool AlertQueue::Push(const AlertEvent &event) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == slots_.size()) {
+        ++dropped_count_;
+        return false;
+    }
+    slots_[tail & mask_] = event;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+bool AlertQueue::Pop(AlertEvent &event) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    event = std::move(slots_[head & mask_]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+AlertHook::~AlertHook() {
+    Stop();
+}
+
+void AlertHook::Start(const QString &program) {
+    if (thread_.joinable() || program.isEmpty()) {
+        return;
+    }
+    program_ = program;
+    stop_ = false;
+    thread_ = std::thread(&AlertHook::Run, this);
+}
+
+void AlertHook::Stop() {
+    if (!thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        stop_ = true;
+    }
+    wake_cv_.notify_one();
+    thread_.join();
+}
+
+void AlertHook::Post(const AlertEvent &event) {
+    if (!thread_.joinable()) {
+        return;
+    }
+    // Notified without the lock so the producer never blocks; a wake-up
+    // lost to the race is covered by the poll
+    if (queue_.Push(event)) {
+        wake_cv_.notify_one();
+    }
+}
+
+void AlertHook::Run() {
+    QStringList arguments = QProcess::splitCommand(program_);
+    if (arguments.isEmpty()) {
+        return;
+    }
+    const QString program = arguments.takeFirst();
+
+    AlertEvent event;
+    while (true) {
+        // Whatever is queued still runs when stopping
+        if (!queue_.Pop(event)) {
+            std::unique_lock<std::mutex> lock(wake_mutex_);
+            if (stop_) {
+                break;
+            }
+            wake_cv_.wait_for(lock, std::chrono::milliseconds(kHookPollMs), [this]() { return stop_ || !queue_.Empty(); });
+            continue;
+        }
+
+        QProcess process;
+        // Its output goes to ours, so it can never fill a pipe nobody reads
+        process.setProcessChannelMode(QProcess::ForwardedChannels);
+        process.start(program, arguments);
+        if (!process.waitForStarted(kHookTimeoutMs)) {
+            qDebug() << "Alert hook" << program << "did not start:" << process.errorString();
+            continue;
+        }
+        process.write(QJsonDocument(AlertEventToJson(event)).toJson(QJsonDocument::Compact) + '\n');
+        process.closeWriteChannel();
+        if (!process.waitForFinished(kHookTimeoutMs)) {
+            qDebug() << "Alert hook" << program << "timed out";
+            process.kill();
+            process.waitForFinished(1000);
+        }
+        ++run_count_;
+    }
+}
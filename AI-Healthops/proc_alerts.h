@@ -0,0 +1,155 @@
+#ifndef PROC_ALERTS_H
+#define PROC_ALERTS_H
+
+#include "proc_stats.h"
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QString>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// One threshold alert. It fires once the metric has stayed past fire for
+// min_duration_ms and clears once it is back past clear, which lies on the
+// near side of fire so values hovering around the threshold do not flap.
+// After clearing it stays quiet for cooldown_ms. A firing alert can ask for
+// capture_ms of high-resolution samples of the process behind it.
+struct AlertRule {
+    QString id;
+    QString label;
+    int metric = 0;              // index into kStatsFields, or kCpuPercentMetric
+    bool above = true;           // fires on high values, else on low ones
+    double fire = 0.0;
+    double clear = 0.0;
+    qint64 min_duration_ms = 0;
+    qint64 cooldown_ms = 0;
+    qint64 capture_ms = 0;
+};
+
+// An alert firing or clearing. Both events of one alert share its id.
+struct AlertEvent {
+    enum Kind : quint8 { Fired, Cleared };
+
+    quint64 id = 0;
+    Kind kind = Fired;
+    QString rule;                // AlertRule::id
+    QString label;
+    int metric = 0;
+    double value = 0.0;          // the sample that fired or cleared it
+    double threshold = 0.0;      // fire or clear
+    qint64 since = 0;            // ms since epoch the metric first crossed fire
+    qint64 time_stamp = 0;
+    quint32 pid = 0;
+    QString process;
+    qint64 capture_ms = 0;       // high-resolution capture asked for, if fired
+};
+
+QJsonObject AlertEventToJson(const AlertEvent &event);
+
+// Evaluates the alert rules on every sample of the sampled process. Rules
+// are read from a JSON file of the form
+//   {"alerts": [{"id": "cpu-high", "label": "...", "metric": "CPU_PERCENT",
+//                "op": ">", "fire": 90, "clear": 70, "for": 10,
+//                "cooldown": 300, "capture": 30}]}
+// with "for", "cooldown" and "capture" in seconds; "clear" defaults to
+// "fire", "op" to ">".
+struct AlertEngine
+{
+    bool Compile(const QByteArray &json, const QString &source, QString *error);
+    // Compiles the rules in path, writing the built-in ones there first if
+    // the file does not exist
+    bool Load(const QString &path, QString *error);
+    static QByteArray DefaultAlerts();
+
+    // Ids continue from here, e.g. past those already stored
+    void SetNextId(quint64 id) { next_id_ = id; }
+    // Metric groups the samples carry. Rules on any other metric are
+    // skipped: it only reads zero and would fire a "<" rule for good.
+    void SetGroups(quint32 groups) { groups_ = groups; }
+
+    // Feeds one sample and appends the alerts that fired or cleared
+    void Update(const StatsSample &sample, std::vector<AlertEvent> &events);
+    // Clears the firing alerts, e.g. when another process is sampled, and
+    // forgets the rest
+    void Reset(qint64 time_stamp, std::vector<AlertEvent> &events);
+
+    const std::vector<AlertRule> &Rules() const { return rules_; }
+    QString Source() const { return source_; }
+
+private:
+    struct State {
+        enum Phase { Idle, Pending, Firing, Cooling } phase = Idle;
+        qint64 since = 0;        // Pending, Firing: first crossing
+        qint64 until = 0;        // Cooling: end of the cooldown
+        quint64 id = 0;          // Firing
+    };
+
+    AlertEvent Event(const AlertRule &rule, const State &state, AlertEvent::Kind kind, double value,
+                     qint64 time_stamp, quint32 pid, const QString &process) const;
+
+    std::vector<AlertRule> rules_;
+    std::vector<State> states_;
+    QString source_;
+    quint64 next_id_ = 1;
+    quint32 groups_ = kAllMetricGroups;
+    quint32 pid_ = 0;
+    QString process_;
+};
+
+// Bounded single-producer single-consumer queue of alert events. Push and
+// Pop never take a lock, so the sampling thread cannot be held up by its
+// reader; when the queue is full the new event is dropped and counted.
+struct AlertQueue
+{
+    // Capacity is rounded up to a power of two
+    explicit AlertQueue(size_t capacity = 1024);
+
+    bool Push(const AlertEvent &event);   // producer only
+    bool Pop(AlertEvent &event);          // consumer only
+    bool Empty() const { return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire); }
+
+    quint64 DroppedCount() const { return dropped_count_; }
+
+private:
+    std::vector<AlertEvent> slots_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> head_{0};   // next slot to pop
+    alignas(64) std::atomic<size_t> tail_{0};   // next slot to push
+    std::atomic<quint64> dropped_count_{0};
+};
+
+// Runs a local program for every alert event on its own thread, so the
+// sampling path never waits for it. The event goes to the program's stdin
+// as one line of JSON; the program is killed if it runs longer than a few
+// seconds.
+struct AlertHook
+{
+    AlertHook() = default;
+    ~AlertHook();
+
+    void Start(const QString &program);
+    void Stop();
+
+    // Producer side, safe only from the one thread that raises alerts
+    void Post(const AlertEvent &event);
+
+    quint64 RunCount() const { return run_count_; }
+    quint64 DroppedCount() const { return queue_.DroppedCount(); }
+
+private:
+    void Run();
+
+    QString program_;
+    AlertQueue queue_;
+    std::thread thread_;
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    std::atomic<bool> stop_{false};
+    std::atomic<quint64> run_count_{0};
+};
+
+#endif // PROC_ALERTS_H
@@ -0,0 +1,169 @@
+#include "proc_anomaly.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Converts a mean absolute deviation to a normal standard deviation
+static const double kAbsDevToSigma = 1.2533;
+
+// Deviations smaller than this fraction of the baseline, or than one unit,
+// are never anomalous; this keeps flat metrics from dividing by zero.
+static const double kRelativeFloor = 0.01;
+static const double kAbsoluteFloor = 1.0;
+
+// Moves the baselines towards x. The median takes a step of fixed size in
+// the direction of x, which converges to the median of a stationary stream.
+static void learn(double &mean, double &var, double &median, double &abs_dev,
+                  double x, double robust_sigma, double alpha) {
+    const double dev = x - median;
+    median += alpha * robust_sigma * (dev > 0 ? 1.0 : dev < 0 ? -1.0 : 0.0);
+    abs_dev += alpha * (std::abs(dev) - abs_dev);
+    const double diff = x - mean;
+    mean += alpha * diff;
+    var = (1.0 - alpha) * (var + alpha * diff * diff);
+}
+
+AnomalyDetector::AnomalyDetector(AnomalyParams params) : params_(params) {
+}
+
+void AnomalyDetector::Close(const ProcessState &state, int metric, MetricState &m, qint64 time_stamp,
+                            std::vector<AnomalyRegion> &closed) {
+    AnomalyRegion region;
+    region.pid = state.pid;
+    region.process = state.process;
+    region.metric = metric;
+    region.kind = m.kind;
+    region.start = m.start;
+    region.end = time_stamp;
+    region.baseline = m.baseline;
+    region.peak = m.peak;
+    region.score = m.score;
+    closed.push_back(std::move(region));
+
+    m.open = false;
+    m.quiet = 0;
+}
+
+void AnomalyDetector::Update(quint32 pid, const QString &process, qint64 time_stamp, const Stats &stats,
+                             std::vector<AnomalyRegion> &closed) {
+    size_t slot;
+    auto it = slots_.constFind(pid);
+    if (it != slots_.constEnd()) {
+        slot = it.value();
+    } else {
+        if (!free_slots_.empty()) {
+            slot = free_slots_.back();
+            free_slots_.pop_back();
+            states_[slot] = ProcessState();
+        } else {
+            slot = states_.size();
+            states_.emplace_back();
+        }
+        slots_.insert(pid, slot);
+        states_[slot].pid = pid;
+    }
+
+    ProcessState &state = states_[slot];
+    state.process = process;
+    const bool first = state.samples == 0;
+    const bool learning = state.samples < static_cast<quint32>(params_.warmup);
+    ++state.samples;
+
+    const double alpha = params_.alpha;
+
+    for (size_t i = 0; i < kStatsFieldCount; ++i) {
+        MetricState &m = state.metrics[i];
+        const double raw = static_cast<double>(stats.*kStatsFields[i].member);
+
+        double x = raw;
+        if (kStatsFields[i].cumulative) {
+            // A counter that went backwards was reset; treat it as no change
+            x = first || raw < m.previous ? 0.0 : raw - m.previous;
+            m.previous = raw;
+        }
+
+        if (first) {
+            m.mean = x;
+            m.median = x;
+            continue;
+        }
+
+        const double floor = std::max(kRelativeFloor * std::abs(m.median), kAbsoluteFloor);
+        const double robust_sigma = std::max(kAbsDevToSigma * m.abs_dev, floor);
+        const double sigma = std::max(std::sqrt(m.var), floor);
+        const double dev = x - m.median;
+        const double z = dev / robust_sigma;
+
+        if (learning) {
+            learn(m.mean, m.var, m.median, m.abs_dev, x, robust_sigma, alpha);
+            continue;
+        }
+
+        // CUSUM input is capped so that a short spike cannot trip it on its own
+        const double cap = params_.open_z / 2.0;
+        const double zc = std::clamp((x - m.mean) / sigma, -cap, cap);
+        m.cusum_pos = std::max(0.0, m.cusum_pos + zc - params_.cusum_k);
+        m.cusum_neg = std::max(0.0, m.cusum_neg - zc - params_.cusum_k);
+        const bool shifted = m.cusum_pos > params_.cusum_h || m.cusum_neg > params_.cusum_h;
+        const bool spike = std::abs(z) >= params_.open_z;
+
+        if (!m.open && (spike || shifted)) {
+            m.open = true;
+            m.kind = spike ? AnomalyRegion::Spike : AnomalyRegion::Shift;
+            m.quiet = 0;
+            m.start = time_stamp;
+            m.baseline = m.mean;
+            m.peak = x;
+            m.score = std::abs(z);
+        } else if (m.open) {
+            if (std::abs(x - m.baseline) > std::abs(m.peak - m.baseline)) {
+                m.peak = x;
+            }
+            m.score = std::max(m.score, std::abs(z));
+        }
+
+        if (shifted) {
+            // The level changed: restart the baseline there, keeping the
+            // learned spread
+            m.kind = AnomalyRegion::Shift;
+            m.mean = x;
+            m.median = x;
+            m.cusum_pos = 0.0;
+            m.cusum_neg = 0.0;
+        } else if (!spike) {
+            // Only normal samples move the baseline
+            learn(m.mean, m.var, m.median, m.abs_dev, x, robust_sigma, alpha);
+        }
+
+        if (m.open) {
+            if (!shifted && std::abs(z) < params_.close_z) {
+                // Back at the baseline, so the excursion was not a shift
+                m.cusum_pos = 0.0;
+                m.cusum_neg = 0.0;
+                if (++m.quiet >= params_.quiet_samples) {
+                    Close(state, static_cast<int>(i), m, time_stamp, closed);
+                }
+            } else {
+                m.quiet = 0;
+            }
+        }
+    }
+}
+
+void AnomalyDetector::Remove(quint32 pid, qint64 time_stamp, std::vector<AnomalyRegion> &closed) {
+    auto it = slots_.find(pid);
+    if (it == slots_.end()) {
+        return;
+    }
+    const size_t slot = it.value();
+    slots_.erase(it);
+
+    ProcessState &state = states_[slot];
+    for (size_t i = 0; i < kStatsFieldCount; ++i) {
+        if (state.metrics[i].open) {
+            Close(state, static_cast<int>(i), state.metrics[i], time_stamp, closed);
+        }
+    }
+    state.process.clear();
+    free_slots_.push_back(slot);
+}
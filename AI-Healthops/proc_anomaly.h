@@ -0,0 +1,93 @@
+#ifndef PROC_ANOMALY_H
+#define PROC_ANOMALY_H
+
+#include "proc_stats.h"
+
+#include <QHash>
+
+#include <array>
+#include <vector>
+
+// A stretch of time in which one metric of one process left its baseline
+struct AnomalyRegion {
+    enum Kind { Spike, Shift };
+
+    quint32 pid = 0;
+    QString process;
+    int metric = 0;         // index into kStatsFields
+    Kind kind = Spike;
+    qint64 start = 0;       // ms since epoch
+    qint64 end = 0;
+    double baseline = 0.0;  // EWMA mean when the region opened
+    double peak = 0.0;      // value furthest from the baseline
+    double score = 0.0;     // largest |robust z| seen in the region
+};
+
+struct AnomalyParams {
+    double alpha = 0.05;       // EWMA weight of a new sample
+    int warmup = 30;           // samples learned before anything is reported
+    double open_z = 4.0;       // |robust z| that opens a spike region
+    double close_z = 2.0;      // |robust z| that counts as quiet again
+    int quiet_samples = 3;     // quiet samples in a row that close a region
+    double cusum_k = 0.5;      // CUSUM slack, in standard deviations
+    double cusum_h = 12.0;     // CUSUM decision threshold
+};
+
+// Online anomaly detection over Stats samples, per metric per process:
+//  - an EWMA mean and variance track the baseline,
+//  - a robust z-score against a streaming median and mean absolute
+//    deviation flags spikes without the spikes dragging the baseline along,
+//  - a two-sided CUSUM on the standardized deviation flags level shifts,
+//    after which the baseline restarts at the new level.
+// Every update is a fixed number of operations per metric, and the state is
+// a flat array per process.
+struct AnomalyDetector
+{
+    explicit AnomalyDetector(AnomalyParams params = AnomalyParams());
+
+    // Feeds one sample. Regions that ended with it are appended to closed.
+    void Update(quint32 pid, const QString &process, qint64 time_stamp, const Stats &stats,
+                std::vector<AnomalyRegion> &closed);
+
+    // Ends the open regions of pid at time_stamp and forgets the process
+    void Remove(quint32 pid, qint64 time_stamp, std::vector<AnomalyRegion> &closed);
+
+    size_t ProcessCount() const { return static_cast<size_t>(slots_.size()); }
+
+private:
+    struct MetricState {
+        double mean = 0.0;
+        double var = 0.0;
+        double median = 0.0;
+        double abs_dev = 0.0;
+        double cusum_pos = 0.0;
+        double cusum_neg = 0.0;
+        double previous = 0.0;  // last raw value of a cumulative field
+
+        // Open region, if any
+        bool open = false;
+        AnomalyRegion::Kind kind = AnomalyRegion::Spike;
+        int quiet = 0;
+        qint64 start = 0;
+        double baseline = 0.0;
+        double peak = 0.0;
+        double score = 0.0;
+    };
+
+    struct ProcessState {
+        QString process;
+        quint32 pid = 0;
+        quint32 samples = 0;
+        std::array<MetricState, kStatsFieldCount> metrics;
+    };
+
+    static void Close(const ProcessState &state, int metric, MetricState &m, qint64 time_stamp,
+                      std::vector<AnomalyRegion> &closed);
+
+    AnomalyParams params_;
+    QHash<quint32, size_t> slots_;
+    std::vector<ProcessState> states_;
+    std::vector<size_t> free_slots_;
+};
+
+#endif // PROC_ANOMALY_H
@@ -0,0 +1,458 @@
+#include "proc_collector.h"
+#include "proc_database.h"
+#include "proc_push.h"
+#include "proc_shared.h"
+#include "proc_stream.h"
+#include "proc_trace.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <chrono>
+
+// Stored anomaly regions handed to the GUI when sampling starts
+static const int kRegionsShownAtStart = 500;
+
+// Regions kept in memory for feature summaries
+static const size_t kRecentRegions = 5000;
+
+// Period of the high-resolution capture an alert can ask for
+static const int kCaptureIntervalMs = 100;
+
+Collector::Collector(QString db_path, int pid, int interval_ms)
+    : db_path_(db_path), pid_(pid), interval_ms_(interval_ms > 0 ? interval_ms : 1000), rule_engine_(interval_ms_) {
+}
+
+Collector::~Collector() {
+    Stop();
+}
+
+QString Collector::DataDir() {
+    // Same place as the GUI's AppLocalDataLocation, whatever the name of
+    // the executable asking
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + "/AI-Healthops_2";
+    QDir().mkpath(dir);
+    return dir;
+}
+
+void Collector::Start() {
+    if (thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(stop_mutex_);
+        stop_ = false;
+    }
+    thread_ = std::thread([this]() { Run(); });
+}
+
+void Collector::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(stop_mutex_);
+        stop_ = true;
+    }
+    stop_cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void Collector::Attach(int pid) {
+    requested_pid_ = pid;
+}
+
+size_t Collector::Drain(std::vector<StatsSample> &out) {
+    out.clear();
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    out.reserve(pending_.size());
+    for (auto &sample : pending_) {
+        out.push_back(std::move(sample));
+    }
+    pending_.clear();
+    return out.size();
+}
+
+size_t Collector::DrainRegions(std::vector<AnomalyRegion> &out) {
+    out.clear();
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    out.swap(pending_regions_);
+    return out.size();
+}
+
+size_t Collector::DrainAlerts(std::vector<AlertEvent> &out) {
+    out.clear();
+    AlertEvent event;
+    while (alerts_.Pop(event)) {
+        out.push_back(std::move(event));
+    }
+    return out.size();
+}
+
+std::vector<TrendEstimate> Collector::Trends() const {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    return trends_;
+}
+
+std::shared_ptr<const RuleSet> Collector::Rules() const {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    return rules_;
+}
+
+std::vector<RuleMatch> Collector::RuleMatches() const {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    return rule_matches_;
+}
+
+void Collector::AddSnapshot(std::shared_ptr<const ProcessSnapshot> snapshot) {
+    // Done here so the top lists are current by the time the GUI shows the
+    // same snapshot
+    heavy_hitters_.Add(*snapshot);
+
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    // Snapshots come every few seconds; a stalled sampling thread should
+    // not make them pile up
+    if (pending_snapshots_.size() < 16) {
+        pending_snapshots_.push_back(std::move(snapshot));
+    }
+}
+
+std::vector<CorrelatedProcess> Collector::Culprits(int series, qint64 from, qint64 to, size_t limit) const {
+    return correlation_.Culprits(series, from, to, limit);
+}
+
+QJsonObject Collector::FeatureSummary(qint64 from, qint64 to) const {
+    std::vector<AnomalyRegion> regions;
+    quint32 pid;
+    QString process;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        regions.assign(recent_regions_.begin(), recent_regions_.end());
+        pid = current_pid_;
+        process = current_process_;
+    }
+    // Host-wide culprits for CPU and I/O, best first across both
+    std::vector<CorrelatedProcess> correlated = correlation_.Culprits(ProcessSnapshot::CpuPercent, from, to, 5);
+    for (const CorrelatedProcess &culprit : correlation_.Culprits(ProcessSnapshot::IoOpsPerSec, from, to, 5)) {
+        correlated.push_back(culprit);
+    }
+    std::stable_sort(correlated.begin(), correlated.end(), [](const CorrelatedProcess &a, const CorrelatedProcess &b) {
+        return a.correlation * a.share > b.correlation * b.share;
+    });
+    std::vector<HeavyHitter> heaviest;
+    for (int series : {ProcessSnapshot::CpuPercent, ProcessSnapshot::WriteBytesPerSec}) {
+        for (const HeavyHitter &hitter : heavy_hitters_.Top(series, 5)) {
+            heaviest.push_back(hitter);
+        }
+    }
+    return BuildFeatureSummary(pid, process, from, to, summary_, regions, correlated,
+                               heaviest, heavy_hitters_.WindowMs());
+}
+
+std::vector<StatsSample> Collector::Samples(qint64 from, qint64 to) const {
+    quint32 pid;
+    QString process;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        pid = current_pid_;
+        process = current_process_;
+    }
+    // The columns are cleared whenever the process changes
+    std::vector<StatsSample> samples;
+    columns_.Rows(from, to, samples);
+    for (StatsSample &sample : samples) {
+        sample.pid = pid;
+        sample.process = process;
+    }
+    return samples;
+}
+
+void Collector::Run() {
+    TRACE_THREAD("stats");
+    std::unique_ptr<PerformanceStats> perf_stats;
+    if (!source_) {
+        perf_stats = std::make_unique<PerformanceStats>("", pid_, interval_ms_, metrics_);
+    }
+    const bool store = storage_enabled_;
+    const bool hand_off = hand_off_enabled_;
+    Database database(db_path_);
+    std::vector<AnomalyRegion> closed = database.LoadRegions(kRegionsShownAtStart);
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        if (hand_off) {
+            pending_regions_.insert(pending_regions_.end(), closed.begin(), closed.end());
+        }
+        recent_regions_.insert(recent_regions_.end(), closed.begin(), closed.end());
+    }
+    closed.clear();
+
+    QString rules_error;
+    if (rules_path_.isEmpty() || !rule_engine_.Load(rules_path_, &rules_error)) {
+        if (!rules_error.isEmpty()) {
+            qDebug() << "Using the built-in rules:" << rules_error;
+        }
+        rule_engine_.Compile(RuleEngine::DefaultRules(), "built-in", nullptr);
+    }
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        rules_ = rule_engine_.Rules();
+    }
+    std::vector<RuleMatch> matches;
+
+    QString alerts_error;
+    if (alerts_path_.isEmpty() || !alert_engine_.Load(alerts_path_, &alerts_error)) {
+        if (!alerts_error.isEmpty()) {
+            qDebug() << "Using the built-in alerts:" << alerts_error;
+        }
+        alert_engine_.Compile(AlertEngine::DefaultAlerts(), "built-in", nullptr);
+    }
+    alert_engine_.SetNextId(database.LastAlertId() + 1);
+    std::vector<AlertEvent> alert_events;
+
+    // At most one high-resolution capture at a time; it only ends up in
+    // the store, so there is none without storage
+    struct Capture {
+        quint64 alert = 0;
+        std::unique_ptr<PerformanceStats> stats;
+        std::chrono::steady_clock::time_point next;
+        std::chrono::steady_clock::time_point end;
+        std::vector<StatsSample> samples;
+    };
+    std::unique_ptr<Capture> capture;
+    auto finishCapture = [&]() {
+        database.SaveCapture(capture->alert, capture->samples);
+        capture.reset();
+    };
+
+    // Sketches of the sampled process are stored when its minute ends
+    quint32 sketch_pid = 0;
+    QString sketch_process;
+    qint64 sketch_minute = -1;
+    std::vector<SketchRecord> sketches;
+    std::vector<std::shared_ptr<const ProcessSnapshot>> snapshots;
+    std::vector<StatsSample> taken;
+    quint32 sampled_pid = 0;
+    auto saveMinute = [&]() {
+        StatsAggregate minute;
+        if (sketch_minute >= 0 && summary_.Minute(sketch_minute * 60000, minute)) {
+            for (size_t i = 0; i < kStatsFieldCount; ++i) {
+                SketchRecord record;
+                record.pid = sketch_pid;
+                record.process = sketch_process;
+                record.metric = kStatsFields[i].name;
+                record.start = sketch_minute * 60000;
+                record.duration = 60000;
+                record.sum = minute[i].sum;
+                record.min = minute[i].min;
+                record.max = minute[i].max;
+                record.sketch = std::move(minute[i].sketch);
+                sketches.push_back(std::move(record));
+            }
+        }
+        sketch_minute = -1;
+    };
+
+    // Memory leaks are projected towards physical memory and the commit limit
+    MEMORYSTATUSEX memory_status;
+    memory_status.dwLength = sizeof(memory_status);
+    if (GlobalMemoryStatusEx(&memory_status)) {
+        leak_detector_.SetLimits(static_cast<double>(memory_status.ullTotalPhys),
+                                 static_cast<double>(memory_status.ullTotalPageFile));
+    }
+
+    const auto interval = std::chrono::milliseconds(interval_ms_);
+    // True once Stop() asks
+    auto waitUntil = [this](std::chrono::steady_clock::time_point until) {
+        std::unique_lock<std::mutex> lock(stop_mutex_);
+        return stop_cv_.wait_until(lock, until, [this]() { return stop_; });
+    };
+    auto next_tick = std::chrono::steady_clock::now();
+
+    while (true) {
+        next_tick += interval;
+        // If a sample took longer than the interval, skip the missed ticks
+        // instead of firing them back to back
+        const auto now = std::chrono::steady_clock::now();
+        if (now > next_tick + interval) {
+            next_tick = now;
+        }
+
+        // Capture samples fill the wait for the next tick
+        bool stopping = false;
+        while (capture && capture->next < next_tick && !(stopping = waitUntil(capture->next))) {
+            TRACE_SPAN("collector.capture");
+            StatsSample sample;
+            sample.time_stamp = QDateTime::currentMSecsSinceEpoch();
+            sample.pid = capture->stats->process_id_;
+            sample.process = capture->stats->process_name_;
+            sample.stats = capture->stats->GetStats();
+            capture->samples.push_back(std::move(sample));
+            // Late captures are skipped, as late ticks are
+            capture->next = std::max(capture->next + std::chrono::milliseconds(kCaptureIntervalMs),
+                                     std::chrono::steady_clock::now());
+            if (capture->next >= capture->end) {
+                finishCapture();
+            }
+        }
+        if (stopping || waitUntil(next_tick)) {
+            break;
+        }
+        TRACE_SPAN("collector.tick");
+
+        // Samples of this tick: one taken here, or whatever the source
+        // published since the previous tick
+        taken.clear();
+        if (source_) {
+            source_->Read(taken);
+        } else {
+            const int requested_pid = requested_pid_.exchange(-1);
+            if (requested_pid >= 0) {
+                pid_ = requested_pid;
+                perf_stats = std::make_unique<PerformanceStats>("", pid_, interval_ms_, metrics_);
+            }
+            StatsSample sample;
+            sample.time_stamp = QDateTime::currentMSecsSinceEpoch();
+            sample.pid = perf_stats->process_id_;
+            sample.process = perf_stats->process_name_;
+            sample.stats = perf_stats->GetStats();
+            taken.push_back(std::move(sample));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(pending_mutex_);
+            snapshots.swap(pending_snapshots_);
+        }
+        for (const auto &snapshot : snapshots) {
+            process_sketches_.Add(*snapshot, sketches);
+            correlation_.Add(*snapshot);
+        }
+        snapshots.clear();
+
+        for (StatsSample &sample : taken) {
+            // Another process starts its series afresh
+            if (sample.pid != sampled_pid) {
+                if (sampled_pid != 0) {
+                    anomaly_detector_.Remove(sampled_pid, QDateTime::currentMSecsSinceEpoch(), closed);
+                    saveMinute();
+                    cpu_history_.Clear();
+                    columns_.Clear();
+                    leak_detector_.Clear();
+                    summary_.Clear();
+                    rule_engine_.Reset();
+                    alert_engine_.Reset(QDateTime::currentMSecsSinceEpoch(), alert_events);
+                }
+                sampled_pid = sample.pid;
+                // Metrics outside the process's groups read zero
+                const quint32 groups = metrics_.For(sample.process);
+                rule_engine_.SetGroups(groups);
+                alert_engine_.SetGroups(groups);
+            }
+            if (stream_) {
+                stream_->Publish(sample);
+            }
+            if (shared_) {
+                shared_->Publish(sample);
+            }
+            if (push_) {
+                push_->Publish(sample);
+            }
+
+            // Storage happens here, on the sampling thread, for every sample
+            const Stats &s = sample.stats;
+            cpu_history_.Append(sample.time_stamp, s.CPU_KERNPERCENT + s.CPU_USERPERCENT);
+            columns_.Append(sample.time_stamp, s);
+            if (store) {
+                database.Save(sample.time_stamp, s);
+            }
+            ++sample_count_;
+
+            if (sample.time_stamp / 60000 != sketch_minute) {
+                saveMinute();
+                sketch_pid = sample.pid;
+                sketch_process = sample.process;
+                sketch_minute = sample.time_stamp / 60000;
+            }
+
+            anomaly_detector_.Update(sample.pid, sample.process, sample.time_stamp, s, closed);
+            if (store) {
+                for (const AnomalyRegion &region : closed) {
+                    database.SaveRegion(region);
+                }
+            }
+            summary_.Add(sample.time_stamp, s);
+            leak_detector_.Update(sample.time_stamp, s);
+            std::vector<TrendEstimate> trends = leak_detector_.Estimates();
+            rule_engine_.Update(s, matches);
+
+            // Alerts go to the store here, and without locks to the hook
+            // and the presentation layer
+            alert_engine_.Update(sample, alert_events);
+            for (const AlertEvent &event : alert_events) {
+                if (store) {
+                    database.SaveAlert(event);
+                }
+                if (alert_hook_) {
+                    alert_hook_->Post(event);
+                }
+                if (hand_off) {
+                    alerts_.Push(event);
+                }
+                if (store && !capture && event.kind == AlertEvent::Fired && event.capture_ms > 0) {
+                    capture = std::make_unique<Capture>();
+                    capture->alert = event.id;
+                    capture->stats = std::make_unique<PerformanceStats>("", static_cast<int>(event.pid),
+                                                                        kCaptureIntervalMs, metrics_);
+                    capture->next = std::chrono::steady_clock::now() + std::chrono::milliseconds(kCaptureIntervalMs);
+                    capture->end = capture->next + std::chrono::milliseconds(event.capture_ms);
+                }
+            }
+            alert_events.clear();
+
+            // Hand-off to the presentation layer
+            std::lock_guard<std::mutex> lock(pending_mutex_);
+            current_pid_ = sample.pid;
+            current_process_ = sample.process;
+            if (hand_off) {
+                if (pending_.size() >= max_pending_) {
+                    pending_.pop_front();
+                    ++dropped_count_;
+                }
+                pending_.push_back(std::move(sample));
+                pending_regions_.insert(pending_regions_.end(), closed.begin(), closed.end());
+            }
+            recent_regions_.insert(recent_regions_.end(), closed.begin(), closed.end());
+            while (recent_regions_.size() > kRecentRegions) {
+                recent_regions_.pop_front();
+            }
+            closed.clear();
+            trends_.swap(trends);
+            rule_matches_.swap(matches);
+        }
+
+        // Once per tick, so minutes the snapshots closed are stored even
+        // on ticks without a sample
+        if (store) {
+            database.SaveSketches(sketches);
+        }
+        sketches.clear();
+    }
+
+    // A capture cut short by the stop keeps what it has
+    if (capture) {
+        finishCapture();
+    }
+
+    // Regions still open when sampling stops end here
+    closed.clear();
+    anomaly_detector_.Remove(sampled_pid, QDateTime::currentMSecsSinceEpoch(), closed);
+    saveMinute();
+    process_sketches_.Flush(sketches);
+    if (store) {
+        for (const AnomalyRegion &region : closed) {
+            database.SaveRegion(region);
+        }
+        database.SaveSketches(sketches);
+    }
+}
@@ -0,0 +1,188 @@
+#ifndef PROC_COLLECTOR_H
+#define PROC_COLLECTOR_H
+
+#include "proc_alerts.h"
+#include "proc_stats.h"
+#include "proc_history.h"
+#include "proc_columns.h"
+#include "proc_anomaly.h"
+#include "proc_trend.h"
+#include "proc_rules.h"
+#include "proc_summary.h"
+#include "proc_topk.h"
+
+struct StatsStreamServer;
+struct SharedStatsWriter;
+struct StatsPushClient;
+struct SharedStatsReader;
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Owns the sampling thread. Every sample is stored (history and database)
+// on the sampling thread itself, so storage never waits for the GUI. The GUI
+// picks samples up with Drain() at its own pace; if it falls far behind, the
+// oldest undrained samples are dropped from the hand-off queue only.
+// Anomaly and leak detection and the local rules run on every sample on
+// the same thread, which also stores a quantile sketch per metric and minute
+// and feeds the enumerator's snapshots to the cross-process correlation.
+// Threshold alerts are evaluated there too; when one fires with a capture,
+// its process is sampled every 100 ms in the gaps between ticks
+// and the capture is stored with the alert.
+struct Collector
+{
+    Collector(QString db_path, int pid = 0, int interval_ms = 1000);
+    ~Collector();
+
+    // Rules file read when sampling starts; created with the built-in
+    // rules if missing
+    void SetRulesPath(const QString &path) { rules_path_ = path; }
+    // Same for the alerts file
+    void SetAlertsPath(const QString &path) { alerts_path_ = path; }
+
+    // Both must be set before Start(). Without storage nothing is written
+    // to the database, e.g. while another collector owns it. Without the
+    // hand-off nothing is queued for Drain() and DrainRegions(), for hosts
+    // that never drain, such as the headless daemon.
+    void SetStorageEnabled(bool enabled) { storage_enabled_ = enabled; }
+    void SetHandOffEnabled(bool enabled) { hand_off_enabled_ = enabled; }
+    // Every sample is also published to stream and shared and pushed to an
+    // aggregator through push, if set. Set before Start(); all must outlive
+    // sampling.
+    void SetStream(StatsStreamServer *stream) { stream_ = stream; }
+    void SetShared(SharedStatsWriter *shared) { shared_ = shared; }
+    void SetPush(StatsPushClient *push) { push_ = push; }
+    // Every alert event is also posted to hook, if set, before Start()
+    void SetAlertHook(AlertHook *hook) { alert_hook_ = hook; }
+    // Metric groups sampled for each process attached to, set before
+    // Start(); the others are never read and stay zero
+    void SetMetrics(const MetricSelection &metrics) { metrics_ = metrics; }
+    // Takes samples from another collector's shared segment instead of
+    // sampling here, e.g. in a viewer; Attach() has no effect then. Set
+    // before Start(); must outlive sampling.
+    void SetSource(SharedStatsReader *source) { source_ = source; }
+
+    // Directory of the database, rules and lock file shared by the GUI and
+    // the daemon; created if missing
+    static QString DataDir();
+
+    void Start();
+    void Stop();
+
+    // Switches sampling to another process (0 for this one) from the next
+    // tick on. The CPU history restarts with the new process, as it does
+    // when the source switches.
+    void Attach(int pid);
+
+    // Moves all samples taken since the last call into out (which is
+    // cleared first) and returns how many there were.
+    size_t Drain(std::vector<StatsSample> &out);
+
+    // Anomaly regions that ended since the last call, stored ones first
+    size_t DrainRegions(std::vector<AnomalyRegion> &out);
+
+    // Alerts that fired or cleared since the last call, oldest first. One
+    // thread only; the sampling thread hands them over without a lock.
+    size_t DrainAlerts(std::vector<AlertEvent> &out);
+    quint64 DroppedAlertCount() const { return alerts_.DroppedCount(); }
+
+    // Working-set and pagefile trends as of the latest sample
+    std::vector<TrendEstimate> Trends() const;
+
+    // Rules in use and the ones matching the latest sample
+    std::shared_ptr<const RuleSet> Rules() const;
+    std::vector<RuleMatch> RuleMatches() const;
+
+    // Hands an enumerator snapshot to the sampling thread, which keeps
+    // per-minute sketches of every process in it. The heavy hitters are
+    // updated right away, on the calling thread. Safe from any thread.
+    void AddSnapshot(std::shared_ptr<const ProcessSnapshot> snapshot);
+
+    // Processes that drove the host total of series (ProcessSnapshot::Series)
+    // during [from, to], most likely first
+    std::vector<CorrelatedProcess> Culprits(int series, qint64 from, qint64 to, size_t limit = 10) const;
+    // Oldest time Culprits() still covers, 0 before the first snapshot
+    qint64 CulpritsSince() const { return correlation_.OldestTime(); }
+
+    // Compact summary of [from, to] for the analysis service
+    QJsonObject FeatureSummary(qint64 from, qint64 to) const;
+
+    // The samples of [from, to] still in memory, tagged with the process
+    // they were taken of
+    std::vector<StatsSample> Samples(qint64 from, qint64 to) const;
+
+    // Statistics of metric (an index into kStatsFields) over the samples of
+    // [from, to] still in memory, counting those above threshold
+    ColumnStats MetricStats(int metric, qint64 from, qint64 to, quint64 threshold = 0) const {
+        return columns_.Aggregate(metric, from, to, threshold);
+    }
+
+    // CPU percent of the process sampled, for the chart
+    const SeriesHistory &CpuHistory() const { return cpu_history_; }
+
+    // Heaviest processes of series over the enumerator's recent window
+    std::vector<HeavyHitter> TopProcesses(int series, size_t k) const { return heavy_hitters_.Top(series, k); }
+
+    // Samples dropped from the hand-off queue because nobody drained them
+    quint64 DroppedCount() const { return dropped_count_; }
+    quint64 SampleCount() const { return sample_count_; }
+
+private:
+    void Run();
+
+    // Internally locked, read by other threads through the methods above
+    SeriesHistory cpu_history_;
+    StatsColumns columns_;
+    SummaryStore summary_;
+    CorrelationEngine correlation_;
+    HeavyHitters heavy_hitters_;
+
+    QString db_path_;
+    QString rules_path_;
+    QString alerts_path_;
+    int pid_;
+    std::atomic<int> requested_pid_{-1};
+    int interval_ms_;
+    size_t max_pending_ = 100000;
+    bool storage_enabled_ = true;
+    bool hand_off_enabled_ = true;
+    StatsStreamServer *stream_ = nullptr;
+    SharedStatsWriter *shared_ = nullptr;
+    StatsPushClient *push_ = nullptr;
+    MetricSelection metrics_;
+    AlertHook *alert_hook_ = nullptr;
+    SharedStatsReader *source_ = nullptr;
+
+    std::thread thread_;
+    std::mutex stop_mutex_;
+    std::condition_variable stop_cv_;
+    bool stop_ = false;
+
+    mutable std::mutex pending_mutex_;
+    std::deque<StatsSample> pending_;
+    std::vector<AnomalyRegion> pending_regions_;
+    std::vector<TrendEstimate> trends_;
+    std::shared_ptr<const RuleSet> rules_;
+    std::vector<RuleMatch> rule_matches_;
+    std::deque<AnomalyRegion> recent_regions_;
+    std::vector<std::shared_ptr<const ProcessSnapshot>> pending_snapshots_;
+    quint32 current_pid_ = 0;
+    QString current_process_;
+    AlertQueue alerts_;
+
+    // Used by the sampling thread only
+    AnomalyDetector anomaly_detector_;
+    ProcessSketches process_sketches_;
+    LeakDetector leak_detector_;
+    RuleEngine rule_engine_;
+    AlertEngine alert_engine_;
+
+    std::atomic<quint64> sample_count_{0};
+    std::atomic<quint64> dropped_count_{0};
+};
+
+#endif // PROC_COLLECTOR_H
@@ -0,0 +1,78 @@
+#include "proc_columns.h"
+#include "proc_kernels.h"
+
+#include <algorithm>
+
+StatsColumns::StatsColumns(size_t capacity) : capacity_(capacity) {
+}
+
+void StatsColumns::Append(qint64 time_stamp, const Stats &stats) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (times_.size() >= capacity_ * 2) {
+        const size_t excess = times_.size() - capacity_;
+        times_.erase(times_.begin(), times_.begin() + excess);
+        for (std::vector<quint64> &column : columns_) {
+            column.erase(column.begin(), column.begin() + excess);
+        }
+    }
+
+    times_.push_back(time_stamp);
+    for (size_t i = 0; i < kStatsFieldCount; ++i) {
+        columns_[i].push_back(stats.*kStatsFields[i].member);
+    }
+}
+
+void StatsColumns::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    times_.clear();
+    for (std::vector<quint64> &column : columns_) {
+        column.clear();
+    }
+}
+
+size_t StatsColumns::Size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return times_.size();
+}
+
+void StatsColumns::Rows(qint64 from, qint64 to, std::vector<StatsSample> &out) const {
+    out.clear();
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto [begin, end] = Find(from, to);
+    out.resize(end - begin);
+    for (size_t row = begin; row < end; ++row) {
+        out[row - begin].time_stamp = times_[row];
+    }
+    for (size_t i = 0; i < kStatsFieldCount; ++i) {
+        const quint64 *values = columns_[i].data();
+        for (size_t row = begin; row < end; ++row) {
+            out[row - begin].stats.*kStatsFields[i].member = values[row];
+        }
+    }
+}
+
+std::pair<size_t, size_t> StatsColumns::Find(qint64 from, qint64 to) const {
+    auto begin = std::lower_bound(times_.begin(), times_.end(), from);
+    auto end = std::upper_bound(begin, times_.end(), to);
+    return {static_cast<size_t>(begin - times_.begin()), static_cast<size_t>(end - times_.begin())};
+}
+
+ColumnStats StatsColumns::Aggregate(int metric, qint64 from, qint64 to, quint64 threshold) const {
+    ColumnStats stats;
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto [begin, end] = Find(from, to);
+    if (begin == end) {
+        return stats;
+    }
+
+    const quint64 *values = columns_[metric].data() + begin;
+    const ColumnKernels &kernels = Kernels();
+    stats.count = end - begin;
+    stats.sum = kernels.sum(values, stats.count);
+    kernels.min_max(values, stats.count, stats.min, stats.max);
+    stats.above = kernels.count_above(values, stats.count, threshold);
+    stats.first = values[0];
+    stats.last = values[stats.count - 1];
+    return stats;
+}
@@ -0,0 +1,57 @@
+#ifndef PROC_COLUMNS_H
+#define PROC_COLUMNS_H
+
+#include "proc_stats.h"
+
+#include <array>
+#include <mutex>
+#include <vector>
+
+// Statistics of one metric over a time range
+struct ColumnStats {
+    size_t count = 0;
+    quint64 sum = 0;
+    quint64 min = 0;
+    quint64 max = 0;
+    quint64 first = 0;
+    quint64 last = 0;
+    size_t above = 0;      // samples above the threshold asked for
+
+    double Mean() const { return count ? static_cast<double>(sum) / count : 0.0; }
+    // Change over the range, e.g. the growth of a cumulative counter
+    qint64 Delta() const { return static_cast<qint64>(last - first); }
+};
+
+// Recent Stats samples stored column by column, one contiguous quint64
+// buffer per field, so a range of one metric is a flat run the aggregation
+// kernels can stream through. Appended by the sampling thread and read by
+// others, so every access takes the lock. Old samples are trimmed in chunks
+// as in SeriesHistory.
+struct StatsColumns
+{
+    // Default capacity holds a day of 1 s samples
+    explicit StatsColumns(size_t capacity = 24 * 3600);
+
+    void Append(qint64 time_stamp, const Stats &stats);
+    void Clear();
+
+    // Aggregates metric (an index into kStatsFields) over [from, to]
+    ColumnStats Aggregate(int metric, qint64 from, qint64 to, quint64 threshold = 0) const;
+
+    // The samples in [from, to] as time stamps and records; out is cleared
+    // first and only time_stamp and stats are set
+    void Rows(qint64 from, qint64 to, std::vector<StatsSample> &out) const;
+
+    size_t Size() const;
+
+private:
+    // Index range of [from, to]; the lock must be held
+    std::pair<size_t, size_t> Find(qint64 from, qint64 to) const;
+
+    size_t capacity_;
+    mutable std::mutex mutex_;
+    std::vector<qint64> times_;
+    std::array<std::vector<quint64>, kStatsFieldCount> columns_;
+};
+
+#endif // PROC_COLUMNS_H
@@ -0,0 +1,242 @@
+#include "proc_correlation.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Processes below this share of the host total in the range are not
+// correlated at all; of the rest only the largest are
+static const double kMinShare = 0.005;
+static const size_t kMaxCandidates = 256;
+
+// Pearson correlation of x[k - lag] with y[k]
+static double laggedCorrelation(const std::vector<double> &x, const std::vector<double> &y, int lag) {
+    const size_t count = y.size() - static_cast<size_t>(lag);
+    if (count < 3) {
+        return 0.0;
+    }
+    double sx = 0.0, sy = 0.0, sxx = 0.0, syy = 0.0, sxy = 0.0;
+    for (size_t k = static_cast<size_t>(lag); k < y.size(); ++k) {
+        const double a = x[k - static_cast<size_t>(lag)];
+        const double b = y[k];
+        sx += a;
+        sy += b;
+        sxx += a * a;
+        syy += b * b;
+        sxy += a * b;
+    }
+    const double n = static_cast<double>(count);
+    const double cxx = n * sxx - sx * sx;
+    const double cyy = n * syy - sy * sy;
+    if (cxx <= 0.0 || cyy <= 0.0) {
+        return 0.0;
+    }
+    return (n * sxy - sx * sy) / std::sqrt(cxx * cyy);
+}
+
+CorrelationEngine::CorrelationEngine(int window, int max_lag)
+    : window_(static_cast<size_t>(std::max(window, 4))), max_lag_(std::clamp(max_lag, 0, std::max(window, 4) / 2)),
+      times_(window_) {
+    for (std::vector<double> &host : host_) {
+        host.assign(window_, 0.0);
+    }
+}
+
+int CorrelationEngine::Acquire(quint32 pid, const QString &process) {
+    auto it = slot_of_.constFind(pid);
+    if (it != slot_of_.constEnd()) {
+        return it.value();
+    }
+
+    int slot;
+    if (!free_slots_.empty()) {
+        // A slot is freed only after a whole window of zeros, so its
+        // columns need no clearing
+        slot = free_slots_.back();
+        free_slots_.pop_back();
+    } else {
+        slot = static_cast<int>(slots_.size());
+        slots_.emplace_back();
+        for (std::vector<float> &values : values_) {
+            values.resize(values.size() + window_, 0.0f);
+        }
+    }
+    slots_[slot].pid = pid;
+    slots_[slot].process = process;
+    slots_[slot].used = true;
+    slot_of_.insert(pid, slot);
+    return slot;
+}
+
+void CorrelationEngine::Add(const ProcessSnapshot &snapshot) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t column = intervals_ % window_;
+    times_[column] = snapshot.time_stamp;
+
+    double host[ProcessSnapshot::SeriesCount] = {};
+    for (size_t row = 0; row < snapshot.Size(); ++row) {
+        const int slot = Acquire(snapshot.pids[row], snapshot.names[row]);
+        slots_[slot].last_seen = intervals_;
+        for (int series = 0; series < ProcessSnapshot::SeriesCount; ++series) {
+            const double value = snapshot.SeriesValue(series, row);
+            At(series, slot, intervals_) = static_cast<float>(value);
+            host[series] += value;
+        }
+    }
+
+    // Processes missing from this snapshot read as zero, and are forgotten
+    // once they have been gone for a whole window
+    for (size_t slot = 0; slot < slots_.size(); ++slot) {
+        Slot &entry = slots_[slot];
+        if (!entry.used || entry.last_seen == intervals_) {
+            continue;
+        }
+        for (int series = 0; series < ProcessSnapshot::SeriesCount; ++series) {
+            At(series, static_cast<int>(slot), intervals_) = 0.0f;
+        }
+        if (intervals_ - entry.last_seen >= window_) {
+            slot_of_.remove(entry.pid);
+            entry = Slot();
+            free_slots_.push_back(static_cast<int>(slot));
+        }
+    }
+
+    for (int series = 0; series < ProcessSnapshot::SeriesCount; ++series) {
+        host_[series][column] = host[series];
+    }
+    ++intervals_;
+}
+
+void CorrelationEngine::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    intervals_ = 0;
+    std::fill(times_.begin(), times_.end(), 0);
+    for (int series = 0; series < ProcessSnapshot::SeriesCount; ++series) {
+        std::fill(host_[series].begin(), host_[series].end(), 0.0);
+        values_[series].clear();
+    }
+    slots_.clear();
+    slot_of_.clear();
+    free_slots_.clear();
+}
+
+qint64 CorrelationEngine::OldestTime() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (intervals_ == 0) {
+        return 0;
+    }
+    return times_[(intervals_ - std::min<quint64>(intervals_, window_)) % window_];
+}
+
+size_t CorrelationEngine::ProcessCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<size_t>(slot_of_.size());
+}
+
+std::vector<CorrelatedProcess> CorrelationEngine::Culprits(int series, qint64 from, qint64 to, size_t limit) const {
+    std::vector<CorrelatedProcess> culprits;
+    if (series < 0 || series >= ProcessSnapshot::SeriesCount) {
+        return culprits;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    const quint64 count = std::min<quint64>(intervals_, window_);
+    if (count < 3) {
+        return culprits;
+    }
+    const quint64 first = intervals_ - count;
+    if (to < times_[first % window_]) {
+        // The range has left the window; any interval scanned would be
+        // an unrelated one
+        return culprits;
+    }
+
+    // A snapshot describes the interval that ends with it, so the range
+    // runs from the first snapshot at or after from to the first at or
+    // after to
+    quint64 range_begin = intervals_;
+    quint64 range_end = intervals_;
+    for (quint64 i = first; i < intervals_; ++i) {
+        const qint64 time_stamp = times_[i % window_];
+        if (range_begin == intervals_ && time_stamp >= from) {
+            range_begin = i;
+        }
+        if (time_stamp >= to) {
+            range_end = i + 1;
+            break;
+        }
+    }
+    if (range_begin == intervals_) {
+        return culprits;
+    }
+
+    const std::vector<double> &host = host_[series];
+    double host_sum = 0.0;
+    for (quint64 i = range_begin; i < range_end; ++i) {
+        host_sum += host[i % window_];
+    }
+    if (host_sum <= 0.0) {
+        return culprits;
+    }
+
+    // Activity filter: most processes are idle during any given range
+    std::vector<std::pair<double, int>> candidates;
+    const float *values = values_[series].data();
+    for (size_t slot = 0; slot < slots_.size(); ++slot) {
+        if (!slots_[slot].used) {
+            continue;
+        }
+        const float *row = values + slot * window_;
+        double sum = 0.0;
+        for (quint64 i = range_begin; i < range_end; ++i) {
+            sum += row[i % window_];
+        }
+        if (sum >= kMinShare * host_sum) {
+            candidates.emplace_back(sum, static_cast<int>(slot));
+        }
+    }
+    if (candidates.size() > kMaxCandidates) {
+        std::nth_element(candidates.begin(), candidates.begin() + kMaxCandidates, candidates.end(),
+                         [](const auto &a, const auto &b) { return a.first > b.first; });
+        candidates.resize(kMaxCandidates);
+    }
+
+    // Correlation over the window up to the end of the range, oldest first
+    std::vector<double> y;
+    std::vector<double> x;
+    for (quint64 i = first; i < range_end; ++i) {
+        y.push_back(host[i % window_]);
+    }
+    x.resize(y.size());
+
+    for (const auto &[sum, slot] : candidates) {
+        const float *row = values + static_cast<size_t>(slot) * window_;
+        for (quint64 i = first; i < range_end; ++i) {
+            x[i - first] = row[i % window_];
+        }
+
+        CorrelatedProcess culprit;
+        culprit.pid = slots_[slot].pid;
+        culprit.process = slots_[slot].process;
+        culprit.series = series;
+        culprit.share = sum / host_sum;
+        culprit.correlation = -1.0;
+        for (int lag = 0; lag <= max_lag_; ++lag) {
+            const double correlation = laggedCorrelation(x, y, lag);
+            if (correlation > culprit.correlation) {
+                culprit.correlation = correlation;
+                culprit.lag = lag;
+            }
+        }
+        if (culprit.correlation > 0.0) {
+            culprits.push_back(culprit);
+        }
+    }
+
+    std::sort(culprits.begin(), culprits.end(), [](const CorrelatedProcess &a, const CorrelatedProcess &b) {
+        return a.correlation * a.share > b.correlation * b.share;
+    });
+    if (culprits.size() > limit) {
+        culprits.resize(limit);
+    }
+    return culprits;
+}
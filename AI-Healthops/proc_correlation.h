@@ -0,0 +1,72 @@
+#ifndef PROC_CORRELATION_H
+#define PROC_CORRELATION_H
+
+#include "proc_snapshot.h"
+
+#include <QHash>
+
+#include <mutex>
+#include <vector>
+
+// Process that moved together with a host total
+struct CorrelatedProcess {
+    quint32 pid = 0;
+    QString process;
+    int series = 0;           // ProcessSnapshot::Series
+    double correlation = 0.0;
+    double share = 0.0;       // fraction of the host total it accounts for
+    int lag = 0;              // intervals by which the process leads the host
+};
+
+// Keeps the last window snapshots of every process as aligned columns, one
+// per snapshot, next to the host totals (the sum over all processes). For
+// a selected time range Culprits() ranks the processes by how much of the
+// host total they account for in the range times how well they follow it
+// over the whole window, with the process leading by 0 to max_lag
+// intervals. Only processes with a noticeable share of the range are
+// correlated, so the cost is linear in the number of processes and does not
+// compare processes with each other.
+struct CorrelationEngine
+{
+    explicit CorrelationEngine(int window = 64, int max_lag = 3);
+
+    void Add(const ProcessSnapshot &snapshot);
+    void Clear();
+
+    // Likely culprits for the host total of series in [from, to], most
+    // likely first. The range is widened to whole snapshot intervals; none
+    // if it ended before the oldest snapshot kept.
+    std::vector<CorrelatedProcess> Culprits(int series, qint64 from, qint64 to, size_t limit = 10) const;
+
+    // Time stamp of the oldest snapshot kept, 0 before the first
+    qint64 OldestTime() const;
+
+    size_t ProcessCount() const;
+
+private:
+    struct Slot {
+        quint32 pid = 0;
+        QString process;
+        quint64 last_seen = 0;   // interval
+        bool used = false;
+    };
+
+    int Acquire(quint32 pid, const QString &process);
+    float &At(int series, int slot, quint64 interval) {
+        return values_[series][static_cast<size_t>(slot) * window_ + interval % window_];
+    }
+
+    mutable std::mutex mutex_;
+    size_t window_;
+    int max_lag_;
+    quint64 intervals_ = 0;               // snapshots added
+
+    std::vector<qint64> times_;           // per column
+    std::vector<double> host_[ProcessSnapshot::SeriesCount];
+    std::vector<float> values_[ProcessSnapshot::SeriesCount];  // slot-major
+    std::vector<Slot> slots_;
+    QHash<quint32, int> slot_of_;
+    std::vector<int> free_slots_;
+};
+
+#endif // PROC_CORRELATION_H
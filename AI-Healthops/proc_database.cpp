@@ -1,72 +1,314 @@
 #include "proc_database.h"
+#include "proc_rules.h"
+#include "proc_trace.h"
 
-    Database::Database(QString path){
-        db = QSqlDatabase::addDatabase("QSQLITE");
+#include <QSqlRecord>
+#include <QStringList>
+
+#include <algorithm>
+
+// The stats table and its insert, expanded from STATS_METRICS at compile
+// time. The insert binds by position, so a sample costs no placeholder
+// lookups.
+static const char kCreateStatsSql[] = "CREATE TABLE IF NOT EXISTS stats (ID INTEGER PRIMARY KEY, TIME_STAMP INTEGER"
+#define STATS_COLUMN(name, cumulative, group) ", " #name " INTEGER"
+    STATS_METRICS(STATS_COLUMN)
+#undef STATS_COLUMN
+    ")";
+
+// High-resolution samples taken while an alert fired
+static const char kCreateCapturesSql[] = "CREATE TABLE IF NOT EXISTS captures (ID INTEGER PRIMARY KEY, ALERT INTEGER, PID INTEGER, TIME_STAMP INTEGER"
+#define STATS_COLUMN(name, cumulative, group) ", " #name " INTEGER"
+    STATS_METRICS(STATS_COLUMN)
+#undef STATS_COLUMN
+    ")";
+
+static const char kInsertCaptureSql[] = "INSERT INTO captures (ALERT, PID, TIME_STAMP"
+#define STATS_COLUMN(name, cumulative, group) ", " #name
+    STATS_METRICS(STATS_COLUMN)
+#undef STATS_COLUMN
+    ") VALUES (?, ?, ?"
+#define STATS_PLACEHOLDER(name, cumulative, group) ", ?"
+    STATS_METRICS(STATS_PLACEHOLDER)
+#undef STATS_PLACEHOLDER
+    ")";
+
+static const char kInsertStatsSql[] = "INSERT INTO stats (TIME_STAMP"
+#define STATS_COLUMN(name, cumulative, group) ", " #name
+    STATS_METRICS(STATS_COLUMN)
+#undef STATS_COLUMN
+    ") VALUES (?"
+#define STATS_PLACEHOLDER(name, cumulative, group) ", ?"
+    STATS_METRICS(STATS_PLACEHOLDER)
+#undef STATS_PLACEHOLDER
+    ")";
+
+// Tables from before a metric was added get its column, empty for the
+// older rows
+static void addMissingColumns(QSqlDatabase &db, const QString &table) {
+    const QSqlRecord columns = db.record(table);
+    QSqlQuery query(db);
+    for (const StatsField &field : kStatsFields) {
+        if (!columns.isEmpty() && !columns.contains(field.name)
+            && !query.exec(QString("ALTER TABLE %1 ADD COLUMN %2 INTEGER").arg(table, field.name))) {
+            qDebug() << "Error adding column" << field.name << "to" << table << ":" << query.lastError().text();
+        }
+    }
+}
+
+    Database::Database(QString path, const QString &connection) : connection(connection){
+        db = connection.isEmpty() ? QSqlDatabase::addDatabase("QSQLITE") : QSqlDatabase::addDatabase("QSQLITE", connection);
         db.setDatabaseName(path);
 
         if (!db.open()) {
             qDebug() << "Error: Could not open database:" << db.lastError().text();
         }
 
-        QSqlQuery query;
-        if (!query.exec("CREATE TABLE IF NOT EXISTS stats (ID INTEGER PRIMARY KEY, TIME_STAMP INTEGER, IO_IOPS_READ INTEGER, IO_IOPS_WRITE INTEGER, IO_BYTESREADPERSEC INTEGER, IO_BYTESWRITEPERSEC INTEGER, IO_TOTALBYTESREAD INTEGER, IO_TOTALBYTESWRITE INTEGER, CPU_KERNPERCENT INTEGER, CPU_USERPERCENT INTEGER, CPU_KERNTOTAL INTEGER, CPU_USERTOTAL INTEGER, PROC_PAGEFAULTCOUNT INTEGER, PROC_WORKINGSETSIZE INTEGER, PROC_PEAKWORKINGSETSIZE INTEGER, PROC_PAGEFILEUSAGE INTEGER, PROC_QUOTAPAGEDPOOLUSAGE INTEGER, PROC_QUOTANONPAGEDPOOLUSAGE INTEGER, PROC_QUOTAPEAKNONPAGEDPOOLUSAGE INTEGER)")) {
+        QSqlQuery query(db);
+        if (!query.exec(kCreateStatsSql)) {
             qDebug() << "Error creating table:" << query.lastError().text();
             db.close();
         }
         qDebug() << "Table 'stats' created or already exists.";
+
+        addMissingColumns(db, "stats");
+
+        if (!query.exec("CREATE TABLE IF NOT EXISTS regions (ID INTEGER PRIMARY KEY, PID INTEGER, PROCESS TEXT, METRIC TEXT, KIND INTEGER, START_TIME INTEGER, END_TIME INTEGER, BASELINE REAL, PEAK REAL, SCORE REAL)")) {
+            qDebug() << "Error creating table:" << query.lastError().text();
+        }
+
+        // One quantile sketch per series and minute
+        if (!query.exec("CREATE TABLE IF NOT EXISTS sketches (ID INTEGER PRIMARY KEY, PID INTEGER, PROCESS TEXT, METRIC TEXT, START_TIME INTEGER, DURATION INTEGER, COUNT INTEGER, SUM REAL, MIN REAL, MAX REAL, SKETCH BLOB)")
+            || !query.exec("CREATE INDEX IF NOT EXISTS sketches_metric_time ON sketches (METRIC, START_TIME)")) {
+            qDebug() << "Error creating table:" << query.lastError().text();
+        }
+
+        // Alerts firing and clearing, and what was captured for them
+        if (!query.exec("CREATE TABLE IF NOT EXISTS alerts (ID INTEGER PRIMARY KEY, ALERT INTEGER, KIND INTEGER, RULE TEXT, LABEL TEXT, METRIC TEXT, VALUE REAL, THRESHOLD REAL, SINCE INTEGER, TIME_STAMP INTEGER, PID INTEGER, PROCESS TEXT)")
+            || !query.exec(kCreateCapturesSql)
+            || !query.exec("CREATE INDEX IF NOT EXISTS captures_alert ON captures (ALERT, TIME_STAMP)")) {
+            qDebug() << "Error creating table:" << query.lastError().text();
+        }
+        addMissingColumns(db, "captures");
     }
 
     Database::~Database(){
+        save_query.reset();
         if(db.isValid()){
             db.close();
         }
+        if (!connection.isEmpty()) {
+            db = QSqlDatabase();
+            QSqlDatabase::removeDatabase(connection);
+        }
+    }
+
+    bool Database::Save(quint64 time_stamp, const Stats &stats){
+        TRACE_SPAN("db.save");
+
+        if (!save_query) {
+            save_query = std::make_unique<QSqlQuery>(db);
+            if (!save_query->prepare(kInsertStatsSql)) {
+                qDebug() << "Failed to prepare stats insert:" << save_query->lastError().text();
+                save_query.reset();
+                return false;
+            }
+        }
+
+        save_query->bindValue(0, time_stamp);
+        for (size_t i = 0; i < kStatsFieldCount; ++i) {
+            save_query->bindValue(static_cast<int>(i) + 1, stats.*kStatsFields[i].member);
+        }
+        if (!save_query->exec()) {
+            qDebug() << "Failed to insert stats:" << save_query->lastError().text();
+            return false;
+        }
+        return true;
+    }
+
+    bool Database::SaveRegion(const AnomalyRegion &region){
+        TRACE_SPAN("db.save_region");
+        QSqlQuery query(db);
+        query.prepare("INSERT INTO regions (PID, PROCESS, METRIC, KIND, START_TIME, END_TIME, BASELINE, PEAK, SCORE) VALUES (:PID, :PROCESS, :METRIC, :KIND, :START_TIME, :END_TIME, :BASELINE, :PEAK, :SCORE)");
+
+        query.bindValue(":PID", region.pid);
+        query.bindValue(":PROCESS", region.process);
+        query.bindValue(":METRIC", QString(kStatsFields[region.metric].name));
+        query.bindValue(":KIND", static_cast<int>(region.kind));
+        query.bindValue(":START_TIME", region.start);
+        query.bindValue(":END_TIME", region.end);
+        query.bindValue(":BASELINE", region.baseline);
+        query.bindValue(":PEAK", region.peak);
+        query.bindValue(":SCORE", region.score);
+        if (!query.exec()) {
+            qDebug() << "Failed to insert region:" << query.lastError().text();
+            return false;
+        }
+        return true;
     }
 
-    bool Database::Save(
-        quint64 time_stamp,
-        quint64 io_iops_read,
-        quint64 io_iops_write,
-        quint64 io_bytesreadpersec,
-        quint64 io_byteswritepersec,
-        quint64 io_totalbytesread,
-        quint64 io_totalbyteswrite,
-        quint64 cpu_kernpercent,
-        quint64 cpu_userpercent,
-        quint64 cpu_kerntotal,
-        quint64 cpu_usertotal,
-        quint64 proc_pagefaultcount,
-        quint64 proc_workingsetsize,
-        quint64 proc_peakworkingsetsize,
-        quint64 proc_pagefileusage,
-        quint64 proc_quotapagedpoolusage,
-        quint64 proc_quotanonpagedpoolusage,
-        quint64 proc_quotapeaknonpagedpoolusage){
-
-        QSqlQuery query;
-        query.prepare("INSERT INTO stats (TIME_STAMP , IO_IOPS_READ , IO_IOPS_WRITE , IO_BYTESREADPERSEC , IO_BYTESWRITEPERSEC , IO_TOTALBYTESREAD , IO_TOTALBYTESWRITE , CPU_KERNPERCENT , CPU_USERPERCENT , CPU_KERNTOTAL , CPU_USERTOTAL , PROC_PAGEFAULTCOUNT , PROC_WORKINGSETSIZE , PROC_PEAKWORKINGSETSIZE , PROC_PAGEFILEUSAGE , PROC_QUOTAPAGEDPOOLUSAGE , PROC_QUOTANONPAGEDPOOLUSAGE , PROC_QUOTAPEAKNONPAGEDPOOLUSAGE ) VALUES (:TIME_STAMP, :IO_IOPS_READ, :IO_IOPS_WRITE, :IO_BYTESREADPERSEC, :IO_BYTESWRITEPERSEC, :IO_TOTALBYTESREAD, :IO_TOTALBYTESWRITE, :CPU_KERNPERCENT, :CPU_USERPERCENT, :CPU_KERNTOTAL, :CPU_USERTOTAL, :PROC_PAGEFAULTCOUNT, :PROC_WORKINGSETSIZE, :PROC_PEAKWORKINGSETSIZE, :PROC_PAGEFILEUSAGE, :PROC_QUOTAPAGEDPOOLUSAGE, :PROC_QUOTANONPAGEDPOOLUSAGE, :PROC_QUOTAPEAKNONPAGEDPOOLUSAGE)");
-
-        query.bindValue(":TIME_STAMP", time_stamp);
-        query.bindValue(":IO_IOPS_READ", io_iops_read);
-        query.bindValue(":IO_IOPS_WRITE", io_iops_write);
-        query.bindValue(":IO_BYTESREADPERSEC", io_bytesreadpersec);
-        query.bindValue(":IO_BYTESWRITEPERSEC", io_byteswritepersec);
-        query.bindValue(":IO_TOTALBYTESREAD", io_totalbytesread);
-        query.bindValue(":IO_TOTALBYTESWRITE", io_totalbyteswrite);
-        query.bindValue(":CPU_KERNPERCENT", cpu_kernpercent);
-        query.bindValue(":CPU_USERPERCENT", cpu_userpercent);
-        query.bindValue(":CPU_KERNTOTAL", cpu_kerntotal);
-        query.bindValue(":CPU_USERTOTAL", cpu_usertotal);
-        query.bindValue(":PROC_PAGEFAULTCOUNT", proc_pagefaultcount);
-        query.bindValue(":PROC_WORKINGSETSIZE", proc_workingsetsize);
-        query.bindValue(":PROC_PEAKWORKINGSETSIZE", proc_peakworkingsetsize);
-        query.bindValue(":PROC_PAGEFILEUSAGE", proc_pagefileusage);
-        query.bindValue(":PROC_QUOTAPAGEDPOOLUSAGE", proc_quotapagedpoolusage);
-        query.bindValue(":PROC_QUOTANONPAGEDPOOLUSAGE", proc_quotanonpagedpoolusage);
-        query.bindValue(":PROC_QUOTAPEAKNONPAGEDPOOLUSAGE", proc_quotapeaknonpagedpoolusage);
+    std::vector<AnomalyRegion> Database::LoadRegions(int limit){
+        std::vector<AnomalyRegion> regions;
+
+        QSqlQuery query(db);
+        query.prepare("SELECT PID, PROCESS, METRIC, KIND, START_TIME, END_TIME, BASELINE, PEAK, SCORE FROM regions ORDER BY END_TIME DESC LIMIT :LIMIT");
+        query.bindValue(":LIMIT", limit);
         if (!query.exec()) {
-            qDebug() << "Failed to insert stats:" << query.lastError().text();
+            qDebug() << "Failed to load regions:" << query.lastError().text();
+            return regions;
+        }
+
+        while (query.next()) {
+            const QString metric = query.value(2).toString();
+            auto field = std::find_if(std::begin(kStatsFields), std::end(kStatsFields), [&](const StatsField &f) {
+                return metric == QLatin1String(f.name);
+            });
+            if (field == std::end(kStatsFields)) {
+                continue;
+            }
+
+            AnomalyRegion region;
+            region.pid = query.value(0).toUInt();
+            region.process = query.value(1).toString();
+            region.metric = static_cast<int>(field - std::begin(kStatsFields));
+            region.kind = query.value(3).toInt() == AnomalyRegion::Shift ? AnomalyRegion::Shift : AnomalyRegion::Spike;
+            region.start = query.value(4).toLongLong();
+            region.end = query.value(5).toLongLong();
+            region.baseline = query.value(6).toDouble();
+            region.peak = query.value(7).toDouble();
+            region.score = query.value(8).toDouble();
+            regions.push_back(region);
+        }
+        std::reverse(regions.begin(), regions.end());
+        return regions;
+    }
+
+    bool Database::SaveAlert(const AlertEvent &event){
+        TRACE_SPAN("db.save_alert");
+        QSqlQuery query(db);
+        query.prepare("INSERT INTO alerts (ALERT, KIND, RULE, LABEL, METRIC, VALUE, THRESHOLD, SINCE, TIME_STAMP, PID, PROCESS) VALUES (:ALERT, :KIND, :RULE, :LABEL, :METRIC, :VALUE, :THRESHOLD, :SINCE, :TIME_STAMP, :PID, :PROCESS)");
+
+        query.bindValue(":ALERT", event.id);
+        query.bindValue(":KIND", static_cast<int>(event.kind));
+        query.bindValue(":RULE", event.rule);
+        query.bindValue(":LABEL", event.label);
+        query.bindValue(":METRIC", QString(MetricName(event.metric)));
+        query.bindValue(":VALUE", event.value);
+        query.bindValue(":THRESHOLD", event.threshold);
+        query.bindValue(":SINCE", event.since);
+        query.bindValue(":TIME_STAMP", event.time_stamp);
+        query.bindValue(":PID", event.pid);
+        query.bindValue(":PROCESS", event.process);
+        if (!query.exec()) {
+            qDebug() << "Failed to insert alert:" << query.lastError().text();
             return false;
         }
-        qDebug() << "Data inserted.";
         return true;
     }
+
+    quint64 Database::LastAlertId(){
+        QSqlQuery query(db);
+        if (!query.exec("SELECT MAX(ALERT) FROM alerts") || !query.next()) {
+            return 0;
+        }
+        return query.value(0).toULongLong();
+    }
+
+    bool Database::SaveCapture(quint64 alert, const std::vector<StatsSample> &samples){
+        TRACE_SPAN("db.save_capture");
+        if (samples.empty()) {
+            return true;
+        }
+
+        db.transaction();
+        QSqlQuery query(db);
+        query.prepare(kInsertCaptureSql);
+        for (const StatsSample &sample : samples) {
+            query.bindValue(0, alert);
+            query.bindValue(1, sample.pid);
+            query.bindValue(2, sample.time_stamp);
+            for (size_t i = 0; i < kStatsFieldCount; ++i) {
+                query.bindValue(static_cast<int>(i) + 3, sample.stats.*kStatsFields[i].member);
+            }
+            if (!query.exec()) {
+                qDebug() << "Failed to insert capture:" << query.lastError().text();
+                db.rollback();
+                return false;
+            }
+        }
+        return db.commit();
+    }
+
+    bool Database::SaveSketches(const std::vector<SketchRecord> &records){
+        TRACE_SPAN("db.save_sketches");
+        if (records.empty()) {
+            return true;
+        }
+
+        db.transaction();
+        QSqlQuery query(db);
+        query.prepare("INSERT INTO sketches (PID, PROCESS, METRIC, START_TIME, DURATION, COUNT, SUM, MIN, MAX, SKETCH) VALUES (:PID, :PROCESS, :METRIC, :START_TIME, :DURATION, :COUNT, :SUM, :MIN, :MAX, :SKETCH)");
+        for (const SketchRecord &record : records) {
+            query.bindValue(":PID", record.pid);
+            query.bindValue(":PROCESS", record.process);
+            query.bindValue(":METRIC", record.metric);
+            query.bindValue(":START_TIME", record.start);
+            query.bindValue(":DURATION", record.duration);
+            query.bindValue(":COUNT", record.sketch.Count());
+            query.bindValue(":SUM", record.sum);
+            query.bindValue(":MIN", record.min);
+            query.bindValue(":MAX", record.max);
+            query.bindValue(":SKETCH", record.sketch.Serialize());
+            if (!query.exec()) {
+                qDebug() << "Failed to insert sketch:" << query.lastError().text();
+                db.rollback();
+                return false;
+            }
+        }
+        return db.commit();
+    }
+
+    int Database::MergeSketches(const QString &metric, const std::vector<quint32> &pids, qint64 from, qint64 to, SketchRecord &out){
+        QString sql = "SELECT PID, PROCESS, START_TIME, DURATION, SUM, MIN, MAX, SKETCH FROM sketches WHERE METRIC = :METRIC AND START_TIME BETWEEN :FROM AND :TO";
+        if (!pids.empty()) {
+            QStringList list;
+            for (quint32 pid : pids) {
+                list << QString::number(pid);
+            }
+            sql += " AND PID IN (" + list.join(',') + ")";
+        }
+
+        QSqlQuery query(db);
+        query.setForwardOnly(true);
+        query.prepare(sql);
+        query.bindValue(":METRIC", metric);
+        query.bindValue(":FROM", from);
+        query.bindValue(":TO", to);
+        if (!query.exec()) {
+            qDebug() << "Failed to load sketches:" << query.lastError().text();
+            return -1;
+        }
+
+        int merged = 0;
+        SketchRecord record;
+        while (query.next()) {
+            if (!QuantileSketch::Deserialize(query.value(7).toByteArray(), record.sketch)) {
+                continue;
+            }
+            record.pid = query.value(0).toUInt();
+            record.process = query.value(1).toString();
+            record.start = query.value(2).toLongLong();
+            record.duration = query.value(3).toLongLong();
+            record.sum = query.value(4).toDouble();
+            record.min = query.value(5).toDouble();
+            record.max = query.value(6).toDouble();
+            if (merged == 0) {
+                out.pid = record.pid;
+                out.process = record.process;
+                out.metric = metric;
+            }
+            out.Merge(record);
+            ++merged;
+        }
+        return merged;
+    }
@@ -1,36 +1,50 @@
 #ifndef PROC_DATABASE_H
 #define PROC_DATABASE_H
 
-#include "mainwindow.h"
+#include "proc_alerts.h"
+#include "proc_anomaly.h"
+#include "proc_sketch.h"
+
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QDebug>
+
+#include <memory>
 
 
 struct Database
 {
-    Database(QString path);
+    // Without a connection name the default connection is used; a second
+    // Database on another thread needs a name of its own
+    Database(QString path, const QString &connection = QString());
 
     ~Database();
 
-    bool Save(
-        quint64 time_stamp,
-        quint64 io_iops_read,
-        quint64 io_iops_write,
-        quint64 io_bytesreadpersec,
-        quint64 io_byteswritepersec,
-        quint64 io_totalbytesread,
-        quint64 io_totalbyteswrite,
-        quint64 cpu_kernpercent,
-        quint64 cpu_userpercent,
-        quint64 cpu_kerntotal,
-        quint64 cpu_usertotal,
-        quint64 proc_pagefaultcount,
-        quint64 proc_workingsetsize,
-        quint64 proc_peakworkingsetsize,
-        quint64 proc_pagefileusage,
-        quint64 proc_quotapagedpoolusage,
-        quint64 proc_quotanonpagedpoolusage,
-        quint64 proc_quotapeaknonpagedpoolusage);
+    // Stores one sample in the stats table
+    bool Save(quint64 time_stamp, const Stats &stats);
+
+    bool SaveRegion(const AnomalyRegion &region);
+    // The most recent limit regions, oldest first
+    std::vector<AnomalyRegion> LoadRegions(int limit);
+
+    bool SaveAlert(const AlertEvent &event);
+    // Highest alert id stored, 0 if none
+    quint64 LastAlertId();
+    // Stores the high-resolution samples of one alert in one transaction
+    bool SaveCapture(quint64 alert, const std::vector<StatsSample> &samples);
+
+    // Stores the records in one transaction
+    bool SaveSketches(const std::vector<SketchRecord> &records);
+    // Merges the stored sketches of metric whose bucket starts in [from, to]
+    // into out, for the given processes or all of them if pids is empty.
+    // Returns the number of sketches merged, or -1 on error.
+    int MergeSketches(const QString &metric, const std::vector<quint32> &pids, qint64 from, qint64 to, SketchRecord &out);
 
     QSqlDatabase db;
+    QString connection;
+    // Prepared on the first Save and reused for every sample after it
+    std::unique_ptr<QSqlQuery> save_query;
 };
 
 #endif // PROC_DATABASE_H
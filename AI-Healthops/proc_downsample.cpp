@@ -0,0 +1,143 @@
+#include "proc_downsample.h"
+
+#include <cmath>
+
+std::vector<size_t> DownsampleLTTB(const qint64 *times, const double *values, size_t count, size_t threshold) {
+    std::vector<size_t> indices;
+    if (count == 0) {
+        return indices;
+    }
+
+    if (threshold >= count || threshold < 3) {
+        indices.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            indices[i] = i;
+        }
+        return indices;
+    }
+
+    indices.reserve(threshold);
+
+    // Times are made relative to the first sample so the triangle areas stay
+    // well inside double precision even for epoch milliseconds.
+    const qint64 origin = times[0];
+    const double every = static_cast<double>(count - 2) / static_cast<double>(threshold - 2);
+
+    size_t a = 0;
+    indices.push_back(a);
+
+    for (size_t i = 0; i < threshold - 2; ++i) {
+        // Average of the next bucket is the third triangle vertex
+        size_t avg_start = static_cast<size_t>(std::floor((i + 1) * every)) + 1;
+        size_t avg_end = static_cast<size_t>(std::floor((i + 2) * every)) + 1;
+        if (avg_end > count) {
+            avg_end = count;
+        }
+
+        double avg_x = 0.0;
+        double avg_y = 0.0;
+        for (size_t j = avg_start; j < avg_end; ++j) {
+            avg_x += static_cast<double>(times[j] - origin);
+            avg_y += values[j];
+        }
+        const size_t avg_len = avg_end - avg_start;
+        if (avg_len > 0) {
+            avg_x /= avg_len;
+            avg_y /= avg_len;
+        }
+
+        // Current bucket
+        size_t range_start = static_cast<size_t>(std::floor(i * every)) + 1;
+        size_t range_end = static_cast<size_t>(std::floor((i + 1) * every)) + 1;
+
+        const double ax = static_cast<double>(times[a] - origin);
+        const double ay = values[a];
+
+        double max_area = -1.0;
+        size_t next_a = range_start;
+        for (size_t j = range_start; j < range_end; ++j) {
+            const double area = std::fabs((ax - avg_x) * (values[j] - ay) -
+                                          (ax - static_cast<double>(times[j] - origin)) * (avg_y - ay));
+            if (area > max_area) {
+                max_area = area;
+                next_a = j;
+            }
+        }
+
+        indices.push_back(next_a);
+        a = next_a;
+    }
+
+    indices.push_back(count - 1);
+    return indices;
+}
+
+std::vector<size_t> DownsampleMinMax(const qint64 *times, const double *values, size_t count, size_t columns) {
+    std::vector<size_t> indices;
+    if (count == 0) {
+        return indices;
+    }
+
+    if (columns == 0 || count <= columns * 2) {
+        indices.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            indices[i] = i;
+        }
+        return indices;
+    }
+
+    indices.reserve(columns * 2);
+
+    const qint64 first = times[0];
+    const double span = static_cast<double>(times[count - 1] - first) + 1.0;
+
+    size_t column_start = 0;
+    size_t current_column = 0;
+    size_t min_index = 0;
+    size_t max_index = 0;
+
+    auto flush = [&]() {
+        if (min_index == max_index) {
+            indices.push_back(min_index);
+        } else if (min_index < max_index) {
+            indices.push_back(min_index);
+            indices.push_back(max_index);
+        } else {
+            indices.push_back(max_index);
+            indices.push_back(min_index);
+        }
+    };
+
+    for (size_t i = 0; i < count; ++i) {
+        size_t column = static_cast<size_t>((times[i] - first) * static_cast<double>(columns) / span);
+        if (column >= columns) {
+            column = columns - 1;
+        }
+
+        if (i == column_start) {
+            current_column = column;
+            min_index = i;
+            max_index = i;
+            continue;
+        }
+
+        if (column != current_column) {
+            flush();
+            column_start = i;
+            current_column = column;
+            min_index = i;
+            max_index = i;
+            continue;
+        }
+
+        if (values[i] < values[min_index]) {
+            min_index = i;
+        }
+        if (values[i] > values[max_index]) {
+            max_index = i;
+        }
+    }
+    flush();
+
+    return indices;
+}
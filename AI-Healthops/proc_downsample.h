@@ -0,0 +1,20 @@
+#ifndef PROC_DOWNSAMPLE_H
+#define PROC_DOWNSAMPLE_H
+
+#include <QtGlobal>
+
+#include <vector>
+#include <cstddef>
+
+// Level-of-detail reduction for long series. Both functions return indices
+// into the input (ascending), so the caller decides how points are built.
+
+// Largest-Triangle-Three-Buckets: keeps the first and last point and picks
+// the visually most significant point from each of threshold - 2 buckets.
+std::vector<size_t> DownsampleLTTB(const qint64 *times, const double *values, size_t count, size_t threshold);
+
+// Min/max envelope: splits the time range into columns and keeps the lowest
+// and highest sample of every column, so no spike can disappear.
+std::vector<size_t> DownsampleMinMax(const qint64 *times, const double *values, size_t count, size_t columns);
+
+#endif // PROC_DOWNSAMPLE_H
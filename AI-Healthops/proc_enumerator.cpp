@@ -0,0 +1,89 @@
+#include "proc_enumerator.h"
+#include "proc_trace.h"
+
+ProcessEnumerator::ProcessEnumerator(Callback on_snapshot, int workers, quint64 affinity) : on_snapshot_(std::move(on_snapshot)) {
+    if (workers <= 0) {
+        workers = WorkStealingPool::DefaultWorkers();
+    }
+    // A single worker is the enumerator thread alone
+    if (workers > 1) {
+        pool_ = std::make_unique<WorkStealingPool>(workers - 1, affinity);
+    }
+    thread_ = std::thread([this]() { Run(); });
+}
+
+ProcessEnumerator::~ProcessEnumerator() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cancel_ = true;
+    cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void ProcessEnumerator::Request() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (running_ && !running_restart_) {
+            cancel_ = true;
+        }
+        pending_ = true;
+    }
+    cv_.notify_one();
+}
+
+std::shared_ptr<const ProcessSnapshot> ProcessEnumerator::Latest() const {
+    return std::atomic_load(&latest_);
+}
+
+void ProcessEnumerator::Run() {
+    TRACE_THREAD("enumerator");
+    static const ProcessSnapshot empty;
+    std::shared_ptr<const ProcessSnapshot> previous;
+    std::shared_ptr<ProcessSnapshot> spare;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]() { return stop_ || pending_; });
+            if (stop_) {
+                break;
+            }
+            pending_ = false;
+            // A run that starts because the previous one was cancelled is
+            // not cancelled again
+            running_restart_ = cancel_.exchange(false);
+            running_ = true;
+        }
+
+        std::shared_ptr<ProcessSnapshot> next = spare ? std::move(spare) : std::make_shared<ProcessSnapshot>();
+        const bool complete = TakeProcessSnapshot(previous ? *previous : empty, *next, &cancel_, pool_.get(), &metrics_);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = false;
+        }
+
+        if (!complete) {
+            ++cancelled_count_;
+            spare = std::move(next);
+            continue;
+        }
+
+        std::shared_ptr<const ProcessSnapshot> published = std::move(next);
+        std::atomic_store(&latest_, published);
+
+        // Once nobody else holds the old snapshot its buffers are reused
+        if (previous && previous.use_count() == 1) {
+            spare = std::const_pointer_cast<ProcessSnapshot>(previous);
+        }
+        previous = published;
+
+        if (on_snapshot_) {
+            on_snapshot_(published);
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef PROC_ENUMERATOR_H
+#define PROC_ENUMERATOR_H
+
+#include "proc_snapshot.h"
+#include "proc_pool.h"
+#include "proc_stats.h"
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Enumerates processes on a worker thread. Each finished enumeration is an
+// immutable snapshot published by swapping a shared pointer; readers keep
+// whichever snapshot they loaded for as long as they need it.
+struct ProcessEnumerator
+{
+    using Callback = std::function<void(std::shared_ptr<const ProcessSnapshot>)>;
+
+    // on_snapshot runs on the worker thread after every published snapshot.
+    // The per-process queries of a sweep are spread over workers threads
+    // (the worker thread included; 0 picks WorkStealingPool::DefaultWorkers()),
+    // pinned to the CPUs of affinity if it is not 0.
+    explicit ProcessEnumerator(Callback on_snapshot, int workers = 0, quint64 affinity = 0);
+    ~ProcessEnumerator();
+
+    // Asks for a fresh snapshot. A refresh that is still running is
+    // cancelled and restarted, unless it is itself such a restart, so a slow
+    // host still gets a result every other request.
+    void Request();
+
+    // Metric groups queried per process, all of them by default. Set it
+    // before the first Request.
+    void SetMetrics(const MetricSelection &metrics) { metrics_ = metrics; }
+
+    std::shared_ptr<const ProcessSnapshot> Latest() const;
+    quint64 CancelledCount() const { return cancelled_count_; }
+
+private:
+    void Run();
+
+    Callback on_snapshot_;
+    std::unique_ptr<WorkStealingPool> pool_;
+    MetricSelection metrics_;
+    std::shared_ptr<const ProcessSnapshot> latest_;
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    bool pending_ = false;
+    bool running_ = false;
+    bool running_restart_ = false;
+    std::atomic<bool> cancel_{false};
+    std::atomic<quint64> cancelled_count_{0};
+};
+
+#endif // PROC_ENUMERATOR_H
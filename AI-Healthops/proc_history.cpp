@@ -0,0 +1,99 @@
+#include "proc_history.h"
+#include "proc_downsample.h"
+
+#include <algorithm>
+
+// Above this many samples per horizontal pixel LTTB starts hiding short
+// spikes, so the chart switches to the min/max envelope instead.
+static const size_t kMinMaxDensity = 64;
+
+SeriesHistory::SeriesHistory(size_t capacity) : capacity_(capacity) {
+    times_.reserve(capacity_);
+    values_.reserve(capacity_);
+}
+
+void SeriesHistory::Append(qint64 time_stamp, double value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Trim in chunks once the buffer holds twice the capacity so the cost of
+    // dropping old samples stays amortized O(1) per append.
+    if (times_.size() >= capacity_ * 2) {
+        const size_t excess = times_.size() - capacity_;
+        times_.erase(times_.begin(), times_.begin() + excess);
+        values_.erase(values_.begin(), values_.begin() + excess);
+    }
+
+    times_.push_back(time_stamp);
+    values_.push_back(value);
+}
+
+QList<QPointF> SeriesHistory::Points(qint64 from, qint64 to, int max_points) const {
+    QList<QPointF> points;
+
+    // Only the range is copied under the lock; the downsampling runs on the
+    // copy so Append() on the stats thread never waits for it
+    std::vector<qint64> times;
+    std::vector<double> values;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto begin = std::lower_bound(times_.begin(), times_.end(), from);
+        auto end = std::upper_bound(begin, times_.end(), to);
+
+        // Include one sample on either side so the line reaches the plot edges
+        if (begin != times_.begin()) {
+            --begin;
+        }
+        if (end != times_.end()) {
+            ++end;
+        }
+
+        const size_t offset = static_cast<size_t>(begin - times_.begin());
+        times.assign(begin, end);
+        values.assign(values_.begin() + static_cast<std::ptrdiff_t>(offset),
+                      values_.begin() + static_cast<std::ptrdiff_t>(offset + times.size()));
+    }
+
+    const size_t count = times.size();
+    if (count == 0) {
+        return points;
+    }
+
+    const qint64 *t = times.data();
+    const double *v = values.data();
+    const size_t columns = static_cast<size_t>(std::max(max_points, 3));
+
+    std::vector<size_t> indices;
+    if (count > columns * kMinMaxDensity) {
+        indices = DownsampleMinMax(t, v, count, columns / 2);
+    } else {
+        indices = DownsampleLTTB(t, v, count, columns);
+    }
+
+    points.reserve(static_cast<qsizetype>(indices.size()));
+    for (size_t index : indices) {
+        points.append(QPointF(static_cast<qreal>(t[index]), v[index]));
+    }
+    return points;
+}
+
+void SeriesHistory::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    times_.clear();
+    values_.clear();
+}
+
+bool SeriesHistory::Empty() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return times_.empty();
+}
+
+qint64 SeriesHistory::FirstTime() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return times_.empty() ? 0 : times_.front();
+}
+
+qint64 SeriesHistory::LastTime() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return times_.empty() ? 0 : times_.back();
+}
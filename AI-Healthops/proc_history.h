@@ -0,0 +1,37 @@
+#ifndef PROC_HISTORY_H
+#define PROC_HISTORY_H
+
+#include <QtGlobal>
+#include <QList>
+#include <QPointF>
+
+#include <vector>
+#include <mutex>
+
+// In-memory time series kept for the charts. Samples are appended by the
+// stats thread and read by the GUI, so every access takes the lock. Storage
+// is struct-of-arrays so range lookups and downsampling walk flat buffers.
+struct SeriesHistory
+{
+    // Default capacity holds a week of 1 s samples
+    explicit SeriesHistory(size_t capacity = 7 * 24 * 3600);
+
+    void Append(qint64 time_stamp, double value);
+    void Clear();
+
+    // Returns at most about max_points points covering [from, to], reduced
+    // with LTTB or a min/max envelope when the range is denser than that.
+    // The lock is held only while the range is copied.
+    QList<QPointF> Points(qint64 from, qint64 to, int max_points) const;
+
+    bool Empty() const;
+    qint64 FirstTime() const;
+    qint64 LastTime() const;
+
+    size_t capacity_;
+    mutable std::mutex mutex_;
+    std::vector<qint64> times_;
+    std::vector<double> values_;
+};
+
+#endif // PROC_HISTORY_H
@@ -0,0 +1,236 @@
+#include "proc_kernels.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define HEALTHOPS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC accepts AVX2 intrinsics in any function; GCC and Clang (MinGW) only
+// in functions compiled for that target
+#if defined(__GNUC__) || defined(__clang__)
+#define HEALTHOPS_AVX2 __attribute__((target("avx2")))
+#else
+#define HEALTHOPS_AVX2
+#endif
+
+static quint64 histogramBin(quint64 value, quint64 low, int shift, size_t bin_count) {
+    const quint64 bin = value < low ? 0 : (value - low) >> shift;
+    return std::min<quint64>(bin, bin_count - 1);
+}
+
+// --- Scalar -----------------------------------------------------------------
+
+static quint64 scalarSum(const quint64 *values, size_t count) {
+    quint64 sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+        sum += values[i];
+    }
+    return sum;
+}
+
+static void scalarMinMax(const quint64 *values, size_t count, quint64 &min, quint64 &max) {
+    if (count == 0) {
+        return;
+    }
+    quint64 low = values[0];
+    quint64 high = values[0];
+    for (size_t i = 1; i < count; ++i) {
+        low = std::min(low, values[i]);
+        high = std::max(high, values[i]);
+    }
+    min = low;
+    max = high;
+}
+
+static size_t scalarCountAbove(const quint64 *values, size_t count, quint64 threshold) {
+    size_t above = 0;
+    for (size_t i = 0; i < count; ++i) {
+        above += values[i] > threshold;
+    }
+    return above;
+}
+
+static void scalarDeltas(const quint64 *values, size_t count, qint64 *out) {
+    for (size_t i = 0; i + 1 < count; ++i) {
+        out[i] = static_cast<qint64>(values[i + 1] - values[i]);
+    }
+}
+
+static void scalarHistogram(const quint64 *values, size_t count, quint64 low, int shift, quint64 *bins, size_t bin_count) {
+    if (bin_count == 0) {
+        return;
+    }
+    shift = std::clamp(shift, 0, 63);
+    for (size_t i = 0; i < count; ++i) {
+        ++bins[histogramBin(values[i], low, shift, bin_count)];
+    }
+}
+
+// --- AVX2 -------------------------------------------------------------------
+
+#ifdef HEALTHOPS_X86
+
+// AVX2 only compares signed 64-bit lanes; flipping the sign bit turns an
+// unsigned comparison into a signed one
+HEALTHOPS_AVX2 static inline __m256i flipSign(__m256i x) {
+    return _mm256_xor_si256(x, _mm256_set1_epi64x(static_cast<long long>(0x8000000000000000ULL)));
+}
+
+HEALTHOPS_AVX2 static inline quint64 horizontalSum(__m256i x) {
+    alignas(32) quint64 lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), x);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+HEALTHOPS_AVX2 static quint64 avx2Sum(const quint64 *values, size_t count) {
+    // Two accumulators keep two additions in flight
+    __m256i a = _mm256_setzero_si256();
+    __m256i b = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        a = _mm256_add_epi64(a, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i)));
+        b = _mm256_add_epi64(b, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i + 4)));
+    }
+    quint64 sum = horizontalSum(_mm256_add_epi64(a, b));
+    for (; i < count; ++i) {
+        sum += values[i];
+    }
+    return sum;
+}
+
+HEALTHOPS_AVX2 static void avx2MinMax(const quint64 *values, size_t count, quint64 &min, quint64 &max) {
+    if (count < 4) {
+        scalarMinMax(values, count, min, max);
+        return;
+    }
+
+    // Lanes hold sign-flipped values throughout
+    __m256i low = flipSign(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(values)));
+    __m256i high = low;
+    size_t i = 4;
+    for (; i + 4 <= count; i += 4) {
+        const __m256i x = flipSign(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i)));
+        low = _mm256_blendv_epi8(low, x, _mm256_cmpgt_epi64(low, x));
+        high = _mm256_blendv_epi8(high, x, _mm256_cmpgt_epi64(x, high));
+    }
+
+    alignas(32) quint64 lows[4];
+    alignas(32) quint64 highs[4];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lows), flipSign(low));
+    _mm256_store_si256(reinterpret_cast<__m256i *>(highs), flipSign(high));
+    quint64 result_min = std::min(std::min(lows[0], lows[1]), std::min(lows[2], lows[3]));
+    quint64 result_max = std::max(std::max(highs[0], highs[1]), std::max(highs[2], highs[3]));
+    for (; i < count; ++i) {
+        result_min = std::min(result_min, values[i]);
+        result_max = std::max(result_max, values[i]);
+    }
+    min = result_min;
+    max = result_max;
+}
+
+HEALTHOPS_AVX2 static size_t avx2CountAbove(const quint64 *values, size_t count, quint64 threshold) {
+    const __m256i limit = flipSign(_mm256_set1_epi64x(static_cast<long long>(threshold)));
+    // A true comparison is -1 in its lane, so subtracting the mask counts it
+    __m256i above = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m256i x = flipSign(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i)));
+        above = _mm256_sub_epi64(above, _mm256_cmpgt_epi64(x, limit));
+    }
+    size_t result = static_cast<size_t>(horizontalSum(above));
+    for (; i < count; ++i) {
+        result += values[i] > threshold;
+    }
+    return result;
+}
+
+HEALTHOPS_AVX2 static void avx2Deltas(const quint64 *values, size_t count, qint64 *out) {
+    size_t i = 0;
+    for (; i + 5 <= count; i += 4) {
+        const __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i));
+        const __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i + 1));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_sub_epi64(next, current));
+    }
+    for (; i + 1 < count; ++i) {
+        out[i] = static_cast<qint64>(values[i + 1] - values[i]);
+    }
+}
+
+HEALTHOPS_AVX2 static void avx2Histogram(const quint64 *values, size_t count, quint64 low, int shift, quint64 *bins, size_t bin_count) {
+    if (bin_count == 0) {
+        return;
+    }
+    shift = std::clamp(shift, 0, 63);
+
+    // The bin numbers are computed four at a time; AVX2 has no scatter, so
+    // the increments stay scalar
+    const __m256i base = _mm256_set1_epi64x(static_cast<long long>(low));
+    const __m256i base_flipped = flipSign(base);
+    const __m256i last = _mm256_set1_epi64x(static_cast<long long>(bin_count - 1));
+    const __m256i last_flipped = flipSign(last);
+    const __m128i count_shift = _mm_cvtsi32_si128(shift);
+    alignas(32) quint64 index[4];
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i));
+        const __m256i below = _mm256_cmpgt_epi64(base_flipped, flipSign(x));
+        __m256i bin = _mm256_srl_epi64(_mm256_andnot_si256(below, _mm256_sub_epi64(x, base)), count_shift);
+        bin = _mm256_blendv_epi8(bin, last, _mm256_cmpgt_epi64(flipSign(bin), last_flipped));
+        _mm256_store_si256(reinterpret_cast<__m256i *>(index), bin);
+        ++bins[index[0]];
+        ++bins[index[1]];
+        ++bins[index[2]];
+        ++bins[index[3]];
+    }
+    for (; i < count; ++i) {
+        ++bins[histogramBin(values[i], low, shift, bin_count)];
+    }
+}
+
+static bool cpuHasAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    const bool os_saves_ymm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+    __cpuidex(info, 7, 0);
+    return os_saves_ymm && (info[1] & (1 << 5));
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // HEALTHOPS_X86
+
+const ColumnKernels &ScalarKernels() {
+    static const ColumnKernels kernels = {
+        "scalar", scalarSum, scalarMinMax, scalarCountAbove, scalarDeltas, scalarHistogram,
+    };
+    return kernels;
+}
+
+const ColumnKernels *Avx2Kernels() {
+#ifdef HEALTHOPS_X86
+    static const ColumnKernels kernels = {
+        "avx2", avx2Sum, avx2MinMax, avx2CountAbove, avx2Deltas, avx2Histogram,
+    };
+    static const bool supported = cpuHasAvx2();
+    return supported ? &kernels : nullptr;
+#else
+    return nullptr;
+#endif
+}
+
+const ColumnKernels &Kernels() {
+    static const ColumnKernels &best = Avx2Kernels() ? *Avx2Kernels() : ScalarKernels();
+    return best;
+}
@@ -0,0 +1,32 @@
+#ifndef PROC_KERNELS_H
+#define PROC_KERNELS_H
+
+#include <QtGlobal>
+
+#include <cstddef>
+
+// Aggregation kernels over a column of quint64 samples. There is a scalar
+// set and, on x86 CPUs that support it, an AVX2 set that handles four
+// samples per instruction; Kernels() picks the best one at runtime, so the
+// binary does not need to be built for AVX2.
+struct ColumnKernels
+{
+    const char *name;
+
+    quint64 (*sum)(const quint64 *values, size_t count);
+    // min and max are left alone when count is 0
+    void (*min_max)(const quint64 *values, size_t count, quint64 &min, quint64 &max);
+    size_t (*count_above)(const quint64 *values, size_t count, quint64 threshold);
+    // out[i] = values[i + 1] - values[i] for the count - 1 pairs
+    void (*deltas)(const quint64 *values, size_t count, qint64 *out);
+    // Adds every value to bins of width 2^shift starting at low. Values
+    // below low count in the first bin, values past the end in the last.
+    void (*histogram)(const quint64 *values, size_t count, quint64 low, int shift, quint64 *bins, size_t bin_count);
+};
+
+const ColumnKernels &ScalarKernels();
+// nullptr when the CPU or the compiler does not support AVX2
+const ColumnKernels *Avx2Kernels();
+const ColumnKernels &Kernels();
+
+#endif // PROC_KERNELS_H
@@ -0,0 +1,145 @@
+#include "proc_pool.h"
+#include "proc_trace.h"
+
+#include <algorithm>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
+WorkStealingPool::WorkStealingPool(int workers, quint64 affinity) {
+    workers = std::max(workers, 0);
+    for (int i = 0; i <= workers; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+
+    // CPUs of the mask, in order
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < 64; ++cpu) {
+        if (affinity >> cpu & 1) {
+            cpus.push_back(cpu);
+        }
+    }
+
+    threads_.reserve(static_cast<size_t>(workers));
+    for (int i = 0; i < workers; ++i) {
+        const int cpu = cpus.empty() ? -1 : cpus[static_cast<size_t>(i) % cpus.size()];
+        threads_.emplace_back([this, i, cpu]() {
+#ifdef Q_OS_WIN
+            if (cpu >= 0) {
+                SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu);
+            }
+#else
+            Q_UNUSED(cpu);
+#endif
+            TRACE_THREAD("pool worker");
+            Run(static_cast<size_t>(i));
+        });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread &thread : threads_) {
+        thread.join();
+    }
+}
+
+int WorkStealingPool::DefaultWorkers() {
+    const int hardware = static_cast<int>(std::thread::hardware_concurrency());
+    return std::clamp(hardware / 2, 1, 8);
+}
+
+bool WorkStealingPool::Take(size_t self, Chunk &chunk) {
+    {
+        Queue &own = *queues_[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.chunks.empty()) {
+            chunk = own.chunks.front();
+            own.chunks.pop_front();
+            return true;
+        }
+    }
+    for (size_t k = 1; k < queues_.size(); ++k) {
+        Queue &victim = *queues_[(self + k) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.chunks.empty()) {
+            chunk = victim.chunks.back();
+            victim.chunks.pop_back();
+            ++stolen_;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::Finish() {
+    if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        // Under the lock, so the caller cannot miss the notification
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_.notify_all();
+    }
+}
+
+void WorkStealingPool::Run(size_t self) {
+    quint64 seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&]() { return stop_ || generation_ != seen; });
+            if (stop_) {
+                return;
+            }
+            seen = generation_;
+        }
+        // Each chunk carries its own body, so a worker waking up late can
+        // never run one sweep's chunks with another's body
+        Chunk chunk;
+        while (Take(self, chunk)) {
+            (*chunk.body)(chunk.begin, chunk.end);
+            Finish();
+        }
+    }
+}
+
+void WorkStealingPool::ParallelFor(size_t count, size_t grain, const Body &body) {
+    if (count == 0) {
+        return;
+    }
+    grain = std::max<size_t>(grain, 1);
+    const size_t chunks = (count + grain - 1) / grain;
+    if (threads_.empty() || chunks == 1) {
+        for (size_t begin = 0; begin < count; begin += grain) {
+            body(begin, std::min(begin + grain, count));
+        }
+        return;
+    }
+
+    // Contiguous blocks keep neighbouring items on one thread unless stolen
+    remaining_ = chunks;
+    const size_t queues = queues_.size();
+    for (size_t q = 0; q < queues; ++q) {
+        Queue &queue = *queues_[q];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        for (size_t c = q * chunks / queues; c < (q + 1) * chunks / queues; ++c) {
+            queue.chunks.push_back({c * grain, std::min((c + 1) * grain, count), &body});
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++generation_;
+    }
+    wake_.notify_all();
+
+    Chunk chunk;
+    while (Take(queues - 1, chunk)) {
+        (*chunk.body)(chunk.begin, chunk.end);
+        Finish();
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]() { return remaining_.load(std::memory_order_acquire) == 0; });
+}
@@ -0,0 +1,72 @@
+#ifndef PROC_POOL_H
+#define PROC_POOL_H
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data-parallel sweeps. ParallelFor() cuts
+// a range into chunks and deals them out in contiguous blocks, one deque
+// per worker plus one for the calling thread, which works along. Everyone
+// takes from the front of its own deque and, once that is empty, steals
+// from the back of the others', so a block full of slow items (e.g.
+// processes whose handles take long to open) is spread out as it runs.
+struct WorkStealingPool
+{
+    using Body = std::function<void(size_t begin, size_t end)>;
+
+    // workers threads besides the caller. With a non-zero affinity mask
+    // every worker is pinned to one CPU of the mask, taking them in turn.
+    explicit WorkStealingPool(int workers, quint64 affinity = 0);
+    ~WorkStealingPool();
+
+    // Runs body over [0, count) in chunks of at most grain items and returns
+    // once every chunk is done. Bodies of different chunks run
+    // concurrently, so each must only write what belongs to its items. One
+    // caller at a time.
+    void ParallelFor(size_t count, size_t grain, const Body &body);
+
+    int WorkerCount() const { return static_cast<int>(threads_.size()); }
+    // Chunks taken from another thread's deque, over the pool's lifetime
+    quint64 StolenCount() const { return stolen_; }
+
+    // Worker count used when none is configured: half the hardware
+    // threads, at most 8, as the sweeps mostly wait in system calls
+    static int DefaultWorkers();
+
+private:
+    struct Chunk {
+        size_t begin;
+        size_t end;
+        const Body *body;
+    };
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Chunk> chunks;
+    };
+
+    bool Take(size_t self, Chunk &chunk);
+    void Run(size_t self);
+    void Finish();
+
+    std::vector<std::unique_ptr<Queue>> queues_;   // the caller's one is last
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    quint64 generation_ = 0;
+    bool stop_ = false;
+
+    std::atomic<size_t> remaining_{0};
+    std::atomic<quint64> stolen_{0};
+};
+
+#endif // PROC_POOL_H
@@ -0,0 +1,340 @@
+#include "proc_push.h"
+
+#include <QJsonDocument>
+#include <QTcpSocket>
+#include <QThread>
+#include <QTimer>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+
+// Samples per Batch frame
+static const size_t kBatchSamples = 1024;
+
+// How often queued samples are sent when no batch fills up
+static const int kFlushMs = 250;
+
+// Bytes the socket may hold before the queue is left to grow instead
+static const qint64 kMaxBuffered = 4 << 20;
+
+// Reconnect delays double from the first to the last
+static const int kFirstBackoffMs = 500;
+static const int kMaxBackoffMs = 30000;
+
+// zlib level of batches: most of the gain at a fraction of the cost
+static const int kCompressionLevel = 1;
+
+static const qsizetype kFrameHeader = 4 + 1;
+static const qsizetype kRecordFixed = 8 + 4 + 2 + 8 * static_cast<qsizetype>(kStatsFieldCount);
+
+// Process names are image paths, which MAX_PATH bounds; longer ones are cut
+static const qsizetype kMaxNameChars = 260;
+static const qsizetype kMaxNameBytes = 3 * kMaxNameChars;
+
+// Largest Batch a collector sends, uncompressed: a full batch with every
+// process name at its longest, under 1 MB
+static const quint32 kMaxBatchBytes = 4 + static_cast<quint32>(kBatchSamples * (kRecordFixed + kMaxNameBytes));
+
+template <typename T>
+static char *put(char *out, T value) {
+    qToLittleEndian(value, out);
+    return out + sizeof(T);
+}
+
+template <typename T>
+static const char *get(const char *in, T &value) {
+    value = qFromLittleEndian<T>(in);
+    return in + sizeof(T);
+}
+
+static void appendFrame(quint8 type, QByteArrayView payload, QByteArray &out) {
+    const qsizetype start = out.size();
+    out.resize(start + kFrameHeader + payload.size());
+    char *p = out.data() + start;
+    p = put(p, static_cast<quint32>(payload.size() + 1));
+    p = put(p, type);
+    if (!payload.isEmpty()) {
+        std::memcpy(p, payload.data(), static_cast<size_t>(payload.size()));
+    }
+}
+
+void EncodeHello(const QString &host, QByteArray &out) {
+    const QByteArray name = host.toUtf8();
+    QByteArray payload(4 + name.size(), Qt::Uninitialized);
+    char *p = put(payload.data(), static_cast<quint32>(kStatsFieldCount));
+    std::memcpy(p, name.constData(), static_cast<size_t>(name.size()));
+    appendFrame(PushHello, payload, out);
+}
+
+bool DecodeHello(QByteArrayView payload, QString &host) {
+    if (payload.size() < 4) {
+        return false;
+    }
+    quint32 fields;
+    const char *p = get(payload.data(), fields);
+    if (fields != kStatsFieldCount) {
+        return false;
+    }
+    host = QString::fromUtf8(p, payload.size() - 4);
+    return !host.isEmpty();
+}
+
+void EncodeBatch(const std::vector<StatsSample> &samples, size_t begin, size_t end, QByteArray &out) {
+    // Every record of a collector names the same few processes, which
+    // compression takes care of
+    std::vector<QByteArray> names;
+    names.reserve(end - begin);
+    qsizetype size = 4;
+    for (size_t i = begin; i < end; ++i) {
+        const QString &process = samples[i].process;
+        qsizetype length = std::min(process.size(), kMaxNameChars);
+        if (length < process.size() && process.at(length - 1).isHighSurrogate()) {
+            --length;
+        }
+        names.push_back(process.left(length).toUtf8());
+        size += kRecordFixed + names.back().size();
+    }
+
+    QByteArray raw(size, Qt::Uninitialized);
+    char *p = put(raw.data(), static_cast<quint32>(end - begin));
+    for (size_t i = begin; i < end; ++i) {
+        const StatsSample &sample = samples[i];
+        const QByteArray &name = names[i - begin];
+        p = put(p, sample.time_stamp);
+        p = put(p, sample.pid);
+        p = put(p, static_cast<quint16>(name.size()));
+        std::memcpy(p, name.constData(), static_cast<size_t>(name.size()));
+        p += name.size();
+        for (size_t f = 0; f < kStatsFieldCount; ++f) {
+            p = put(p, sample.stats.*kStatsFields[f].member);
+        }
+    }
+    appendFrame(PushBatch, qCompress(raw, kCompressionLevel), out);
+}
+
+bool DecodeBatch(QByteArrayView payload, std::vector<StatsSample> &out) {
+    // qCompress() leads with the uncompressed size, big-endian. It is
+    // checked before qUncompress() allocates that much for any peer.
+    if (payload.size() < 4) {
+        return false;
+    }
+    const quint32 size = qFromBigEndian<quint32>(payload.data());
+    if (size < 4 || size > kMaxBatchBytes) {
+        return false;
+    }
+    const QByteArray raw = qUncompress(reinterpret_cast<const uchar *>(payload.data()), payload.size());
+    if (raw.size() != static_cast<qsizetype>(size)) {
+        return false;
+    }
+    const char *p = raw.constData();
+    const char *end = p + raw.size();
+    quint32 count;
+    p = get(p, count);
+    if (count > kBatchSamples || static_cast<qsizetype>(count) > (raw.size() - 4) / kRecordFixed) {
+        return false;
+    }
+
+    out.reserve(out.size() + count);
+    for (quint32 n = 0; n < count; ++n) {
+        if (end - p < kRecordFixed) {
+            return false;
+        }
+        StatsSample sample;
+        quint16 length;
+        p = get(p, sample.time_stamp);
+        p = get(p, sample.pid);
+        p = get(p, length);
+        if (length > kMaxNameBytes || end - p < length + 8 * static_cast<qsizetype>(kStatsFieldCount)) {
+            return false;
+        }
+        sample.process = QString::fromUtf8(p, length);
+        p += length;
+        for (size_t f = 0; f < kStatsFieldCount; ++f) {
+            p = get(p, sample.stats.*kStatsFields[f].member);
+        }
+        out.push_back(std::move(sample));
+    }
+    return p == end;
+}
+
+void EncodeJsonFrame(quint8 type, const QJsonObject &json, QByteArray &out) {
+    appendFrame(type, QJsonDocument(json).toJson(QJsonDocument::Compact), out);
+}
+
+bool DecodeJsonFrame(QByteArrayView payload, QJsonObject &json) {
+    const QJsonDocument document = QJsonDocument::fromJson(payload.toByteArray());
+    if (!document.isObject()) {
+        return false;
+    }
+    json = document.object();
+    return true;
+}
+
+StatsPushClient::StatsPushClient(size_t capacity) : capacity_(std::max(capacity, kBatchSamples * 2)) {
+}
+
+StatsPushClient::~StatsPushClient() {
+    Stop();
+}
+
+void StatsPushClient::Start(const QString &address, quint16 port, const QString &host_name) {
+    if (thread_) {
+        return;
+    }
+    address_ = address;
+    port_ = port;
+    host_name_ = host_name;
+    backoff_ms_ = kFirstBackoffMs;
+    thread_ = std::make_unique<QThread>();
+    thread_->setObjectName("StatsPushClient");
+    context_ = new QObject;
+    context_->moveToThread(thread_.get());
+    thread_->start();
+
+    QMetaObject::invokeMethod(context_, [this]() {
+        socket_ = new QTcpSocket(context_);
+        flush_timer_ = new QTimer(context_);
+        reconnect_timer_ = new QTimer(context_);
+        reconnect_timer_->setSingleShot(true);
+
+        QObject::connect(socket_, &QTcpSocket::connected, context_, [this]() {
+            socket_->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+            connected_ = true;
+            backoff_ms_ = kFirstBackoffMs;
+            DropInFlight();
+            frame_.clear();
+            EncodeHello(host_name_, frame_);
+            socket_->write(frame_);
+            queued_bytes_ += frame_.size();
+            Flush();
+        });
+        QObject::connect(socket_, &QTcpSocket::bytesWritten, context_, [this](qint64 bytes) {
+            Written(bytes);
+            Flush();
+        });
+        // A failed attempt only reports an error, a lost connection also
+        // disconnects; either way the next attempt waits out the backoff
+        auto retry = [this]() {
+            connected_ = false;
+            DropInFlight();
+            if (!reconnect_timer_->isActive()) {
+                reconnect_timer_->start(backoff_ms_);
+                backoff_ms_ = std::min(backoff_ms_ * 2, kMaxBackoffMs);
+            }
+        };
+        QObject::connect(socket_, &QTcpSocket::disconnected, context_, retry);
+        QObject::connect(socket_, &QTcpSocket::errorOccurred, context_, retry);
+        QObject::connect(reconnect_timer_, &QTimer::timeout, context_, [this]() { Connect(); });
+        QObject::connect(flush_timer_, &QTimer::timeout, context_, [this]() { Flush(); });
+        flush_timer_->start(kFlushMs);
+        Connect();
+    }, Qt::BlockingQueuedConnection);
+
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    running_ = true;
+}
+
+void StatsPushClient::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        running_ = false;
+    }
+    if (!thread_) {
+        return;
+    }
+    QMetaObject::invokeMethod(context_, [this]() {
+        // Whatever is queued still goes out if the aggregator is there
+        Flush();
+        if (connected_) {
+            socket_->disconnectFromHost();
+            if (socket_->state() != QAbstractSocket::UnconnectedState) {
+                socket_->waitForDisconnected(1000);
+            }
+        }
+        QObject::disconnect(socket_, nullptr, context_, nullptr);
+        DropInFlight();
+        delete socket_;
+        socket_ = nullptr;
+        delete flush_timer_;
+        flush_timer_ = nullptr;
+        delete reconnect_timer_;
+        reconnect_timer_ = nullptr;
+    }, Qt::BlockingQueuedConnection);
+    thread_->quit();
+    thread_->wait();
+    delete context_;
+    context_ = nullptr;
+    thread_.reset();
+    connected_ = false;
+    flush_queued_ = false;
+
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    queue_.clear();
+}
+
+void StatsPushClient::Publish(const StatsSample &sample) {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    if (!running_) {
+        return;
+    }
+    if (queue_.size() >= capacity_) {
+        // Oldest first, a batch at a time so the erase stays cheap
+        queue_.erase(queue_.begin(), queue_.begin() + kBatchSamples);
+        dropped_count_ += kBatchSamples;
+    }
+    queue_.push_back(sample);
+
+    if (queue_.size() >= kBatchSamples && !flush_queued_.exchange(true)) {
+        QMetaObject::invokeMethod(context_, [this]() {
+            flush_queued_ = false;
+            Flush();
+        }, Qt::QueuedConnection);
+    }
+}
+
+void StatsPushClient::Connect() {
+    if (socket_->state() != QAbstractSocket::UnconnectedState) {
+        socket_->abort();
+    }
+    socket_->connectToHost(address_, port_);
+}
+
+void StatsPushClient::Flush() {
+    if (!connected_ || socket_->bytesToWrite() >= kMaxBuffered) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        sending_.swap(queue_);
+    }
+    if (sending_.empty()) {
+        return;
+    }
+    frame_.clear();
+    for (size_t begin = 0; begin < sending_.size(); begin += kBatchSamples) {
+        EncodeBatch(sending_, begin, std::min(begin + kBatchSamples, sending_.size()), frame_);
+    }
+    socket_->write(frame_);
+    queued_bytes_ += frame_.size();
+    in_flight_.emplace_back(queued_bytes_, sending_.size());
+    sending_.clear();
+}
+
+void StatsPushClient::Written(qint64 bytes) {
+    written_bytes_ += bytes;
+    while (!in_flight_.empty() && in_flight_.front().first <= written_bytes_) {
+        sent_count_ += in_flight_.front().second;
+        in_flight_.pop_front();
+    }
+}
+
+void StatsPushClient::DropInFlight() {
+    // Whatever the socket still buffered went down with the connection
+    for (const auto &batch : in_flight_) {
+        dropped_count_ += batch.second;
+    }
+    in_flight_.clear();
+    queued_bytes_ = 0;
+    written_bytes_ = 0;
+}
@@ -0,0 +1,114 @@
+#ifndef PROC_PUSH_H
+#define PROC_PUSH_H
+
+#include "proc_stats.h"
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QJsonObject>
+#include <QString>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class QObject;
+class QThread;
+class QTcpSocket;
+class QTimer;
+
+// Wire format between collectors and a fleet aggregator over TCP, framed
+// like the live stats stream (see NextStreamFrame): a quint32 length of
+// what follows, a quint8 type and the payload, all little-endian.
+//   Hello (collector):   quint32 kStatsFieldCount, then the host name in UTF-8
+//   Batch (collector):   qCompress() of quint32 record count, then per
+//                        record qint64 time_stamp, quint32 pid, quint16
+//                        length and UTF-8 bytes of the process name (at
+//                        most 260 UTF-16 units), and one quint64 per
+//                        kStatsFields entry
+//   Query (client):      JSON request in UTF-8
+//   Result (aggregator): JSON reply in UTF-8
+enum PushFrameType : quint8 {
+    PushHello = 16,
+    PushBatch = 17,
+    FleetQuery = 18,
+    FleetResult = 19,
+};
+
+// Port an aggregator listens on unless configured otherwise
+inline constexpr quint16 kDefaultAggregatorPort = 7390;
+
+void EncodeHello(const QString &host, QByteArray &out);
+bool DecodeHello(QByteArrayView payload, QString &host);
+
+// Appends one Batch frame holding samples[begin, end) to out
+void EncodeBatch(const std::vector<StatsSample> &samples, size_t begin, size_t end, QByteArray &out);
+// Appends the samples of a Batch payload to out; false if it is malformed
+bool DecodeBatch(QByteArrayView payload, std::vector<StatsSample> &out);
+
+// Query and Result frames
+void EncodeJsonFrame(quint8 type, const QJsonObject &json, QByteArray &out);
+bool DecodeJsonFrame(QByteArrayView payload, QJsonObject &json);
+
+// Pushes every collected sample to an aggregator. Publish() only queues
+// the sample; the client thread sends the queue in compressed batches a
+// few times a second, or sooner once a batch is full. While the
+// aggregator is unreachable the client reconnects with backoff and keeps
+// the newest samples up to its capacity.
+struct StatsPushClient
+{
+    explicit StatsPushClient(size_t capacity = 65536);
+    ~StatsPushClient();
+
+    // Starts the client thread; host_name tags every sample at the aggregator
+    void Start(const QString &address, quint16 port, const QString &host_name);
+    void Stop();
+
+    // Safe from any thread; never waits for the network
+    void Publish(const StatsSample &sample);
+
+    bool Connected() const { return connected_; }
+    // Samples the socket has handed to the network
+    quint64 SentCount() const { return sent_count_; }
+    // Samples dropped because the queue was full, or because the
+    // connection was lost while they were still in the socket's buffer
+    quint64 DroppedCount() const { return dropped_count_; }
+
+private:
+    // Client thread only
+    void Connect();
+    void Flush();
+    void Written(qint64 bytes);
+    void DropInFlight();
+
+    size_t capacity_;
+    std::mutex queue_mutex_;
+    std::vector<StatsSample> queue_;
+    bool running_ = false;     // guarded by queue_mutex_
+
+    QString address_;
+    quint16 port_ = 0;
+    QString host_name_;
+    std::unique_ptr<QThread> thread_;
+    QObject *context_ = nullptr;
+    QTcpSocket *socket_ = nullptr;
+    QTimer *flush_timer_ = nullptr;
+    QTimer *reconnect_timer_ = nullptr;
+    std::vector<StatsSample> sending_;
+    QByteArray frame_;
+    int backoff_ms_ = 0;
+    // Batches written to the socket but not yet out of its buffer, as the
+    // byte offset they end at and their sample count
+    std::deque<std::pair<qint64, size_t>> in_flight_;
+    qint64 queued_bytes_ = 0;
+    qint64 written_bytes_ = 0;
+
+    std::atomic<bool> flush_queued_{false};
+    std::atomic<bool> connected_{false};
+    std::atomic<quint64> sent_count_{0};
+    std::atomic<quint64> dropped_count_{0};
+};
+
+#endif // PROC_PUSH_H
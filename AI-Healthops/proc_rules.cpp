@@ -0,0 +1,428 @@
+#include "proc_rules.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <tuple>
+
+// Longest window a rule may ask for: a day of 1 s samples
+static const int kMaxWindow = 24 * 3600;
+
+const char *MetricName(int metric) {
+    return metric == kCpuPercentMetric ? "CPU_PERCENT" : kStatsFields[metric].name;
+}
+
+quint32 MetricGroupOf(int metric) {
+    return metric == kCpuPercentMetric ? CpuMetrics : kStatsFields[metric].group;
+}
+
+int MetricIndex(const QString &name) {
+    if (name == QLatin1String("CPU_PERCENT")) {
+        return kCpuPercentMetric;
+    }
+    for (size_t i = 0; i < kStatsFieldCount; ++i) {
+        if (name == QLatin1String(kStatsFields[i].name)) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+// Sizes read better in MB
+static QString formatValue(int metric, double value) {
+    const QString name = MetricName(metric);
+    if (std::abs(value) >= 1024.0 * 1024.0 && (name.contains("SIZE") || name.contains("USAGE") || name.contains("BYTES"))) {
+        return QString::number(value / (1024.0 * 1024.0), 'f', 1) + " MB";
+    }
+    return QString::number(value, 'g', 4);
+}
+
+QString RuleCondition::Describe(double value) const {
+    static const char *const aggregates[] = {"value", "delta", "mean", "min", "max", "slope"};
+    static const char *const ops[] = {"<", "<=", ">", ">="};
+
+    QString text = aggregate == Value
+                       ? QString(MetricName(metric))
+                       : QString("%1(%2, %3)").arg(aggregates[aggregate], MetricName(metric)).arg(window);
+    const QString unit = aggregate == Slope ? "/h" : "";
+    return QString("%1 = %2%3 %4 %5%6")
+        .arg(text, formatValue(metric, value), unit, ops[op], formatValue(metric, threshold), unit);
+}
+
+RuleEngine::RuleEngine(int interval_ms)
+    : samples_per_hour_(3600.0 * 1000.0 / std::max(interval_ms, 1)), rules_(std::make_shared<RuleSet>()) {
+}
+
+QByteArray RuleEngine::DefaultRules() {
+    return R"({
+  "rules": [
+    {
+      "id": "cpu-sustained",
+      "group": "CPU Optimization",
+      "label": "Sustained high CPU",
+      "details": "The process has kept the CPU busy for the last minute. Profile its hot paths or move the work off the interactive path.",
+      "when": [{"metric": "CPU_PERCENT", "aggregate": "mean", "window": 60, "op": ">", "value": 80}]
+    },
+    {
+      "id": "cpu-kernel-heavy",
+      "group": "CPU Optimization",
+      "label": "Kernel time dominates",
+      "details": "Most CPU time is spent in the kernel, which usually means many small system calls, I/O or paging. Batch the I/O and check for page faults.",
+      "when": [
+        {"metric": "CPU_KERNPERCENT", "aggregate": "mean", "window": 60, "op": ">", "value": 20},
+        {"metric": "CPU_USERPERCENT", "aggregate": "mean", "window": 60, "op": "<", "value": 10}
+      ]
+    },
+    {
+      "id": "cpu-spike",
+      "group": "CPU Optimization",
+      "label": "CPU spike",
+      "details": "CPU usage jumped within the last 10 seconds.",
+      "when": [
+        {"metric": "CPU_PERCENT", "aggregate": "max", "window": 10, "op": ">=", "value": 90},
+        {"metric": "CPU_PERCENT", "aggregate": "mean", "window": 300, "op": "<", "value": 30}
+      ]
+    },
+    {
+      "id": "memory-growth",
+      "group": "Memory Optimization",
+      "label": "Working set keeps growing",
+      "details": "The working set has grown steadily over the last 10 minutes. Check for caches without limits or leaked allocations.",
+      "when": [{"metric": "PROC_WORKINGSETSIZE", "aggregate": "slope", "window": 600, "op": ">", "value": 52428800}]
+    },
+    {
+      "id": "memory-large",
+      "group": "Memory Optimization",
+      "label": "Large working set",
+      "details": "The process holds more than 2 GB of physical memory.",
+      "when": [{"metric": "PROC_WORKINGSETSIZE", "aggregate": "value", "op": ">", "value": 2147483648}]
+    },
+    {
+      "id": "pagefile-growth",
+      "group": "Memory Optimization",
+      "label": "Committed memory keeps growing",
+      "details": "Pagefile usage has grown steadily over the last 10 minutes, which points at a leak of private memory.",
+      "when": [{"metric": "PROC_PAGEFILEUSAGE", "aggregate": "slope", "window": 600, "op": ">", "value": 52428800}]
+    },
+    {
+      "id": "page-faults",
+      "group": "Memory Optimization",
+      "label": "Heavy paging",
+      "details": "The process takes many page faults. Reduce its working set or give the machine more memory.",
+      "when": [{"metric": "PROC_PAGEFAULTCOUNT", "aggregate": "delta", "window": 60, "op": ">", "value": 300000}]
+    },
+    {
+      "id": "io-read-ops",
+      "group": "System Performance",
+      "label": "Many small reads",
+      "details": "The process issues many read operations. Larger, buffered reads are usually cheaper.",
+      "when": [{"metric": "IO_IOPS_READ", "aggregate": "mean", "window": 60, "op": ">", "value": 1000}]
+    },
+    {
+      "id": "io-write-ops",
+      "group": "System Performance",
+      "label": "Many small writes",
+      "details": "The process issues many write operations. Batch writes or flush less often.",
+      "when": [{"metric": "IO_IOPS_WRITE", "aggregate": "mean", "window": 60, "op": ">", "value": 1000}]
+    }
+  ]
+}
+)";
+}
+
+bool RuleEngine::Load(const QString &path, QString *error) {
+    QFile file(path);
+    if (!file.exists()) {
+        if (file.open(QIODevice::WriteOnly)) {
+            file.write(DefaultRules());
+            file.close();
+        }
+        return Compile(DefaultRules(), "built-in", error);
+    }
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error) {
+            *error = "Cannot read " + path + ": " + file.errorString();
+        }
+        return false;
+    }
+    return Compile(file.readAll(), path, error);
+}
+
+bool RuleEngine::Compile(const QByteArray &json, const QString &source, QString *error) {
+    auto fail = [error](const QString &message) {
+        if (error) {
+            *error = message;
+        }
+        return false;
+    };
+
+    QJsonParseError parse_error;
+    const QJsonDocument document = QJsonDocument::fromJson(json, &parse_error);
+    if (document.isNull()) {
+        return fail("Rules are not valid JSON: " + parse_error.errorString());
+    }
+    const QJsonValue rule_values = document.object().value("rules");
+    if (!rule_values.isArray()) {
+        return fail("Rules file has no \"rules\" array");
+    }
+
+    auto rule_set = std::make_shared<RuleSet>();
+    rule_set->source = source;
+    std::vector<Input> inputs;
+    std::vector<Instruction> program;
+    std::map<std::tuple<int, int, int>, quint32> input_ids;
+
+    for (const QJsonValue &rule_value : rule_values.toArray()) {
+        const QJsonObject object = rule_value.toObject();
+        Rule rule;
+        rule.id = object.value("id").toString();
+        if (rule.id.isEmpty()) {
+            return fail(QString("Rule %1 has no id").arg(rule_set->rules.size() + 1));
+        }
+        rule.group = object.value("group").toString("Local rules");
+        rule.label = object.value("label").toString(rule.id);
+        rule.details = object.value("details").toString();
+
+        const QJsonArray conditions = object.value("when").toArray();
+        if (conditions.isEmpty()) {
+            return fail("Rule '" + rule.id + "' has no conditions");
+        }
+
+        for (const QJsonValue &condition_value : conditions) {
+            const QJsonObject c = condition_value.toObject();
+            RuleCondition condition;
+
+            condition.metric = MetricIndex(c.value("metric").toString());
+            if (condition.metric < 0) {
+                return fail("Rule '" + rule.id + "': unknown metric '" + c.value("metric").toString() + "'");
+            }
+
+            static const char *const aggregates[] = {"value", "delta", "mean", "min", "max", "slope"};
+            const QString aggregate = c.value("aggregate").toString("value");
+            auto found = std::find_if(std::begin(aggregates), std::end(aggregates), [&](const char *name) {
+                return aggregate == QLatin1String(name);
+            });
+            if (found == std::end(aggregates)) {
+                return fail("Rule '" + rule.id + "': unknown aggregate '" + aggregate + "'");
+            }
+            condition.aggregate = static_cast<RuleCondition::Aggregate>(found - std::begin(aggregates));
+
+            condition.window = condition.aggregate == RuleCondition::Value ? 1 : c.value("window").toInt(1);
+            if (condition.window < 1 || condition.window > kMaxWindow) {
+                return fail(QString("Rule '%1': window must be between 1 and %2 samples").arg(rule.id).arg(kMaxWindow));
+            }
+
+            const QString op = c.value("op").toString();
+            if (op == "<") {
+                condition.op = RuleCondition::Less;
+            } else if (op == "<=") {
+                condition.op = RuleCondition::LessEqual;
+            } else if (op == ">") {
+                condition.op = RuleCondition::Greater;
+            } else if (op == ">=") {
+                condition.op = RuleCondition::GreaterEqual;
+            } else {
+                return fail("Rule '" + rule.id + "': unknown operator '" + op + "'");
+            }
+
+            if (!c.value("value").isDouble()) {
+                return fail("Rule '" + rule.id + "': condition has no numeric value");
+            }
+            condition.threshold = c.value("value").toDouble();
+
+            // Conditions that need the same aggregate share one input
+            const auto key = std::make_tuple(condition.metric, static_cast<int>(condition.aggregate), condition.window);
+            auto it = input_ids.find(key);
+            if (it == input_ids.end()) {
+                it = input_ids.emplace(key, static_cast<quint32>(inputs.size())).first;
+                inputs.push_back(Input{condition.metric, condition.aggregate, condition.window});
+            }
+
+            Instruction instruction;
+            instruction.input = it->second;
+            instruction.op = condition.op;
+            instruction.last = false;
+            instruction.rule = static_cast<quint32>(rule_set->rules.size());
+            instruction.next_rule = 0;
+            instruction.group = MetricGroupOf(condition.metric);
+            instruction.threshold = condition.threshold;
+            program.push_back(instruction);
+
+            rule.conditions.push_back(condition);
+        }
+
+        program.back().last = true;
+        for (size_t i = program.size() - rule.conditions.size(); i < program.size(); ++i) {
+            program[i].next_rule = static_cast<quint32>(program.size());
+        }
+        rule_set->rules.push_back(std::move(rule));
+    }
+
+    // Each metric keeps as many past values as its longest window needs
+    std::vector<MetricHistory> histories(kStatsFieldCount + 1);
+    for (const Input &input : inputs) {
+        const size_t size = static_cast<size_t>(input.window) + 1;
+        if (histories[input.metric].values.size() < size) {
+            histories[input.metric].values.assign(size, 0.0);
+        }
+    }
+
+    rules_ = std::move(rule_set);
+    inputs_ = std::move(inputs);
+    program_ = std::move(program);
+    histories_ = std::move(histories);
+    values_.assign(inputs_.size(), 0.0);
+    Reset();
+    return true;
+}
+
+void RuleEngine::Reset() {
+    for (Input &input : inputs_) {
+        input.sum = 0.0;
+        input.sum_tx = 0.0;
+        input.extremes.clear();
+    }
+    for (MetricHistory &history : histories_) {
+        std::fill(history.values.begin(), history.values.end(), 0.0);
+        history.has_previous = false;
+    }
+    sequence_ = 0;
+}
+
+double RuleEngine::At(const MetricHistory &history, quint64 sequence) const {
+    return history.values[sequence % history.values.size()];
+}
+
+void RuleEngine::UpdateInput(Input &input, const MetricHistory &history, double x, double delta) {
+    const quint64 s = sequence_ - 1;
+    const quint64 w = static_cast<quint64>(input.window);
+    const bool full = s >= w;
+    const size_t index = &input - inputs_.data();
+
+    switch (input.aggregate) {
+    case RuleCondition::Value:
+        values_[index] = x;
+        break;
+
+    case RuleCondition::Delta:
+        values_[index] = w == 1 ? delta : x - At(history, full ? s - w : 0);
+        break;
+
+    case RuleCondition::Mean:
+        input.sum += x - (full ? At(history, s - w) : 0.0);
+        values_[index] = input.sum / static_cast<double>(full ? w : s + 1);
+        break;
+
+    case RuleCondition::Min:
+    case RuleCondition::Max: {
+        const bool is_max = input.aggregate == RuleCondition::Max;
+        auto &extremes = input.extremes;
+        while (!extremes.empty() && (is_max ? extremes.back().second <= x : extremes.back().second >= x)) {
+            extremes.pop_back();
+        }
+        extremes.emplace_back(s, x);
+        while (extremes.front().first + w <= s) {
+            extremes.pop_front();
+        }
+        values_[index] = extremes.front().second;
+        break;
+    }
+
+    case RuleCondition::Slope: {
+        // t runs from 0 for the oldest value in the window to n - 1
+        if (!full) {
+            input.sum_tx += static_cast<double>(s) * x;
+            input.sum += x;
+        } else {
+            const double x_old = At(history, s - w);
+            input.sum_tx += -(input.sum - x_old) + static_cast<double>(w - 1) * x;
+            input.sum += x - x_old;
+        }
+        const double n = static_cast<double>(full ? w : s + 1);
+        if (n < 2.0) {
+            values_[index] = 0.0;
+            break;
+        }
+        const double sum_t = n * (n - 1.0) / 2.0;
+        const double sum_tt = (n - 1.0) * n * (2.0 * n - 1.0) / 6.0;
+        const double slope = (n * input.sum_tx - sum_t * input.sum) / (n * sum_tt - sum_t * sum_t);
+        values_[index] = slope * samples_per_hour_;
+        break;
+    }
+    }
+
+    // Large values lose low bits in the running sums; start them again from
+    // the stored window once per window length
+    if ((input.aggregate == RuleCondition::Mean || input.aggregate == RuleCondition::Slope) && full && s % w == 0) {
+        input.sum = 0.0;
+        input.sum_tx = 0.0;
+        for (quint64 t = 0; t < w; ++t) {
+            const double value = At(history, s - w + 1 + t);
+            input.sum += value;
+            input.sum_tx += static_cast<double>(t) * value;
+        }
+    }
+}
+
+void RuleEngine::Update(const Stats &stats, std::vector<RuleMatch> &active) {
+    active.clear();
+    const quint64 s = sequence_++;
+
+    double x[kStatsFieldCount + 1];
+    double delta[kStatsFieldCount + 1];
+    for (size_t m = 0; m <= kStatsFieldCount; ++m) {
+        x[m] = m < kStatsFieldCount
+                   ? static_cast<double>(stats.*kStatsFields[m].member)
+                   : static_cast<double>(stats.CPU_USERPERCENT + stats.CPU_KERNPERCENT);
+
+        MetricHistory &history = histories_[m];
+        delta[m] = history.has_previous ? x[m] - history.previous : 0.0;
+        history.previous = x[m];
+        history.has_previous = true;
+        if (!history.values.empty()) {
+            history.values[s % history.values.size()] = x[m];
+        }
+    }
+
+    for (Input &input : inputs_) {
+        UpdateInput(input, histories_[input.metric], x[input.metric], delta[input.metric]);
+    }
+
+    // One pass over the program; a failed condition jumps to the next rule
+    size_t pc = 0;
+    while (pc < program_.size()) {
+        const Instruction &instruction = program_[pc];
+        if (!(instruction.group & groups_)) {
+            pc = instruction.next_rule;
+            continue;
+        }
+        const double value = values_[instruction.input];
+        bool holds = false;
+        switch (instruction.op) {
+        case RuleCondition::Less:         holds = value < instruction.threshold; break;
+        case RuleCondition::LessEqual:    holds = value <= instruction.threshold; break;
+        case RuleCondition::Greater:      holds = value > instruction.threshold; break;
+        case RuleCondition::GreaterEqual: holds = value >= instruction.threshold; break;
+        }
+
+        if (!holds) {
+            pc = instruction.next_rule;
+            continue;
+        }
+        if (instruction.last) {
+            const size_t first = pc + 1 - rules_->rules[instruction.rule].conditions.size();
+            RuleMatch match;
+            match.rule = static_cast<int>(instruction.rule);
+            for (size_t i = first; i <= pc; ++i) {
+                match.evidence.push_back(values_[program_[i].input]);
+            }
+            active.push_back(std::move(match));
+        }
+        ++pc;
+    }
+}
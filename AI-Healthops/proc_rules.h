@@ -0,0 +1,132 @@
+#ifndef PROC_RULES_H
+#define PROC_RULES_H
+
+#include "proc_stats.h"
+
+#include <QByteArray>
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+// One test of a rule: aggregate(metric over the last window samples) op threshold
+struct RuleCondition {
+    enum Aggregate { Value, Delta, Mean, Min, Max, Slope };
+    enum Op { Less, LessEqual, Greater, GreaterEqual };
+
+    int metric = 0;          // index into kStatsFields, or kCpuPercentMetric
+    Aggregate aggregate = Value;
+    int window = 1;          // samples
+    Op op = Greater;
+    double threshold = 0.0;
+
+    // e.g. "mean(CPU_PERCENT, 60) = 85.2 > 80"
+    QString Describe(double value) const;
+};
+
+struct Rule {
+    QString id;
+    QString group;
+    QString label;
+    QString details;
+    std::vector<RuleCondition> conditions;
+};
+
+struct RuleSet {
+    QString source;  // file the rules came from, or "built-in"
+    std::vector<Rule> rules;
+};
+
+// A rule whose conditions all hold, with the value behind each condition
+struct RuleMatch {
+    int rule = 0;
+    std::vector<double> evidence;
+};
+
+// Pseudo metric for CPU_USERPERCENT + CPU_KERNPERCENT
+static const int kCpuPercentMetric = static_cast<int>(kStatsFieldCount);
+
+// Name of a metric index and back; MetricIndex returns -1 for an unknown name
+const char *MetricName(int metric);
+int MetricIndex(const QString &name);
+// MetricGroup a metric index is read with
+quint32 MetricGroupOf(int metric);
+
+// Local rule engine. Rules are read from a JSON file of the form
+//   {"rules": [{"id": "...", "group": "...", "label": "...", "details": "...",
+//               "when": [{"metric": "CPU_PERCENT", "aggregate": "mean",
+//                         "window": 60, "op": ">", "value": 80}, ...]}]}
+// and compiled into a flat program. Every distinct (metric, aggregate,
+// window) becomes one input that is updated in O(1) per sample: running
+// sums for mean and slope, monotonic queues for min and max. The program is
+// then a linear pass of comparisons that skips to the next rule on the first
+// failed condition. Slopes are per hour.
+struct RuleEngine
+{
+    explicit RuleEngine(int interval_ms = 1000);
+
+    // Replaces the rules. On error nothing changes and error describes the
+    // first problem.
+    bool Compile(const QByteArray &json, const QString &source, QString *error);
+
+    // Compiles the rules in path, writing the built-in rules there first if
+    // the file does not exist
+    bool Load(const QString &path, QString *error);
+
+    static QByteArray DefaultRules();
+
+    // Forgets all samples, e.g. when another process is sampled
+    void Reset();
+
+    // Metric groups the samples carry. A rule with a condition on any other
+    // metric never matches, since that metric only reads zero.
+    void SetGroups(quint32 groups) { groups_ = groups; }
+
+    // Feeds one sample and fills active with the rules that now match
+    void Update(const Stats &stats, std::vector<RuleMatch> &active);
+
+    std::shared_ptr<const RuleSet> Rules() const { return rules_; }
+    size_t InputCount() const { return inputs_.size(); }
+
+private:
+    struct Input {
+        int metric;
+        RuleCondition::Aggregate aggregate;
+        int window;
+
+        double sum = 0.0;      // Mean, Slope: sum of the window
+        double sum_tx = 0.0;   // Slope: sum of t * x with t = 0 for the oldest
+        std::deque<std::pair<quint64, double>> extremes;  // Min, Max
+    };
+
+    struct Instruction {
+        quint32 input;
+        RuleCondition::Op op;
+        bool last;             // last condition of its rule
+        quint32 rule;
+        quint32 next_rule;     // first instruction of the following rule
+        quint32 group;         // MetricGroup of the input's metric
+        double threshold;
+    };
+
+    // Last max_window values of one metric, oldest overwritten first
+    struct MetricHistory {
+        std::vector<double> values;
+        double previous = 0.0;
+        bool has_previous = false;
+    };
+
+    double At(const MetricHistory &history, quint64 sequence) const;
+    void UpdateInput(Input &input, const MetricHistory &history, double x, double delta);
+
+    double samples_per_hour_;
+    std::shared_ptr<const RuleSet> rules_;
+    std::vector<Input> inputs_;
+    std::vector<Instruction> program_;
+    std::vector<MetricHistory> histories_;  // one per metric
+    std::vector<double> values_;            // current value of every input
+    quint64 sequence_ = 0;                  // samples seen
+    quint32 groups_ = kAllMetricGroups;
+};
+
+#endif // PROC_RULES_H
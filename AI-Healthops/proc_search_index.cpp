@@ -0,0 +1,231 @@
+#include "proc_search_index.h"
+
+#include <QRegularExpression>
+
+#include <algorithm>
+#include <numeric>
+
+static bool isDigits(const QString &text) {
+    if (text.isEmpty()) {
+        return false;
+    }
+    for (QChar c : text) {
+        if (!c.isDigit()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool compare(double value, int op, double number) {
+    switch (op) {
+    case 1: return value < number;
+    case 2: return value <= number;
+    case 3: return value > number;
+    case 4: return value >= number;
+    case 5: return value == number;
+    }
+    return true;
+}
+
+quint32 ProcessSearchIndex::Intern(const QString &text) {
+    const QString folded = text.toCaseFolded();
+    auto it = string_ids_.constFind(folded);
+    if (it != string_ids_.constEnd()) {
+        return it.value();
+    }
+    const quint32 id = static_cast<quint32>(strings_.size());
+    strings_.push_back(folded);
+    string_ids_.insert(folded, id);
+    return id;
+}
+
+void ProcessSearchIndex::Build(const ProcessSnapshot &rows) {
+    strings_.clear();
+    sorted_strings_.clear();
+    string_ids_.clear();
+    trigrams_.clear();
+    name_ids_.clear();
+    user_ids_.clear();
+    pids_.clear();
+    cpu_.clear();
+    working_set_.clear();
+    pid_text_.clear();
+
+    const size_t count = rows.Size();
+    name_ids_.reserve(count);
+    user_ids_.reserve(count);
+    pids_.reserve(count);
+    cpu_.reserve(count);
+    working_set_.reserve(count);
+    pid_text_.reserve(count);
+
+    for (size_t r = 0; r < count; ++r) {
+        name_ids_.push_back(Intern(rows.names[r]));
+        user_ids_.push_back(Intern(rows.users[r]));
+        pids_.push_back(rows.pids[r]);
+        cpu_.push_back(rows.cpu_user_percent[r] + rows.cpu_kernel_percent[r]);
+        working_set_.push_back(rows.working_set[r]);
+        pid_text_.emplace_back(QString::number(rows.pids[r]), static_cast<quint32>(r));
+    }
+
+    sorted_strings_.resize(strings_.size());
+    std::iota(sorted_strings_.begin(), sorted_strings_.end(), 0u);
+    std::sort(sorted_strings_.begin(), sorted_strings_.end(), [this](quint32 a, quint32 b) {
+        return strings_[a] < strings_[b];
+    });
+
+    // String ids are visited in increasing order, so every posting list
+    // comes out sorted and only needs consecutive duplicates skipped
+    for (quint32 id = 0; id < strings_.size(); ++id) {
+        const QString &text = strings_[id];
+        for (qsizetype i = 0; i + 3 <= text.size(); ++i) {
+            std::vector<quint32> &postings = trigrams_[Trigram(text.constData() + i)];
+            if (postings.empty() || postings.back() != id) {
+                postings.push_back(id);
+            }
+        }
+    }
+
+    std::sort(pid_text_.begin(), pid_text_.end());
+}
+
+void ProcessSearchIndex::MatchStrings(const QString &text, std::vector<char> &string_matches) const {
+    if (text.size() >= 3) {
+        // Verify only the strings of the rarest trigram
+        const std::vector<quint32> *smallest = nullptr;
+        for (qsizetype i = 0; i + 3 <= text.size(); ++i) {
+            auto it = trigrams_.find(Trigram(text.constData() + i));
+            if (it == trigrams_.end()) {
+                return;
+            }
+            if (!smallest || it->second.size() < smallest->size()) {
+                smallest = &it->second;
+            }
+        }
+        for (quint32 id : *smallest) {
+            if (strings_[id].contains(text)) {
+                string_matches[id] = 1;
+            }
+        }
+        return;
+    }
+
+    auto it = std::lower_bound(sorted_strings_.begin(), sorted_strings_.end(), text, [this](quint32 id, const QString &value) {
+        return strings_[id] < value;
+    });
+    for (; it != sorted_strings_.end() && strings_[*it].startsWith(text); ++it) {
+        string_matches[*it] = 1;
+    }
+}
+
+void ProcessSearchIndex::MatchPidPrefix(const QString &digits, std::vector<char> &row_matches) const {
+    auto it = std::lower_bound(pid_text_.begin(), pid_text_.end(), digits, [](const std::pair<QString, quint32> &entry, const QString &value) {
+        return entry.first < value;
+    });
+    for (; it != pid_text_.end() && it->first.startsWith(digits); ++it) {
+        row_matches[it->second] = 1;
+    }
+}
+
+std::vector<ProcessSearchIndex::Term> ProcessSearchIndex::Parse(const QString &query) {
+    static const QRegularExpression operatorSpacing("\\s*(>=|<=|>|<|=)\\s*");
+    static const QRegularExpression unitSpacing("(\\d)\\s+(kb|mb|gb|b|%)(?=\\s|$)");
+    static const QRegularExpression whitespace("\\s+");
+    static const QRegularExpression numericTerm("^(ws|mem|workingset|cpu|pid)(>=|<=|>|<|=)([0-9]*\\.?[0-9]+)(kb|mb|gb|b|%)?$");
+
+    QString normalized = query.toCaseFolded();
+    normalized.replace("working set", "ws");
+    normalized.replace(operatorSpacing, "\\1");
+    normalized.replace(unitSpacing, "\\1\\2");
+
+    std::vector<Term> terms;
+    for (const QString &token : normalized.split(whitespace, Qt::SkipEmptyParts)) {
+        Term term;
+
+        QRegularExpressionMatch match = numericTerm.match(token);
+        if (match.hasMatch()) {
+            const QString field = match.captured(1);
+            const QString op = match.captured(2);
+            const QString unit = match.captured(4);
+
+            term.field = field == "cpu" ? Field::Cpu : field == "pid" ? Field::Pid : Field::WorkingSet;
+            term.op = op == "<" ? Op::Less : op == "<=" ? Op::LessEqual : op == ">" ? Op::Greater
+                    : op == ">=" ? Op::GreaterEqual : Op::Equal;
+            term.number = match.captured(3).toDouble();
+
+            if (term.field == Field::WorkingSet) {
+                // Working set without a unit is taken as MB
+                if (unit == "kb") {
+                    term.number *= 1024.0;
+                } else if (unit == "gb") {
+                    term.number *= 1024.0 * 1024.0 * 1024.0;
+                } else if (unit != "b") {
+                    term.number *= 1024.0 * 1024.0;
+                }
+            }
+            terms.push_back(term);
+            continue;
+        }
+
+        if (token.startsWith("name:")) {
+            term.field = Field::Name;
+            term.text = token.mid(5);
+        } else if (token.startsWith("user:")) {
+            term.field = Field::User;
+            term.text = token.mid(5);
+        } else {
+            term.text = token;
+        }
+        if (!term.text.isEmpty()) {
+            terms.push_back(term);
+        }
+    }
+    return terms;
+}
+
+size_t ProcessSearchIndex::Search(const QString &query, std::vector<char> &matches) const {
+    const size_t count = pids_.size();
+    matches.assign(count, 1);
+
+    std::vector<char> string_matches;
+    std::vector<char> term_rows;
+
+    for (const Term &term : Parse(query)) {
+        if (term.op == Op::Contains) {
+            string_matches.assign(strings_.size(), 0);
+            MatchStrings(term.text, string_matches);
+
+            term_rows.assign(count, 0);
+            for (size_t r = 0; r < count; ++r) {
+                term_rows[r] = (term.field != Field::User && string_matches[name_ids_[r]])
+                               || (term.field != Field::Name && string_matches[user_ids_[r]]);
+            }
+            if (term.field == Field::Any && isDigits(term.text)) {
+                MatchPidPrefix(term.text, term_rows);
+            }
+
+            for (size_t r = 0; r < count; ++r) {
+                matches[r] = matches[r] && term_rows[r];
+            }
+            continue;
+        }
+
+        const int op = static_cast<int>(term.op);
+        for (size_t r = 0; r < count; ++r) {
+            if (!matches[r]) {
+                continue;
+            }
+            double value = 0.0;
+            switch (term.field) {
+            case Field::Cpu:        value = cpu_[r]; break;
+            case Field::Pid:        value = pids_[r]; break;
+            case Field::WorkingSet: value = static_cast<double>(working_set_[r]); break;
+            default:                break;
+            }
+            matches[r] = compare(value, op, term.number);
+        }
+    }
+
+    return static_cast<size_t>(std::count(matches.begin(), matches.end(), 1));
+}
@@ -0,0 +1,69 @@
+#ifndef PROC_SEARCH_INDEX_H
+#define PROC_SEARCH_INDEX_H
+
+#include "proc_snapshot.h"
+
+#include <QHash>
+
+#include <unordered_map>
+
+// Search index over the rows of a ProcessSnapshot, rebuilt whenever the
+// snapshot changes. Names and users are interned into one case-folded string
+// pool, so a text term is matched once per distinct string (a few hundred)
+// rather than once per process:
+//  - terms of three or more characters use trigram posting lists and match
+//    anywhere in the name or user,
+//  - shorter terms match as a prefix through the sorted string pool,
+//  - digit-only terms also match PID prefixes.
+// Numeric filters are scanned over the snapshot's columns. Supported fields
+// are ws / mem / "working set" (with B, KB, MB or GB), cpu and pid, with
+// <, <=, >, >= and =, e.g. "svc ws > 500 MB cpu>=1". name: and user:
+// restrict a text term to one column. All terms must match.
+struct ProcessSearchIndex
+{
+    void Build(const ProcessSnapshot &rows);
+
+    // Resizes matches to the row count and sets 1 for every matching row.
+    // Returns the number of matches.
+    size_t Search(const QString &query, std::vector<char> &matches) const;
+
+    size_t Size() const { return pids_.size(); }
+
+private:
+    enum class Field { Any, Name, User, Pid, Cpu, WorkingSet };
+    enum class Op { Contains, Less, LessEqual, Greater, GreaterEqual, Equal };
+
+    struct Term {
+        Field field = Field::Any;
+        Op op = Op::Contains;
+        QString text;
+        double number = 0.0;
+    };
+
+    static std::vector<Term> Parse(const QString &query);
+    quint32 Intern(const QString &text);
+    void MatchStrings(const QString &text, std::vector<char> &string_matches) const;
+    void MatchPidPrefix(const QString &digits, std::vector<char> &row_matches) const;
+
+    static quint64 Trigram(const QChar *text) {
+        return (quint64(text[0].unicode()) << 32) | (quint64(text[1].unicode()) << 16) | quint64(text[2].unicode());
+    }
+
+    // Interned, case-folded strings and their ids sorted by text
+    std::vector<QString> strings_;
+    std::vector<quint32> sorted_strings_;
+    QHash<QString, quint32> string_ids_;
+    std::unordered_map<quint64, std::vector<quint32>> trigrams_;
+
+    // Per row
+    std::vector<quint32> name_ids_;
+    std::vector<quint32> user_ids_;
+    std::vector<quint32> pids_;
+    std::vector<double> cpu_;
+    std::vector<quint64> working_set_;
+
+    // PIDs as decimal text, sorted, with their rows
+    std::vector<std::pair<QString, quint32>> pid_text_;
+};
+
+#endif // PROC_SEARCH_INDEX_H
@@ -0,0 +1,270 @@
+#include "proc_shared.h"
+
+#include <QSharedMemory>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+static const quint32 kSharedMagic = 0x53504f48;   // "HOPS"
+static const quint32 kSharedVersion = 1;
+
+// Characters of the sampled process's name kept in the segment
+static const int kNameChars = 128;
+
+// A reader that saw nothing new for this many intervals re-attaches, in
+// case its publisher restarted into a new segment
+static const int kStaleIntervals = 5;
+
+// How often a reader without a segment tries to attach
+static const auto kAttachRetry = std::chrono::seconds(1);
+
+// Layout of the segment: the header, then capacity slots. Slot fields are
+// copied while the writer may be changing them; the sequence word read
+// before and after the copy tells whether the copy is usable.
+struct SharedHeader {
+    quint32 magic;
+    quint32 version;
+    quint32 field_count;
+    quint32 capacity;
+    qint32 interval_ms;
+    quint32 reserved;
+    quint64 generation;               // new for every writer taking over
+    std::atomic<quint64> published;   // samples written so far
+    std::atomic<quint64> name_seq;    // seqlock of pid and name
+    quint32 pid;
+    quint32 name_length;
+    char16_t name[kNameChars];
+};
+
+struct SharedSlot {
+    std::atomic<quint64> seq;         // 2n + 1 while sample n is written, 2n + 2 once complete
+    qint64 time_stamp;
+    quint32 pid;
+    quint32 reserved;
+    quint64 values[kStatsFieldCount];
+};
+
+static_assert(std::atomic<quint64>::is_always_lock_free, "atomics in shared memory must be lock-free");
+
+static SharedSlot *slotsOf(void *data) {
+    return reinterpret_cast<SharedSlot *>(static_cast<char *>(data) + sizeof(SharedHeader));
+}
+
+static const SharedSlot *slotsOf(const void *data) {
+    return reinterpret_cast<const SharedSlot *>(static_cast<const char *>(data) + sizeof(SharedHeader));
+}
+
+static qsizetype segmentSize(size_t capacity) {
+    return static_cast<qsizetype>(sizeof(SharedHeader) + capacity * sizeof(SharedSlot));
+}
+
+SharedStatsWriter::SharedStatsWriter() = default;
+
+SharedStatsWriter::~SharedStatsWriter() {
+    Close();
+}
+
+bool SharedStatsWriter::Create(const QString &name, size_t capacity, int interval_ms) {
+    Close();
+    capacity = std::max<size_t>(capacity, 2);
+    memory_ = std::make_unique<QSharedMemory>(name);
+    if (!memory_->create(segmentSize(capacity))) {
+        // Still mapped by viewers of a collector that is gone; the collector
+        // lock rules out a live writer
+        if (memory_->error() != QSharedMemory::AlreadyExists || !memory_->attach()) {
+            error_ = memory_->errorString();
+            memory_.reset();
+            return false;
+        }
+        if (memory_->size() < segmentSize(capacity)) {
+            error_ = QString("segment %1 exists with room for fewer than %2 samples").arg(name).arg(capacity);
+            memory_.reset();
+            return false;
+        }
+    }
+
+    // Readers ignore the segment until the magic is back
+    SharedHeader *header = static_cast<SharedHeader *>(memory_->data());
+    header->magic = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+    SharedSlot *slots = slotsOf(memory_->data());
+    for (size_t i = 0; i < capacity; ++i) {
+        slots[i].seq.store(0, std::memory_order_relaxed);
+    }
+    header->version = kSharedVersion;
+    header->field_count = static_cast<quint32>(kStatsFieldCount);
+    header->capacity = static_cast<quint32>(capacity);
+    header->interval_ms = interval_ms;
+    header->generation = static_cast<quint64>(std::chrono::steady_clock::now().time_since_epoch().count());
+    header->published.store(0, std::memory_order_relaxed);
+    header->name_seq.store(0, std::memory_order_relaxed);
+    header->pid = 0;
+    header->name_length = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = kSharedMagic;
+
+    next_ = 0;
+    named_ = false;
+    return true;
+}
+
+void SharedStatsWriter::Close() {
+    memory_.reset();
+}
+
+void SharedStatsWriter::Publish(const StatsSample &sample) {
+    if (!memory_) {
+        return;
+    }
+    SharedHeader *header = static_cast<SharedHeader *>(memory_->data());
+
+    if (!named_ || sample.pid != named_pid_) {
+        const quint64 seq = header->name_seq.load(std::memory_order_relaxed);
+        header->name_seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        const int length = std::min<int>(static_cast<int>(sample.process.size()), kNameChars);
+        header->pid = sample.pid;
+        std::memcpy(header->name, sample.process.utf16(), length * sizeof(char16_t));
+        header->name_length = static_cast<quint32>(length);
+        header->name_seq.store(seq + 2, std::memory_order_release);
+        named_ = true;
+        named_pid_ = sample.pid;
+    }
+
+    SharedSlot &slot = slotsOf(memory_->data())[next_ % header->capacity];
+    slot.seq.store(2 * next_ + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.time_stamp = sample.time_stamp;
+    slot.pid = sample.pid;
+    for (size_t i = 0; i < kStatsFieldCount; ++i) {
+        slot.values[i] = sample.stats.*kStatsFields[i].member;
+    }
+    slot.seq.store(2 * next_ + 2, std::memory_order_release);
+    header->published.store(++next_, std::memory_order_release);
+}
+
+SharedStatsReader::SharedStatsReader(const QString &name) : name_(name) {
+}
+
+SharedStatsReader::~SharedStatsReader() {
+    Detach();
+}
+
+bool SharedStatsReader::Attached() const {
+    return memory_ != nullptr;
+}
+
+bool SharedStatsReader::Attach() {
+    const auto now = std::chrono::steady_clock::now();
+    last_attempt_ = now;
+    auto memory = std::make_unique<QSharedMemory>(name_);
+    if (!memory->attach(QSharedMemory::ReadOnly) || memory->size() < segmentSize(0)) {
+        return false;
+    }
+    const SharedHeader *header = static_cast<const SharedHeader *>(memory->constData());
+    if (header->magic != kSharedMagic || header->version != kSharedVersion ||
+        header->field_count != kStatsFieldCount || memory->size() < segmentSize(header->capacity)) {
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    memory_ = std::move(memory);
+    interval_ms_ = header->interval_ms;
+    // Back on the same writer's segment, e.g. after it stalled, reading goes
+    // on where it stopped. A new writer starts with whatever its ring holds.
+    if (!attached_once_ || header->generation != generation_) {
+        const quint64 published = header->published.load(std::memory_order_acquire);
+        cursor_ = published > header->capacity ? published - header->capacity : 0;
+    }
+    generation_ = header->generation;
+    attached_once_ = true;
+    last_progress_ = now;
+    return true;
+}
+
+void SharedStatsReader::Detach() {
+    memory_.reset();
+    interval_ms_ = 0;
+}
+
+size_t SharedStatsReader::Read(std::vector<StatsSample> &out) {
+    const auto now = std::chrono::steady_clock::now();
+    if (memory_ && now - last_progress_ > std::chrono::milliseconds(std::max(interval_ms_, 1000) * kStaleIntervals)) {
+        Detach();
+    }
+    if (!memory_ && (now - last_attempt_ < kAttachRetry || !Attach())) {
+        return 0;
+    }
+
+    const SharedHeader *header = static_cast<const SharedHeader *>(memory_->constData());
+    if (header->magic != kSharedMagic || header->generation != generation_) {
+        // Another writer took the segment over
+        Detach();
+        if (!Attach()) {
+            return 0;
+        }
+        header = static_cast<const SharedHeader *>(memory_->constData());
+    }
+
+    const quint64 capacity = header->capacity;
+    const quint64 published = header->published.load(std::memory_order_acquire);
+    if (cursor_ > published) {
+        cursor_ = published;
+    }
+    if (published - cursor_ > capacity) {
+        lost_ += published - capacity - cursor_;
+        cursor_ = published - capacity;
+    }
+
+    // Name of the sampled process; samples of an earlier one go without
+    quint32 named_pid = 0;
+    QString name;
+    for (int attempt = 0; attempt < 4; ++attempt) {
+        const quint64 seq = header->name_seq.load(std::memory_order_acquire);
+        if (seq & 1) {
+            continue;
+        }
+        const quint32 pid = header->pid;
+        const int length = static_cast<int>(std::min<quint32>(header->name_length, kNameChars));
+        char16_t chars[kNameChars];
+        std::memcpy(chars, header->name, length * sizeof(char16_t));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header->name_seq.load(std::memory_order_relaxed) == seq) {
+            named_pid = pid;
+            name = QString::fromUtf16(chars, length);
+            break;
+        }
+    }
+
+    const size_t start = out.size();
+    const SharedSlot *slots = slotsOf(memory_->constData());
+    for (; cursor_ < published; ++cursor_) {
+        const SharedSlot &slot = slots[cursor_ % capacity];
+        const quint64 expected = 2 * cursor_ + 2;
+        if (slot.seq.load(std::memory_order_acquire) != expected) {
+            ++lost_;
+            continue;
+        }
+        StatsSample sample;
+        sample.time_stamp = slot.time_stamp;
+        sample.pid = slot.pid;
+        for (size_t i = 0; i < kStatsFieldCount; ++i) {
+            sample.stats.*kStatsFields[i].member = slot.values[i];
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != expected) {
+            // Overwritten while being copied
+            ++lost_;
+            continue;
+        }
+        if (sample.pid == named_pid) {
+            sample.process = name;
+        }
+        out.push_back(std::move(sample));
+    }
+    if (out.size() > start) {
+        last_progress_ = now;
+    }
+    return out.size() - start;
+}
@@ -0,0 +1,78 @@
+#ifndef PROC_SHARED_H
+#define PROC_SHARED_H
+
+#include "proc_stats.h"
+
+#include <QString>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+class QSharedMemory;
+
+// Segment the collector publishes into unless configured otherwise
+inline constexpr char kDefaultSharedName[] = "healthops-live";
+
+// Publishes the latest samples into a named shared-memory segment laid out
+// as a ring of fixed-size slots. Each slot is a seqlock: its sequence word
+// is odd while the slot is written and encodes the sample number once it
+// is complete, so readers never block the writer or each other and need
+// neither a lock nor a system call to read.
+struct SharedStatsWriter
+{
+    SharedStatsWriter();
+    ~SharedStatsWriter();
+
+    // Creates (or takes over) the segment with room for capacity samples;
+    // interval_ms only tells readers how often to look
+    bool Create(const QString &name, size_t capacity, int interval_ms);
+    void Close();
+
+    // Sampling thread only
+    void Publish(const StatsSample &sample);
+
+    QString ErrorString() const { return error_; }
+
+private:
+    std::unique_ptr<QSharedMemory> memory_;
+    quint64 next_ = 0;
+    quint32 named_pid_ = 0;
+    bool named_ = false;
+    QString error_;
+};
+
+// Read-only view of a SharedStatsWriter's segment, e.g. for a GUI running as
+// a viewer while the daemon samples
+struct SharedStatsReader
+{
+    explicit SharedStatsReader(const QString &name = kDefaultSharedName);
+    ~SharedStatsReader();
+
+    // Appends the samples published since the last call to out, oldest
+    // first, and returns how many. Attaches to the segment when needed,
+    // so a publisher started later or restarted is picked up.
+    size_t Read(std::vector<StatsSample> &out);
+
+    bool Attached() const;
+    // Samples overwritten before they were read
+    quint64 LostCount() const { return lost_; }
+    // Publisher's sampling interval, 0 until attached
+    int IntervalMs() const { return interval_ms_; }
+
+private:
+    bool Attach();
+    void Detach();
+
+    QString name_;
+    std::unique_ptr<QSharedMemory> memory_;
+    quint64 generation_ = 0;
+    bool attached_once_ = false;
+    quint64 cursor_ = 0;
+    quint64 lost_ = 0;
+    int interval_ms_ = 0;
+    std::chrono::steady_clock::time_point last_progress_;
+    std::chrono::steady_clock::time_point last_attempt_;
+};
+
+#endif // PROC_SHARED_H
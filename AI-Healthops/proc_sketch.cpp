@@ -0,0 +1,196 @@
+#include "proc_sketch.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const double kGamma = (1.0 + QuantileSketch::kRelativeAccuracy) / (1.0 - QuantileSketch::kRelativeAccuracy);
+static const double kLogGamma = std::log(kGamma);
+
+static const char kFormatVersion = 1;
+
+static void writeVarint(QByteArray &out, quint64 value) {
+    while (value >= 0x80) {
+        out.append(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.append(static_cast<char>(value));
+}
+
+static bool readVarint(const QByteArray &in, qsizetype &pos, quint64 &value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && pos < in.size(); shift += 7) {
+        const quint8 byte = static_cast<quint8>(in[pos++]);
+        value |= static_cast<quint64>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Bin i holds the values in (gamma^(i-1), gamma^i]
+int QuantileSketch::Index(double value) {
+    return static_cast<int>(std::ceil(std::log(value) / kLogGamma));
+}
+
+// The point of bin i with the same relative distance to both bounds
+double QuantileSketch::Value(int index) {
+    return 2.0 * std::pow(kGamma, index) / (kGamma + 1.0);
+}
+
+void QuantileSketch::Extend(int low, int high) {
+    if (bins_.empty()) {
+        offset_ = std::max(low, high - kMaxBins + 1);
+        bins_.assign(static_cast<size_t>(high - offset_ + 1), 0);
+        return;
+    }
+
+    const int old_high = offset_ + static_cast<int>(bins_.size()) - 1;
+    int new_low = std::min(low, offset_);
+    const int new_high = std::max(high, old_high);
+    if (new_high - new_low + 1 > kMaxBins) {
+        new_low = new_high - kMaxBins + 1;
+    }
+
+    if (new_low == offset_) {
+        bins_.resize(static_cast<size_t>(new_high - offset_ + 1), 0);
+        return;
+    }
+
+    // The span moves down, or up when the lowest bins are folded together
+    std::vector<quint64> bins(static_cast<size_t>(new_high - new_low + 1), 0);
+    for (size_t i = 0; i < bins_.size(); ++i) {
+        const int index = std::max(offset_ + static_cast<int>(i), new_low);
+        bins[static_cast<size_t>(index - new_low)] += bins_[i];
+    }
+    bins_.swap(bins);
+    offset_ = new_low;
+}
+
+void QuantileSketch::Add(double value, quint64 count) {
+    if (count == 0) {
+        return;
+    }
+    count_ += count;
+    if (!(value > kMinValue)) {
+        zero_count_ += count;
+        return;
+    }
+
+    const int index = Index(value);
+    if (bins_.empty() || index < offset_ || index >= offset_ + static_cast<int>(bins_.size())) {
+        Extend(index, index);
+    }
+    bins_[static_cast<size_t>(std::max(index, offset_) - offset_)] += count;
+}
+
+void QuantileSketch::Merge(const QuantileSketch &other) {
+    count_ += other.count_;
+    zero_count_ += other.zero_count_;
+    if (other.bins_.empty()) {
+        return;
+    }
+
+    Extend(other.offset_, other.offset_ + static_cast<int>(other.bins_.size()) - 1);
+    for (size_t i = 0; i < other.bins_.size(); ++i) {
+        const int index = std::max(other.offset_ + static_cast<int>(i), offset_);
+        bins_[static_cast<size_t>(index - offset_)] += other.bins_[i];
+    }
+}
+
+void QuantileSketch::Clear() {
+    bins_.clear();
+    zero_count_ = 0;
+    count_ = 0;
+}
+
+double QuantileSketch::Quantile(double q) const {
+    if (count_ == 0) {
+        return 0.0;
+    }
+    const quint64 rank = static_cast<quint64>(std::clamp(q, 0.0, 1.0) * static_cast<double>(count_ - 1));
+    quint64 seen = zero_count_;
+    if (rank < seen) {
+        return 0.0;
+    }
+    for (size_t i = 0; i < bins_.size(); ++i) {
+        seen += bins_[i];
+        if (rank < seen) {
+            return Value(offset_ + static_cast<int>(i));
+        }
+    }
+    return Value(offset_ + static_cast<int>(bins_.size()) - 1);
+}
+
+QByteArray QuantileSketch::Serialize() const {
+    QByteArray out;
+    out.reserve(static_cast<qsizetype>(bins_.size()) + 16);
+    out.append(kFormatVersion);
+    writeVarint(out, zero_count_);
+    // Zigzag so that negative offsets (values below 1) stay short
+    writeVarint(out, (static_cast<quint64>(offset_) << 1) ^ static_cast<quint64>(offset_ >> 31));
+    writeVarint(out, bins_.size());
+    for (quint64 bin : bins_) {
+        writeVarint(out, bin);
+    }
+    return out;
+}
+
+bool QuantileSketch::Deserialize(const QByteArray &data, QuantileSketch &out) {
+    out.Clear();
+    if (data.isEmpty() || data[0] != kFormatVersion) {
+        return false;
+    }
+
+    qsizetype pos = 1;
+    quint64 zero_count, offset, size;
+    if (!readVarint(data, pos, zero_count) || !readVarint(data, pos, offset) || !readVarint(data, pos, size)
+        || size > static_cast<quint64>(kMaxBins)) {
+        return false;
+    }
+
+    QuantileSketch sketch;
+    sketch.zero_count_ = zero_count;
+    sketch.count_ = zero_count;
+    sketch.offset_ = static_cast<int>((offset >> 1) ^ (~(offset & 1) + 1));
+    sketch.bins_.resize(static_cast<size_t>(size));
+    for (quint64 &bin : sketch.bins_) {
+        if (!readVarint(data, pos, bin)) {
+            return false;
+        }
+        sketch.count_ += bin;
+    }
+    out = std::move(sketch);
+    return true;
+}
+
+void SketchRecord::Add(double value) {
+    if (sketch.Empty()) {
+        min = max = value;
+    } else {
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+    sum += value;
+    sketch.Add(value);
+}
+
+void SketchRecord::Merge(const SketchRecord &other) {
+    if (other.sketch.Empty()) {
+        return;
+    }
+    if (sketch.Empty()) {
+        start = other.start;
+        duration = other.duration;
+        min = other.min;
+        max = other.max;
+    } else {
+        const qint64 end = std::max(start + duration, other.start + other.duration);
+        start = std::min(start, other.start);
+        duration = end - start;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+    sum += other.sum;
+    sketch.Merge(other.sketch);
+}
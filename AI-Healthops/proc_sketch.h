@@ -0,0 +1,68 @@
+#ifndef PROC_SKETCH_H
+#define PROC_SKETCH_H
+
+#include <QByteArray>
+#include <QString>
+#include <QtGlobal>
+
+#include <vector>
+
+// Quantile sketch in the style of DDSketch: values are counted in bins whose
+// bounds grow by a factor of (1 + a) / (1 - a), so every quantile is within
+// a relative error a of a value that was added. Bins are kept as a dense
+// span from the lowest to the highest one in use; when the span would grow
+// past kMaxBins the lowest bins are folded together, which only loses
+// accuracy on the low quantiles. Two sketches merge by adding their bins, so
+// a sketch of any range is the merge of the sketches of its parts.
+// Values at or below kMinValue, including zero, share one bin.
+struct QuantileSketch
+{
+    static constexpr double kRelativeAccuracy = 0.01;
+    static constexpr double kMinValue = 1e-3;
+    static constexpr int kMaxBins = 2048;
+
+    void Add(double value, quint64 count = 1);
+    void Merge(const QuantileSketch &other);
+    void Clear();
+
+    // Value at quantile q in [0, 1]; 0 for an empty sketch
+    double Quantile(double q) const;
+
+    quint64 Count() const { return count_; }
+    bool Empty() const { return count_ == 0; }
+    size_t BinCount() const { return bins_.size(); }
+
+    // Compact form for storage: varint counts of the span and the zero bin
+    QByteArray Serialize() const;
+    static bool Deserialize(const QByteArray &data, QuantileSketch &out);
+
+private:
+    static int Index(double value);
+    static double Value(int index);
+    void Extend(int low, int high);
+
+    int offset_ = 0;                // index of bins_[0]
+    std::vector<quint64> bins_;
+    quint64 zero_count_ = 0;
+    quint64 count_ = 0;
+};
+
+// Sketch and moments of one series over one time bucket, as stored in the
+// sketches table
+struct SketchRecord {
+    quint32 pid = 0;
+    QString process;
+    QString metric;
+    qint64 start = 0;        // ms since epoch
+    qint64 duration = 0;     // ms
+    double sum = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+    QuantileSketch sketch;
+
+    void Add(double value);
+    // Adds other to this record, widening the time span to cover both
+    void Merge(const SketchRecord &other);
+};
+
+#endif // PROC_SKETCH_H
@@ -0,0 +1,345 @@
+#include "proc_snapshot.h"
+#include "proc_pool.h"
+#include "proc_stats.h"
+#include "proc_trace.h"
+
+#include <QHash>
+#include <QDateTime>
+
+#include <windows.h>
+#include <tlhelp32.h>
+#include <psapi.h>
+
+#include <string>
+
+// Helper function to get current user name
+static QString getCurrentUserName() {
+    char username[256];
+    DWORD size = sizeof(username);
+    if (GetUserNameA(username, &size)) {
+        return QString::fromLocal8Bit(username);
+    }
+    return "Unknown";
+}
+
+static quint64 fileTimeToUInt64(const FILETIME &ft) {
+    ULARGE_INTEGER value;
+    value.LowPart = ft.dwLowDateTime;
+    value.HighPart = ft.dwHighDateTime;
+    return value.QuadPart;
+}
+
+const char *ProcessSnapshot::SeriesName(int series) {
+    switch (series) {
+    case CpuPercent: return "CPU_PERCENT";
+    case IoOpsPerSec: return "IO_OPS_PER_SEC";
+    case WriteBytesPerSec: return "IO_WRITEBYTES_PER_SEC";
+    default: return "PROC_WORKINGSETSIZE";
+    }
+}
+
+const char *ProcessSnapshot::SketchMetric(int series) {
+    switch (series) {
+    case CpuPercent: return "SNAP_CPU_PERCENT";
+    case IoOpsPerSec: return "SNAP_IO_OPS_PER_SEC";
+    case WriteBytesPerSec: return "SNAP_IO_WRITEBYTES_PER_SEC";
+    default: return "SNAP_WORKINGSET";
+    }
+}
+
+quint32 ProcessSnapshot::SeriesGroup(int series) {
+    switch (series) {
+    case CpuPercent: return CpuMetrics;
+    case WorkingSet: return MemoryMetrics;
+    default: return IoMetrics;
+    }
+}
+
+double ProcessSnapshot::SeriesValue(int series, size_t row) const {
+    switch (series) {
+    case CpuPercent: return cpu_user_percent[row] + cpu_kernel_percent[row];
+    case IoOpsPerSec: return io_ops_per_sec[row];
+    case WriteBytesPerSec: return io_write_bytes_per_sec[row];
+    default: return static_cast<double>(working_set[row]);
+    }
+}
+
+void ProcessSnapshot::Clear() {
+    time_stamp = 0;
+    system_time = 0;
+    pids.clear();
+    names.clear();
+    users.clear();
+    kernel_times.clear();
+    user_times.clear();
+    cpu_user_percent.clear();
+    cpu_kernel_percent.clear();
+    working_set.clear();
+    io_operations.clear();
+    io_ops_per_sec.clear();
+    io_write_bytes.clear();
+    io_write_bytes_per_sec.clear();
+    groups.clear();
+}
+
+void ProcessSnapshot::Reserve(size_t count) {
+    pids.reserve(count);
+    names.reserve(count);
+    users.reserve(count);
+    kernel_times.reserve(count);
+    user_times.reserve(count);
+    cpu_user_percent.reserve(count);
+    cpu_kernel_percent.reserve(count);
+    working_set.reserve(count);
+    io_operations.reserve(count);
+    io_ops_per_sec.reserve(count);
+    io_write_bytes.reserve(count);
+    io_write_bytes_per_sec.reserve(count);
+    groups.reserve(count);
+}
+
+void ProcessSnapshot::EraseRows(size_t first, size_t last) {
+    pids.erase(pids.begin() + first, pids.begin() + last);
+    names.erase(names.begin() + first, names.begin() + last);
+    users.erase(users.begin() + first, users.begin() + last);
+    kernel_times.erase(kernel_times.begin() + first, kernel_times.begin() + last);
+    user_times.erase(user_times.begin() + first, user_times.begin() + last);
+    cpu_user_percent.erase(cpu_user_percent.begin() + first, cpu_user_percent.begin() + last);
+    cpu_kernel_percent.erase(cpu_kernel_percent.begin() + first, cpu_kernel_percent.begin() + last);
+    working_set.erase(working_set.begin() + first, working_set.begin() + last);
+    io_operations.erase(io_operations.begin() + first, io_operations.begin() + last);
+    io_ops_per_sec.erase(io_ops_per_sec.begin() + first, io_ops_per_sec.begin() + last);
+    io_write_bytes.erase(io_write_bytes.begin() + first, io_write_bytes.begin() + last);
+    io_write_bytes_per_sec.erase(io_write_bytes_per_sec.begin() + first, io_write_bytes_per_sec.begin() + last);
+    groups.erase(groups.begin() + first, groups.begin() + last);
+}
+
+void ProcessSnapshot::AppendRow(const ProcessSnapshot &from, size_t from_row) {
+    pids.push_back(from.pids[from_row]);
+    names.push_back(from.names[from_row]);
+    users.push_back(from.users[from_row]);
+    kernel_times.push_back(from.kernel_times[from_row]);
+    user_times.push_back(from.user_times[from_row]);
+    cpu_user_percent.push_back(from.cpu_user_percent[from_row]);
+    cpu_kernel_percent.push_back(from.cpu_kernel_percent[from_row]);
+    working_set.push_back(from.working_set[from_row]);
+    io_operations.push_back(from.io_operations[from_row]);
+    io_ops_per_sec.push_back(from.io_ops_per_sec[from_row]);
+    io_write_bytes.push_back(from.io_write_bytes[from_row]);
+    io_write_bytes_per_sec.push_back(from.io_write_bytes_per_sec[from_row]);
+    groups.push_back(from.groups[from_row]);
+}
+
+bool ProcessSnapshot::AssignRow(size_t row, const ProcessSnapshot &from, size_t from_row) {
+    const bool changed = names[row] != from.names[from_row]
+                         || users[row] != from.users[from_row]
+                         || cpu_user_percent[row] != from.cpu_user_percent[from_row]
+                         || cpu_kernel_percent[row] != from.cpu_kernel_percent[from_row]
+                         || working_set[row] != from.working_set[from_row];
+
+    pids[row] = from.pids[from_row];
+    if (changed) {
+        names[row] = from.names[from_row];
+        users[row] = from.users[from_row];
+        cpu_user_percent[row] = from.cpu_user_percent[from_row];
+        cpu_kernel_percent[row] = from.cpu_kernel_percent[from_row];
+        working_set[row] = from.working_set[from_row];
+    }
+    kernel_times[row] = from.kernel_times[from_row];
+    user_times[row] = from.user_times[from_row];
+    io_operations[row] = from.io_operations[from_row];
+    io_ops_per_sec[row] = from.io_ops_per_sec[from_row];
+    io_write_bytes[row] = from.io_write_bytes[from_row];
+    io_write_bytes_per_sec[row] = from.io_write_bytes_per_sec[from_row];
+    groups[row] = from.groups[from_row];
+    return changed;
+}
+
+// Counters of one process, read by one per-process query
+struct ProcessCounters {
+    quint64 kernel_time = 0;
+    quint64 user_time = 0;
+    quint64 working_set = 0;
+    quint64 io_operations = 0;
+    quint64 io_write_bytes = 0;
+};
+
+// Processes queried per pool task: enough to amortize taking a task, few
+// enough that slow processes can be stolen away
+static const size_t kQueryGrain = 16;
+
+// Makes only the calls of groups, with no more rights than they need
+static ProcessCounters queryProcess(quint32 pid, quint32 groups) {
+    ProcessCounters counters;
+    // GetProcessMemoryInfo also needs PROCESS_VM_READ, which protected
+    // processes refuse; those are opened again for their times and I/O only
+    HANDLE hProcess = NULL;
+    if (groups & MemoryMetrics) {
+        hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | PROCESS_VM_READ, FALSE, pid);
+    }
+    const bool readable = hProcess != NULL;
+    if (!readable && (groups & (CpuMetrics | IoMetrics))) {
+        hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    }
+    if (hProcess == NULL) {
+        return counters;
+    }
+
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (readable && GetProcessMemoryInfo(hProcess, &pmc, sizeof(pmc))) {
+        counters.working_set = pmc.WorkingSetSize;
+    }
+
+    FILETIME creation, exit, kernel, user;
+    if ((groups & CpuMetrics) && GetProcessTimes(hProcess, &creation, &exit, &kernel, &user)) {
+        counters.kernel_time = fileTimeToUInt64(kernel);
+        counters.user_time = fileTimeToUInt64(user);
+    }
+
+    IO_COUNTERS io;
+    if ((groups & IoMetrics) && GetProcessIoCounters(hProcess, &io)) {
+        counters.io_operations = io.ReadOperationCount + io.WriteOperationCount;
+        counters.io_write_bytes = io.WriteTransferCount;
+    }
+    CloseHandle(hProcess);
+    return counters;
+}
+
+bool TakeProcessSnapshot(const ProcessSnapshot &previous, ProcessSnapshot &next, const std::atomic<bool> *cancel,
+                         WorkStealingPool *pool, const MetricSelection *metrics) {
+    TRACE_SPAN("snapshot.sweep");
+    next.Clear();
+    next.Reserve(previous.Size());
+
+    static const QString currentUser = getCurrentUserName();
+
+    // The tick's boundary: every process is measured against this moment
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    next.system_time = fileTimeToUInt64(now);
+    next.time_stamp = QDateTime::currentMSecsSinceEpoch();
+
+    const double elapsed = previous.system_time != 0 ? static_cast<double>(next.system_time - previous.system_time) : 0.0;
+
+    // Take a snapshot of all processes in the system
+    HANDLE hProcessSnap = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if (hProcessSnap == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    PROCESSENTRY32 pe32;
+    pe32.dwSize = sizeof(PROCESSENTRY32);
+    if (!Process32First(hProcessSnap, &pe32)) {
+        CloseHandle(hProcessSnap);
+        return false;
+    }
+
+    // First the list itself, which is cheap; names go into one buffer
+    std::vector<quint32> pids;
+    std::vector<size_t> nameEnds;
+    std::wstring nameChars;
+    pids.reserve(previous.Size());
+    nameEnds.reserve(previous.Size());
+    do {
+        pids.push_back(pe32.th32ProcessID);
+        nameChars.append(pe32.szExeFile);
+        nameEnds.push_back(nameChars.size());
+    } while (Process32Next(hProcessSnap, &pe32));
+    CloseHandle(hProcessSnap);
+
+    // Then the per-process queries, several system calls each. Every task
+    // writes only its own rows, so the results need no lock and keep the
+    // list's order.
+    // Groups by image name are only looked up when some are configured
+    std::vector<ProcessCounters> counters(pids.size());
+    std::vector<quint32> groups(pids.size(), metrics ? metrics->groups : kAllMetricGroups);
+    const bool byProcess = metrics && !metrics->by_process.isEmpty();
+    auto query = [&](size_t begin, size_t end) {
+        TRACE_SPAN("snapshot.query");
+        for (size_t i = begin; i < end; ++i) {
+            if (cancel && cancel->load(std::memory_order_relaxed)) {
+                return;
+            }
+            if (byProcess) {
+                const size_t nameBegin = i == 0 ? 0 : nameEnds[i - 1];
+                groups[i] = metrics->For(QString::fromWCharArray(nameChars.data() + nameBegin,
+                                                                 static_cast<qsizetype>(nameEnds[i] - nameBegin)));
+            }
+            counters[i] = queryProcess(pids[i], groups[i]);
+        }
+    };
+    if (pool) {
+        pool->ParallelFor(pids.size(), kQueryGrain, query);
+    } else {
+        query(0, pids.size());
+    }
+    if (cancel && cancel->load(std::memory_order_relaxed)) {
+        return false;
+    }
+
+    // Toolhelp returns processes in a mostly stable order, so the previous
+    // row at the same position is tried before falling back to the hash.
+    QHash<quint32, size_t> previousRows;
+    auto findPrevious = [&](quint32 pid, size_t hint) -> int {
+        if (hint < previous.Size() && previous.pids[hint] == pid) {
+            return static_cast<int>(hint);
+        }
+        if (previousRows.isEmpty() && previous.Size() != 0) {
+            previousRows.reserve(static_cast<qsizetype>(previous.Size()));
+            for (size_t i = 0; i < previous.Size(); ++i) {
+                previousRows.insert(previous.pids[i], i);
+            }
+        }
+        auto it = previousRows.constFind(pid);
+        return it == previousRows.constEnd() ? -1 : static_cast<int>(it.value());
+    };
+
+    for (size_t row = 0; row < pids.size(); ++row) {
+        const quint32 pid = pids[row];
+        const ProcessCounters &c = counters[row];
+
+        double cpuUser = 0.0;
+        double cpuKernel = 0.0;
+        double ioOpsPerSec = 0.0;
+        double ioWriteBytesPerSec = 0.0;
+        const int prev = findPrevious(pid, row);
+        if (prev >= 0 && elapsed > 0.0) {
+            if (c.user_time >= previous.user_times[prev]) {
+                cpuUser = (c.user_time - previous.user_times[prev]) / elapsed * 100.0;
+            }
+            if (c.kernel_time >= previous.kernel_times[prev]) {
+                cpuKernel = (c.kernel_time - previous.kernel_times[prev]) / elapsed * 100.0;
+            }
+            if (c.io_operations >= previous.io_operations[prev]) {
+                // elapsed is in 100 ns units
+                ioOpsPerSec = (c.io_operations - previous.io_operations[prev]) / elapsed * 1e7;
+            }
+            if (c.io_write_bytes >= previous.io_write_bytes[prev]) {
+                ioWriteBytesPerSec = (c.io_write_bytes - previous.io_write_bytes[prev]) / elapsed * 1e7;
+            }
+        }
+
+        next.pids.push_back(pid);
+        // Share the previous QString when the name did not change instead of
+        // converting and allocating it again on every refresh
+        const size_t nameBegin = row == 0 ? 0 : nameEnds[row - 1];
+        const QStringView exeName(nameChars.data() + nameBegin, static_cast<qsizetype>(nameEnds[row] - nameBegin));
+        if (prev >= 0 && previous.names[prev] == exeName) {
+            next.names.push_back(previous.names[prev]);
+        } else {
+            next.names.push_back(exeName.toString());
+        }
+        next.users.push_back(currentUser); // For simplicity, assuming current user
+        next.kernel_times.push_back(c.kernel_time);
+        next.user_times.push_back(c.user_time);
+        next.cpu_user_percent.push_back(cpuUser);
+        next.cpu_kernel_percent.push_back(cpuKernel);
+        next.working_set.push_back(c.working_set);
+        next.io_operations.push_back(c.io_operations);
+        next.io_ops_per_sec.push_back(ioOpsPerSec);
+        next.io_write_bytes.push_back(c.io_write_bytes);
+        next.io_write_bytes_per_sec.push_back(ioWriteBytesPerSec);
+        next.groups.push_back(groups[row]);
+    }
+    return true;
+}
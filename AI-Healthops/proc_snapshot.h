@@ -0,0 +1,65 @@
+#ifndef PROC_SNAPSHOT_H
+#define PROC_SNAPSHOT_H
+
+#include <QString>
+#include <QtGlobal>
+
+#include <vector>
+#include <atomic>
+
+struct WorkStealingPool;
+struct MetricSelection;
+
+// One enumeration of all processes, stored column by column. Rows are
+// matched between consecutive snapshots by PID to compute CPU usage.
+struct ProcessSnapshot
+{
+    // Per-process series tracked across all processes
+    enum Series { CpuPercent, IoOpsPerSec, WorkingSet, WriteBytesPerSec, SeriesCount };
+    static const char *SeriesName(int series);
+    // Name of the series' rows in the sketches table. Kept apart from the
+    // Stats field names, which the sampled process's own sketches use.
+    static const char *SketchMetric(int series);
+    // MetricGroup a series is read with
+    static quint32 SeriesGroup(int series);
+    double SeriesValue(int series, size_t row) const;
+
+    size_t Size() const { return pids.size(); }
+    void Clear();
+    void Reserve(size_t count);
+
+    // Row helpers used to keep a model's rows in a stable order
+    void EraseRows(size_t first, size_t last);
+    void AppendRow(const ProcessSnapshot &from, size_t from_row);
+    // Overwrites row with from_row and returns whether any shown value changed
+    bool AssignRow(size_t row, const ProcessSnapshot &from, size_t from_row);
+
+    qint64 time_stamp = 0;      // ms since epoch
+    quint64 system_time = 0;    // FILETIME units, used for CPU deltas
+
+    std::vector<quint32> pids;
+    std::vector<QString> names;
+    std::vector<QString> users;
+    std::vector<quint64> kernel_times;
+    std::vector<quint64> user_times;
+    std::vector<double> cpu_user_percent;
+    std::vector<double> cpu_kernel_percent;
+    std::vector<quint64> working_set;
+    std::vector<quint64> io_operations;   // reads + writes since the process started
+    std::vector<double> io_ops_per_sec;
+    std::vector<quint64> io_write_bytes;  // bytes written since the process started
+    std::vector<double> io_write_bytes_per_sec;
+    std::vector<quint32> groups;          // MetricGroups queried; the other columns are zero
+};
+
+// Fills next with the current process list. CPU percentages and I/O rates are computed
+// against previous, which may be empty for the first call. The vectors in
+// next are cleared, not freed, so repeated calls reuse their capacity.
+// With a pool the per-process queries run on it; rows keep the same order.
+// Each process is only queried for the groups metrics picks for it, every
+// group without metrics.
+// Returns false if enumeration failed or cancel was set part way through.
+bool TakeProcessSnapshot(const ProcessSnapshot &previous, ProcessSnapshot &next, const std::atomic<bool> *cancel = nullptr,
+                         WorkStealingPool *pool = nullptr, const MetricSelection *metrics = nullptr);
+
+#endif // PROC_SNAPSHOT_H
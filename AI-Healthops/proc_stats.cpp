@@ -1,7 +1,54 @@
 #include "proc_stats.h"
+#include "proc_trace.h"
 
+#include <QStringList>
 
-PerformanceStats::PerformanceStats(std::string db_path, int pid, int stats_query_interval) : pid_(pid), stats_query_interval_(stats_query_interval) {
+#include <algorithm>
+
+// Names of the groups in configuration
+static const struct {
+    const char *name;
+    quint32 group;
+} kMetricGroupNames[] = {
+    {"cpu", CpuMetrics},
+    {"memory", MemoryMetrics},
+    {"io", IoMetrics},
+};
+
+quint32 MetricSelection::For(const QString &process) const {
+    return by_process.value(process.toLower(), groups);
+}
+
+bool ParseMetricGroups(const QString &list, quint32 &groups) {
+    quint32 parsed = 0;
+    for (const QString &item : list.split(',', Qt::SkipEmptyParts)) {
+        const QString name = item.trimmed().toLower();
+        if (name == "all") {
+            parsed |= kAllMetricGroups;
+            continue;
+        }
+        auto group = std::find_if(std::begin(kMetricGroupNames), std::end(kMetricGroupNames),
+                                  [&](const auto &g) { return name == QLatin1String(g.name); });
+        if (group == std::end(kMetricGroupNames)) {
+            return false;
+        }
+        parsed |= group->group;
+    }
+    groups = parsed;
+    return true;
+}
+
+QString MetricGroupNames(quint32 groups) {
+    QStringList names;
+    for (const auto &group : kMetricGroupNames) {
+        if (groups & group.group) {
+            names.append(group.name);
+        }
+    }
+    return names.isEmpty() ? "none" : names.join(',');
+}
+
+PerformanceStats::PerformanceStats(std::string db_path, int pid, int stats_query_interval, const MetricSelection &selection) : pid_(pid), stats_query_interval_(stats_query_interval) {
     //create or open db
     //create thread to periodically query the stats and save it to db
 
@@ -10,18 +57,50 @@ PerformanceStats::PerformanceStats(std::string db_path, int pid, int stats_query
     memcpy(&prev_system_time, &ftime, sizeof(FILETIME));
 
     if (pid_ != 0) {
-        const DWORD kRights = PROCESS_QUERY_INFORMATION | PROCESS_VM_READ;
-        hProc = ::OpenProcess(kRights, FALSE, pid_);
+        // Enough for the image name, the CPU times and the I/O counters
+        hProc = ::OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid_);
     }
     else {
         hProc = GetCurrentProcess();
     }
 
-    GetProcessTimes(hProc, &ftime, &ftime, &fsys, &fuser);
-    memcpy(&prev_kern_time, &fsys, sizeof(FILETIME));
-    memcpy(&prev_user_time, &fuser, sizeof(FILETIME));
+    // Resolve the identity once so every sample can be attributed
+    process_id_ = pid_ != 0 ? static_cast<quint32>(pid_) : static_cast<quint32>(GetCurrentProcessId());
+    wchar_t image_path[MAX_PATH];
+    DWORD image_path_size = MAX_PATH;
+    if (hProc && QueryFullProcessImageNameW(hProc, 0, image_path, &image_path_size)) {
+        QString path = QString::fromWCharArray(image_path, static_cast<int>(image_path_size));
+        process_name_ = path.mid(path.lastIndexOf('\\') + 1);
+    }
+    else {
+        process_name_ = QString("PID %1").arg(process_id_);
+    }
 
-    GetProcessIoCounters(hProc, &prev_io_counters);
+    // The plan: disabled groups are never read, not even once here
+    groups_ = selection.For(process_name_);
+    if (groups_ & CpuMetrics) {
+        plan_.push_back(&PerformanceStats::SampleCpu);
+        GetProcessTimes(hProc, &ftime, &ftime, &fsys, &fuser);
+        memcpy(&prev_kern_time, &fsys, sizeof(FILETIME));
+        memcpy(&prev_user_time, &fuser, sizeof(FILETIME));
+    }
+    if (groups_ & MemoryMetrics) {
+        plan_.push_back(&PerformanceStats::SampleMemory);
+        // GetProcessMemoryInfo also needs to read the process's memory
+        if (pid_ != 0) {
+            HANDLE readable = ::OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | PROCESS_VM_READ, FALSE, pid_);
+            if (readable) {
+                if (hProc) {
+                    CloseHandle(hProc);
+                }
+                hProc = readable;
+            }
+        }
+    }
+    if (groups_ & IoMetrics) {
+        plan_.push_back(&PerformanceStats::SampleIo);
+        GetProcessIoCounters(hProc, &prev_io_counters);
+    }
 }
 
 
@@ -39,92 +118,101 @@ PerformanceStats::PerformanceStats(std::string db_path, int pid, int stats_query
 
 
     Stats PerformanceStats::GetStats() {
-        Stats stats;
+        TRACE_SPAN("stats.get_stats");
+        Stats stats{};
         try {
-            FILETIME ftime, fsys, fuser;
-            ULARGE_INTEGER now, kernel, user;
+            FILETIME ftime;
+            ULARGE_INTEGER now;
             GetSystemTimeAsFileTime(&ftime);
             memcpy(&now, &ftime, sizeof(FILETIME));
-
-            GetProcessTimes(hProc, &ftime, &ftime, &fsys, &fuser);
-            memcpy(&kernel, &fsys, sizeof(FILETIME));
-            memcpy(&user, &fuser, sizeof(FILETIME));
-
-            double kernelTimeDiff = (double)(kernel.QuadPart - prev_kern_time.QuadPart);
-            double userTimeDiff = (double)(user.QuadPart - prev_user_time.QuadPart);
             double systemTimeDiff = (double)(now.QuadPart - prev_system_time.QuadPart);
-
-            // Update global variables for next calculation
-            prev_kern_time = kernel;
-            prev_user_time = user;
             prev_system_time = now;
 
-            stats.CPU_KERNTOTAL = static_cast<quint64>(kernelTimeDiff);
-            if (systemTimeDiff > 0.001 && kernelTimeDiff > 0.001) {
-                stats.CPU_KERNPERCENT = static_cast<quint64>((kernelTimeDiff / systemTimeDiff) * 100.0);
-            }
-            else {
-                stats.CPU_KERNPERCENT = 0;
+            for (Step step : plan_) {
+                (this->*step)(stats, systemTimeDiff);
             }
+        }
+        catch(...){}
 
-            stats.CPU_USERTOTAL = static_cast<quint64>(userTimeDiff);
-            if (systemTimeDiff > 0.001 && userTimeDiff > 0.001) {
-                stats.CPU_USERPERCENT = static_cast<quint64>((userTimeDiff / systemTimeDiff) * 100.0);
-            }
-            else {
-                stats.CPU_USERPERCENT = 0;
-            }
+        return stats;
+    }
 
+    void PerformanceStats::SampleCpu(Stats &stats, double systemTimeDiff) {
+        FILETIME ftime, fsys, fuser;
+        ULARGE_INTEGER kernel, user;
+        GetProcessTimes(hProc, &ftime, &ftime, &fsys, &fuser);
+        memcpy(&kernel, &fsys, sizeof(FILETIME));
+        memcpy(&user, &fuser, sizeof(FILETIME));
 
-            PROCESS_MEMORY_COUNTERS counters;
-            if (hProc && (GetProcessMemoryInfo(hProc, &counters, sizeof(counters)) != 0)) {
-                stats.PROC_PAGEFAULTCOUNT = counters.PageFaultCount;
-                stats.PROC_PEAKWORKINGSETSIZE = counters.PeakWorkingSetSize;
-                stats.PROC_WORKINGSETSIZE = counters.WorkingSetSize;
-                stats.PROC_QUOTAPAGEDPOOLUSAGE = counters.QuotaPagedPoolUsage;
-                stats.PROC_QUOTANONPAGEDPOOLUSAGE = counters.QuotaPeakNonPagedPoolUsage;
-                stats.PROC_QUOTAPEAKNONPAGEDPOOLUSAGE = counters.QuotaNonPagedPoolUsage;
-                stats.PROC_PAGEFILEUSAGE = counters.PagefileUsage;
-            }
+        double kernelTimeDiff = (double)(kernel.QuadPart - prev_kern_time.QuadPart);
+        double userTimeDiff = (double)(user.QuadPart - prev_user_time.QuadPart);
 
-            IO_COUNTERS cur_io_counters;
-            if (GetProcessIoCounters(hProc, &cur_io_counters)) {
-                stats.IO_IOPS_READ = (cur_io_counters.ReadOperationCount - prev_io_counters.ReadOperationCount) /* / stats_query_interval_ */;
+        // Update global variables for next calculation
+        prev_kern_time = kernel;
+        prev_user_time = user;
 
+        stats.CPU_KERNTOTAL = static_cast<quint64>(kernelTimeDiff);
+        if (systemTimeDiff > 0.001 && kernelTimeDiff > 0.001) {
+            stats.CPU_KERNPERCENT = static_cast<quint64>((kernelTimeDiff / systemTimeDiff) * 100.0);
+        }
+        else {
+            stats.CPU_KERNPERCENT = 0;
+        }
 
-                stats.IO_IOPS_WRITE = (cur_io_counters.WriteOperationCount - prev_io_counters.WriteOperationCount) /* / stats_query_interval_ */ ;
+        stats.CPU_USERTOTAL = static_cast<quint64>(userTimeDiff);
+        if (systemTimeDiff > 0.001 && userTimeDiff > 0.001) {
+            stats.CPU_USERPERCENT = static_cast<quint64>((userTimeDiff / systemTimeDiff) * 100.0);
+        }
+        else {
+            stats.CPU_USERPERCENT = 0;
+        }
+    }
 
-                stats.IO_TOTALBYTESREAD = cur_io_counters.ReadTransferCount - prev_io_counters.ReadTransferCount;
-                if (stats.IO_TOTALBYTESREAD != 0) {
-                    stats.IO_BYTESREADPERSEC = stats.IO_TOTALBYTESREAD / systemTimeDiff;
-                }
-                else {
-                    stats.IO_BYTESREADPERSEC = 0;
-                }
+    void PerformanceStats::SampleMemory(Stats &stats, double) {
+        PROCESS_MEMORY_COUNTERS counters;
+        if (hProc && (GetProcessMemoryInfo(hProc, &counters, sizeof(counters)) != 0)) {
+            stats.PROC_PAGEFAULTCOUNT = counters.PageFaultCount;
+            stats.PROC_PEAKWORKINGSETSIZE = counters.PeakWorkingSetSize;
+            stats.PROC_WORKINGSETSIZE = counters.WorkingSetSize;
+            stats.PROC_QUOTAPAGEDPOOLUSAGE = counters.QuotaPagedPoolUsage;
+            stats.PROC_QUOTANONPAGEDPOOLUSAGE = counters.QuotaPeakNonPagedPoolUsage;
+            stats.PROC_QUOTAPEAKNONPAGEDPOOLUSAGE = counters.QuotaNonPagedPoolUsage;
+            stats.PROC_PAGEFILEUSAGE = counters.PagefileUsage;
+        }
+    }
 
-                if (cur_io_counters.WriteTransferCount != 0) {
-                    stats.IO_TOTALBYTESWRITE = cur_io_counters.WriteTransferCount - prev_io_counters.WriteTransferCount;
-                }
-                else {
-                    stats.IO_TOTALBYTESWRITE = 0;
-                }
+    void PerformanceStats::SampleIo(Stats &stats, double systemTimeDiff) {
+        IO_COUNTERS cur_io_counters;
+        if (GetProcessIoCounters(hProc, &cur_io_counters)) {
+            stats.IO_IOPS_READ = (cur_io_counters.ReadOperationCount - prev_io_counters.ReadOperationCount) /* / stats_query_interval_ */;
 
-                if (stats.IO_TOTALBYTESWRITE != 0) {
-                    stats.IO_BYTESWRITEPERSEC = stats.IO_TOTALBYTESWRITE / systemTimeDiff;
-                }
-                else {
-                    stats.IO_BYTESWRITEPERSEC = 0;
-                }
 
-                prev_io_counters = cur_io_counters;
+            stats.IO_IOPS_WRITE = (cur_io_counters.WriteOperationCount - prev_io_counters.WriteOperationCount) /* / stats_query_interval_ */ ;
+
+            stats.IO_TOTALBYTESREAD = cur_io_counters.ReadTransferCount - prev_io_counters.ReadTransferCount;
+            if (stats.IO_TOTALBYTESREAD != 0) {
+                stats.IO_BYTESREADPERSEC = stats.IO_TOTALBYTESREAD / systemTimeDiff;
+            }
+            else {
+                stats.IO_BYTESREADPERSEC = 0;
+            }
 
+            if (cur_io_counters.WriteTransferCount != 0) {
+                stats.IO_TOTALBYTESWRITE = cur_io_counters.WriteTransferCount - prev_io_counters.WriteTransferCount;
+            }
+            else {
+                stats.IO_TOTALBYTESWRITE = 0;
             }
 
+            if (stats.IO_TOTALBYTESWRITE != 0) {
+                stats.IO_BYTESWRITEPERSEC = stats.IO_TOTALBYTESWRITE / systemTimeDiff;
+            }
+            else {
+                stats.IO_BYTESWRITEPERSEC = 0;
+            }
 
+            prev_io_counters = cur_io_counters;
         }
-        catch(...){}
-
-        return stats;
     }
 
 //    int PerformanceStats::SaveStats(Stats stats) {
@@ -135,3 +223,43 @@ PerformanceStats::PerformanceStats(std::string db_path, int pid, int stats_query
 //
 //    }
 
+
+// Expanded from STATS_METRICS, so it is one literal built by the compiler
+static const char kStatsCsvHeader[] = "PID,PROCESS,TIME_STAMP"
+#define STATS_CSV_COLUMN(name, cumulative, group) "," #name
+    STATS_METRICS(STATS_CSV_COLUMN)
+#undef STATS_CSV_COLUMN
+    "\n";
+
+QJsonObject StatsToJson(const StatsSample &sample) {
+    QJsonObject object;
+    object["PID"] = static_cast<qint64>(sample.pid);
+    object["PROCESS"] = sample.process;
+    object["TIME_STAMP"] = sample.time_stamp;
+    for (const StatsField &field : kStatsFields) {
+        object[QLatin1String(field.name)] = static_cast<qint64>(sample.stats.*field.member);
+    }
+    return object;
+}
+
+QByteArray StatsCsvHeader() {
+    return QByteArray::fromRawData(kStatsCsvHeader, sizeof(kStatsCsvHeader) - 1);
+}
+
+void AppendStatsCsv(const StatsSample &sample, QByteArray &out) {
+    out.append(QByteArray::number(sample.pid));
+    out.append(',');
+    // Process names may hold commas or quotes
+    QByteArray process = sample.process.toUtf8();
+    if (process.contains(',') || process.contains('"')) {
+        process = '"' + process.replace("\"", "\"\"") + '"';
+    }
+    out.append(process);
+    out.append(',');
+    out.append(QByteArray::number(sample.time_stamp));
+    for (const StatsField &field : kStatsFields) {
+        out.append(',');
+        out.append(QByteArray::number(sample.stats.*field.member));
+    }
+    out.append('\n');
+}
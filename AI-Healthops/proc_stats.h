@@ -1,32 +1,110 @@
 #ifndef PROC_STATS_H
 #define PROC_STATS_H
 
-#include "mainwindow.h"
+#include <QByteArray>
+#include <QHash>
+#include <QJsonObject>
+#include <QString>
+#include <QtGlobal>
+
+#include <string>
+#include <vector>
+
+#include <windows.h>
+#include <psapi.h>
+
+// Groups of metrics that are read with one call each. A PerformanceStats
+// only makes the calls of the groups it samples; the fields of the others
+// stay zero.
+enum MetricGroup : quint32 {
+    CpuMetrics = 1 << 0,      // GetProcessTimes
+    MemoryMetrics = 1 << 1,   // GetProcessMemoryInfo
+    IoMetrics = 1 << 2,       // GetProcessIoCounters
+};
+
+inline constexpr quint32 kAllMetricGroups = CpuMetrics | MemoryMetrics | IoMetrics;
+
+// Every metric a Stats record holds, as X(NAME, cumulative, group), in
+// storage and wire order. The record, the stats table and its bindings,
+// the CSV header and the kStatsFields table below are all expanded from
+// this list, so a new metric is one line here plus the code in its group's
+// sampling step that fills it. Cumulative fields are running counters;
+// per-sample statistics should look at their differences.
+#define STATS_METRICS(X) \
+    X(IO_IOPS_READ, false, IoMetrics) \
+    X(IO_IOPS_WRITE, false, IoMetrics) \
+    X(IO_BYTESREADPERSEC, false, IoMetrics) \
+    X(IO_BYTESWRITEPERSEC, false, IoMetrics) \
+    X(IO_TOTALBYTESREAD, false, IoMetrics) \
+    X(IO_TOTALBYTESWRITE, false, IoMetrics) \
+    X(CPU_KERNPERCENT, false, CpuMetrics) \
+    X(CPU_USERPERCENT, false, CpuMetrics) \
+    X(CPU_KERNTOTAL, false, CpuMetrics) \
+    X(CPU_USERTOTAL, false, CpuMetrics) \
+    X(PROC_PAGEFAULTCOUNT, true, MemoryMetrics) \
+    X(PROC_WORKINGSETSIZE, false, MemoryMetrics) \
+    X(PROC_PEAKWORKINGSETSIZE, false, MemoryMetrics) \
+    X(PROC_PAGEFILEUSAGE, false, MemoryMetrics) \
+    X(PROC_QUOTAPAGEDPOOLUSAGE, false, MemoryMetrics) \
+    X(PROC_QUOTANONPAGEDPOOLUSAGE, false, MemoryMetrics) \
+    X(PROC_QUOTAPEAKNONPAGEDPOOLUSAGE, false, MemoryMetrics)
 
 struct Stats {
-    quint64 IO_IOPS_READ;
-    quint64 IO_IOPS_WRITE;
-    quint64 IO_BYTESREADPERSEC;
-    quint64 IO_BYTESWRITEPERSEC;
-    quint64 IO_TOTALBYTESREAD;
-    quint64 IO_TOTALBYTESWRITE;
-    quint64 CPU_KERNPERCENT;
-    quint64 CPU_USERPERCENT;
-    quint64 CPU_KERNTOTAL;
-    quint64 CPU_USERTOTAL;
-    quint64 PROC_PAGEFAULTCOUNT;
-    quint64 PROC_WORKINGSETSIZE;
-    quint64 PROC_PEAKWORKINGSETSIZE;
-    quint64 PROC_PAGEFILEUSAGE;
-    quint64 PROC_QUOTAPAGEDPOOLUSAGE;
-    quint64 PROC_QUOTANONPAGEDPOOLUSAGE;
-    quint64 PROC_QUOTAPEAKNONPAGEDPOOLUSAGE;
+#define STATS_MEMBER(name, cumulative, group) quint64 name;
+    STATS_METRICS(STATS_MEMBER)
+#undef STATS_MEMBER
+};
+
+// The Stats fields in declaration order, for code that handles every metric
+// the same way
+struct StatsField {
+    const char *name;
+    quint64 Stats::*member;
+    bool cumulative;
+    quint32 group;
+};
+
+inline constexpr StatsField kStatsFields[] = {
+#define STATS_FIELD(name, cumulative, group) {#name, &Stats::name, cumulative, group},
+    STATS_METRICS(STATS_FIELD)
+#undef STATS_FIELD
 };
 
+inline constexpr size_t kStatsFieldCount = sizeof(kStatsFields) / sizeof(kStatsFields[0]);
+
+// A Stats record tagged with when and for which process it was taken
+struct StatsSample {
+    qint64 time_stamp = 0;  // ms since epoch
+    quint32 pid = 0;
+    QString process;
+    Stats stats;
+};
+
+// Export encoders: one object or CSV row per sample with PID, PROCESS,
+// TIME_STAMP and then every metric under its column name
+QJsonObject StatsToJson(const StatsSample &sample);
+QByteArray StatsCsvHeader();
+void AppendStatsCsv(const StatsSample &sample, QByteArray &out);
+
+// The metric groups to sample, for every process or by image name
+struct MetricSelection {
+    quint32 groups = kAllMetricGroups;
+    QHash<QString, quint32> by_process;   // keyed by lower-case image name
+
+    quint32 For(const QString &process) const;
+};
+
+// Parses a list such as "cpu,io" or "all"; false on an unknown group
+bool ParseMetricGroups(const QString &list, quint32 &groups);
+QString MetricGroupNames(quint32 groups);
+
 struct PerformanceStats
 {
 
-    PerformanceStats(std::string db_path = "", int pid = 0, int stats_query_interval = 0);
+    // Builds the sampling plan for the groups selection picks for the
+    // process; the handle is opened with no more rights than they need
+    PerformanceStats(std::string db_path = "", int pid = 0, int stats_query_interval = 0,
+                     const MetricSelection &selection = MetricSelection());
     ~PerformanceStats();
 
     std::vector<Stats> GetStats(quint64 start, quint64 end);
@@ -40,12 +118,24 @@ struct PerformanceStats
 
 
     int pid_;
+    quint32 process_id_ = 0;
+    QString process_name_;
     int stats_query_interval_;
     HANDLE hProc = nullptr;
     IO_COUNTERS prev_io_counters;
     ULARGE_INTEGER prev_kern_time;
     ULARGE_INTEGER prev_user_time;
     ULARGE_INTEGER prev_system_time;
+
+    // Groups sampled, and one step per group in the order they are read
+    using Step = void (PerformanceStats::*)(Stats &stats, double system_time_diff);
+    quint32 groups_ = 0;
+    std::vector<Step> plan_;
+
+private:
+    void SampleCpu(Stats &stats, double system_time_diff);
+    void SampleMemory(Stats &stats, double system_time_diff);
+    void SampleIo(Stats &stats, double system_time_diff);
 };
 
 
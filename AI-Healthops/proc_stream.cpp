@@ -0,0 +1,385 @@
+#include "proc_stream.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QThread>
+#include <QtEndian>
+
+#include <algorithm>
+#include <chrono>
+
+// Samples read from the ring per frame, and so per lock of the ring
+static const quint64 kBatchRecords = 1024;
+
+// Bytes a subscriber's socket may hold before it stops reading the ring
+static const qint64 kMaxBuffered = 1 << 20;
+
+// Longest request a subscriber may send
+static const qsizetype kMaxRequestBytes = 64 * 1024;
+
+static const qsizetype kFrameHeader = 4 + 1;
+static const qsizetype kSamplesHeader = 4 + 4 + 8;
+static const qsizetype kRecordHeader = 8 + 4;
+
+template <typename T>
+static char *put(char *out, T value) {
+    qToLittleEndian(value, out);
+    return out + sizeof(T);
+}
+
+template <typename T>
+static const char *get(const char *in, T &value) {
+    value = qFromLittleEndian<T>(in);
+    return in + sizeof(T);
+}
+
+static qsizetype metricCount(quint64 metrics) {
+    qsizetype count = 0;
+    for (; metrics; metrics &= metrics - 1) {
+        ++count;
+    }
+    return count;
+}
+
+static qsizetype recordSize(quint64 metrics) {
+    return kRecordHeader + 8 * metricCount(metrics & kStreamAllMetrics);
+}
+
+bool StreamFilter::Matches(quint32 pid) const {
+    // DecodeSubscribe() leaves the pids sorted
+    return pids.empty() || std::binary_search(pids.begin(), pids.end(), pid);
+}
+
+qint64 StreamClockUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void EncodeSubscribe(const StreamFilter &filter, QByteArray &out) {
+    const qsizetype size = 1 + 8 + 4 + 4 + 4 * static_cast<qsizetype>(filter.pids.size());
+    const qsizetype start = out.size();
+    out.resize(start + 4 + size);
+    char *p = out.data() + start;
+    p = put(p, static_cast<quint32>(size));
+    p = put(p, static_cast<quint8>(StreamSubscribe));
+    p = put(p, filter.metrics);
+    p = put(p, filter.decimation);
+    p = put(p, static_cast<quint32>(filter.pids.size()));
+    for (quint32 pid : filter.pids) {
+        p = put(p, pid);
+    }
+}
+
+bool DecodeSubscribe(QByteArrayView payload, StreamFilter &filter) {
+    if (payload.size() < 16) {
+        return false;
+    }
+    const char *p = payload.data();
+    quint64 metrics;
+    quint32 decimation, count;
+    p = get(p, metrics);
+    p = get(p, decimation);
+    p = get(p, count);
+    if (payload.size() != 16 + 4 * static_cast<qsizetype>(count)) {
+        return false;
+    }
+    filter.metrics = metrics & kStreamAllMetrics;
+    filter.decimation = std::max<quint32>(decimation, 1);
+    filter.pids.resize(count);
+    for (quint32 &pid : filter.pids) {
+        p = get(p, pid);
+    }
+    std::sort(filter.pids.begin(), filter.pids.end());
+    return true;
+}
+
+bool NextStreamFrame(const QByteArray &buffer, qsizetype &offset, quint8 &type, QByteArrayView &payload) {
+    if (buffer.size() - offset < kFrameHeader) {
+        return false;
+    }
+    const char *p = buffer.constData() + offset;
+    quint32 size;
+    p = get(p, size);
+    if (size == 0 || buffer.size() - offset - 4 < static_cast<qsizetype>(size)) {
+        return false;
+    }
+    type = static_cast<quint8>(*p);
+    payload = QByteArrayView(p + 1, static_cast<qsizetype>(size) - 1);
+    offset += 4 + static_cast<qsizetype>(size);
+    return true;
+}
+
+size_t DecodeSamples(QByteArrayView payload, quint64 metrics, std::vector<StreamRecord> &out,
+                     quint32 *dropped, qint64 *published_us) {
+    if (payload.size() < kSamplesHeader) {
+        return 0;
+    }
+    const char *p = payload.data();
+    quint32 count, lost;
+    qint64 published;
+    p = get(p, count);
+    p = get(p, lost);
+    p = get(p, published);
+    if (payload.size() != kSamplesHeader + static_cast<qsizetype>(count) * recordSize(metrics)) {
+        return 0;
+    }
+    if (dropped) {
+        *dropped = lost;
+    }
+    if (published_us) {
+        *published_us = published;
+    }
+
+    out.reserve(out.size() + count);
+    for (quint32 n = 0; n < count; ++n) {
+        StreamRecord record;
+        p = get(p, record.time_stamp);
+        p = get(p, record.pid);
+        for (size_t i = 0; i < kStatsFieldCount; ++i) {
+            if (metrics >> i & 1) {
+                p = get(p, record.values[i]);
+            }
+        }
+        out.push_back(record);
+    }
+    return count;
+}
+
+struct StatsStreamServer::Subscriber {
+    QLocalSocket *socket = nullptr;
+    QByteArray input;
+    QByteArray frame;        // reused between flushes
+    StreamFilter filter;
+    bool subscribed = false;
+    bool closed = false;
+    quint64 cursor = 0;      // next ring sequence number to read
+    quint32 skipped = 0;     // matching samples since the last one sent
+    quint32 dropped = 0;     // lost since the last frame
+};
+
+StatsStreamServer::StatsStreamServer(size_t capacity) : capacity_(std::max<size_t>(capacity, kBatchRecords)) {
+}
+
+StatsStreamServer::~StatsStreamServer() {
+    Close();
+}
+
+bool StatsStreamServer::Listen(const QString &name) {
+    if (thread_) {
+        return false;
+    }
+    // The ring is only allocated by collectors that actually stream
+    ring_.assign(capacity_, Entry{});
+    thread_ = std::make_unique<QThread>();
+    thread_->setObjectName("StatsStreamServer");
+    context_ = new QObject;
+    context_->moveToThread(thread_.get());
+    thread_->start();
+
+    bool listening = false;
+    QMetaObject::invokeMethod(context_, [this, &name, &listening]() {
+        server_ = new QLocalServer(context_);
+        server_->setSocketOptions(QLocalServer::UserAccessOption);
+        QObject::connect(server_, &QLocalServer::newConnection, context_, [this]() { Accept(); });
+        listening = server_->listen(name);
+        if (!listening && server_->serverError() == QAbstractSocket::AddressInUseError) {
+            // Socket file left behind by a collector that did not stop
+            // cleanly; the collector lock rules out a live one
+            QLocalServer::removeServer(name);
+            listening = server_->listen(name);
+        }
+        if (!listening) {
+            error_ = server_->errorString();
+        }
+    }, Qt::BlockingQueuedConnection);
+
+    if (!listening) {
+        Close();
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(ring_mutex_);
+    listening_ = true;
+    return true;
+}
+
+void StatsStreamServer::Close() {
+    {
+        std::lock_guard<std::mutex> lock(ring_mutex_);
+        listening_ = false;
+    }
+    if (!thread_) {
+        return;
+    }
+    QMetaObject::invokeMethod(context_, [this]() {
+        // The sockets are children of the server; they must not report
+        // their disconnection to subscribers already gone
+        for (const std::unique_ptr<Subscriber> &subscriber : subscribers_) {
+            if (!subscriber->closed) {
+                QObject::disconnect(subscriber->socket, nullptr, context_, nullptr);
+            }
+        }
+        subscribers_.clear();
+        delete server_;
+        server_ = nullptr;
+    }, Qt::BlockingQueuedConnection);
+    thread_->quit();
+    thread_->wait();
+    delete context_;
+    context_ = nullptr;
+    thread_.reset();
+    subscriber_count_ = 0;
+    flush_queued_ = false;
+
+    std::lock_guard<std::mutex> lock(ring_mutex_);
+    ring_ = std::vector<Entry>();
+    head_ = 0;
+}
+
+void StatsStreamServer::Publish(const StatsSample &sample) {
+    std::lock_guard<std::mutex> lock(ring_mutex_);
+    if (!listening_) {
+        return;
+    }
+    Entry &entry = ring_[head_ % capacity_];
+    entry.time_stamp = sample.time_stamp;
+    entry.published_us = StreamClockUs();
+    entry.pid = sample.pid;
+    entry.stats = sample.stats;
+    ++head_;
+
+    // One queued flush covers everything published until it runs
+    if (subscriber_count_ > 0 && !flush_queued_.exchange(true)) {
+        QMetaObject::invokeMethod(context_, [this]() {
+            flush_queued_ = false;
+            FlushAll();
+        }, Qt::QueuedConnection);
+    }
+}
+
+void StatsStreamServer::Accept() {
+    while (QLocalSocket *socket = server_->nextPendingConnection()) {
+        auto subscriber = std::make_unique<Subscriber>();
+        subscriber->socket = socket;
+        Subscriber *raw = subscriber.get();
+        QObject::connect(socket, &QLocalSocket::readyRead, context_, [this, raw]() { Receive(raw); });
+        QObject::connect(socket, &QLocalSocket::bytesWritten, context_, [this, raw]() { Flush(raw); });
+        QObject::connect(socket, &QLocalSocket::disconnected, context_, [this, raw]() { Remove(raw); });
+        subscribers_.push_back(std::move(subscriber));
+    }
+}
+
+void StatsStreamServer::Receive(Subscriber *subscriber) {
+    if (subscriber->closed) {
+        return;
+    }
+    subscriber->input.append(subscriber->socket->readAll());
+
+    qsizetype offset = 0;
+    quint8 type;
+    QByteArrayView payload;
+    while (NextStreamFrame(subscriber->input, offset, type, payload)) {
+        if (type != StreamSubscribe || !DecodeSubscribe(payload, subscriber->filter)) {
+            subscriber->socket->abort();
+            return;
+        }
+        if (!subscriber->subscribed) {
+            subscriber->subscribed = true;
+            ++subscriber_count_;
+        }
+        // A new subscription starts with the next sample
+        subscriber->skipped = 0;
+        subscriber->dropped = 0;
+        std::lock_guard<std::mutex> lock(ring_mutex_);
+        subscriber->cursor = head_;
+    }
+    subscriber->input.remove(0, offset);
+    if (subscriber->input.size() > kMaxRequestBytes) {
+        subscriber->socket->abort();
+    }
+}
+
+void StatsStreamServer::Flush(Subscriber *subscriber) {
+    if (subscriber->closed || !subscriber->subscribed) {
+        return;
+    }
+    const StreamFilter &filter = subscriber->filter;
+    QByteArray &frame = subscriber->frame;
+
+    while (subscriber->socket->bytesToWrite() < kMaxBuffered) {
+        frame.resize(kFrameHeader + kSamplesHeader + static_cast<qsizetype>(kBatchRecords) * recordSize(filter.metrics));
+        char *out = frame.data() + kFrameHeader + kSamplesHeader;
+        quint32 count = 0;
+        qint64 published_us = 0;
+        bool more;
+        {
+            std::lock_guard<std::mutex> lock(ring_mutex_);
+            // Overwritten samples are lost to this subscriber
+            if (head_ - subscriber->cursor > capacity_) {
+                const quint64 lost = head_ - capacity_ - subscriber->cursor;
+                subscriber->dropped += static_cast<quint32>(lost);
+                dropped_count_ += lost;
+                subscriber->cursor = head_ - capacity_;
+            }
+            const quint64 end = std::min(head_, subscriber->cursor + kBatchRecords);
+            for (; subscriber->cursor < end; ++subscriber->cursor) {
+                const Entry &entry = ring_[subscriber->cursor % capacity_];
+                if (!filter.Matches(entry.pid) || ++subscriber->skipped < filter.decimation) {
+                    continue;
+                }
+                subscriber->skipped = 0;
+                if (count++ == 0) {
+                    published_us = entry.published_us;
+                }
+                out = put(out, entry.time_stamp);
+                out = put(out, entry.pid);
+                for (size_t i = 0; i < kStatsFieldCount; ++i) {
+                    if (filter.metrics >> i & 1) {
+                        out = put(out, entry.stats.*kStatsFields[i].member);
+                    }
+                }
+            }
+            more = subscriber->cursor < head_;
+        }
+
+        if (count > 0) {
+            frame.resize(out - frame.constData());
+            char *p = frame.data();
+            p = put(p, static_cast<quint32>(frame.size() - 4));
+            p = put(p, static_cast<quint8>(StreamSamples));
+            p = put(p, count);
+            p = put(p, subscriber->dropped);
+            put(p, published_us);
+            subscriber->dropped = 0;
+            subscriber->socket->write(frame);
+        }
+        if (!more || subscriber->closed) {
+            break;
+        }
+    }
+}
+
+void StatsStreamServer::FlushAll() {
+    for (size_t i = 0; i < subscribers_.size(); ++i) {
+        Flush(subscribers_[i].get());
+    }
+}
+
+void StatsStreamServer::Remove(Subscriber *subscriber) {
+    if (subscriber->closed) {
+        return;
+    }
+    // May be called from inside a write, so the subscriber is only
+    // marked here and erased once control is back in the event loop
+    subscriber->closed = true;
+    if (subscriber->subscribed) {
+        --subscriber_count_;
+    }
+    subscriber->socket->deleteLater();
+    QMetaObject::invokeMethod(context_, [this]() { Prune(); }, Qt::QueuedConnection);
+}
+
+void StatsStreamServer::Prune() {
+    subscribers_.erase(std::remove_if(subscribers_.begin(), subscribers_.end(),
+                                      [](const std::unique_ptr<Subscriber> &subscriber) { return subscriber->closed; }),
+                       subscribers_.end());
+}
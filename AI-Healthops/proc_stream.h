@@ -0,0 +1,130 @@
+#ifndef PROC_STREAM_H
+#define PROC_STREAM_H
+
+#include "proc_stats.h"
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QString>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class QLocalServer;
+class QObject;
+class QThread;
+
+// Wire format of the live stats stream. Every frame is a quint32 length of
+// what follows, a quint8 type and the payload, all little-endian.
+//   Subscribe (client): quint64 metrics, quint32 decimation, quint32 pid
+//                       count, then the pids
+//   Samples (server):   quint32 record count, quint32 samples dropped since
+//                       the previous frame, qint64 StreamClockUs() at which
+//                       the oldest record was published, then per record
+//                       qint64 time_stamp, quint32 pid and one quint64 per
+//                       subscribed metric in kStatsFields order
+enum StreamFrameType : quint8 {
+    StreamSubscribe = 1,
+    StreamSamples = 2,
+};
+
+static_assert(kStatsFieldCount <= 64, "metric masks are 64 bits wide");
+inline constexpr quint64 kStreamAllMetrics = kStatsFieldCount == 64 ? ~0ULL : (1ULL << kStatsFieldCount) - 1;
+
+// Name the collector listens on unless configured otherwise
+inline constexpr char kDefaultStreamName[] = "healthops-stats";
+
+// What one subscriber wants to receive
+struct StreamFilter {
+    std::vector<quint32> pids;             // empty for every process
+    quint64 metrics = kStreamAllMetrics;   // bit i selects kStatsFields[i]
+    quint32 decimation = 1;                // every n-th matching sample
+
+    bool Matches(quint32 pid) const;
+};
+
+// One decoded sample; metrics outside the subscription stay 0
+struct StreamRecord {
+    qint64 time_stamp = 0;
+    quint32 pid = 0;
+    std::array<quint64, kStatsFieldCount> values{};
+};
+
+// Monotonic microseconds, comparable between processes on the same host
+qint64 StreamClockUs();
+
+// Appends a Subscribe frame for filter to out
+void EncodeSubscribe(const StreamFilter &filter, QByteArray &out);
+bool DecodeSubscribe(QByteArrayView payload, StreamFilter &filter);
+
+// Finds the frame starting at offset in buffer. Returns false if it is not
+// complete yet; otherwise sets type and payload and moves offset past it.
+bool NextStreamFrame(const QByteArray &buffer, qsizetype &offset, quint8 &type, QByteArrayView &payload);
+
+// Appends the records of a Samples payload sent for metrics to out and
+// returns how many there were
+size_t DecodeSamples(QByteArrayView payload, quint64 metrics, std::vector<StreamRecord> &out,
+                     quint32 *dropped = nullptr, qint64 *published_us = nullptr);
+
+// Local endpoint streaming every collected sample to subscribers: a named
+// pipe on Windows, a Unix domain socket elsewhere, reachable by the current
+// user only. Publish() copies the sample into a ring shared by all
+// subscribers and returns. Each subscriber reads the ring from its own
+// cursor on the server thread, in batches, while its socket has room; one
+// that falls more than the ring behind loses its oldest samples, so no
+// subscriber can hold up the sampler or the others.
+struct StatsStreamServer
+{
+    explicit StatsStreamServer(size_t capacity = 16384);
+    ~StatsStreamServer();
+
+    // Starts the server thread and listens on name; false if that fails
+    bool Listen(const QString &name);
+    void Close();
+
+    // Safe from any thread; never waits for subscribers
+    void Publish(const StatsSample &sample);
+
+    int SubscriberCount() const { return subscriber_count_; }
+    // Samples lost by subscribers that fell behind, all of them together
+    quint64 DroppedCount() const { return dropped_count_; }
+    QString ErrorString() const { return error_; }
+
+private:
+    struct Entry {
+        qint64 time_stamp;
+        qint64 published_us;
+        quint32 pid;
+        Stats stats;
+    };
+    struct Subscriber;
+
+    // Server thread only
+    void Accept();
+    void Receive(Subscriber *subscriber);
+    void Flush(Subscriber *subscriber);
+    void FlushAll();
+    void Remove(Subscriber *subscriber);
+    void Prune();
+
+    size_t capacity_;
+    std::mutex ring_mutex_;
+    std::vector<Entry> ring_;
+    quint64 head_ = 0;          // sequence number of the next sample
+
+    std::unique_ptr<QThread> thread_;
+    QObject *context_ = nullptr;
+    QLocalServer *server_ = nullptr;
+    std::vector<std::unique_ptr<Subscriber>> subscribers_;
+    QString error_;
+
+    bool listening_ = false;    // guarded by ring_mutex_
+    std::atomic<bool> flush_queued_{false};
+    std::atomic<int> subscriber_count_{0};
+    std::atomic<quint64> dropped_count_{0};
+};
+
+#endif // PROC_STREAM_H
@@ -0,0 +1,314 @@
+#include "proc_summary.h"
+
+#include <QDateTime>
+#include <QJsonArray>
+
+#include <algorithm>
+#include <cmath>
+
+static const qint64 kMinuteMs = 60 * 1000;
+static const qint64 kHourMs = 3600 * 1000;
+static const size_t kMinutesKept = 24 * 60;
+static const size_t kHoursKept = 30 * 24;
+
+// Entries per list in the summary document
+static const size_t kTopRegions = 5;
+static const size_t kTopCorrelated = 5;
+
+void MetricAggregate::Add(double t, double value) {
+    if (n == 0.0) {
+        min = max = value;
+    } else {
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+    n += 1.0;
+    sum += value;
+    sum_t += t;
+    sum_tt += t * t;
+    sum_tx += t * value;
+    sketch.Add(value);
+}
+
+void MetricAggregate::Merge(const MetricAggregate &other) {
+    if (other.n == 0.0) {
+        return;
+    }
+    if (n == 0.0) {
+        *this = other;
+        return;
+    }
+    n += other.n;
+    sum += other.sum;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    sum_t += other.sum_t;
+    sum_tt += other.sum_tt;
+    sum_tx += other.sum_tx;
+    sketch.Merge(other.sketch);
+}
+
+void MetricAggregate::Clear() {
+    n = sum = min = max = sum_t = sum_tt = sum_tx = 0.0;
+    sketch.Clear();
+}
+
+double MetricAggregate::Slope() const {
+    const double denominator = n * sum_tt - sum_t * sum_t;
+    if (n < 2.0 || denominator <= 0.0) {
+        return 0.0;
+    }
+    return (n * sum_tx - sum_t * sum) / denominator;
+}
+
+SummaryStore::SummaryStore() : minutes_(kMinutesKept), hours_(kHoursKept) {
+}
+
+const SummaryStore::Bucket *SummaryStore::Find(const std::vector<Bucket> &ring, qint64 index) {
+    const Bucket &bucket = ring[static_cast<size_t>(index) % ring.size()];
+    return bucket.index == index ? &bucket : nullptr;
+}
+
+SummaryStore::Bucket &SummaryStore::Slot(std::vector<Bucket> &ring, qint64 index) {
+    Bucket &bucket = ring[static_cast<size_t>(index) % ring.size()];
+    if (bucket.index != index) {
+        bucket.index = index;
+        for (MetricAggregate &metric : bucket.metrics) {
+            metric.Clear();
+        }
+    }
+    return bucket;
+}
+
+void SummaryStore::Add(qint64 time_stamp, const Stats &stats) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (origin_ < 0) {
+        origin_ = first_ = time_stamp;
+    }
+    // Late samples for buckets that were already reused are dropped
+    if (time_stamp < last_ - static_cast<qint64>(kMinutesKept) * kMinuteMs) {
+        return;
+    }
+    last_ = std::max(last_, time_stamp);
+
+    const double t = static_cast<double>(time_stamp - origin_) / kHourMs;
+    Bucket &minute = Slot(minutes_, time_stamp / kMinuteMs);
+    Bucket &hour = Slot(hours_, time_stamp / kHourMs);
+    for (size_t i = 0; i < kStatsFieldCount; ++i) {
+        const double value = static_cast<double>(stats.*kStatsFields[i].member);
+        minute.metrics[i].Add(t, value);
+        hour.metrics[i].Add(t, value);
+    }
+}
+
+void SummaryStore::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (Bucket &bucket : minutes_) {
+        bucket.index = -1;
+    }
+    for (Bucket &bucket : hours_) {
+        bucket.index = -1;
+    }
+    origin_ = -1;
+    first_ = last_ = 0;
+}
+
+bool SummaryStore::Range(qint64 from, qint64 to, StatsAggregate &out, qint64 &first, qint64 &last) const {
+    for (MetricAggregate &metric : out) {
+        metric.Clear();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (origin_ < 0) {
+        return false;
+    }
+    from = std::max(from, first_);
+    to = std::min(to, last_);
+    if (from > to) {
+        return false;
+    }
+    first = from;
+    last = to;
+
+    auto merge = [&out](const Bucket &bucket) {
+        for (size_t i = 0; i < kStatsFieldCount; ++i) {
+            out[i].Merge(bucket.metrics[i]);
+        }
+    };
+
+    // Minutes are kept for the last day only; older parts of the range are
+    // answered with whole hours
+    const qint64 oldest_minute = last_ / kMinuteMs - static_cast<qint64>(kMinutesKept) + 1;
+    const qint64 last_minute = to / kMinuteMs;
+    qint64 minute = from / kMinuteMs;
+    while (minute <= last_minute) {
+        const qint64 hour = minute / 60;
+        const qint64 next_hour = (hour + 1) * 60;
+        const bool whole_hour = minute % 60 == 0 && next_hour - 1 <= last_minute;
+        const Bucket *hour_bucket = Find(hours_, hour);
+
+        if (hour_bucket && (whole_hour || minute < oldest_minute)) {
+            merge(*hour_bucket);
+            minute = next_hour;
+            continue;
+        }
+        if (minute < oldest_minute) {
+            minute = next_hour;
+            continue;
+        }
+        if (const Bucket *minute_bucket = Find(minutes_, minute)) {
+            merge(*minute_bucket);
+        }
+        ++minute;
+    }
+    return out[0].n > 0.0;
+}
+
+bool SummaryStore::Minute(qint64 time_stamp, StatsAggregate &out) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Bucket *bucket = Find(minutes_, time_stamp / kMinuteMs);
+    if (!bucket || bucket->metrics[0].n == 0.0) {
+        return false;
+    }
+    out = bucket->metrics;
+    return true;
+}
+
+void ProcessSketches::Add(const ProcessSnapshot &snapshot, std::vector<SketchRecord> &closed) {
+    const qint64 minute = snapshot.time_stamp / kMinuteMs;
+    if (minute != minute_) {
+        Flush(closed);
+        minute_ = minute;
+    }
+
+    for (size_t row = 0; row < snapshot.Size(); ++row) {
+        auto it = processes_.find(snapshot.pids[row]);
+        if (it == processes_.end()) {
+            std::array<SketchRecord, ProcessSnapshot::SeriesCount> records;
+            for (int series = 0; series < ProcessSnapshot::SeriesCount; ++series) {
+                records[series].pid = snapshot.pids[row];
+                records[series].process = snapshot.names[row];
+                records[series].metric = ProcessSnapshot::SketchMetric(series);
+                records[series].start = minute * kMinuteMs;
+                records[series].duration = kMinuteMs;
+            }
+            it = processes_.insert(snapshot.pids[row], std::move(records));
+        }
+        std::array<SketchRecord, ProcessSnapshot::SeriesCount> &records = it.value();
+        for (int series = 0; series < ProcessSnapshot::SeriesCount; ++series) {
+            // Series of groups that were not queried only read zero
+            if (snapshot.groups[row] & ProcessSnapshot::SeriesGroup(series)) {
+                records[series].Add(snapshot.SeriesValue(series, row));
+            }
+        }
+    }
+}
+
+void ProcessSketches::Flush(std::vector<SketchRecord> &closed) {
+    for (auto it = processes_.begin(); it != processes_.end(); ++it) {
+        for (SketchRecord &record : it.value()) {
+            if (!record.sketch.Empty()) {
+                closed.push_back(std::move(record));
+            }
+        }
+    }
+    processes_.clear();
+}
+
+QJsonObject BuildFeatureSummary(quint32 pid, const QString &process, qint64 from, qint64 to,
+                                const SummaryStore &store,
+                                const std::vector<AnomalyRegion> &regions,
+                                const std::vector<CorrelatedProcess> &correlated,
+                                const std::vector<HeavyHitter> &heaviest, qint64 heavy_window_ms) {
+    StatsAggregate aggregate;
+    qint64 first = from;
+    qint64 last = to;
+    store.Range(from, to, aggregate, first, last);
+
+    QJsonObject summary;
+    summary["PID"] = QString::number(pid);
+    summary["Process"] = process;
+    summary["TimeStamp"] = QDateTime::fromMSecsSinceEpoch(first, Qt::UTC).toString(Qt::ISODate);
+    summary["Interval"] = QString::number((last - first) / 1000);
+    summary["Samples"] = aggregate[0].n;
+
+    // Regions of this process that overlap the range
+    std::vector<const AnomalyRegion *> overlapping;
+    for (const AnomalyRegion &region : regions) {
+        if (region.pid == pid && region.end >= first && region.start <= last) {
+            overlapping.push_back(&region);
+        }
+    }
+
+    QJsonObject metrics;
+    for (size_t i = 0; i < kStatsFieldCount; ++i) {
+        const MetricAggregate &a = aggregate[i];
+        const int bursts = static_cast<int>(std::count_if(overlapping.begin(), overlapping.end(), [i](const AnomalyRegion *region) {
+            return region->metric == static_cast<int>(i) && region->kind == AnomalyRegion::Spike;
+        }));
+        auto percentile = [&a](double q) {
+            return std::clamp(a.sketch.Quantile(q), a.min, a.max);
+        };
+
+        QJsonObject metric;
+        metric["mean"] = a.n > 0.0 ? a.sum / a.n : 0.0;
+        metric["min"] = a.min;
+        metric["max"] = a.max;
+        metric["p50"] = percentile(0.50);
+        metric["p95"] = percentile(0.95);
+        metric["p99"] = percentile(0.99);
+        metric["slopePerHour"] = a.Slope();
+        metric["bursts"] = bursts;
+        metrics[kStatsFields[i].name] = metric;
+    }
+    summary["metrics"] = metrics;
+
+    const size_t region_count = std::min(overlapping.size(), kTopRegions);
+    std::partial_sort(overlapping.begin(), overlapping.begin() + static_cast<std::ptrdiff_t>(region_count), overlapping.end(),
+                      [](const AnomalyRegion *a, const AnomalyRegion *b) { return a->score > b->score; });
+    QJsonArray top_regions;
+    for (size_t i = 0; i < region_count; ++i) {
+        const AnomalyRegion &region = *overlapping[i];
+        QJsonObject object;
+        object["metric"] = kStatsFields[region.metric].name;
+        object["kind"] = region.kind == AnomalyRegion::Shift ? "shift" : "spike";
+        object["start"] = QDateTime::fromMSecsSinceEpoch(region.start, Qt::UTC).toString(Qt::ISODate);
+        object["durationSec"] = static_cast<double>(region.end - region.start) / 1000.0;
+        object["baseline"] = region.baseline;
+        object["peak"] = region.peak;
+        object["score"] = region.score;
+        top_regions.append(object);
+    }
+    summary["regionsOfInterest"] = top_regions;
+
+    const size_t correlated_count = std::min(correlated.size(), kTopCorrelated);
+    QJsonArray top_correlated;
+    for (size_t i = 0; i < correlated_count; ++i) {
+        QJsonObject object;
+        object["pid"] = QString::number(correlated[i].pid);
+        object["process"] = correlated[i].process;
+        object["metric"] = ProcessSnapshot::SeriesName(correlated[i].series);
+        object["correlation"] = correlated[i].correlation;
+        object["share"] = correlated[i].share;
+        object["lag"] = correlated[i].lag;
+        top_correlated.append(object);
+    }
+    summary["correlatedProcesses"] = top_correlated;
+
+    QJsonArray heavy;
+    for (const HeavyHitter &hitter : heaviest) {
+        QJsonObject object;
+        object["pid"] = QString::number(hitter.pid);
+        object["process"] = hitter.process;
+        object["metric"] = HeavyHitters::AmountName(hitter.series);
+        object["amount"] = hitter.amount;
+        object["error"] = hitter.error;
+        heavy.append(object);
+    }
+    QJsonObject heavy_hitters;
+    heavy_hitters["windowSec"] = static_cast<double>(heavy_window_ms / 1000);
+    heavy_hitters["processes"] = heavy;
+    summary["heavyHitters"] = heavy_hitters;
+
+    return summary;
+}
@@ -0,0 +1,104 @@
+#ifndef PROC_SUMMARY_H
+#define PROC_SUMMARY_H
+
+#include "proc_stats.h"
+#include "proc_anomaly.h"
+#include "proc_sketch.h"
+#include "proc_snapshot.h"
+#include "proc_correlation.h"
+#include "proc_topk.h"
+
+#include <QHash>
+#include <QJsonObject>
+
+#include <array>
+#include <mutex>
+#include <vector>
+
+// Running aggregates of one metric: moments, extremes, least-squares sums
+// against time in hours, and a quantile sketch for percentiles. Merging two
+// of them gives the aggregate of both spans.
+struct MetricAggregate
+{
+    void Add(double t, double value);
+    void Merge(const MetricAggregate &other);
+    void Clear();
+
+    double Slope() const;  // per hour
+
+    double n = 0.0;
+    double sum = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+    double sum_t = 0.0;
+    double sum_tt = 0.0;
+    double sum_tx = 0.0;
+    QuantileSketch sketch;
+};
+
+using StatsAggregate = std::array<MetricAggregate, kStatsFieldCount>;
+
+// Per-minute aggregates of every Stats field for the last day and per-hour
+// aggregates for the last 30 days. A range query merges whole hours where
+// it can and minutes at the edges, so its cost depends on the length of the
+// range in hours, not on the number of samples.
+struct SummaryStore
+{
+    SummaryStore();
+
+    void Add(qint64 time_stamp, const Stats &stats);
+    void Clear();
+
+    // Merges the aggregates of [from, to] into out. Returns false when the
+    // range holds no samples; first and last are the covered sample times.
+    bool Range(qint64 from, qint64 to, StatsAggregate &out, qint64 &first, qint64 &last) const;
+
+    // Aggregates of the minute holding time_stamp, if it is still kept
+    bool Minute(qint64 time_stamp, StatsAggregate &out) const;
+
+private:
+    struct Bucket {
+        qint64 index = -1;
+        StatsAggregate metrics;
+    };
+
+    static const Bucket *Find(const std::vector<Bucket> &ring, qint64 index);
+    static Bucket &Slot(std::vector<Bucket> &ring, qint64 index);
+
+    mutable std::mutex mutex_;
+    std::vector<Bucket> minutes_;
+    std::vector<Bucket> hours_;
+    qint64 origin_ = -1;   // time of the first sample; slopes use hours since then
+    qint64 first_ = 0;
+    qint64 last_ = 0;
+};
+
+// Per-minute sketches of CPU percent, I/O operations per second and working
+// set for every process in the enumerator's snapshots. Only the current
+// minute is kept; finished minutes are handed back for storage.
+struct ProcessSketches
+{
+    // Adds one snapshot and appends the records of the minute that ended
+    // before it, if any, to closed
+    void Add(const ProcessSnapshot &snapshot, std::vector<SketchRecord> &closed);
+    // Appends the records of the current minute to closed and starts over
+    void Flush(std::vector<SketchRecord> &closed);
+
+private:
+    qint64 minute_ = -1;
+    QHash<quint32, std::array<SketchRecord, ProcessSnapshot::SeriesCount>> processes_;
+};
+
+// Condenses a time range into a document of fixed size for the analysis
+// service: sample metadata in the style of SampleData_ResourceUsage.json,
+// then per metric the mean, min, max, p50/p95/p99, least-squares slope and
+// the number of spike regions, the top regions of interest by score and the
+// first entries of correlated, which is expected most likely culprit first,
+// and the heaviest processes of the last heavy_window_ms.
+QJsonObject BuildFeatureSummary(quint32 pid, const QString &process, qint64 from, qint64 to,
+                                const SummaryStore &store,
+                                const std::vector<AnomalyRegion> &regions,
+                                const std::vector<CorrelatedProcess> &correlated,
+                                const std::vector<HeavyHitter> &heaviest, qint64 heavy_window_ms);
+
+#endif // PROC_SUMMARY_H
@@ -0,0 +1,240 @@
+#include "proc_topk.h"
+
+#include <algorithm>
+
+// Sweeps further apart than this are not integrated (e.g. after sleep)
+static const qint64 kMaxSweepGapMs = 5 * 60 * 1000;
+
+SpaceSaving::SpaceSaving(size_t capacity) : capacity_(std::max<size_t>(capacity, 1)) {
+    heap_.reserve(capacity_);
+}
+
+void SpaceSaving::Place(size_t i, const Counter &counter) {
+    heap_[i] = counter;
+    position_[counter.key] = i;
+}
+
+void SpaceSaving::SiftUp(size_t i) {
+    const Counter counter = heap_[i];
+    while (i > 0) {
+        const size_t parent = (i - 1) / 2;
+        if (heap_[parent].count <= counter.count) {
+            break;
+        }
+        Place(i, heap_[parent]);
+        i = parent;
+    }
+    Place(i, counter);
+}
+
+void SpaceSaving::SiftDown(size_t i) {
+    const Counter counter = heap_[i];
+    const size_t size = heap_.size();
+    while (true) {
+        size_t child = 2 * i + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && heap_[child + 1].count < heap_[child].count) {
+            ++child;
+        }
+        if (counter.count <= heap_[child].count) {
+            break;
+        }
+        Place(i, heap_[child]);
+        i = child;
+    }
+    Place(i, counter);
+}
+
+void SpaceSaving::Add(quint32 key, double weight) {
+    if (!(weight > 0.0)) {
+        return;
+    }
+
+    auto it = position_.constFind(key);
+    if (it != position_.constEnd()) {
+        const size_t i = it.value();
+        heap_[i].count += weight;
+        SiftDown(i);
+        return;
+    }
+
+    if (heap_.size() < capacity_) {
+        heap_.push_back({key, weight, 0.0});
+        position_.insert(key, heap_.size() - 1);
+        SiftUp(heap_.size() - 1);
+        return;
+    }
+
+    // Take over the smallest counter
+    const Counter smallest = heap_.front();
+    position_.remove(smallest.key);
+    Place(0, {key, smallest.count + weight, smallest.count});
+    SiftDown(0);
+    ++evictions_;
+}
+
+void SpaceSaving::Clear() {
+    heap_.clear();
+    position_.clear();
+    evictions_ = 0;
+}
+
+HeavyHitters::HeavyHitters(qint64 window_ms, int panes, size_t capacity)
+    : window_ms_(std::max<qint64>(window_ms, 1000)),
+      pane_ms_(std::max<qint64>(window_ms_ / std::max(panes, 1), 1)),
+      panes_(static_cast<size_t>(std::max(panes, 1)) + 1) {
+    // One pane more than the window holds, for the one being filled
+    for (Pane &pane : panes_) {
+        for (SpaceSaving &summary : pane.summaries) {
+            summary = SpaceSaving(capacity);
+        }
+    }
+    exact_.fill(true);
+}
+
+int HeavyHitters::Tracked(int series) {
+    for (int i = 0; i < kTrackedCount; ++i) {
+        if (kTracked[i] == series) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char *HeavyHitters::AmountName(int series) {
+    switch (series) {
+    case ProcessSnapshot::CpuPercent: return "CPU_SECONDS";
+    case ProcessSnapshot::IoOpsPerSec: return "IO_OPERATIONS";
+    case ProcessSnapshot::WriteBytesPerSec: return "IO_WRITE_BYTES";
+    default: return ProcessSnapshot::SeriesName(series);
+    }
+}
+
+void HeavyHitters::Add(const ProcessSnapshot &snapshot) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const qint64 gap = snapshot.time_stamp - last_time_;
+    const bool integrate = last_time_ > 0 && gap > 0 && gap <= kMaxSweepGapMs;
+    last_time_ = snapshot.time_stamp;
+    if (!integrate) {
+        return;
+    }
+
+    const qint64 index = snapshot.time_stamp / pane_ms_;
+    Pane &pane = panes_[static_cast<size_t>(index % static_cast<qint64>(panes_.size()))];
+    if (pane.index != index) {
+        pane.index = index;
+        for (SpaceSaving &summary : pane.summaries) {
+            summary.Clear();
+        }
+    }
+
+    const double seconds = gap / 1000.0;
+    for (size_t row = 0; row < snapshot.Size(); ++row) {
+        const quint32 pid = snapshot.pids[row];
+        bool active = false;
+        for (int i = 0; i < kTrackedCount; ++i) {
+            double amount = snapshot.SeriesValue(kTracked[i], row) * seconds;
+            if (kTracked[i] == ProcessSnapshot::CpuPercent) {
+                amount /= 100.0;
+            }
+            if (amount > 0.0) {
+                pane.summaries[i].Add(pid, amount);
+                active = true;
+            }
+        }
+        if (active) {
+            names_[pid] = snapshot.names[row];
+        }
+    }
+
+    Rank();
+}
+
+void HeavyHitters::Rank() {
+    const qint64 newest = last_time_ / pane_ms_;
+    const qint64 oldest = newest - static_cast<qint64>(panes_.size()) + 1;
+
+    QHash<quint32, bool> in_window;
+    for (int i = 0; i < kTrackedCount; ++i) {
+        // Per key: summed counts and errors, and the missing bounds of the
+        // panes that do have a counter for it
+        QHash<quint32, std::array<double, 3>> merged;
+        double missing_total = 0.0;
+        bool exact = true;
+        for (const Pane &pane : panes_) {
+            if (pane.index < oldest || pane.index > newest) {
+                continue;
+            }
+            const SpaceSaving &summary = pane.summaries[i];
+            const double missing = summary.MissingBound();
+            missing_total += missing;
+            exact = exact && summary.Exact();
+            for (const SpaceSaving::Counter &counter : summary.Counters()) {
+                std::array<double, 3> &entry = merged[counter.key];
+                entry[0] += counter.count;
+                entry[1] += counter.error;
+                entry[2] += missing;
+            }
+        }
+
+        std::vector<HeavyHitter> &ranked = ranked_[i];
+        ranked.clear();
+        ranked.reserve(static_cast<size_t>(merged.size()));
+        for (auto it = merged.constBegin(); it != merged.constEnd(); ++it) {
+            // A pane without a counter for the key may still have seen up
+            // to its missing bound of it
+            const double unseen = missing_total - it.value()[2];
+            HeavyHitter hitter;
+            hitter.pid = it.key();
+            hitter.process = names_.value(it.key());
+            hitter.series = kTracked[i];
+            hitter.amount = it.value()[0] + unseen;
+            hitter.error = it.value()[1] + unseen;
+            ranked.push_back(hitter);
+            in_window.insert(it.key(), true);
+        }
+        std::sort(ranked.begin(), ranked.end(), [](const HeavyHitter &a, const HeavyHitter &b) {
+            return a.amount > b.amount;
+        });
+        exact_[i] = exact;
+    }
+
+    // Names of processes that left the window are no longer needed
+    for (auto it = names_.begin(); it != names_.end();) {
+        it = in_window.contains(it.key()) ? std::next(it) : names_.erase(it);
+    }
+}
+
+void HeavyHitters::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (Pane &pane : panes_) {
+        pane.index = -1;
+        for (SpaceSaving &summary : pane.summaries) {
+            summary.Clear();
+        }
+    }
+    last_time_ = 0;
+    names_.clear();
+    for (std::vector<HeavyHitter> &ranked : ranked_) {
+        ranked.clear();
+    }
+    exact_.fill(true);
+}
+
+std::vector<HeavyHitter> HeavyHitters::Top(int series, size_t k) const {
+    const int i = Tracked(series);
+    if (i < 0) {
+        return {};
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::vector<HeavyHitter> &ranked = ranked_[i];
+    return std::vector<HeavyHitter>(ranked.begin(), ranked.begin() + static_cast<std::ptrdiff_t>(std::min(k, ranked.size())));
+}
+
+bool HeavyHitters::Exact(int series) const {
+    const int i = Tracked(series);
+    std::lock_guard<std::mutex> lock(mutex_);
+    return i >= 0 && exact_[i];
+}
@@ -0,0 +1,106 @@
+#ifndef PROC_TOPK_H
+#define PROC_TOPK_H
+
+#include "proc_snapshot.h"
+
+#include <QHash>
+
+#include <array>
+#include <mutex>
+#include <vector>
+
+// Weighted Space-Saving summary: at most capacity counters, the smallest
+// one kept at the root of a min-heap. A key without a counter takes over
+// the smallest one, inheriting its count as error, so every count is an
+// upper bound and count - error a lower bound. Until a counter has been
+// taken over all counts are exact.
+struct SpaceSaving
+{
+    struct Counter {
+        quint32 key;
+        double count;
+        double error;
+    };
+
+    explicit SpaceSaving(size_t capacity = 1024);
+
+    void Add(quint32 key, double weight);
+    void Clear();
+
+    const std::vector<Counter> &Counters() const { return heap_; }
+    // Largest amount a key without a counter can have
+    double MissingBound() const { return evictions_ ? heap_.front().count : 0.0; }
+    bool Exact() const { return evictions_ == 0; }
+
+private:
+    void SiftUp(size_t i);
+    void SiftDown(size_t i);
+    void Place(size_t i, const Counter &counter);
+
+    size_t capacity_;
+    std::vector<Counter> heap_;
+    QHash<quint32, size_t> position_;
+    quint64 evictions_ = 0;
+};
+
+// Process with one of the largest totals of a series over the window
+struct HeavyHitter {
+    quint32 pid = 0;
+    QString process;
+    int series = 0;          // ProcessSnapshot::Series
+    double amount = 0.0;     // upper bound of the total
+    double error = 0.0;      // the total is at least amount - error
+};
+
+// Totals of CPU time, I/O operations and bytes written per process over a
+// sliding window, e.g. "which processes wrote the most in the last 15
+// minutes". The window is split into panes with one Space-Saving summary
+// per series each; a pane is dropped whole when it leaves the window, so
+// the totals cover the window in whole panes plus the pane being filled. Every
+// sweep merges the panes into a ranked list per series, so Top() only
+// copies its first k entries whatever the number of processes.
+struct HeavyHitters
+{
+    explicit HeavyHitters(qint64 window_ms = 15 * 60 * 1000, int panes = 15, size_t capacity = 1024);
+
+    // Adds one enumeration sweep. Rates are turned into amounts using the
+    // time since the previous sweep.
+    void Add(const ProcessSnapshot &snapshot);
+    void Clear();
+
+    // The k largest totals of series (CpuPercent, IoOpsPerSec or
+    // WriteBytesPerSec), largest first. Amounts are CPU seconds, operations
+    // and bytes.
+    std::vector<HeavyHitter> Top(int series, size_t k) const;
+    // Whether every total of series is exact, i.e. no pane in the window
+    // ever saw more active processes than it has counters
+    bool Exact(int series) const;
+
+    // Name of the amount behind a series, e.g. "CPU_SECONDS"
+    static const char *AmountName(int series);
+    qint64 WindowMs() const { return window_ms_; }
+
+private:
+    static constexpr int kTracked[] = {ProcessSnapshot::CpuPercent, ProcessSnapshot::IoOpsPerSec,
+                                       ProcessSnapshot::WriteBytesPerSec};
+    static constexpr int kTrackedCount = 3;
+    static int Tracked(int series);
+
+    struct Pane {
+        qint64 index = -1;
+        std::array<SpaceSaving, kTrackedCount> summaries;
+    };
+
+    void Rank();
+
+    mutable std::mutex mutex_;
+    qint64 window_ms_;
+    qint64 pane_ms_;
+    std::vector<Pane> panes_;
+    qint64 last_time_ = 0;
+    QHash<quint32, QString> names_;
+    std::array<std::vector<HeavyHitter>, kTrackedCount> ranked_;
+    std::array<bool, kTrackedCount> exact_{};
+};
+
+#endif // PROC_TOPK_H
@@ -0,0 +1,181 @@
+#include "proc_trace.h"
+
+#include <QCoreApplication>
+#include <QFile>
+
+#ifdef HEALTHOPS_TRACING
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Spans kept per thread; older ones are overwritten
+static const size_t kTraceCapacity = 1 << 15;
+
+struct TraceEvent {
+    const char *name;
+    qint64 begin;
+    qint64 end;
+};
+
+// Ring of one thread. Only that thread writes; the writer publishes a span
+// by bumping written after filling its slot, and a reader keeps only the
+// slots the writer cannot have reached while they were copied.
+struct TraceBuffer {
+    quint32 tid = 0;
+    std::atomic<const char *> name{nullptr};
+    std::unique_ptr<TraceEvent[]> events{new TraceEvent[kTraceCapacity]};
+    std::atomic<quint64> written{0};
+};
+
+// A TraceClock() reading next to a steady clock reading. One is taken with
+// the first span and one when writing, which gives the clock's rate.
+struct ClockAnchor {
+    qint64 ticks;
+    qint64 ns;
+
+    static ClockAnchor Now() {
+        return {TraceClock(), std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                  std::chrono::steady_clock::now().time_since_epoch()).count()};
+    }
+};
+
+// Rings outlive their threads so spans of finished threads are written too
+static std::mutex registry_mutex;
+static std::vector<std::unique_ptr<TraceBuffer>> registry;
+static ClockAnchor first_anchor;   // guarded by registry_mutex
+static thread_local TraceBuffer *local_buffer = nullptr;
+
+static TraceBuffer *localBuffer() {
+    if (!local_buffer) {
+        auto buffer = std::make_unique<TraceBuffer>();
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        if (registry.empty()) {
+            first_anchor = ClockAnchor::Now();
+        }
+        buffer->tid = static_cast<quint32>(registry.size() + 1);
+        local_buffer = buffer.get();
+        registry.push_back(std::move(buffer));
+    }
+    return local_buffer;
+}
+
+void TraceRecord(const char *name, qint64 begin, qint64 end) {
+    TraceBuffer *buffer = localBuffer();
+    const quint64 n = buffer->written.load(std::memory_order_relaxed);
+    buffer->events[n % kTraceCapacity] = {name, begin, end};
+    buffer->written.store(n + 1, std::memory_order_release);
+}
+
+void TraceThreadName(const char *name) {
+    localBuffer()->name.store(name, std::memory_order_release);
+}
+
+// Span names are literals from the code, but keep the JSON valid anyway
+static void appendString(QByteArray &out, const char *text) {
+    out.append('"');
+    for (const char *c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            out.append('\\');
+        }
+        if (static_cast<unsigned char>(*c) >= 0x20) {
+            out.append(*c);
+        }
+    }
+    out.append('"');
+}
+
+bool WriteChromeTrace(const QString &path, QString *error) {
+    struct Thread {
+        quint32 tid;
+        const char *name;
+        std::vector<TraceEvent> events;
+    };
+    std::vector<Thread> threads;
+    double ns_per_tick = 1.0;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        const ClockAnchor last = ClockAnchor::Now();
+        if (!registry.empty() && last.ticks > first_anchor.ticks && last.ns > first_anchor.ns) {
+            ns_per_tick = static_cast<double>(last.ns - first_anchor.ns) / static_cast<double>(last.ticks - first_anchor.ticks);
+        }
+        threads.reserve(registry.size());
+        for (const auto &buffer : registry) {
+            Thread thread{buffer->tid, buffer->name.load(std::memory_order_acquire), {}};
+            const quint64 end = buffer->written.load(std::memory_order_acquire);
+            const quint64 begin = end > kTraceCapacity ? end - kTraceCapacity : 0;
+            thread.events.reserve(static_cast<size_t>(end - begin));
+            for (quint64 i = begin; i < end; ++i) {
+                thread.events.push_back(buffer->events[i % kTraceCapacity]);
+            }
+            // The writer may have lapped the oldest copied slots meanwhile;
+            // the one it is filling now is the slot after written
+            const quint64 after = buffer->written.load(std::memory_order_acquire);
+            if (after + 1 > begin + kTraceCapacity) {
+                const size_t stale = static_cast<size_t>(std::min<quint64>(after + 1 - kTraceCapacity - begin, end - begin));
+                thread.events.erase(thread.events.begin(), thread.events.begin() + static_cast<std::ptrdiff_t>(stale));
+            }
+            threads.push_back(std::move(thread));
+        }
+    }
+
+    // Times relative to the first span keep the numbers short
+    qint64 origin = std::numeric_limits<qint64>::max();
+    for (const Thread &thread : threads) {
+        for (const TraceEvent &event : thread.events) {
+            origin = std::min(origin, event.begin);
+        }
+    }
+
+    const QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+    QByteArray out;
+    out.append("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    bool first = true;
+    auto separator = [&]() {
+        out.append(first ? "\n" : ",\n");
+        first = false;
+    };
+    for (const Thread &thread : threads) {
+        if (thread.name) {
+            separator();
+            out.append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"tid\":" + QByteArray::number(thread.tid)
+                       + ",\"args\":{\"name\":");
+            appendString(out, thread.name);
+            out.append("}}");
+        }
+        for (const TraceEvent &event : thread.events) {
+            separator();
+            out.append("{\"name\":");
+            appendString(out, event.name);
+            out.append(",\"ph\":\"X\",\"ts\":" + QByteArray::number((event.begin - origin) * ns_per_tick / 1000.0, 'f', 3)
+                       + ",\"dur\":" + QByteArray::number((event.end - event.begin) * ns_per_tick / 1000.0, 'f', 3)
+                       + ",\"pid\":" + pid + ",\"tid\":" + QByteArray::number(thread.tid) + "}");
+        }
+    }
+    out.append("\n]}\n");
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(out) != out.size()) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+    return true;
+}
+
+#else
+
+bool WriteChromeTrace(const QString &path, QString *error) {
+    Q_UNUSED(path);
+    if (error) {
+        *error = "tracing is not compiled in; build with CONFIG+=tracing";
+    }
+    return false;
+}
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef PROC_TRACE_H
+#define PROC_TRACE_H
+
+#include <QString>
+#include <QtGlobal>
+
+#ifdef HEALTHOPS_TRACING
+#if defined(Q_PROCESSOR_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(Q_PROCESSOR_X86)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+#endif
+
+// Scoped timing spans for finding where the sampling thread, storage,
+// enumeration and UI slots spend their time. A span is recorded into a
+// ring owned by the calling thread without locks or allocation; the rings
+// are written out on demand as Chrome trace-event JSON, which Perfetto and
+// chrome://tracing open.
+//
+// Spans are only compiled in with CONFIG+=tracing, which defines
+// HEALTHOPS_TRACING. Otherwise TRACE_SPAN and TRACE_THREAD expand to
+// nothing and WriteChromeTrace() only reports that.
+//
+//   void Database::Save(...) {
+//       TRACE_SPAN("db.save");   // a string literal; only the pointer is kept
+//       ...
+//   }
+
+#ifdef HEALTHOPS_TRACING
+
+inline constexpr bool kTracingEnabled = true;
+
+// Span timestamps in ticks of the cheapest monotonic clock: the time-stamp
+// counter on x86, which costs a fraction of a system clock read, converted
+// to time when the trace is written
+inline qint64 TraceClock() {
+#ifdef Q_PROCESSOR_X86
+    return static_cast<qint64>(__rdtsc());
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Adds a finished span to the calling thread's ring
+void TraceRecord(const char *name, qint64 begin, qint64 end);
+// Names the calling thread in the trace
+void TraceThreadName(const char *name);
+
+struct TraceSpan
+{
+    explicit TraceSpan(const char *name) : name_(name), begin_(TraceClock()) {}
+    ~TraceSpan() { TraceRecord(name_, begin_, TraceClock()); }
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+    const char *name_;
+    qint64 begin_;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SPAN(name) TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name)
+#define TRACE_THREAD(name) TraceThreadName(name)
+
+#else
+
+inline constexpr bool kTracingEnabled = false;
+
+#define TRACE_SPAN(name) static_cast<void>(0)
+#define TRACE_THREAD(name) static_cast<void>(0)
+
+#endif
+
+// Writes the spans still held by every thread's ring to path. Returns false
+// and sets error if that failed or tracing is not compiled in.
+bool WriteChromeTrace(const QString &path, QString *error = nullptr);
+
+#endif // PROC_TRACE_H
@@ -0,0 +1,208 @@
+#include "proc_trend.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const double kMsPerHour = 3600.0 * 1000.0;
+
+// Growth only counts as sustained when the line explains most of the
+// variation and adds at least this much over the window
+static const double kMinR2 = 0.5;
+static const double kMinRelativeGrowth = 0.02;
+static const double kMinAbsoluteGrowth = 1024.0 * 1024.0;
+
+// Fraction of the window that must hold samples before it is trusted
+static const double kMinCoverage = 0.8;
+
+static int fieldIndex(quint64 Stats::*member) {
+    for (size_t i = 0; i < kStatsFieldCount; ++i) {
+        if (kStatsFields[i].member == member) {
+            return static_cast<int>(i);
+        }
+    }
+    return 0;
+}
+
+SlidingTrend::SlidingTrend(qint64 window_ms, int buckets)
+    : window_ms_(window_ms), bucket_ms_(std::max<qint64>(window_ms / std::max(buckets, 2), 1)),
+      buckets_(static_cast<size_t>(std::max(buckets, 2))) {
+}
+
+void SlidingTrend::Clear() {
+    std::fill(buckets_.begin(), buckets_.end(), Bucket());
+    newest_ = -1;
+    theil_sen_ = 0.0;
+}
+
+void SlidingTrend::Add(qint64 time_stamp, double value) {
+    if (newest_ < 0) {
+        origin_ = time_stamp;
+    }
+
+    const qint64 index = time_stamp / bucket_ms_;
+    const qint64 count = static_cast<qint64>(buckets_.size());
+    if (index <= newest_ - count) {
+        return;  // older than the window
+    }
+
+    Bucket &bucket = buckets_[static_cast<size_t>(index % count)];
+    if (bucket.index != index) {
+        if (index < newest_) {
+            return;  // late sample for a bucket already reused
+        }
+        bucket = Bucket();
+        bucket.index = index;
+    }
+
+    const double t = (time_stamp - origin_) / kMsPerHour;
+    bucket.n += 1.0;
+    bucket.st += t;
+    bucket.sx += value;
+    bucket.stt += t * t;
+    bucket.stx += t * value;
+    bucket.sxx += value * value;
+
+    if (index > newest_) {
+        const bool closed = newest_ >= 0;
+        newest_ = index;
+        if (closed) {
+            UpdateTheilSen();
+        }
+    }
+}
+
+void SlidingTrend::UpdateTheilSen() {
+    const qint64 oldest = newest_ - static_cast<qint64>(buckets_.size());
+
+    // Means of the closed buckets in the window, in time order
+    std::vector<std::pair<double, double>> &points = points_;
+    points.clear();
+    for (const Bucket &bucket : buckets_) {
+        if (bucket.index > oldest && bucket.index < newest_ && bucket.n > 0) {
+            points.emplace_back(bucket.st / bucket.n, bucket.sx / bucket.n);
+        }
+    }
+
+    slopes_.clear();
+    for (size_t i = 0; i < points.size(); ++i) {
+        for (size_t j = i + 1; j < points.size(); ++j) {
+            const double dt = points[j].first - points[i].first;
+            if (dt != 0.0) {
+                slopes_.push_back((points[j].second - points[i].second) / dt);
+            }
+        }
+    }
+
+    if (slopes_.empty()) {
+        theil_sen_ = 0.0;
+        return;
+    }
+    auto middle = slopes_.begin() + static_cast<std::ptrdiff_t>(slopes_.size() / 2);
+    std::nth_element(slopes_.begin(), middle, slopes_.end());
+    theil_sen_ = *middle;
+}
+
+void SlidingTrend::Estimate(TrendEstimate &estimate) const {
+    estimate.window_ms = window_ms_;
+    estimate.least_squares = 0.0;
+    estimate.theil_sen = theil_sen_;
+    estimate.r2 = 0.0;
+    estimate.current = 0.0;
+    estimate.covered = false;
+
+    if (newest_ < 0) {
+        return;
+    }
+
+    const qint64 count = static_cast<qint64>(buckets_.size());
+    const qint64 oldest = newest_ - count;
+    qint64 first = newest_;
+    double n = 0.0, st = 0.0, sx = 0.0, stt = 0.0, stx = 0.0, sxx = 0.0;
+    for (const Bucket &bucket : buckets_) {
+        if (bucket.index <= oldest || bucket.n == 0) {
+            continue;
+        }
+        first = std::min(first, bucket.index);
+        n += bucket.n;
+        st += bucket.st;
+        sx += bucket.sx;
+        stt += bucket.stt;
+        stx += bucket.stx;
+        sxx += bucket.sxx;
+    }
+
+    const Bucket &current = buckets_[static_cast<size_t>(newest_ % count)];
+    estimate.current = current.sx / current.n;
+    estimate.covered = newest_ - first + 1 >= static_cast<qint64>(kMinCoverage * count);
+
+    const double ctt = n * stt - st * st;
+    const double ctx = n * stx - st * sx;
+    const double cxx = n * sxx - sx * sx;
+    if (n < 2.0 || ctt <= 0.0) {
+        return;
+    }
+    estimate.least_squares = ctx / ctt;
+    estimate.r2 = cxx > 0.0 ? (ctx * ctx) / (ctt * cxx) : 0.0;
+}
+
+LeakDetector::LeakDetector() {
+    const qint64 windows[] = {10LL * 60 * 1000, 3600LL * 1000, 24LL * 3600 * 1000};
+    for (quint64 Stats::*member : {&Stats::PROC_WORKINGSETSIZE, &Stats::PROC_PAGEFILEUSAGE}) {
+        Series series;
+        series.metric = fieldIndex(member);
+        series.limit = 0.0;
+        for (qint64 window : windows) {
+            series.windows.emplace_back(window);
+        }
+        series_.push_back(std::move(series));
+    }
+}
+
+void LeakDetector::Update(qint64 time_stamp, const Stats &stats) {
+    for (Series &series : series_) {
+        const double value = static_cast<double>(stats.*kStatsFields[series.metric].member);
+        for (SlidingTrend &window : series.windows) {
+            window.Add(time_stamp, value);
+        }
+    }
+}
+
+void LeakDetector::Clear() {
+    for (Series &series : series_) {
+        for (SlidingTrend &window : series.windows) {
+            window.Clear();
+        }
+    }
+}
+
+void LeakDetector::SetLimits(double working_set_limit, double pagefile_limit) {
+    series_[0].limit = working_set_limit;
+    series_[1].limit = pagefile_limit;
+}
+
+std::vector<TrendEstimate> LeakDetector::Estimates() const {
+    std::vector<TrendEstimate> estimates;
+    for (const Series &series : series_) {
+        for (const SlidingTrend &window : series.windows) {
+            TrendEstimate estimate;
+            estimate.metric = series.metric;
+            estimate.limit = series.limit;
+            window.Estimate(estimate);
+
+            const double hours = window.WindowMs() / kMsPerHour;
+            const double min_growth = std::max(kMinRelativeGrowth * estimate.current, kMinAbsoluteGrowth);
+            estimate.growing = estimate.covered
+                               && estimate.least_squares > 0.0 && estimate.theil_sen > 0.0
+                               && estimate.r2 >= kMinR2
+                               && estimate.theil_sen * hours >= min_growth;
+
+            if (series.limit > 0.0 && estimate.current >= series.limit) {
+                estimate.hours_to_limit = 0.0;
+            } else if (series.limit > 0.0 && estimate.theil_sen > 0.0) {
+                estimate.hours_to_limit = (series.limit - estimate.current) / estimate.theil_sen;
+            }
+            estimates.push_back(estimate);
+        }
+    }
+    return estimates;
+}
@@ -0,0 +1,90 @@
+#ifndef PROC_TREND_H
+#define PROC_TREND_H
+
+#include "proc_stats.h"
+
+#include <vector>
+
+// Growth of one metric over one sliding window
+struct TrendEstimate {
+    int metric = 0;               // index into kStatsFields
+    qint64 window_ms = 0;
+    double least_squares = 0.0;   // slope, units per hour
+    double theil_sen = 0.0;       // slope, units per hour
+    double r2 = 0.0;              // fit of the least-squares line
+    double current = 0.0;         // mean of the newest bucket
+    double limit = 0.0;           // 0 when unknown
+    double hours_to_limit = -1.0; // negative when not approaching the limit
+    bool covered = false;         // the window is mostly filled with samples
+    bool growing = false;         // sustained growth
+};
+
+// Slope of a series over a sliding time window, in bounded memory. The
+// window is split into a fixed number of buckets, each holding the sums a
+// least-squares fit needs. Adding a sample is O(1); the Theil-Sen slope (the
+// median of the pairwise slopes between bucket means) is recomputed only
+// when a bucket closes.
+struct SlidingTrend
+{
+    SlidingTrend(qint64 window_ms, int buckets = 60);
+
+    void Add(qint64 time_stamp, double value);
+    void Clear();
+
+    // Fills the slopes, fit, coverage and current value of estimate
+    void Estimate(TrendEstimate &estimate) const;
+
+    qint64 WindowMs() const { return window_ms_; }
+
+private:
+    struct Bucket {
+        qint64 index = -1;  // time_stamp / bucket width; -1 when empty
+        double n = 0.0;
+        double st = 0.0;
+        double sx = 0.0;
+        double stt = 0.0;
+        double stx = 0.0;
+        double sxx = 0.0;
+    };
+
+    void UpdateTheilSen();
+
+    qint64 window_ms_;
+    qint64 bucket_ms_;
+    std::vector<Bucket> buckets_;
+    qint64 newest_ = -1;
+    qint64 origin_ = 0;      // times are hours since origin_
+    double theil_sen_ = 0.0;
+
+    // Scratch for UpdateTheilSen
+    std::vector<std::pair<double, double>> points_;
+    std::vector<double> slopes_;
+};
+
+// Leak detector over the working set and the pagefile usage of one
+// process. Each metric is followed over 10 minute, 1 hour and 24 hour
+// windows; growth counts as sustained when both slope estimates agree, the
+// line fits, and the window is mostly covered.
+struct LeakDetector
+{
+    LeakDetector();
+
+    void Update(qint64 time_stamp, const Stats &stats);
+    void Clear();
+
+    // Limits the metrics grow towards, in bytes; 0 disables time-to-limit
+    void SetLimits(double working_set_limit, double pagefile_limit);
+
+    std::vector<TrendEstimate> Estimates() const;
+
+private:
+    struct Series {
+        int metric;
+        double limit;
+        std::vector<SlidingTrend> windows;
+    };
+
+    std::vector<Series> series_;
+};
+
+#endif // PROC_TREND_H
@@ -0,0 +1,39 @@
+#include "processfilterproxymodel.h"
+#include "processtablemodel.h"
+
+ProcessFilterProxyModel::ProcessFilterProxyModel(ProcessTableModel *model, QObject *parent)
+    : QSortFilterProxyModel(parent)
+    , processModel(model)
+{
+    setSourceModel(model);
+    setSortRole(ProcessTableModel::SortRole);
+    setDynamicSortFilter(true);
+    connect(model, &ProcessTableModel::indexRebuilt, this, &ProcessFilterProxyModel::refilter);
+}
+
+void ProcessFilterProxyModel::setQuery(const QString &query)
+{
+    if (query == currentQuery) {
+        return;
+    }
+    currentQuery = query;
+    refilter();
+}
+
+void ProcessFilterProxyModel::refilter()
+{
+    matches = processModel->searchIndex().Search(currentQuery, accepted);
+    invalidateRowsFilter();
+    emit matchCountChanged(static_cast<int>(matches));
+}
+
+bool ProcessFilterProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+{
+    Q_UNUSED(sourceParent);
+    // Rows the index has not seen yet (mid-refresh) stay visible until the
+    // model reports the rebuilt index
+    if (sourceRow < 0 || static_cast<size_t>(sourceRow) >= accepted.size()) {
+        return true;
+    }
+    return accepted[static_cast<size_t>(sourceRow)] != 0;
+}
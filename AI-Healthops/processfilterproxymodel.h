@@ -0,0 +1,42 @@
+#ifndef PROCESSFILTERPROXYMODEL_H
+#define PROCESSFILTERPROXYMODEL_H
+
+#include <QSortFilterProxyModel>
+
+#include <vector>
+
+class ProcessTableModel;
+
+// Sorting and filtering proxy over a ProcessTableModel. The filter is a
+// ProcessSearchIndex query evaluated once per keystroke or refresh for all
+// rows; filterAcceptsRow() only looks the row up. Several views can each
+// have their own proxy (and query) over the same model.
+class ProcessFilterProxyModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+
+public:
+    explicit ProcessFilterProxyModel(ProcessTableModel *model, QObject *parent = nullptr);
+
+    QString query() const { return currentQuery; }
+    int matchCount() const { return static_cast<int>(matches); }
+
+public slots:
+    void setQuery(const QString &query);
+
+signals:
+    void matchCountChanged(int count);
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
+
+private:
+    void refilter();
+
+    ProcessTableModel *processModel;
+    QString currentQuery;
+    std::vector<char> accepted;
+    size_t matches = 0;
+};
+
+#endif // PROCESSFILTERPROXYMODEL_H
@@ -0,0 +1,203 @@
+#include "processtablemodel.h"
+#include "proc_trace.h"
+
+#include <QBrush>
+#include <QColor>
+
+ProcessTableModel::ProcessTableModel(QObject *parent)
+    : QAbstractTableModel(parent)
+{
+}
+
+int ProcessTableModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : static_cast<int>(rows.Size());
+}
+
+int ProcessTableModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant ProcessTableModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= static_cast<int>(rows.Size())) {
+        return QVariant();
+    }
+
+    const size_t row = static_cast<size_t>(index.row());
+    const double totalCpu = rows.cpu_user_percent[row] + rows.cpu_kernel_percent[row];
+
+    const HeavyHitter *windowTotal = nullptr;
+    if (index.column() == CpuWindowColumn || index.column() == WrittenWindowColumn) {
+        const QHash<quint32, HeavyHitter> &totals = index.column() == CpuWindowColumn ? cpuWindow : writtenWindow;
+        auto it = totals.constFind(rows.pids[row]);
+        if (it != totals.constEnd()) {
+            windowTotal = &it.value();
+        }
+    }
+    auto formatTotal = [&](double amount) {
+        return index.column() == CpuWindowColumn ? QString::number(amount, 'f', 1) + " s"
+                                                 : QString::number(amount / (1024.0 * 1024.0), 'f', 1) + " MB";
+    };
+
+    switch (role) {
+    case Qt::DisplayRole:
+        switch (index.column()) {
+        case NameColumn:       return rows.names[row];
+        case PidColumn:        return rows.pids[row];
+        case CpuUserColumn:    return QString::number(rows.cpu_user_percent[row], 'f', 1) + "%";
+        case CpuKernelColumn:  return QString::number(rows.cpu_kernel_percent[row], 'f', 1) + "%";
+        case CpuTotalColumn:   return QString::number(totalCpu, 'f', 1) + "%";
+        case WorkingSetColumn: return QString::number(rows.working_set[row] / (1024.0 * 1024.0), 'f', 1) + " MB";
+        case CpuWindowColumn:
+        case WrittenWindowColumn:
+            return windowTotal ? formatTotal(windowTotal->amount) : QString();
+        case UserColumn:       return rows.users[row];
+        }
+        break;
+
+    case Qt::ToolTipRole:
+        // Totals past the summary's capacity are estimates with bounds
+        if (windowTotal && windowTotal->error > 0.0) {
+            return QString("Between %1 and %2").arg(formatTotal(windowTotal->amount - windowTotal->error),
+                                                    formatTotal(windowTotal->amount));
+        }
+        break;
+
+    case SortRole:
+        switch (index.column()) {
+        case NameColumn:       return rows.names[row];
+        case PidColumn:        return rows.pids[row];
+        case CpuUserColumn:    return rows.cpu_user_percent[row];
+        case CpuKernelColumn:  return rows.cpu_kernel_percent[row];
+        case CpuTotalColumn:   return totalCpu;
+        case WorkingSetColumn: return rows.working_set[row];
+        case CpuWindowColumn:
+        case WrittenWindowColumn:
+            return windowTotal ? windowTotal->amount : 0.0;
+        case UserColumn:       return rows.users[row];
+        }
+        break;
+
+    case Qt::TextAlignmentRole:
+        if (index.column() != NameColumn && index.column() != UserColumn) {
+            return int(Qt::AlignRight | Qt::AlignVCenter);
+        }
+        break;
+
+    case Qt::BackgroundRole:
+        // Color code based on CPU usage
+        if (index.column() == CpuTotalColumn) {
+            if (totalCpu > 5.0) {
+                return QBrush(QColor(255, 200, 200)); // Light red for high usage
+            } else if (totalCpu > 2.0) {
+                return QBrush(QColor(255, 255, 200)); // Light yellow for medium usage
+            }
+            return QBrush(QColor(200, 255, 200)); // Light green for low usage
+        }
+        break;
+    }
+
+    return QVariant();
+}
+
+QVariant ProcessTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole || orientation != Qt::Horizontal) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+
+    switch (section) {
+    case NameColumn:       return QStringLiteral("Process");
+    case PidColumn:        return QStringLiteral("PID");
+    case CpuUserColumn:    return QStringLiteral("CPU-User%");
+    case CpuKernelColumn:  return QStringLiteral("CPU-Kernel");
+    case CpuTotalColumn:   return QStringLiteral("Total CPU");
+    case WorkingSetColumn: return QStringLiteral("Working Set");
+    case CpuWindowColumn:  return QStringLiteral("CPU 15 min");
+    case WrittenWindowColumn: return QStringLiteral("Written 15 min");
+    case UserColumn:       return QStringLiteral("User");
+    }
+    return QVariant();
+}
+
+void ProcessTableModel::setHeavyHitters(const std::vector<HeavyHitter> &cpu, const std::vector<HeavyHitter> &written)
+{
+    cpuWindow.clear();
+    for (const HeavyHitter &hitter : cpu) {
+        cpuWindow.insert(hitter.pid, hitter);
+    }
+    writtenWindow.clear();
+    for (const HeavyHitter &hitter : written) {
+        writtenWindow.insert(hitter.pid, hitter);
+    }
+    if (!rows.Size()) {
+        return;
+    }
+    emit dataChanged(index(0, CpuWindowColumn), index(static_cast<int>(rows.Size()) - 1, WrittenWindowColumn));
+}
+
+void ProcessTableModel::setSnapshot(const ProcessSnapshot &snapshot)
+{
+    TRACE_SPAN("ui.process_model");
+    nextRows.clear();
+    nextRows.reserve(static_cast<qsizetype>(snapshot.Size()));
+    for (size_t i = 0; i < snapshot.Size(); ++i) {
+        nextRows.insert(snapshot.pids[i], i);
+    }
+
+    // Remove exited processes, one contiguous run at a time from the end
+    int row = static_cast<int>(rows.Size()) - 1;
+    while (row >= 0) {
+        if (nextRows.contains(rows.pids[row])) {
+            --row;
+            continue;
+        }
+        const int last = row;
+        while (row >= 0 && !nextRows.contains(rows.pids[row])) {
+            --row;
+        }
+        const int first = row + 1;
+        beginRemoveRows(QModelIndex(), first, last);
+        rows.EraseRows(static_cast<size_t>(first), static_cast<size_t>(last) + 1);
+        endRemoveRows();
+    }
+
+    // Update surviving rows in place and report the changed runs
+    matched.assign(snapshot.Size(), 0);
+    int changedFirst = -1;
+    const int surviving = static_cast<int>(rows.Size());
+    for (int r = 0; r < surviving; ++r) {
+        const size_t from = nextRows.value(rows.pids[r]);
+        matched[from] = 1;
+        const bool changed = rows.AssignRow(static_cast<size_t>(r), snapshot, from);
+        if (changed && changedFirst < 0) {
+            changedFirst = r;
+        } else if (!changed && changedFirst >= 0) {
+            emit dataChanged(index(changedFirst, 0), index(r - 1, ColumnCount - 1));
+            changedFirst = -1;
+        }
+    }
+    if (changedFirst >= 0) {
+        emit dataChanged(index(changedFirst, 0), index(surviving - 1, ColumnCount - 1));
+    }
+
+    // Append processes that started since the last refresh
+    const int added = static_cast<int>(snapshot.Size()) - surviving;
+    if (added > 0) {
+        beginInsertRows(QModelIndex(), surviving, surviving + added - 1);
+        for (size_t i = 0; i < snapshot.Size(); ++i) {
+            if (!matched[i]) {
+                rows.AppendRow(snapshot, i);
+            }
+        }
+        endInsertRows();
+    }
+
+    rows.time_stamp = snapshot.time_stamp;
+    rows.system_time = snapshot.system_time;
+
+    rowIndex.Build(rows);
+    emit indexRebuilt();
+}
@@ -0,0 +1,66 @@
+#ifndef PROCESSTABLEMODEL_H
+#define PROCESSTABLEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QHash>
+
+#include "proc_snapshot.h"
+#include "proc_search_index.h"
+#include "proc_topk.h"
+
+// Table model over a ProcessSnapshot. Cells are formatted on demand, so only
+// visible rows cost anything to render. Rows keep a stable order across
+// refreshes: exited processes are removed, new ones appended, and changed
+// rows are reported as contiguous dataChanged ranges.
+class ProcessTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column {
+        NameColumn,
+        PidColumn,
+        CpuUserColumn,
+        CpuKernelColumn,
+        CpuTotalColumn,
+        WorkingSetColumn,
+        CpuWindowColumn,       // CPU seconds over the heavy-hitter window
+        WrittenWindowColumn,   // bytes written over the heavy-hitter window
+        UserColumn,
+        ColumnCount
+    };
+
+    // Numeric value for numeric columns, used by the proxy for sorting
+    static const int SortRole = Qt::UserRole;
+
+    explicit ProcessTableModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    void setSnapshot(const ProcessSnapshot &snapshot);
+    const ProcessSnapshot &snapshot() const { return rows; }
+
+    // Window totals of the heaviest processes; other rows show no total
+    void setHeavyHitters(const std::vector<HeavyHitter> &cpu, const std::vector<HeavyHitter> &written);
+
+    // Index over the current rows, rebuilt by every setSnapshot()
+    const ProcessSearchIndex &searchIndex() const { return rowIndex; }
+
+signals:
+    void indexRebuilt();
+
+private:
+    ProcessSnapshot rows;
+    ProcessSearchIndex rowIndex;
+    QHash<quint32, HeavyHitter> cpuWindow;
+    QHash<quint32, HeavyHitter> writtenWindow;
+
+    // Scratch buffers reused between refreshes
+    QHash<quint32, size_t> nextRows;
+    std::vector<char> matched;
+};
+
+#endif // PROCESSTABLEMODEL_H
@@ -0,0 +1,174 @@
+#include "proc_rules.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtTest>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+static const char *const kAggregates[] = {"value", "delta", "mean", "min", "max", "slope"};
+
+// Windows of one and two samples are where off-by-one errors show first
+static const int kWindows[] = {1, 2, 7, 50};
+
+// More than three times the longest window, so every window fills, slides
+// and is re-normalised several times
+static const int kSamples = 200;
+
+// Samples per hour at the engine's default interval of 1 s
+static const double kSamplesPerHour = 3600.0;
+
+// Aggregate of the window ending at s, computed from scratch. Windows
+// shorter than w at the start cover every sample so far, as in the engine.
+static double bruteForce(const QString &aggregate, int w, const std::vector<double> &x, size_t s) {
+    const size_t window = static_cast<size_t>(w);
+    const size_t n = std::min(window, s + 1);
+    const auto begin = x.begin() + static_cast<std::ptrdiff_t>(s + 1 - n);
+    const auto end = x.begin() + static_cast<std::ptrdiff_t>(s + 1);
+    if (aggregate == "value") {
+        return x[s];
+    }
+    if (aggregate == "delta") {
+        return x[s] - x[s >= window ? s - window : 0];
+    }
+    if (aggregate == "mean") {
+        double sum = 0.0;
+        for (auto it = begin; it != end; ++it) {
+            sum += *it;
+        }
+        return sum / static_cast<double>(n);
+    }
+    if (aggregate == "min") {
+        return *std::min_element(begin, end);
+    }
+    if (aggregate == "max") {
+        return *std::max_element(begin, end);
+    }
+    // Least-squares slope against t = 0..n-1, per hour
+    if (n < 2) {
+        return 0.0;
+    }
+    double mean_t = 0.0;
+    double mean_x = 0.0;
+    for (size_t t = 0; t < n; ++t) {
+        mean_t += static_cast<double>(t);
+        mean_x += begin[static_cast<std::ptrdiff_t>(t)];
+    }
+    mean_t /= static_cast<double>(n);
+    mean_x /= static_cast<double>(n);
+    double covariance = 0.0;
+    double variance = 0.0;
+    for (size_t t = 0; t < n; ++t) {
+        const double dt = static_cast<double>(t) - mean_t;
+        covariance += dt * (begin[static_cast<std::ptrdiff_t>(t)] - mean_x);
+        variance += dt * dt;
+    }
+    return covariance / variance * kSamplesPerHour;
+}
+
+class RulesTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void slidingAggregatesMatchBruteForce_data();
+    void slidingAggregatesMatchBruteForce();
+};
+
+void RulesTest::slidingAggregatesMatchBruteForce_data()
+{
+    QTest::addColumn<std::vector<double>>("values");
+
+    std::mt19937_64 random(340);
+
+    // Large values drifting both ways, where the running sums lose low bits
+    std::vector<double> walk;
+    double level = 4.0e9;
+    std::normal_distribution<double> step(0.0, 5.0e6);
+    for (int i = 0; i < kSamples; ++i) {
+        level = std::max(0.0, level + std::round(step(random)));
+        walk.push_back(level);
+    }
+    QTest::newRow("random walk") << walk;
+
+    // Few distinct values, so min and max see many ties
+    std::vector<double> ties;
+    for (int i = 0; i < kSamples; ++i) {
+        ties.push_back(static_cast<double>(random() % 4));
+    }
+    QTest::newRow("ties") << ties;
+
+    // Monotonic runs, which fill and then drain the queues
+    std::vector<double> sawtooth;
+    for (int i = 0; i < kSamples; ++i) {
+        sawtooth.push_back(static_cast<double>(i % 60 < 30 ? i % 60 : 60 - i % 60) * 1000.0);
+    }
+    QTest::newRow("sawtooth") << sawtooth;
+}
+
+void RulesTest::slidingAggregatesMatchBruteForce()
+{
+    QFETCH(std::vector<double>, values);
+
+    // One rule per aggregate and window that always matches, so its
+    // evidence is the input's value after every sample
+    struct Probe {
+        QString aggregate;
+        int window;
+    };
+    std::vector<Probe> probes;
+    QJsonArray rules;
+    for (const char *aggregate : kAggregates) {
+        for (int window : kWindows) {
+            QJsonObject condition;
+            condition["metric"] = "PROC_WORKINGSETSIZE";
+            condition["aggregate"] = aggregate;
+            condition["window"] = window;
+            condition["op"] = ">=";
+            condition["value"] = -1.0e300;
+            QJsonObject rule;
+            rule["id"] = QString("%1-%2").arg(aggregate).arg(window);
+            rule["when"] = QJsonArray{condition};
+            rules.append(rule);
+            probes.push_back({aggregate, window});
+        }
+    }
+
+    RuleEngine engine;
+    QString error;
+    QVERIFY2(engine.Compile(QJsonDocument(QJsonObject{{"rules", rules}}).toJson(), "test", &error), qPrintable(error));
+
+    // Scale of the running sums behind mean and slope
+    const double magnitude = std::max(1.0, *std::max_element(values.begin(), values.end())) * kSamplesPerHour;
+
+    std::vector<RuleMatch> active;
+    for (size_t s = 0; s < values.size(); ++s) {
+        Stats stats{};
+        stats.PROC_WORKINGSETSIZE = static_cast<quint64>(values[s]);
+        engine.Update(stats, active);
+        QCOMPARE(active.size(), probes.size());
+
+        for (size_t i = 0; i < probes.size(); ++i) {
+            const Probe &probe = probes[i];
+            QCOMPARE(active[i].rule, static_cast<int>(i));
+            QCOMPARE(active[i].evidence.size(), static_cast<size_t>(1));
+            const double expected = bruteForce(probe.aggregate, probe.window, values, s);
+            const double actual = active[i].evidence[0];
+            // Running sums drift a little from a fresh sum; min, max, value
+            // and delta must be exact
+            const bool summed = probe.aggregate == "mean" || probe.aggregate == "slope";
+            const double allowed = summed ? 1e-9 * std::max(std::abs(expected), magnitude) : 0.0;
+            QVERIFY2(std::abs(actual - expected) <= allowed,
+                     qPrintable(QString("%1(%2) at sample %3: engine %4, brute force %5")
+                                    .arg(probe.aggregate).arg(probe.window).arg(s).arg(actual, 0, 'g', 17)
+                                    .arg(expected, 0, 'g', 17)));
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(RulesTest)
+#include "rules_test.moc"
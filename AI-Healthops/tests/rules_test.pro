@@ -0,0 +1,14 @@
+QT = core testlib
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TARGET = rules_test
+
+# The rule engine's O(1) sliding aggregates against the same aggregates
+# computed from scratch over every window. Run with "make check".
+
+include(../collector.pri)
+
+SOURCES += \
+    rules_test.cpp
@@ -0,0 +1,137 @@
+#include "proc_database.h"
+#include "proc_sketch.h"
+
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+static const double kQuantiles[] = {0.0, 0.01, 0.25, 0.5, 0.75, 0.9, 0.95, 0.99, 1.0};
+
+// Values per sketch, one a second for a minute
+static const int kValuesPerMinute = 60;
+
+// Log-uniform over six decades, so every quantile lands in a different bin
+static double randomValue(std::mt19937_64 &random) {
+    return std::pow(10.0, std::uniform_real_distribution<double>(0.0, 6.0)(random));
+}
+
+// Every quantile of sketch is within the relative accuracy of the value at
+// the same rank of the raw values
+static void compareQuantiles(const QuantileSketch &sketch, std::vector<double> values) {
+    QCOMPARE(sketch.Count(), static_cast<quint64>(values.size()));
+    std::sort(values.begin(), values.end());
+    for (double q : kQuantiles) {
+        const double expected = values[static_cast<size_t>(q * static_cast<double>(values.size() - 1))];
+        const double actual = sketch.Quantile(q);
+        QVERIFY2(std::abs(actual - expected) <= expected * QuantileSketch::kRelativeAccuracy * (1.0 + 1e-9),
+                 qPrintable(QString("q %1: sketch %2, raw %3").arg(q).arg(actual).arg(expected)));
+    }
+}
+
+class SketchTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void mergedQuantilesMatchRawValues();
+    void storedSketchesMergeByRangeAndPid();
+};
+
+void SketchTest::mergedQuantilesMatchRawValues()
+{
+    std::mt19937_64 random(36);
+    std::vector<double> values;
+    SketchRecord merged;
+    for (int minute = 0; minute < 60; ++minute) {
+        SketchRecord record;
+        for (int i = 0; i < kValuesPerMinute; ++i) {
+            const double value = randomValue(random);
+            record.Add(value);
+            values.push_back(value);
+        }
+
+        // Stored sketches go through their serialized form
+        SketchRecord stored = record;
+        QVERIFY(QuantileSketch::Deserialize(record.sketch.Serialize(), stored.sketch));
+        merged.Merge(stored);
+    }
+
+    compareQuantiles(merged.sketch, values);
+    QCOMPARE(merged.min, *std::min_element(values.begin(), values.end()));
+    QCOMPARE(merged.max, *std::max_element(values.begin(), values.end()));
+}
+
+void SketchTest::storedSketchesMergeByRangeAndPid()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    const qint64 base = 1700000000000LL / 60000 * 60000;
+    const quint32 pids[] = {100, 200, 300};
+    const int minutes = 10;
+
+    // Raw values by pid and minute. The sampled process's own sketches share
+    // PIDs and minutes with the enumerator's but must not leak in.
+    std::mt19937_64 random(360);
+    std::vector<std::vector<std::vector<double>>> raw(std::size(pids), std::vector<std::vector<double>>(minutes));
+    std::vector<SketchRecord> records;
+    for (size_t p = 0; p < std::size(pids); ++p) {
+        for (int minute = 0; minute < minutes; ++minute) {
+            for (const char *metric : {"SNAP_CPU_PERCENT", "CPU_USERPERCENT"}) {
+                SketchRecord record;
+                record.pid = pids[p];
+                record.process = QString("process-%1.exe").arg(pids[p]);
+                record.metric = metric;
+                record.start = base + minute * 60000;
+                record.duration = 60000;
+                for (int i = 0; i < kValuesPerMinute; ++i) {
+                    const double value = randomValue(random);
+                    record.Add(value);
+                    if (record.metric == "SNAP_CPU_PERCENT") {
+                        raw[p][minute].push_back(value);
+                    }
+                }
+                records.push_back(std::move(record));
+            }
+        }
+    }
+
+    Database database(dir.filePath("sketches.db"), "sketch-test");
+    QVERIFY(database.SaveSketches(records));
+
+    // Minutes 2 to 6 of the first and last process
+    std::vector<double> expected;
+    for (size_t p : {size_t(0), size_t(2)}) {
+        for (int minute = 2; minute <= 6; ++minute) {
+            expected.insert(expected.end(), raw[p][minute].begin(), raw[p][minute].end());
+        }
+    }
+    SketchRecord merged;
+    QCOMPARE(database.MergeSketches("SNAP_CPU_PERCENT", {pids[0], pids[2]}, base + 2 * 60000, base + 6 * 60000, merged), 10);
+    compareQuantiles(merged.sketch, expected);
+    QCOMPARE(merged.min, *std::min_element(expected.begin(), expected.end()));
+    QCOMPARE(merged.max, *std::max_element(expected.begin(), expected.end()));
+
+    // No pids is every process
+    std::vector<double> all;
+    for (const auto &process : raw) {
+        for (const auto &minute : process) {
+            all.insert(all.end(), minute.begin(), minute.end());
+        }
+    }
+    SketchRecord everything;
+    QCOMPARE(database.MergeSketches("SNAP_CPU_PERCENT", {}, base, base + (minutes - 1) * 60000, everything),
+             static_cast<int>(std::size(pids)) * minutes);
+    compareQuantiles(everything.sketch, all);
+
+    SketchRecord none;
+    QCOMPARE(database.MergeSketches("SNAP_CPU_PERCENT", {}, base + minutes * 60000, base + 2 * minutes * 60000, none), 0);
+    QVERIFY(none.sketch.Empty());
+}
+
+QTEST_GUILESS_MAIN(SketchTest)
+#include "sketch_test.moc"
@@ -0,0 +1,15 @@
+QT = core testlib
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TARGET = sketch_test
+
+# Percentiles merged from per-minute quantile sketches, in memory and
+# through the store's sketches table, against the sorted raw values.
+# Run with "make check".
+
+include(../collector.pri)
+
+SOURCES += \
+    sketch_test.cpp
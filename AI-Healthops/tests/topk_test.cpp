@@ -0,0 +1,226 @@
+#include "proc_topk.h"
+
+#include <QHash>
+#include <QtTest>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Sweeps one second apart from a time on a whole pane
+static const qint64 kBase = 1700000000000;
+static const qint64 kSweepMs = 1000;
+
+// Totals are sums of doubles in a different order than the test's
+static bool near(double a, double b) {
+    return std::abs(a - b) <= 1e-9 * std::max({1.0, std::abs(a), std::abs(b)});
+}
+
+static void addRow(ProcessSnapshot &snapshot, quint32 pid, double cpu_percent, double write_bytes_per_sec) {
+    snapshot.pids.push_back(pid);
+    snapshot.names.push_back(QString("process-%1.exe").arg(pid));
+    snapshot.users.push_back("test");
+    snapshot.kernel_times.push_back(0);
+    snapshot.user_times.push_back(0);
+    snapshot.cpu_user_percent.push_back(cpu_percent);
+    snapshot.cpu_kernel_percent.push_back(0.0);
+    snapshot.working_set.push_back(0);
+    snapshot.io_operations.push_back(0);
+    snapshot.io_ops_per_sec.push_back(0.0);
+    snapshot.io_write_bytes.push_back(0);
+    snapshot.io_write_bytes_per_sec.push_back(write_bytes_per_sec);
+    snapshot.groups.push_back(kAllMetricGroups);
+}
+
+class TopKTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void spaceSavingExactBelowCapacity();
+    void spaceSavingBoundsAfterEvictions();
+    void heavyHittersExactBelowCapacity();
+    void heavyHittersBoundsAfterEvictions();
+    void heavyHittersPaneExpiry();
+};
+
+void TopKTest::spaceSavingExactBelowCapacity()
+{
+    SpaceSaving summary(8);
+    QHash<quint32, double> totals;
+    std::mt19937_64 random(390);
+    std::uniform_real_distribution<double> weight(0.1, 10.0);
+    for (int i = 0; i < 1000; ++i) {
+        const quint32 key = static_cast<quint32>(random() % 8);
+        const double w = weight(random);
+        summary.Add(key, w);
+        totals[key] += w;
+    }
+
+    QVERIFY(summary.Exact());
+    QCOMPARE(summary.MissingBound(), 0.0);
+    QCOMPARE(summary.Counters().size(), static_cast<size_t>(totals.size()));
+    for (const SpaceSaving::Counter &counter : summary.Counters()) {
+        QVERIFY(near(counter.count, totals.value(counter.key)));
+        QCOMPARE(counter.error, 0.0);
+    }
+}
+
+void TopKTest::spaceSavingBoundsAfterEvictions()
+{
+    SpaceSaving summary(16);
+    QHash<quint32, double> totals;
+    std::mt19937_64 random(391);
+    // Skewed keys, so some stay in and some keep evicting each other
+    std::geometric_distribution<int> keys(0.05);
+    std::uniform_real_distribution<double> weight(0.1, 10.0);
+    for (int i = 0; i < 5000; ++i) {
+        const quint32 key = static_cast<quint32>(keys(random));
+        const double w = weight(random);
+        summary.Add(key, w);
+        totals[key] += w;
+    }
+
+    QVERIFY(!summary.Exact());
+    QCOMPARE(summary.Counters().size(), static_cast<size_t>(16));
+    QHash<quint32, bool> counted;
+    for (const SpaceSaving::Counter &counter : summary.Counters()) {
+        const double total = totals.value(counter.key);
+        QVERIFY2(counter.count - counter.error <= total * (1.0 + 1e-9) && total <= counter.count * (1.0 + 1e-9),
+                 qPrintable(QString("key %1: count %2, error %3, total %4").arg(counter.key).arg(counter.count)
+                                .arg(counter.error).arg(total)));
+        counted.insert(counter.key, true);
+    }
+    for (auto it = totals.constBegin(); it != totals.constEnd(); ++it) {
+        if (!counted.contains(it.key())) {
+            QVERIFY(it.value() <= summary.MissingBound() * (1.0 + 1e-9));
+        }
+    }
+}
+
+void TopKTest::heavyHittersExactBelowCapacity()
+{
+    HeavyHitters hitters(60000, 6, 8);
+    const double cpu[] = {50.0, 20.0, 5.0, 1.0};
+    const double writes[] = {0.0, 1024.0, 4096.0, 0.0};
+    const int sweeps = 30;
+    for (int sweep = 0; sweep <= sweeps; ++sweep) {
+        ProcessSnapshot snapshot;
+        snapshot.time_stamp = kBase + sweep * kSweepMs;
+        for (size_t i = 0; i < std::size(cpu); ++i) {
+            addRow(snapshot, static_cast<quint32>(4 * (i + 1)), cpu[i], writes[i]);
+        }
+        hitters.Add(snapshot);
+    }
+
+    // The first sweep only starts the clock
+    QVERIFY(hitters.Exact(ProcessSnapshot::CpuPercent));
+    const std::vector<HeavyHitter> top = hitters.Top(ProcessSnapshot::CpuPercent, 10);
+    QCOMPARE(top.size(), std::size(cpu));
+    for (size_t i = 0; i < top.size(); ++i) {
+        QCOMPARE(top[i].pid, static_cast<quint32>(4 * (i + 1)));
+        QCOMPARE(top[i].process, QString("process-%1.exe").arg(top[i].pid));
+        QVERIFY(near(top[i].amount, cpu[i] / 100.0 * sweeps));
+        QCOMPARE(top[i].error, 0.0);
+    }
+
+    // Processes that wrote nothing are not listed
+    const std::vector<HeavyHitter> written = hitters.Top(ProcessSnapshot::WriteBytesPerSec, 10);
+    QCOMPARE(written.size(), static_cast<size_t>(2));
+    QCOMPARE(written[0].pid, 12u);
+    QVERIFY(near(written[0].amount, 4096.0 * sweeps));
+    QCOMPARE(hitters.Top(ProcessSnapshot::CpuPercent, 2).size(), static_cast<size_t>(2));
+}
+
+void TopKTest::heavyHittersBoundsAfterEvictions()
+{
+    // 5 panes of 2 s and the one being filled; 4 counters each
+    const qint64 windowMs = 10000;
+    const int panes = 5;
+    const qint64 paneMs = windowMs / panes;
+    HeavyHitters hitters(windowMs, panes, 4);
+
+    std::mt19937_64 random(392);
+    std::uniform_real_distribution<double> cpu(0.0, 50.0);
+    std::vector<std::pair<qint64, QHash<quint32, double>>> amounts;   // per integrated sweep
+    const int sweeps = 40;
+    for (int sweep = 0; sweep <= sweeps; ++sweep) {
+        ProcessSnapshot snapshot;
+        snapshot.time_stamp = kBase + sweep * kSweepMs;
+        QHash<quint32, double> added;
+        for (quint32 pid = 4; pid <= 120; pid += 4) {
+            if (random() % 3 == 0) {
+                continue;
+            }
+            const double percent = cpu(random) * (pid <= 16 ? 4.0 : 1.0);
+            addRow(snapshot, pid, percent, 0.0);
+            added[pid] = percent / 100.0 * kSweepMs / 1000.0;
+        }
+        hitters.Add(snapshot);
+        if (sweep > 0) {
+            amounts.emplace_back(snapshot.time_stamp, added);
+        }
+    }
+
+    // What the window covered: whole panes back from the newest sweep's
+    const qint64 newest = (kBase + sweeps * kSweepMs) / paneMs;
+    QHash<quint32, double> totals;
+    for (const auto &[time_stamp, added] : amounts) {
+        if (time_stamp / paneMs >= newest - panes) {
+            for (auto it = added.constBegin(); it != added.constEnd(); ++it) {
+                totals[it.key()] += it.value();
+            }
+        }
+    }
+
+    QVERIFY(!hitters.Exact(ProcessSnapshot::CpuPercent));
+    const std::vector<HeavyHitter> top = hitters.Top(ProcessSnapshot::CpuPercent, 1000);
+    QVERIFY(!top.empty());
+    for (size_t i = 0; i < top.size(); ++i) {
+        const HeavyHitter &hitter = top[i];
+        const double total = totals.value(hitter.pid);
+        QVERIFY2(hitter.amount - hitter.error <= total + 1e-9 && total <= hitter.amount + 1e-9,
+                 qPrintable(QString("pid %1: amount %2, error %3, total %4").arg(hitter.pid).arg(hitter.amount)
+                                .arg(hitter.error).arg(total)));
+        if (i > 0) {
+            QVERIFY(top[i - 1].amount >= hitter.amount);
+        }
+    }
+}
+
+void TopKTest::heavyHittersPaneExpiry()
+{
+    // Panes of 1 s; six of them and the one being filled are kept
+    HeavyHitters hitters(6000, 6, 8);
+    auto sweep = [&hitters](int n, bool early) {
+        ProcessSnapshot snapshot;
+        snapshot.time_stamp = kBase + n * kSweepMs;
+        if (early) {
+            addRow(snapshot, 4, 80.0, 0.0);
+        }
+        addRow(snapshot, 8, 10.0, 0.0);
+        hitters.Add(snapshot);
+    };
+
+    for (int n = 0; n <= 3; ++n) {
+        sweep(n, true);
+    }
+    std::vector<HeavyHitter> top = hitters.Top(ProcessSnapshot::CpuPercent, 10);
+    QCOMPARE(top.size(), static_cast<size_t>(2));
+    QCOMPARE(top[0].pid, 4u);
+    QVERIFY(near(top[0].amount, 0.8 * 3));
+
+    for (int n = 4; n <= 20; ++n) {
+        sweep(n, false);
+    }
+    // Only sweeps 14 to 20 are left in the window, and none from pid 4
+    top = hitters.Top(ProcessSnapshot::CpuPercent, 10);
+    QCOMPARE(top.size(), static_cast<size_t>(1));
+    QCOMPARE(top[0].pid, 8u);
+    QVERIFY(near(top[0].amount, 0.1 * 7));
+    QCOMPARE(top[0].error, 0.0);
+}
+
+QTEST_GUILESS_MAIN(TopKTest)
+#include "topk_test.moc"
@@ -0,0 +1,15 @@
+QT = core testlib
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TARGET = topk_test
+
+# Space-Saving counters and the windowed heavy hitters: exact totals below
+# capacity, amount - error <= total <= amount after evictions, and panes
+# leaving the window. Run with "make check".
+
+include(../collector.pri)
+
+SOURCES += \
+    topk_test.cpp
@@ -0,0 +1,141 @@
+#include "verify.h"
+
+#include <QJsonArray>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QtTest>
+
+// Start of the first sketch bucket; children are placed in minutes after it
+static const qint64 kBase = 1700000000000LL / 60000 * 60000;
+
+// A child that ran for minutes and burned cpu_percent of one core
+static QJsonObject child(quint32 pid, qint64 start_minute, int minutes, double cpu_percent, bool reused = false) {
+    const qint64 elapsed = minutes * 60000LL;
+    QJsonObject truth;
+    truth["elapsed_ms"] = elapsed;
+    truth["cpu_ms"] = cpu_percent * 10.0 * static_cast<double>(elapsed) / 1000.0;
+
+    QJsonObject json;
+    json["group"] = "cpu";
+    json["pid"] = static_cast<qint64>(pid);
+    json["start_ms"] = kBase + start_minute * 60000;
+    json["end_ms"] = kBase + start_minute * 60000 + elapsed;
+    json["reused_pid"] = reused;
+    json["truth"] = truth;
+    return json;
+}
+
+class WorkloadVerifyTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void matchingStorePasses();
+    void wrongCpuFails();
+    void missingChildFails();
+    void overlappingReusedPidIsSkipped();
+    void laterReusedPidIsChecked();
+
+private:
+    // One SNAP_CPU_PERCENT sketch row per minute with the given mean
+    void addSketches(quint32 pid, qint64 start_minute, int minutes, double mean);
+    int verify(const QJsonArray &children);
+
+    std::unique_ptr<QTemporaryDir> dir_;
+    QString dbPath_;
+};
+
+void WorkloadVerifyTest::init()
+{
+    dir_ = std::make_unique<QTemporaryDir>();
+    QVERIFY(dir_->isValid());
+    dbPath_ = dir_->filePath("healthops.db");
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "fixture");
+        db.setDatabaseName(dbPath_);
+        QVERIFY(db.open());
+        // As the collector creates it
+        QVERIFY(QSqlQuery(db).exec("CREATE TABLE sketches (ID INTEGER PRIMARY KEY, PID INTEGER, PROCESS TEXT, METRIC TEXT, START_TIME INTEGER, DURATION INTEGER, COUNT INTEGER, SUM REAL, MIN REAL, MAX REAL, SKETCH BLOB)"));
+    }
+    QSqlDatabase::removeDatabase("fixture");
+}
+
+void WorkloadVerifyTest::cleanup()
+{
+    dir_.reset();
+}
+
+void WorkloadVerifyTest::addSketches(quint32 pid, qint64 start_minute, int minutes, double mean)
+{
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "fixture");
+        db.setDatabaseName(dbPath_);
+        QVERIFY(db.open());
+        QSqlQuery query(db);
+        query.prepare("INSERT INTO sketches (PID, PROCESS, METRIC, START_TIME, DURATION, COUNT, SUM, MIN, MAX) "
+                      "VALUES (?, 'workload_gen', 'SNAP_CPU_PERCENT', ?, 60000, 6, ?, ?, ?)");
+        for (int minute = 0; minute < minutes; ++minute) {
+            query.bindValue(0, pid);
+            query.bindValue(1, kBase + (start_minute + minute) * 60000);
+            query.bindValue(2, mean * 6.0);
+            query.bindValue(3, mean * 0.9);
+            query.bindValue(4, mean * 1.1);
+            QVERIFY(query.exec());
+        }
+    }
+    QSqlDatabase::removeDatabase("fixture");
+}
+
+int WorkloadVerifyTest::verify(const QJsonArray &children)
+{
+    QJsonObject manifest;
+    manifest["children"] = children;
+    manifest["pid_reuses"] = 0;
+    return VerifyManifest(manifest, dbPath_, 0.15);
+}
+
+void WorkloadVerifyTest::matchingStorePasses()
+{
+    addSketches(100, 0, 3, 50.0);
+    addSketches(200, 0, 3, 20.0);
+    QCOMPARE(verify({child(100, 0, 3, 50.0), child(200, 0, 3, 21.0)}), 0);
+}
+
+void WorkloadVerifyTest::wrongCpuFails()
+{
+    addSketches(100, 0, 3, 50.0);
+    addSketches(200, 0, 3, 20.0);
+    QCOMPARE(verify({child(100, 0, 3, 50.0), child(200, 0, 3, 80.0)}), 1);
+}
+
+void WorkloadVerifyTest::missingChildFails()
+{
+    addSketches(100, 0, 3, 50.0);
+    QCOMPARE(verify({child(100, 0, 3, 50.0), child(300, 0, 3, 50.0)}), 1);
+}
+
+void WorkloadVerifyTest::overlappingReusedPidIsSkipped()
+{
+    // Two children held PID 400 within the same minutes; its sketches mix
+    // both, so neither matches its own truth and neither is checked
+    addSketches(400, 0, 2, 50.0);
+    addSketches(400, 2, 2, 5.0);
+    addSketches(100, 0, 4, 30.0);
+    QCOMPARE(verify({child(400, 0, 2, 80.0), child(400, 2, 2, 1.0, true), child(100, 0, 4, 30.0)}), 0);
+}
+
+void WorkloadVerifyTest::laterReusedPidIsChecked()
+{
+    // An hour apart the buckets do not meet, so both holders are checked
+    addSketches(500, 0, 2, 50.0);
+    addSketches(500, 60, 2, 10.0);
+    QCOMPARE(verify({child(500, 0, 2, 50.0), child(500, 60, 2, 10.0, true)}), 0);
+    QCOMPARE(verify({child(500, 0, 2, 50.0), child(500, 60, 2, 40.0, true)}), 1);
+}
+
+QTEST_GUILESS_MAIN(WorkloadVerifyTest)
+#include "workload_verify_test.moc"
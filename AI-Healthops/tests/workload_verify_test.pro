@@ -0,0 +1,19 @@
+QT = core sql testlib
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TARGET = workload_verify_test
+
+# The workload generator's --verify against hand-built sketches tables,
+# including PIDs reused by several children. Qt Core and SQL only, so it
+# runs on Linux too. Run with "make check".
+
+INCLUDEPATH += ../workload
+
+SOURCES += \
+    workload_verify_test.cpp \
+    ../workload/verify.cpp
+
+HEADERS += \
+    ../workload/verify.h
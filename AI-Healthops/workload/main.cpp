@@ -0,0 +1,396 @@
+#include "verify.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QSet>
+#include <QTemporaryFile>
+#include <QTimer>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Synthetic workload for checking the collector against known load. The
+// controller spawns a fleet of copies of itself in child mode, each running
+// one scripted profile, and writes a manifest with every child's PID,
+// lifetime and the ground truth it measured itself. --verify then compares
+// the manifest with what a collector stored in its sketches table.
+//
+// Only Qt Core and SQL are used, so the generator runs on any box without
+// privileges. Measuring needs a collector on the same host, and the
+// collector is Windows-only: on Linux a fleet runs, but --verify has no
+// store to check.
+
+// Every profile works in ticks of this length
+static const int kTickMs = 100;
+
+// Fleet used without a fleet file: one group per profile
+static const char kDefaultFleet[] = R"({
+    "duration_s": 180,
+    "groups": [
+        {"name": "cpu-half", "count": 2, "threads": 1, "cpu_percent": 50},
+        {"name": "cpu-multi", "count": 1, "threads": 4, "cpu_percent": 25},
+        {"name": "leak", "count": 2, "memory_mb_per_min": 120},
+        {"name": "writer", "count": 2, "write_kb_per_s": 2048},
+        {"name": "thread-churn", "count": 1, "thread_churn_per_s": 200, "cpu_percent": 5},
+        {"name": "burst", "count": 6, "lifetime_ms": 700, "respawn": true, "cpu_percent": 100}
+    ]
+})";
+
+// Load of one child
+struct Profile {
+    QString group;
+    int threads = 1;                  // threads burning CPU
+    double cpu_percent = 0.0;         // per thread, of one core
+    double memory_mb_per_min = 0.0;   // allocated, touched and kept
+    double write_kb_per_s = 0.0;      // written and flushed to a temporary file
+    double thread_churn_per_s = 0.0;  // short threads started and joined
+    qint64 lifetime_ms = 0;           // 0 for the whole run
+    bool respawn = false;             // replace the child whenever it exits
+
+    static Profile FromJson(const QJsonObject &json) {
+        Profile profile;
+        profile.group = json["name"].toString();
+        profile.threads = std::max(1, json["threads"].toInt(1));
+        profile.cpu_percent = std::clamp(json["cpu_percent"].toDouble(), 0.0, 100.0);
+        profile.memory_mb_per_min = std::max(0.0, json["memory_mb_per_min"].toDouble());
+        profile.write_kb_per_s = std::max(0.0, json["write_kb_per_s"].toDouble());
+        profile.thread_churn_per_s = std::max(0.0, json["thread_churn_per_s"].toDouble());
+        profile.lifetime_ms = std::max<qint64>(0, json["lifetime_ms"].toInteger());
+        profile.respawn = json["respawn"].toBool();
+        return profile;
+    }
+
+    QJsonObject ToJson() const {
+        QJsonObject json;
+        json["name"] = group;
+        json["threads"] = threads;
+        json["cpu_percent"] = cpu_percent;
+        json["memory_mb_per_min"] = memory_mb_per_min;
+        json["write_kb_per_s"] = write_kb_per_s;
+        json["thread_churn_per_s"] = thread_churn_per_s;
+        json["lifetime_ms"] = lifetime_ms;
+        json["respawn"] = respawn;
+        return json;
+    }
+};
+
+// CPU time of this process, user and kernel, in ms
+static qint64 processCpuMs() {
+#ifdef Q_OS_WIN
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return static_cast<qint64>((k.QuadPart + u.QuadPart) / 10000);
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000LL
+           + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000;
+#endif
+}
+
+// Child mode: runs profile for lifetime_ms and prints the ground truth as
+// one JSON line
+static int runChild(const Profile &profile) {
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+    const auto end = start + std::chrono::milliseconds(profile.lifetime_ms);
+    const auto tick = std::chrono::milliseconds(kTickMs);
+    const qint64 cpuAtStart = processCpuMs();
+
+    // Duty cycle per tick: busy for cpu_percent of it, asleep for the rest
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> burners;
+    if (profile.cpu_percent > 0.0) {
+        const auto busy = std::chrono::duration_cast<Clock::duration>(tick * (profile.cpu_percent / 100.0));
+        for (int i = 0; i < profile.threads; ++i) {
+            burners.emplace_back([&stop, busy, tick]() {
+                volatile quint64 spin = 0;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    const auto periodStart = Clock::now();
+                    while (Clock::now() - periodStart < busy) {
+                        spin = spin + 1;
+                    }
+                    std::this_thread::sleep_until(periodStart + tick);
+                }
+            });
+        }
+    }
+
+    QTemporaryFile output;
+    if (profile.write_kb_per_s > 0.0 && !output.open()) {
+        std::fprintf(stderr, "Could not create a temporary file: %s\n", qPrintable(output.errorString()));
+        return 1;
+    }
+
+    // Memory, writes and thread churn run on this thread, spread over ticks
+    // with the fractions carried over so low rates still add up
+    std::vector<std::unique_ptr<char[]>> blocks;
+    double memoryDue = 0.0;
+    double writeDue = 0.0;
+    double churnDue = 0.0;
+    qint64 allocated = 0;
+    qint64 written = 0;
+    qint64 threadsStarted = 0;
+    const QByteArray chunk(64 * 1024, 'x');
+    auto next = start;
+    while (Clock::now() < end) {
+        memoryDue += profile.memory_mb_per_min * 1024.0 * 1024.0 / 60.0 * kTickMs / 1000.0;
+        if (memoryDue >= 4096.0) {
+            const size_t size = static_cast<size_t>(memoryDue);
+            blocks.emplace_back(new char[size]);
+            std::memset(blocks.back().get(), 0x5a, size);   // touched, so it is in the working set
+            allocated += static_cast<qint64>(size);
+            memoryDue -= static_cast<double>(size);
+        }
+
+        writeDue += profile.write_kb_per_s * 1024.0 * kTickMs / 1000.0;
+        while (writeDue >= 1.0) {
+            const qint64 size = std::min<qint64>(chunk.size(), static_cast<qint64>(writeDue));
+            output.write(chunk.constData(), size);
+            written += size;
+            writeDue -= static_cast<double>(size);
+        }
+        if (output.isOpen()) {
+            output.flush();
+            if (output.size() > 256LL * 1024 * 1024) {
+                output.resize(0);
+                output.seek(0);
+            }
+        }
+
+        churnDue += profile.thread_churn_per_s * kTickMs / 1000.0;
+        while (churnDue >= 1.0) {
+            std::thread([]() {
+                volatile int work = 0;
+                for (int i = 0; i < 1000; ++i) {
+                    work = work + i;
+                }
+            }).join();
+            ++threadsStarted;
+            churnDue -= 1.0;
+        }
+
+        next += tick;
+        std::this_thread::sleep_until(std::min(next, end));
+    }
+
+    stop = true;
+    for (std::thread &burner : burners) {
+        burner.join();
+    }
+
+    const qint64 elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+    QJsonObject truth;
+    truth["elapsed_ms"] = elapsedMs;
+    truth["cpu_ms"] = processCpuMs() - cpuAtStart;
+    truth["allocated_bytes"] = allocated;
+    truth["written_bytes"] = written;
+    truth["threads_started"] = threadsStarted;
+    std::printf("%s\n", QJsonDocument(truth).toJson(QJsonDocument::Compact).constData());
+    return 0;
+}
+
+// Controller mode: keeps the fleet running for duration_ms and collects
+// every child's ground truth
+struct Fleet
+{
+    Fleet(const std::vector<Profile> &profiles, const std::vector<int> &counts, qint64 duration_ms)
+        : profiles_(profiles), counts_(counts), duration_ms_(duration_ms) {}
+
+    void Start() {
+        started_ = QDateTime::currentMSecsSinceEpoch();
+        for (size_t i = 0; i < profiles_.size(); ++i) {
+            for (int n = 0; n < counts_[i]; ++n) {
+                Spawn(i);
+            }
+        }
+        // Children end by themselves; this only catches ones that hang
+        QTimer::singleShot(duration_ms_ + 30000, [this]() {
+            for (QProcess *process : running_) {
+                process->kill();
+            }
+        });
+    }
+
+    QJsonObject Manifest(const QJsonObject &fleet) const {
+        QJsonObject manifest;
+        manifest["started_ms"] = started_;
+        manifest["finished_ms"] = QDateTime::currentMSecsSinceEpoch();
+        manifest["cores"] = static_cast<int>(std::thread::hardware_concurrency());
+        manifest["fleet"] = fleet;
+        manifest["children"] = children_;
+        manifest["pid_reuses"] = pid_reuses_;
+        return manifest;
+    }
+
+    std::function<void()> finished;
+
+private:
+    void Spawn(size_t index) {
+        const qint64 now = QDateTime::currentMSecsSinceEpoch();
+        Profile profile = profiles_[index];
+        const qint64 remaining = started_ + duration_ms_ - now;
+        profile.lifetime_ms = profile.lifetime_ms > 0 ? std::min(profile.lifetime_ms, remaining) : remaining;
+        if (profile.lifetime_ms <= 0) {
+            return;
+        }
+
+        QProcess *process = new QProcess();
+        process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        running_.insert(process);
+        QObject::connect(process, &QProcess::finished, [this, process, index, now](int exitCode, QProcess::ExitStatus) {
+            const quint32 pid = process->property("pid").toUInt();
+            QJsonObject child;
+            child["group"] = profiles_[index].group;
+            child["pid"] = static_cast<qint64>(pid);
+            child["start_ms"] = now;
+            child["end_ms"] = QDateTime::currentMSecsSinceEpoch();
+            child["exit_code"] = exitCode;
+            child["reused_pid"] = process->property("reused").toBool();
+            const QList<QByteArray> lines = process->readAllStandardOutput().trimmed().split('\n');
+            child["truth"] = QJsonDocument::fromJson(lines.last()).object();
+            children_.append(child);
+
+            running_.remove(process);
+            process->deleteLater();
+            if (profiles_[index].respawn) {
+                Spawn(index);
+            }
+            if (running_.isEmpty() && finished) {
+                finished();
+            }
+        });
+        QObject::connect(process, &QProcess::started, [this, process]() {
+            // Short-lived children make the OS hand out PIDs again; the
+            // collector has to tell the processes apart
+            const quint32 pid = static_cast<quint32>(process->processId());
+            process->setProperty("pid", pid);
+            if (seen_pids_.contains(pid)) {
+                process->setProperty("reused", true);
+                ++pid_reuses_;
+            }
+            seen_pids_.insert(pid);
+        });
+        process->start(QCoreApplication::applicationFilePath(),
+                       {"--child", QString::fromUtf8(QJsonDocument(profile.ToJson()).toJson(QJsonDocument::Compact))});
+    }
+
+    std::vector<Profile> profiles_;
+    std::vector<int> counts_;
+    qint64 duration_ms_;
+    qint64 started_ = 0;
+    QSet<QProcess *> running_;
+    QSet<quint32> seen_pids_;
+    QJsonArray children_;
+    int pid_reuses_ = 0;
+};
+
+// Usage:
+//   workload_gen [fleet.json] [--manifest file]      run a fleet
+//   workload_gen --verify manifest.json --db file    check a collector's store
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Synthetic process fleet with known load, and a check of what the collector measured");
+    parser.addHelpOption();
+    parser.addPositionalArgument("fleet", "Fleet description (JSON); a built-in fleet without it.", "[fleet]");
+    const QCommandLineOption manifestOption("manifest", "Write the manifest to <file>.", "file", "workload-manifest.json");
+    const QCommandLineOption verifyOption("verify", "Check the manifest in <file> against a collector's database.", "file");
+    const QCommandLineOption dbOption("db", "Database of the collector to check.", "file");
+    const QCommandLineOption toleranceOption("tolerance", "Allowed relative error in <percent> (default 15).", "percent", "15");
+    const QCommandLineOption childOption("child", "Internal: run one child with <profile>.", "profile");
+    const QCommandLineOption exampleOption("example", "Print the built-in fleet.");
+    childOption.setFlags(QCommandLineOption::HiddenFromHelp);
+    parser.addOptions({manifestOption, verifyOption, dbOption, toleranceOption, childOption, exampleOption});
+    parser.process(app);
+
+    if (parser.isSet(childOption)) {
+        return runChild(Profile::FromJson(QJsonDocument::fromJson(parser.value(childOption).toUtf8()).object()));
+    }
+    if (parser.isSet(exampleOption)) {
+        std::printf("%s\n", kDefaultFleet);
+        return 0;
+    }
+
+    if (parser.isSet(verifyOption)) {
+        QFile file(parser.value(verifyOption));
+        if (!file.open(QIODevice::ReadOnly) || !parser.isSet(dbOption)) {
+            std::fprintf(stderr, "Need a readable manifest and --db\n");
+            return 2;
+        }
+        const int failures = VerifyManifest(QJsonDocument::fromJson(file.readAll()).object(), parser.value(dbOption),
+                                    parser.value(toleranceOption).toDouble() / 100.0);
+        return failures == 0 ? 0 : failures < 0 ? 2 : 1;
+    }
+
+    QByteArray fleetJson = kDefaultFleet;
+    if (!parser.positionalArguments().isEmpty()) {
+        QFile file(parser.positionalArguments().first());
+        if (!file.open(QIODevice::ReadOnly)) {
+            std::fprintf(stderr, "Could not open %s: %s\n", qPrintable(file.fileName()), qPrintable(file.errorString()));
+            return 2;
+        }
+        fleetJson = file.readAll();
+    }
+    const QJsonObject fleet = QJsonDocument::fromJson(fleetJson).object();
+    std::vector<Profile> profiles;
+    std::vector<int> counts;
+    for (const QJsonValue &value : fleet["groups"].toArray()) {
+        profiles.push_back(Profile::FromJson(value.toObject()));
+        counts.push_back(std::max(0, value.toObject()["count"].toInt(1)));
+    }
+    const qint64 durationMs = static_cast<qint64>(fleet["duration_s"].toDouble(60) * 1000);
+    if (profiles.empty() || durationMs <= 0) {
+        std::fprintf(stderr, "The fleet needs groups and a positive duration_s\n");
+        return 2;
+    }
+
+    Fleet runner(profiles, counts, durationMs);
+    const QString manifestPath = parser.value(manifestOption);
+    runner.finished = [&]() {
+        QFile file(manifestPath);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            std::fprintf(stderr, "Could not write %s: %s\n", qPrintable(manifestPath), qPrintable(file.errorString()));
+            app.exit(2);
+            return;
+        }
+        const QJsonObject manifest = runner.Manifest(fleet);
+        file.write(QJsonDocument(manifest).toJson());
+        std::printf("%lld children, %d PIDs reused; manifest in %s\n",
+                    static_cast<long long>(manifest["children"].toArray().size()), manifest["pid_reuses"].toInt(), qPrintable(manifestPath));
+        app.exit(0);
+    };
+    std::printf("Running %zu groups for %lld s\n", profiles.size(), static_cast<long long>(durationMs / 1000));
+    runner.Start();
+    return app.exec();
+}
@@ -0,0 +1,155 @@
+#include "verify.h"
+
+#include <QHash>
+#include <QJsonArray>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+// Children shorter than this are not checked; a process needs a few
+// enumerator sweeps before its sketches mean anything
+static const qint64 kMinVerifiedMs = 60 * 1000;
+
+// Absolute slack of the CPU check in percent of one core, for near-idle children
+static const double kCpuSlackPercent = 2.0;
+
+// Length of one sketch bucket
+static const qint64 kBucketMs = 60 * 1000;
+
+// Mean and range of metric for pid over [from, to] from the sketches table
+struct Measured {
+    qint64 count = 0;
+    double mean = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+};
+
+static Measured measured(QSqlDatabase &db, quint32 pid, const QString &metric, qint64 from, qint64 to) {
+    QSqlQuery query(db);
+    query.prepare("SELECT SUM(COUNT), SUM(SUM), MIN(MIN), MAX(MAX) FROM sketches "
+                  "WHERE PID = :pid AND METRIC = :metric AND START_TIME >= :from AND START_TIME <= :to");
+    query.bindValue(":pid", pid);
+    query.bindValue(":metric", metric);
+    // Buckets are minutes; the first one may start before the child did
+    query.bindValue(":from", from - kBucketMs);
+    query.bindValue(":to", to);
+    Measured result;
+    if (query.exec() && query.next()) {
+        result.count = query.value(0).toLongLong();
+        if (result.count > 0) {
+            result.mean = query.value(1).toDouble() / static_cast<double>(result.count);
+            result.min = query.value(2).toDouble();
+            result.max = query.value(3).toDouble();
+        }
+    }
+    return result;
+}
+
+// Sketch buckets that measured() reads for a child
+static std::pair<qint64, qint64> buckets(const QJsonObject &child) {
+    return {(child["start_ms"].toInteger() - kBucketMs) / kBucketMs, child["end_ms"].toInteger() / kBucketMs};
+}
+
+static int verify(QSqlDatabase &db, const QJsonObject &manifest, double tolerance) {
+    int failures = 0;
+    int checked = 0;
+    int shortSeen = 0;
+    int shortTotal = 0;
+    int shared = 0;
+    auto check = [&](const QJsonObject &child, const char *what, double expected, double actual, double slack) {
+        const double allowed = std::max(std::abs(expected) * tolerance, slack);
+        const bool ok = std::abs(actual - expected) <= allowed;
+        std::printf("%-14s %7lld  %-14s %14.1f %14.1f  %s\n", qPrintable(child["group"].toString()),
+                    static_cast<long long>(child["pid"].toInteger()), what, expected, actual, ok ? "ok" : "FAIL");
+        ++checked;
+        failures += ok ? 0 : 1;
+    };
+
+    // A reused PID mixes the sketches of its holders in every bucket they
+    // share; only children that had theirs to themselves are checked
+    const QJsonArray children = manifest["children"].toArray();
+    QHash<quint32, std::vector<std::pair<qint64, qint64>>> holders;
+    for (const QJsonValue &value : children) {
+        const QJsonObject child = value.toObject();
+        holders[static_cast<quint32>(child["pid"].toInteger())].push_back(buckets(child));
+    }
+
+    std::printf("%-14s %7s  %-14s %14s %14s\n", "group", "pid", "check", "expected", "measured");
+    for (const QJsonValue &value : children) {
+        const QJsonObject child = value.toObject();
+        const QJsonObject truth = child["truth"].toObject();
+        const quint32 pid = static_cast<quint32>(child["pid"].toInteger());
+        const qint64 from = child["start_ms"].toInteger();
+        const qint64 to = child["end_ms"].toInteger();
+        const double seconds = std::max<qint64>(truth["elapsed_ms"].toInteger(), 1) / 1000.0;
+
+        const std::pair<qint64, qint64> own = buckets(child);
+        const auto &spans = holders[pid];
+        const auto overlapping = std::count_if(spans.begin(), spans.end(), [&own](const std::pair<qint64, qint64> &span) {
+            return span.first <= own.second && own.first <= span.second;
+        });
+        if (overlapping > 1) {
+            ++shared;
+            continue;
+        }
+
+        const Measured cpu = measured(db, pid, "SNAP_CPU_PERCENT", from, to);
+        if (to - from < kMinVerifiedMs) {
+            // Bursty children: only whether the enumerator saw them at all
+            ++shortTotal;
+            shortSeen += cpu.count > 0 ? 1 : 0;
+            continue;
+        }
+        if (cpu.count == 0) {
+            std::printf("%-14s %7u  not in the sketches table  FAIL\n", qPrintable(child["group"].toString()), pid);
+            ++checked;
+            ++failures;
+            continue;
+        }
+
+        // Percent of one core, as the enumerator computes it
+        check(child, "cpu %", truth["cpu_ms"].toDouble() / 10.0 / seconds, cpu.mean, kCpuSlackPercent);
+
+        const double written = truth["written_bytes"].toDouble();
+        if (written > 0.0) {
+            const Measured writes = measured(db, pid, "SNAP_IO_WRITEBYTES_PER_SEC", from, to);
+            check(child, "write B/s", written / seconds, writes.mean, 0.0);
+        }
+
+        const double allocated = truth["allocated_bytes"].toDouble();
+        if (allocated > 0.0) {
+            // Growth of the working set between the first and last sweep
+            const Measured memory = measured(db, pid, "SNAP_WORKINGSET", from, to);
+            check(child, "ws growth MB", allocated / 1048576.0, (memory.max - memory.min) / 1048576.0, 4.0);
+        }
+    }
+
+    std::printf("\n%d of %d checks failed (tolerance %.0f%%)\n", failures, checked, tolerance * 100.0);
+    std::printf("%d of %d short-lived children seen by the enumerator; %d PIDs reused, %d children skipped "
+                "for sharing theirs\n",
+                shortSeen, shortTotal, manifest["pid_reuses"].toInt(), shared);
+    return failures;
+}
+
+int VerifyManifest(const QJsonObject &manifest, const QString &dbPath, double tolerance) {
+    int failures;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "verify");
+        db.setDatabaseName(dbPath);
+        if (!db.open()) {
+            std::fprintf(stderr, "Could not open %s: %s\n", qPrintable(dbPath), qPrintable(db.lastError().text()));
+            failures = -1;
+        } else {
+            failures = verify(db, manifest, tolerance);
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase("verify");
+    return failures;
+}
@@ -0,0 +1,14 @@
+#ifndef WORKLOAD_VERIFY_H
+#define WORKLOAD_VERIFY_H
+
+#include <QJsonObject>
+#include <QString>
+
+// Compares the ground truth in a workload manifest with what a collector
+// stored in the sketches table of the database at dbPath, printing one line
+// per check. Children whose PID another child held during the same minutes
+// are skipped, since their sketches cannot be told apart. Returns the
+// number of failed checks, or -1 if the database cannot be opened.
+int VerifyManifest(const QJsonObject &manifest, const QString &dbPath, double tolerance);
+
+#endif // WORKLOAD_VERIFY_H
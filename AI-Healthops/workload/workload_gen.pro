@@ -0,0 +1,19 @@
+QT = core sql
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = workload_gen
+
+# Fleet of child processes with scripted CPU, memory, write and thread
+# churn profiles, and a check of the collector's store against the load
+# the children measured themselves. Qt Core and SQL only, so the fleet
+# also runs on Linux without privileges; the store --verify checks comes
+# from the Windows collector.
+
+SOURCES += \
+    main.cpp \
+    verify.cpp
+
+HEADERS += \
+    verify.h